@@ -42,6 +42,14 @@ class biome_map {
         return height_map_value;
     }
 
+    // Optional. Fills a whole row of the map in one call, so c++ calls the
+    // script once for each x rather than for each tile.
+    void sample_row(int x, array<int>@ out) {
+        for (uint y = 0; y < out.length(); y++) {
+            out[y] = sample(x, int(y));
+        }
+    }
+
     // Maps for trees and bushes
     // name should be used in json file
     float sample_plants(string plant_id, int x, int y) {
@@ -67,6 +75,28 @@ class biome_map {
             return 0.0;
         }
     }
+
+    // Optional. Same as sample_plants for a whole row of the map.
+    void sample_plants_row(string plant_id, int x, array<float>@ out) {
+        if (plant_id == "Flower_1") {
+            // sample the whole row of noise at once
+            array<double> values;
+            flower_noise.sample_grid(x * 4, 0, 0, 4, 1, out.length(), values);
+            for (uint y = 0; y < out.length(); y++) {
+                if (int(values[y]) > 0) {
+                    out[y] = 0.10;
+                }
+                else {
+                    out[y] = 0.0;
+                }
+            }
+        }
+        else {
+            for (uint y = 0; y < out.length(); y++) {
+                out[y] = sample_plants(plant_id, x, int(y));
+            }
+        }
+    }
 }
 
 }
@@ -1,12 +1,28 @@
 #version 450 core
+// gl_DrawIDARB is the index of the chunk in glMultiDrawElementsBaseVertex
+#extension GL_ARB_shader_draw_parameters : require
 
 // Input vertex data, different for all executions of this shader.
-layout(location = 0) in ivec3 vertex_position;
+// Only the position in the chunk (first 15 bits of x) is used.
+layout(location = 0) in uvec2 packed_vertex;
+
+// Origin of each chunk, w is the width of each voxel in tiles.
+layout(std430, binding = 0) readonly buffer ChunkOrigins {
+    ivec4 chunk_origins[];
+};
 
 // Values that stay constant for the whole mesh.
 uniform mat4 depth_MVP;
 
 void
 main() {
+    ivec4 chunk_origin = chunk_origins[gl_DrawIDARB];
+    ivec3 vertex_position = chunk_origin.xyz
+                            + chunk_origin.w
+                                  * ivec3(
+                                      packed_vertex.x & 31u,
+                                      (packed_vertex.x >> 5) & 31u,
+                                      (packed_vertex.x >> 10) & 31u
+                                  );
     gl_Position = depth_MVP * vec4(vertex_position, 1);
 }
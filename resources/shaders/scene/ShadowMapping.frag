@@ -1,6 +1,8 @@
 #version 450 core
 
 flat in uint Vertex_color_id;
+// number of solid tiles next to the vertex, 0 to 2
+in float Ambient_occlusion;
 // Interpolated values from the vertex shaders
 in vec3 Position_worldspace;
 in vec3 Normal_cameraspace;
@@ -41,6 +43,9 @@ main() {
 
     vec3 Vertex_color = vec3(texelFetch(material_color_texture, int(Vertex_color_id), 0).rgb);
 
+    // darken corners next to solid tiles
+    Vertex_color *= 1.0 - 0.15 * Ambient_occlusion;
+
     // Material properties
     vec3 MaterialDiffuseColor = Vertex_color * 0.6;
     vec3 MaterialAmbientColor = diffuse_light_color * MaterialDiffuseColor;
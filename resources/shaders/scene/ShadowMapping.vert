@@ -1,12 +1,20 @@
 #version 450 core
+// gl_DrawIDARB is the index of the chunk in glMultiDrawElementsBaseVertex
+#extension GL_ARB_shader_draw_parameters : require
 
 // Input vertex data, different for all executions of this shader.
-layout(location = 0) in ivec3 vertexPosition_modelspace;
-layout(location = 1) in uint vertex_color_id;
-layout(location = 2) in ivec3 vertexNormal_modelspace_int;
+// x: position in chunk (5 bits each), normal index (3 bits), ambient occlusion
+// (2 bits). y: color id. See util::PackedVertex
+layout(location = 0) in uvec2 packed_vertex;
+
+// Origin of each chunk, w is the width of each voxel in tiles.
+layout(std430, binding = 0) readonly buffer ChunkOrigins {
+    ivec4 chunk_origins[];
+};
 
 // Output data ; will be interpolated for each fragment.
 out uint Vertex_color_id;
+out float Ambient_occlusion;
 out vec3 Position_worldspace;
 out vec3 Normal_cameraspace;
 out vec3 EyeDirection_cameraspace;
@@ -19,12 +27,25 @@ uniform mat4 view_matrix;
 uniform vec3 light_direction;
 uniform mat4 depth_texture_projection;
 
+const ivec3 normals[6] = ivec3[](
+    ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0),
+    ivec3(0, 0, 1), ivec3(0, 0, -1)
+);
+
 void
 main() {
+    ivec3 vertex_position_chunkspace = ivec3(
+        packed_vertex.x & 31u, (packed_vertex.x >> 5) & 31u,
+        (packed_vertex.x >> 10) & 31u
+    );
+    ivec4 chunk_origin = chunk_origins[gl_DrawIDARB];
+    vec3 vertexPosition_modelspace =
+        vec3(chunk_origin.xyz + chunk_origin.w * vertex_position_chunkspace);
+
     // Output position of the vertex, in clip space : MVP * position
     gl_Position = MVP * vec4(vertexPosition_modelspace, 1);
 
-    vec3 vertexNormal_modelspace = vec3(vertexNormal_modelspace_int);
+    vec3 vertexNormal_modelspace = vec3(normals[(packed_vertex.x >> 15) & 7u]);
 
     ShadowCoord = depth_texture_projection * vec4(vertexPosition_modelspace + vertexNormal_modelspace * .5, 1);
 
@@ -43,5 +64,8 @@ main() {
     Normal_cameraspace = (view_matrix * vec4(vertexNormal_modelspace, 0))
                              .xyz;
     // UV of the vertex. No special space for this one.
-    Vertex_color_id = vertex_color_id;
+    Vertex_color_id = packed_vertex.y;
+
+    // number of solid tiles next to the vertex, 0, 1, or 2
+    Ambient_occlusion = float((packed_vertex.x >> 18) & 3u);
 }
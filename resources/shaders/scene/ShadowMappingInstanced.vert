@@ -7,6 +7,7 @@ layout(location = 2) in ivec3 vertexNormal_modelspace;
 layout(location = 3) in ivec4 model_matrix_transform;
 // Output data ; will be interpolated for each fragment.
 out uint Vertex_color_id;
+out float Ambient_occlusion;
 out vec3 Position_worldspace;
 out vec3 Normal_cameraspace;
 out vec3 EyeDirection_cameraspace;
@@ -62,4 +63,7 @@ main() {
 
     // UV of the vertex. No special space for this one.
     Vertex_color_id = vertex_color_id;
+
+    // objects do not have ambient occlusion
+    Ambient_occlusion = 0;
 }
@@ -192,7 +192,7 @@ enum class BindingTarget : GLenum {
     // PIXEL_PACK_BUFFER = GL_PIXEL_PACK_BUFFER
     // PIXEL_UNPACK_BUFFER = GL_PIXEL_UNPACK_BUFFER
     // QUERY_BUFFER = GL_QUERY_BUFFER
-    // SHADER_STORAGE_BUFFER = GL_SHADER_STORAGE_BUFFER
+    SHADER_STORAGE_BUFFER = GL_SHADER_STORAGE_BUFFER,
     // TEXTURE_BUFFER = GL_TEXTURE_BUFFER
     // TRANSFORM_FEEDBACK_BUFFER = GL_TRANSFORM_FEEDBACK_BUFFER
     // UNIFORM_BUFFER = GL_UNIFORM_BUFFER
@@ -26,12 +26,16 @@
 #include "../gl_enums.hpp"
 #include "global_context.hpp"
 #include "logging.hpp"
+#include "util/range_allocator.hpp"
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <concepts>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace gui {
@@ -224,6 +228,23 @@ class VertexBufferObject {
         });
     };
 
+    /**
+     * @brief Construct VertexBufferObject with data, without copying it
+     *
+     * @param std::vector<T>&& data data to send to GPU
+     */
+    inline explicit VertexBufferObject(std::vector<T>&& data) :
+        divisor_(0), size_(0), alloc_size_(0) {
+        GlobalContext& context = GlobalContext::instance();
+        context.push_opengl_task([this, data = std::move(data)]() {
+            LOG_BACKTRACE(
+                logging::opengl_logger, "Buffer ID before generation: {}", buffer_ID_
+            );
+            glGenBuffers(1, &buffer_ID_);
+            this->private_insert_(data.data(), data.size(), 0, 0);
+        });
+    };
+
     /**
      * @brief Construct VertexBufferObject with data
      *
@@ -268,6 +289,31 @@ class VertexBufferObject {
         });
     }
 
+    /**
+     * @brief Change the number of elements, keeping the data in front.
+     *
+     * @details Used with util::RangeAllocator, which gives out ranges of the
+     * whole buffer.
+     */
+    inline void
+    resize(size_t size) {
+        GlobalContext& context = GlobalContext::instance();
+        context.push_opengl_task([this, size]() { this->private_resize_(size); });
+    }
+
+    /**
+     * @brief Move ranges of data. Data not in any range is dropped.
+     *
+     * @param moves ranges from util::RangeAllocator::compact
+     */
+    inline void
+    compact(std::vector<util::RangeAllocator::Move> moves) {
+        GlobalContext& context = GlobalContext::instance();
+        context.push_opengl_task([this, moves = std::move(moves)]() {
+            this->private_compact_(moves);
+        });
+    }
+
     /**
      * @brief Get the divisor
      *
@@ -302,6 +348,13 @@ class VertexBufferObject {
      */
     inline void bind() const;
 
+    /**
+     * @brief Bind this buffer to an indexed binding point.
+     *
+     * @param GLuint index the binding = # in programs
+     */
+    inline void bind_base(GLuint index) const;
+
     /**
      * @brief Get array type.
      *
@@ -362,8 +415,70 @@ class VertexBufferObject {
  private:
     void
     private_insert_(const T* data_begin, size_t data_size, size_t start, size_t end);
+
+    void private_resize_(size_t size);
+
+    void private_compact_(const std::vector<util::RangeAllocator::Move>& moves);
 };
 
+template <class T, BindingTarget Buffer>
+void
+VertexBufferObject<T, Buffer>::private_resize_(size_t size) {
+    if (size == size_) {
+        return;
+    }
+    LOG_BACKTRACE(
+        logging::opengl_logger, "Resizing buffer {} from {} to {} elements.",
+        buffer_ID_, size_, size
+    );
+
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(static_cast<GLenum>(Buffer), new_buffer);
+    glBufferData(
+        static_cast<GLenum>(Buffer), size * sizeof(T), nullptr, GL_DYNAMIC_DRAW
+    );
+    size_t keep = std::min(size_, size);
+    if (keep != 0) {
+        glCopyNamedBufferSubData(buffer_ID_, new_buffer, 0, 0, keep * sizeof(T));
+    }
+
+    glDeleteBuffers(1, &buffer_ID_);
+    buffer_ID_ = new_buffer;
+    size_ = size;
+    alloc_size_ = size;
+}
+
+template <class T, BindingTarget Buffer>
+void
+VertexBufferObject<T, Buffer>::private_compact_(
+    const std::vector<util::RangeAllocator::Move>& moves
+) {
+    LOG_BACKTRACE(
+        logging::opengl_logger, "Compacting {} ranges of buffer {}.", moves.size(),
+        buffer_ID_
+    );
+
+    // ranges may overlap, so they are copied into a new buffer
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(static_cast<GLenum>(Buffer), new_buffer);
+    glBufferData(
+        static_cast<GLenum>(Buffer), size_ * sizeof(T), nullptr, GL_DYNAMIC_DRAW
+    );
+    for (const util::RangeAllocator::Move& move : moves) {
+        assert(move.from + move.size <= size_ && move.to + move.size <= size_);
+        glCopyNamedBufferSubData(
+            buffer_ID_, new_buffer, move.from * sizeof(T), move.to * sizeof(T),
+            move.size * sizeof(T)
+        );
+    }
+
+    glDeleteBuffers(1, &buffer_ID_);
+    buffer_ID_ = new_buffer;
+    alloc_size_ = size_;
+}
+
 template <class T, BindingTarget Buffer>
 void
 VertexBufferObject<T, Buffer>::private_insert_(
@@ -566,6 +681,21 @@ VertexBufferObject<T, Buffer>::bind() const {
     glBindBuffer(static_cast<GLenum>(Buffer), buffer_ID_);
 }
 
+template <class T, BindingTarget Buffer>
+void
+VertexBufferObject<T, Buffer>::bind_base(GLuint index) const {
+    static_assert(
+        Buffer == BindingTarget::SHADER_STORAGE_BUFFER,
+        "Only shader storage buffers have indexed binding points."
+    );
+
+    LOG_BACKTRACE(
+        logging::opengl_logger, "Binding Buffer ID: {} to index {}", buffer_ID_, index
+    );
+
+    glBindBufferBase(static_cast<GLenum>(Buffer), index, buffer_ID_);
+}
+
 template <class T, BindingTarget Buffer>
 #ifdef GCC
 __attribute__((optimize(3)))
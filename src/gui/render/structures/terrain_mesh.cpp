@@ -1,87 +1,204 @@
 #include "terrain_mesh.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <optional>
+#include <utility>
+
 namespace gui {
 
 namespace gpu_data {
 
 namespace detail {
 
-coalesced_data::coalesced_data(
-    const std::unordered_map<ChunkPos, util::Mesh> mesh_map
-) {
-    size_t total_size = 0;
-    size_t total_elements_size = 0;
+void
+coalesced_block::push_back(ChunkPos position, const util::PackedMesh& mesh) {
+    vertex_array.insert(
+        vertex_array.end(), mesh.get_packed_vertices().begin(),
+        mesh.get_packed_vertices().end()
+    );
+    element_array.insert(
+        element_array.end(), mesh.get_indices().begin(), mesh.get_indices().end()
+    );
+    chunk_positions.push_back(position);
+    opaque_faces.push_back(mesh.get_opaque_faces());
+    chunk_origins.emplace_back(mesh.get_center(), mesh.get_scale());
+    num_vertices.push_back(mesh.get_indices().size());
+    num_packed_vertices.push_back(mesh.get_packed_vertices().size());
+
+    if (mesh.get_indices().empty()) {
+        return;
+    }
+    auto max_element =
+        std::max_element(mesh.get_indices().begin(), mesh.get_indices().end());
+    if (*max_element != mesh.get_packed_vertices().size() - 1) {
+        LOG_WARNING(
+            logging::opengl_logger, "Max element: {} and indices offset {} not equal",
+            *max_element, mesh.get_indices().size() - 1
+        );
+    }
+}
+
+namespace {
+
+std::vector<coalesced_block>
+concatenate_blocks(const std::unordered_map<ChunkPos, util::PackedMesh>& mesh_map) {
+    // draws are in the iteration order of mesh_map, TerrainMesh relies on this
+    std::vector<std::pair<ChunkPos, const util::PackedMesh*>> meshes;
+    meshes.reserve(mesh_map.size());
     for (const auto& [pos, mesh] : mesh_map) {
-        total_size += mesh.get_indexed_vertices().size();
-        total_elements_size += mesh.get_indices().size();
+        meshes.emplace_back(pos, &mesh);
     }
-    vertex_array.reserve(total_size);
-    color_array.reserve(total_size);
-    normal_array.reserve(total_size);
 
-    element_array.reserve(total_elements_size);
+    constexpr size_t block_size = coalesced_data::COPY_BLOCK_SIZE;
+    size_t num_blocks = (meshes.size() + block_size - 1) / block_size;
+    std::vector<coalesced_block> blocks(num_blocks);
+    auto copy_block = [&meshes, &blocks](size_t block) {
+        size_t end = std::min((block + 1) * block_size, meshes.size());
+        for (size_t index = block * block_size; index < end; index++) {
+            blocks[block].push_back(meshes[index].first, *meshes[index].second);
+        }
+    };
+
+    if (num_blocks <= 1) {
+        for (size_t block = 0; block < num_blocks; block++) {
+            copy_block(block);
+        }
+        return blocks;
+    }
+    GlobalContext& context = GlobalContext::instance();
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_blocks);
+    for (size_t block = 0; block < num_blocks; block++) {
+        futures.push_back(context.submit_task([&copy_block, block]() {
+            copy_block(block);
+        }));
+    }
+    // every task uses copy_block, so wait for all of them before get rethrows
+    // any exception
+    for (const auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    return blocks;
+}
 
-    size_t offset_size = 0;
-    size_t vertex_offset_size = 0;
+} // namespace
 
-    num_vertices.reserve(mesh_map.size());
-    elements_offsets.reserve(mesh_map.size());
-    base_vertex.reserve(mesh_map.size());
+coalesced_data::coalesced_data(std::vector<coalesced_block>&& data_blocks) :
+    blocks(std::move(data_blocks)) {
+    size_t num_draws = 0;
+    for (const coalesced_block& block : blocks) {
+        num_draws += block.num_vertices.size();
+    }
+    chunk_positions.reserve(num_draws);
+    opaque_faces.reserve(num_draws);
+    chunk_origins.reserve(num_draws);
+    num_vertices.reserve(num_draws);
+    elements_offsets.reserve(num_draws);
+    base_vertex.reserve(num_draws);
+    num_packed_vertices.reserve(num_draws);
 
-    for (const auto& [pos, mesh] : mesh_map) {
-        vertex_array.insert(
-            vertex_array.end(), mesh.get_indexed_vertices().begin(),
-            mesh.get_indexed_vertices().end()
+    size_t offset_size = 0;
+    size_t vertex_offset_size = 0;
+    for (const coalesced_block& block : blocks) {
+        chunk_positions.insert(
+            chunk_positions.end(), block.chunk_positions.begin(),
+            block.chunk_positions.end()
         );
-        color_array.insert(
-            color_array.end(), mesh.get_indexed_color_ids().begin(),
-            mesh.get_indexed_color_ids().end()
+        opaque_faces.insert(
+            opaque_faces.end(), block.opaque_faces.begin(), block.opaque_faces.end()
         );
-        normal_array.insert(
-            normal_array.end(), mesh.get_indexed_normals().begin(),
-            mesh.get_indexed_normals().end()
+        chunk_origins.insert(
+            chunk_origins.end(), block.chunk_origins.begin(), block.chunk_origins.end()
         );
-
-        element_array.insert(
-            element_array.end(), mesh.get_indices().begin(), mesh.get_indices().end()
+        num_vertices.insert(
+            num_vertices.end(), block.num_vertices.begin(), block.num_vertices.end()
         );
-
-        num_vertices.push_back(mesh.get_indices().size());
-        elements_offsets.push_back(
-            offset_size * sizeof(decltype(element_array)::value_type)
+        num_packed_vertices.insert(
+            num_packed_vertices.end(), block.num_packed_vertices.begin(),
+            block.num_packed_vertices.end()
         );
-        base_vertex.push_back(vertex_offset_size);
-
-        offset_size += mesh.get_indices().size();
-        vertex_offset_size += mesh.get_indexed_vertices().size();
-
-        if (offset_size != element_array.size()) {
-            LOG_WARNING(
-                logging::opengl_logger,
-                "Offset size: {} and element array size {} not equal", offset_size,
-                element_array.size()
+        for (size_t draw = 0; draw < block.num_vertices.size(); draw++) {
+            elements_offsets.push_back(
+                offset_size * sizeof(decltype(block.element_array)::value_type)
             );
+            base_vertex.push_back(vertex_offset_size);
+            offset_size += block.num_vertices[draw];
+            vertex_offset_size += block.num_packed_vertices[draw];
         }
+    }
+}
 
-        auto max_element =
-            std::max_element(mesh.get_indices().begin(), mesh.get_indices().end());
+coalesced_data::coalesced_data(
+    const std::unordered_map<ChunkPos, util::PackedMesh>& mesh_map
+) :
+    coalesced_data(concatenate_blocks(mesh_map)) {}
 
-        if (*max_element != mesh.get_indexed_vertices().size() - 1) {
-            LOG_WARNING(
-                logging::opengl_logger,
-                "Max element: {} and indices offset {} not equal", *max_element,
-                mesh.get_indices().size() - 1
-            );
+} // namespace detail
+
+IMeshMultiGPU::IMeshMultiGPU(detail::coalesced_data&& data, bool b) :
+    vertex_array_(), chunk_origins_(data.chunk_origins), element_array_(),
+    num_vertices_(std::move(data.num_vertices)),
+    elements_offsets_(std::move(data.elements_offsets)),
+    base_vertex_(std::move(data.base_vertex)), do_render_(!num_vertices_.empty()),
+    origins_(std::move(data.chunk_origins)) {
+    size_t total_vertices = 0;
+    for (size_t num_packed_vertices : data.num_packed_vertices) {
+        total_vertices += num_packed_vertices;
+    }
+    size_t total_elements = 0;
+    for (GLsizei num_elements : num_vertices_) {
+        total_elements += num_elements;
+    }
+    vertex_allocator_.grow(total_vertices);
+    element_allocator_.grow(total_elements);
+
+    // each block is written to its slot, so the blocks are never joined on the
+    // cpu
+    vertex_array_.resize(total_vertices);
+    element_array_.resize(total_elements);
+    size_t vertex_offset = 0;
+    size_t element_offset = 0;
+    for (detail::coalesced_block& block : data.blocks) {
+        size_t block_vertices = block.vertex_array.size();
+        size_t block_elements = block.element_array.size();
+        if (block_vertices != 0) {
+            vertex_array_.update(std::move(block.vertex_array), vertex_offset);
         }
+        if (block_elements != 0) {
+            element_array_.update(std::move(block.element_array), element_offset);
+        }
+        vertex_offset += block_vertices;
+        element_offset += block_elements;
+    }
+
+    // the buffers start full, so the ranges are given out in order
+    draw_ranges_.reserve(num_vertices_.size());
+    for (size_t index = 0; index < num_vertices_.size(); index++) {
+        DrawRanges ranges{
+            *vertex_allocator_.allocate(data.num_packed_vertices[index]),
+            *element_allocator_.allocate(num_vertices_[index])
+        };
+        assert(
+            ranges.vertices.size == 0
+            || ranges.vertices.offset == static_cast<size_t>(base_vertex_[index])
+        );
+        draw_ranges_.push_back(ranges);
+    }
+
+    if (b) {
+        GlobalContext& context = GlobalContext::instance();
+        context.push_opengl_task([this]() { initialize(); });
     }
 }
-} // namespace detail
 
 void
 IMeshMultiGPU::attach_all() {
     vertex_array_.attach_to_vertex_attribute(0);
-    color_array_.attach_to_vertex_attribute(1);
-    normal_array_.attach_to_vertex_attribute(2);
     element_array_.bind();
 }
 
@@ -92,123 +209,263 @@ IMeshMultiGPU::initialize() {
     vertex_array_object_.release();
 }
 
-size_t
-IMeshMultiGPU::push_back(const util::Mesh& mesh) {
-    // update base_vertex_
-    if (base_vertex_.size() > 0) {
-        base_vertex_.push_back(vertex_array_.size());
-    } else {
-        base_vertex_.push_back(0);
+template <class T, BindingTarget Buffer>
+IMeshMultiGPU::Range
+IMeshMultiGPU::fit_range_(
+    util::RangeAllocator& allocator, VertexBufferObject<T, Buffer>& buffer,
+    Range range, size_t size
+) {
+    if (size <= range.size && size * 2 >= range.size) {
+        return range;
+    }
+    // room to grow a little without moving
+    size_t padded_size = size + size / 8;
+    std::optional<Range> out = allocator.reallocate(range, padded_size);
+    if (!out) {
+        allocator.grow(std::max(
+            allocator.get_capacity() * 2, allocator.get_capacity() + padded_size
+        ));
+        out = allocator.allocate(padded_size);
+        assert(out && "Buffer did not grow enough");
+        buffer.resize(allocator.get_capacity());
+        // the vertex array object still points to the old buffer
+        GlobalContext& context = GlobalContext::instance();
+        context.push_opengl_task([this]() { initialize(); });
     }
-    vertex_array_.update(mesh.get_indexed_vertices(), vertex_array_.size());
-    color_array_.update(mesh.get_indexed_color_ids(), color_array_.size());
-    normal_array_.update(mesh.get_indexed_normals(), normal_array_.size());
+    return *out;
+}
 
-    num_vertices_.push_back(mesh.get_indexed_vertices().size());
-    elements_offsets_.push_back(element_array_.size());
+void
+IMeshMultiGPU::write_draw_(size_t index, const util::PackedMesh& mesh) {
+    const DrawRanges& ranges = draw_ranges_[index];
+    if (!mesh.get_packed_vertices().empty()) {
+        vertex_array_.update(mesh.get_packed_vertices(), ranges.vertices.offset);
+    }
+    if (!mesh.get_indices().empty()) {
+        element_array_.update(mesh.get_indices(), ranges.elements.offset);
+    }
+    origins_[index] = glm::ivec4(mesh.get_center(), mesh.get_scale());
+    chunk_origins_.update({origins_[index]}, static_cast<GLuint>(index));
 
-    element_array_.update(mesh.get_indices(), element_array_.size());
+    num_vertices_[index] = mesh.get_indices().size();
+    elements_offsets_[index] = ranges.elements.offset * sizeof(uint16_t);
+    base_vertex_[index] = ranges.vertices.offset;
+}
 
-    return get_num_objects();
+size_t
+IMeshMultiGPU::push_back(const util::PackedMesh& mesh) {
+    size_t index = draw_ranges_.size();
+    DrawRanges ranges;
+    ranges.vertices = fit_range_(
+        vertex_allocator_, vertex_array_, {}, mesh.get_packed_vertices().size()
+    );
+    ranges.elements =
+        fit_range_(element_allocator_, element_array_, {}, mesh.get_indices().size());
+
+    draw_ranges_.push_back(ranges);
+    origins_.emplace_back();
+    num_vertices_.emplace_back();
+    elements_offsets_.emplace_back();
+    base_vertex_.emplace_back();
+    write_draw_(index, mesh);
+
+    do_render_ = true;
+    return index;
 }
 
 void
-IMeshMultiGPU::replace(size_t index, const util::Mesh& mesh) {
-    assert(index < num_vertices_.size() && "Something Something this will break");
-    size_t start = 0;
-    for (size_t id = 0; id < index; id++) {
-        start += num_vertices_[id];
-    }
-    size_t end = start + num_vertices_[index];
-
-    vertex_array_.insert(mesh.get_indexed_vertices(), start, end);
-    color_array_.insert(mesh.get_indexed_color_ids(), start, end);
-    normal_array_.insert(mesh.get_indexed_normals(), start, end);
-
-    start = elements_offsets_[index];
-    if (index == num_vertices_.size() - 1) {
-        end = element_array_.size();
-    } else {
-        end = elements_offsets_[index + 1];
-    }
-
-    element_array_.insert(mesh.get_indices(), start, end);
-
-    // update base_vertex_
-    if (index == num_vertices_.size() - 1) {
-        if (index != 0) {
-            base_vertex_[index] =
-                base_vertex_[index - 1] + mesh.get_indexed_vertices().size();
-        } else {
-            base_vertex_[index] = mesh.get_indexed_vertices().size();
-        }
-    } else {
-        size_t difference = mesh.get_indexed_vertices().size()
-                            - (base_vertex_[index + 1] - base_vertex_[index]);
-
-        for (size_t i = index + 1; i < num_vertices_.size(); i++) {
-            base_vertex_[index] += difference;
-        }
-    }
+IMeshMultiGPU::replace(size_t index, const util::PackedMesh& mesh) {
+    assert(index < draw_ranges_.size() && "Index out of range");
+    DrawRanges& ranges = draw_ranges_[index];
+    ranges.vertices = fit_range_(
+        vertex_allocator_, vertex_array_, ranges.vertices,
+        mesh.get_packed_vertices().size()
+    );
+    ranges.elements = fit_range_(
+        element_allocator_, element_array_, ranges.elements, mesh.get_indices().size()
+    );
+    write_draw_(index, mesh);
 }
 
 void
 IMeshMultiGPU::remove(size_t index) {
-    assert(index < num_vertices_.size() && "Something Something this will break");
-    size_t start = 0;
-    for (size_t id = 0; id < index; id++) {
-        start += num_vertices_[id];
+    assert(index < draw_ranges_.size() && "Index out of range");
+    vertex_allocator_.free(draw_ranges_[index].vertices);
+    element_allocator_.free(draw_ranges_[index].elements);
+
+    // move the last draw into the gap, so only one origin is written
+    size_t last = draw_ranges_.size() - 1;
+    if (index != last) {
+        draw_ranges_[index] = draw_ranges_[last];
+        origins_[index] = origins_[last];
+        num_vertices_[index] = num_vertices_[last];
+        elements_offsets_[index] = elements_offsets_[last];
+        base_vertex_[index] = base_vertex_[last];
+        chunk_origins_.update({origins_[index]}, static_cast<GLuint>(index));
     }
-    size_t end = start + num_vertices_[index];
+    draw_ranges_.pop_back();
+    origins_.pop_back();
+    num_vertices_.pop_back();
+    elements_offsets_.pop_back();
+    base_vertex_.pop_back();
+
+    do_render_ = !num_vertices_.empty();
+}
 
-    vertex_array_.insert({}, start, end);
-    color_array_.insert({}, start, end);
-    normal_array_.insert({}, start, end);
+namespace {
 
-    start = elements_offsets_[index];
-    if (index == num_vertices_.size() - 1) {
-        end = element_array_.size();
-    } else {
-        end = elements_offsets_[index + 1];
+// offset of the range at from after compaction
+size_t
+moved_offset(const std::vector<util::RangeAllocator::Move>& moves, size_t from) {
+    auto move = std::lower_bound(
+        moves.begin(), moves.end(), from,
+        [](const util::RangeAllocator::Move& move, size_t offset) {
+            return move.from < offset;
+        }
+    );
+    assert(move != moves.end() && move->from == from);
+    return move->to;
+}
+
+// compact when over half the free space is between meshes, and the free
+// space is over a quarter of the buffer
+bool
+should_compact(const util::RangeAllocator& allocator) {
+    size_t free_size = allocator.get_capacity() - allocator.get_used();
+    return allocator.get_fragmentation() > 0.5f
+           && free_size > allocator.get_capacity() / 4;
+}
+
+} // namespace
+
+bool
+IMeshMultiGPU::compact_if_fragmented() {
+    bool compact_vertices = should_compact(vertex_allocator_);
+    bool compact_elements = should_compact(element_allocator_);
+    if (!compact_vertices && !compact_elements) {
+        return false;
     }
 
-    element_array_.insert({}, start, end);
+    if (compact_vertices) {
+        std::vector<util::RangeAllocator::Move> moves = vertex_allocator_.compact();
+        for (size_t index = 0; index < draw_ranges_.size(); index++) {
+            Range& range = draw_ranges_[index].vertices;
+            if (range.size > 0) {
+                range.offset = moved_offset(moves, range.offset);
+                base_vertex_[index] = range.offset;
+            }
+        }
+        vertex_array_.compact(std::move(moves));
+    }
+    if (compact_elements) {
+        std::vector<util::RangeAllocator::Move> moves = element_allocator_.compact();
+        for (size_t index = 0; index < draw_ranges_.size(); index++) {
+            Range& range = draw_ranges_[index].elements;
+            if (range.size > 0) {
+                range.offset = moved_offset(moves, range.offset);
+                elements_offsets_[index] = range.offset * sizeof(uint16_t);
+            }
+        }
+        element_array_.compact(std::move(moves));
+    }
 
-    num_vertices_.erase(num_vertices_.begin() + index);
-    elements_offsets_.erase(elements_offsets_.begin() + index);
+    LOG_DEBUG(
+        logging::opengl_logger,
+        "Compacted terrain buffers. {} of {} vertices and {} of {} elements used.",
+        vertex_allocator_.get_used(), vertex_allocator_.get_capacity(),
+        element_allocator_.get_used(), element_allocator_.get_capacity()
+    );
+
+    // the vertex array object still points to the old buffers
+    GlobalContext& context = GlobalContext::instance();
+    context.push_opengl_task([this]() { initialize(); });
+    return true;
+}
 
-    // update base_vertex_
-    if (index != num_vertices_.size() - 1) {
-        size_t difference = (base_vertex_[index] - base_vertex_[index + 1]);
-        for (size_t i = index + 1; i < num_vertices_.size(); i++) {
-            base_vertex_[index] += difference;
+void
+VisibleTerrainDraws::assign(
+    const std::vector<size_t>& visible, const IMeshMultiGPU& mesh
+) {
+    origins_.clear();
+    num_vertices_.clear();
+    elements_offsets_.clear();
+    base_vertex_.clear();
+    for (size_t index : visible) {
+        if (mesh.get_num_vertices()[index] == 0) {
+            continue;
         }
+        origins_.push_back(mesh.get_origins()[index]);
+        num_vertices_.push_back(mesh.get_num_vertices()[index]);
+        elements_offsets_.push_back(mesh.get_elements_position()[index]);
+        base_vertex_.push_back(mesh.get_base_vertex()[index]);
+    }
+    if (!origins_.empty()) {
+        chunk_origins_.update(origins_, 0);
     }
-    base_vertex_.erase(base_vertex_.begin() + index);
 }
 
 void
-TerrainMesh::push_back(ChunkPos position, const util::Mesh& mesh) {
+VisibleTerrainDraws::bind() const {
+    terrain_mesh_.bind();
+    // replaces the origins of every chunk bound by the terrain mesh
+    chunk_origins_.bind_base(0);
+}
+
+void
+VisibleTerrainDraws::release() const {
+    terrain_mesh_.release();
+}
+
+GPUArayType
+VisibleTerrainDraws::get_element_type() const {
+    return terrain_mesh_.get_element_type();
+}
+
+void
+TerrainMesh::push_back(ChunkPos position, const util::PackedMesh& mesh) {
+    assert(!has_chunk(position) && "Use replace");
     world_position_to_index_[position] = IMeshMultiGPU::push_back(mesh);
+    index_to_world_position_.push_back(position);
+    culler_.set_opaque_faces(position, mesh.get_opaque_faces());
 }
 
 void
-TerrainMesh::replace(ChunkPos position, const util::Mesh& mesh) {
-    IMeshMultiGPU::replace(world_position_to_index_[position], mesh);
+TerrainMesh::replace(ChunkPos position, const util::PackedMesh& mesh) {
+    IMeshMultiGPU::replace(world_position_to_index_.at(position), mesh);
+    culler_.set_opaque_faces(position, mesh.get_opaque_faces());
 }
 
 void
 TerrainMesh::remove(ChunkPos position) {
-    size_t rm_position = world_position_to_index_[position];
-    IMeshMultiGPU::remove(rm_position);
-
+    auto removed = world_position_to_index_.find(position);
+    if (removed == world_position_to_index_.end()) {
+        return;
+    }
+    size_t index = removed->second;
+    IMeshMultiGPU::remove(index);
+
+    // the last draw was moved to index
+    ChunkPos moved = index_to_world_position_.back();
+    index_to_world_position_[index] = moved;
+    index_to_world_position_.pop_back();
+    world_position_to_index_[moved] = index;
     world_position_to_index_.erase(position);
+    culler_.remove(position);
+}
 
-    for (auto& [chunk_position, id] : world_position_to_index_) {
-        if (id > rm_position) {
-            id--;
-        }
-    }
+void
+TerrainMesh::cull(const glm::mat4& view_projection, glm::vec3 camera_position) {
+    const std::vector<size_t>& visible = culler_.cull(
+        index_to_world_position_, terrain::Frustum(view_projection), camera_position
+    );
+    visible_draws_.assign(visible, *this);
+
+    const terrain::ChunkCuller::Counts& counts = culler_.get_counts();
+    LOG_BACKTRACE(
+        logging::opengl_logger,
+        "Drawing {} of {} chunks, {} outside the frustum, {} occluded.",
+        counts.visible(), counts.total, counts.outside_frustum, counts.occluded
+    );
 }
 
 } // namespace gpu_data
@@ -26,6 +26,8 @@
 #include "i_mesh.hpp"
 #include "logging.hpp"
 #include "types.hpp"
+#include "util/range_allocator.hpp"
+#include "world/terrain/chunk_culling.hpp"
 #include "world/terrain/material.hpp"
 
 namespace gui {
@@ -34,29 +36,98 @@ namespace gpu_data {
 
 namespace detail {
 
+/**
+ * @brief The meshes of a run of draws, concatenated
+ *
+ * @details Built by whichever thread finishes the run, so the copy of one run
+ * overlaps meshing and copying the others.
+ */
+struct coalesced_block {
+    std::vector<util::PackedVertex> vertex_array;
+    std::vector<uint16_t> element_array;
+
+    // chunk of each draw
+    std::vector<ChunkPos> chunk_positions;
+    // opaque faces of each draw (see util::PackedMesh::get_opaque_faces)
+    std::vector<uint8_t> opaque_faces;
+    // origin of each chunk, w is the scale (see util::PackedMesh::get_scale)
+    std::vector<glm::ivec4> chunk_origins;
+    // number of elements of each draw
+    std::vector<GLsizei> num_vertices;
+    // number of packed vertices of each draw
+    std::vector<size_t> num_packed_vertices;
+
+    /**
+     * @brief Append mesh as the draw of the chunk at position
+     */
+    void push_back(ChunkPos position, const util::PackedMesh& mesh);
+};
+
 struct coalesced_data {
-    std::vector<glm::ivec3> vertex_array;
-    std::vector<uint16_t> color_array;
-    std::vector<glm::i8vec3> normal_array;
+    // vertex and element data in draw order, written to the buffers one block
+    // at a time
+    std::vector<coalesced_block> blocks;
 
-    std::vector<uint16_t> element_array;
+    std::vector<ChunkPos> chunk_positions;
+    std::vector<uint8_t> opaque_faces;
+    // origin of each chunk, w is the scale (see util::PackedMesh::get_scale)
+    std::vector<glm::ivec4> chunk_origins;
 
     std::vector<GLsizei> num_vertices;
     std::vector<size_t> elements_offsets;
     std::vector<GLint> base_vertex;
+    // number of packed vertices of each chunk
+    std::vector<size_t> num_packed_vertices;
+
+    // meshes copied by one task
+    static constexpr size_t COPY_BLOCK_SIZE = 32;
 
-    coalesced_data(const std::unordered_map<ChunkPos, util::Mesh> mesh_map);
+    /**
+     * @brief Find where each draw of the blocks goes
+     *
+     * @details Only the per draw arrays are built, the vertices and elements
+     * stay in their blocks.
+     */
+    explicit coalesced_data(std::vector<coalesced_block>&& data_blocks);
+
+    /**
+     * @brief Concatenate the meshes in blocks of COPY_BLOCK_SIZE
+     *
+     * @details The blocks are copied on the thread pool. Do not call from the
+     * thread pool.
+     */
+    explicit coalesced_data(
+        const std::unordered_map<ChunkPos, util::PackedMesh>& mesh_map
+    );
 };
 
 } // namespace detail
 
+/**
+ * @brief Many meshes in shared buffers, drawn with one draw call
+ *
+ * @details Each mesh owns a range of the vertex and element buffers, given out
+ * by util::RangeAllocator. A new mesh that fits in the range of the old one is
+ * written in place, and otherwise it moves to a free range. Buffers grow when
+ * there is no free range large enough, and compact_if_fragmented packs the
+ * ranges together again. Changing one mesh does not copy any other mesh.
+ */
 class IMeshMultiGPU : public virtual GPUDataElementsMulti {
  protected:
+    using Range = util::RangeAllocator::Range;
+
+    // ranges of vertex_array_ and element_array_ used by one draw
+    struct DrawRanges {
+        Range vertices;
+        Range elements;
+    };
+
     VertexArrayObject vertex_array_object_;
 
-    VertexBufferObject<glm::ivec3> vertex_array_;
-    VertexBufferObject<uint16_t> color_array_;
-    VertexBufferObject<glm::i8vec3> normal_array_;
+    VertexBufferObject<util::PackedVertex> vertex_array_;
+    // origin and scale of each chunk, read by the shader with the draw id
+    VertexBufferObject<glm::ivec4, BindingTarget::SHADER_STORAGE_BUFFER>
+        chunk_origins_;
     VertexBufferObject<uint16_t, BindingTarget::ELEMENT_ARRAY_BUFFER> element_array_;
 
     std::vector<GLsizei> num_vertices_;    // number of elements to read
@@ -64,6 +135,12 @@ class IMeshMultiGPU : public virtual GPUDataElementsMulti {
     std::vector<GLint> base_vertex_;       // off set into vertex array
     bool do_render_;
 
+    util::RangeAllocator vertex_allocator_;
+    util::RangeAllocator element_allocator_;
+    std::vector<DrawRanges> draw_ranges_;
+    // same as chunk_origins_, kept to move draws when one is removed
+    std::vector<glm::ivec4> origins_;
+
  public:
     IMeshMultiGPU(const IMeshMultiGPU& other) = delete;
     IMeshMultiGPU(IMeshMultiGPU&& other) = default;
@@ -77,22 +154,13 @@ class IMeshMultiGPU : public virtual GPUDataElementsMulti {
      * @details Default constructor
      */
     inline IMeshMultiGPU() :
-        vertex_array_(), color_array_(), normal_array_(), element_array_(),
-        num_vertices_(), do_render_() {
+        vertex_array_(), chunk_origins_(), element_array_(), num_vertices_(),
+        do_render_() {
         GlobalContext& context = GlobalContext::instance();
         context.push_opengl_task([this]() { initialize(); });
     }
 
-    inline IMeshMultiGPU(const detail::coalesced_data data, bool b = true) :
-        vertex_array_(data.vertex_array), color_array_(data.color_array),
-        normal_array_(data.normal_array), element_array_(data.element_array),
-        num_vertices_(data.num_vertices), elements_offsets_(data.elements_offsets),
-        base_vertex_(data.base_vertex), do_render_(data.num_vertices.size()) {
-        if (b) {
-            GlobalContext& context = GlobalContext::instance();
-            context.push_opengl_task([this]() { initialize(); });
-        }
-    }
+    IMeshMultiGPU(detail::coalesced_data&& data, bool b = true);
 
     inline virtual ~IMeshMultiGPU() {}
 
@@ -111,15 +179,51 @@ class IMeshMultiGPU : public virtual GPUDataElementsMulti {
      */
     virtual void attach_all();
 
-    size_t push_back(const util::Mesh& mesh);
+    /**
+     * @brief Add a mesh
+     *
+     * @return size_t index of the new draw
+     */
+    size_t push_back(const util::PackedMesh& mesh);
 
-    void replace(size_t index, const util::Mesh& mesh);
+    /**
+     * @brief Replace the mesh of a draw
+     */
+    void replace(size_t index, const util::PackedMesh& mesh);
 
+    /**
+     * @brief Remove a draw. The last draw is moved to index.
+     */
     void remove(size_t index);
 
+    /**
+     * @brief Pack the ranges of each buffer together if too much of its free
+     * space is in small ranges between meshes.
+     *
+     * @return true if either buffer was compacted
+     */
+    bool compact_if_fragmented();
+
+    // origin and scale of each draw
+    [[nodiscard]] inline const std::vector<glm::ivec4>&
+    get_origins() const noexcept {
+        return origins_;
+    }
+
+    [[nodiscard]] inline const util::RangeAllocator&
+    get_vertex_allocator() const noexcept {
+        return vertex_allocator_;
+    }
+
+    [[nodiscard]] inline const util::RangeAllocator&
+    get_element_allocator() const noexcept {
+        return element_allocator_;
+    }
+
     inline virtual void
     bind() const override {
         vertex_array_object_.bind();
+        chunk_origins_.bind_base(0);
     }
 
     inline virtual void
@@ -158,6 +262,83 @@ class IMeshMultiGPU : public virtual GPUDataElementsMulti {
     }
 
  private:
+    // write the mesh in the ranges of draw index
+    void write_draw_(size_t index, const util::PackedMesh& mesh);
+
+    // find a range of size elements, resizing the buffer if there is none
+    template <class T, BindingTarget Buffer>
+    Range fit_range_(
+        util::RangeAllocator& allocator, VertexBufferObject<T, Buffer>& buffer,
+        Range range, size_t size
+    );
+};
+
+class TerrainMesh;
+
+/**
+ * @brief The draws of a TerrainMesh that passed culling
+ *
+ * @details Uses the buffers of the TerrainMesh, but has its own draw arrays.
+ * The shader finds the origin of each chunk with the draw id, so the origins
+ * of the visible chunks are written to a buffer of their own each time the
+ * draws change. Filled by TerrainMesh::cull.
+ */
+class VisibleTerrainDraws : public virtual GPUDataElementsMulti {
+ private:
+    const TerrainMesh& terrain_mesh_;
+
+    VertexBufferObject<glm::ivec4, BindingTarget::SHADER_STORAGE_BUFFER>
+        chunk_origins_;
+
+    std::vector<glm::ivec4> origins_;
+    std::vector<GLsizei> num_vertices_;
+    std::vector<size_t> elements_offsets_;
+    std::vector<GLint> base_vertex_;
+
+ public:
+    inline explicit VisibleTerrainDraws(const TerrainMesh& terrain_mesh) :
+        terrain_mesh_(terrain_mesh) {}
+
+    VisibleTerrainDraws(const VisibleTerrainDraws& other) = delete;
+    VisibleTerrainDraws& operator=(const VisibleTerrainDraws& other) = delete;
+
+    /**
+     * @brief Draw only the given draws of mesh
+     *
+     * @param visible indices of the draws of mesh to draw
+     */
+    void assign(const std::vector<size_t>& visible, const IMeshMultiGPU& mesh);
+
+    void bind() const override;
+
+    void release() const override;
+
+    inline bool
+    do_render() const override {
+        return !num_vertices_.empty();
+    }
+
+    inline const std::vector<GLsizei>&
+    get_num_vertices() const override {
+        return num_vertices_;
+    }
+
+    GPUArayType get_element_type() const override;
+
+    inline uint32_t
+    get_num_objects() const override {
+        return num_vertices_.size();
+    }
+
+    inline const std::vector<size_t>&
+    get_elements_position() const override {
+        return elements_offsets_;
+    }
+
+    inline const std::vector<GLint>&
+    get_base_vertex() const override {
+        return base_vertex_;
+    }
 };
 
 /**
@@ -174,27 +355,41 @@ class TerrainMesh : public virtual IMeshMultiGPU {
     Texture1D& color_texture_;
 
     std::unordered_map<ChunkPos, size_t> world_position_to_index_;
+    // chunk drawn by each draw
+    std::vector<ChunkPos> index_to_world_position_;
+
+    terrain::ChunkCuller culler_;
+    VisibleTerrainDraws visible_draws_;
 
  public:
     inline TerrainMesh() :
-        color_texture_(terrain::TerrainColorMapping::get_color_texture()) {};
+        color_texture_(terrain::TerrainColorMapping::get_color_texture()),
+        visible_draws_(*this) {};
 
     inline TerrainMesh(Texture1D& color_texture_id) :
-        color_texture_(color_texture_id) {};
+        color_texture_(color_texture_id), visible_draws_(*this) {};
 
     inline TerrainMesh(
-        const std::unordered_map<ChunkPos, util::Mesh> mesh_map,
+        const std::unordered_map<ChunkPos, util::PackedMesh>& mesh_map,
         Texture1D& color_texture_id
     ) :
-        IMeshMultiGPU(detail::coalesced_data(mesh_map), true),
-        color_texture_(color_texture_id) {
-        size_t index = 0;
-        for (const auto& [pos, mesh] : mesh_map) {
+        TerrainMesh(detail::coalesced_data(mesh_map), color_texture_id) {}
+
+    inline TerrainMesh(detail::coalesced_data&& data, Texture1D& color_texture_id) :
+        IMeshMultiGPU(std::move(data), true), color_texture_(color_texture_id),
+        visible_draws_(*this) {
+        // IMeshMultiGPU does not take the chunk positions or opaque faces
+        for (size_t index = 0; index < data.chunk_positions.size(); index++) {
+            ChunkPos pos = data.chunk_positions[index];
             world_position_to_index_[pos] = index;
-            index += 1;
+            culler_.set_opaque_faces(pos, data.opaque_faces[index]);
         }
+        index_to_world_position_ = std::move(data.chunk_positions);
     }
 
+    TerrainMesh(const TerrainMesh& other) = delete;
+    TerrainMesh(TerrainMesh&& other) = delete;
+
     inline virtual ~TerrainMesh() {}
 
     inline void
@@ -207,12 +402,56 @@ class TerrainMesh : public virtual IMeshMultiGPU {
         shadow_texture_ = shadow_texture;
     }
 
-    void push_back(ChunkPos position, const util::Mesh& mesh);
+    // true if the chunk at position has a mesh
+    [[nodiscard]] inline bool
+    has_chunk(ChunkPos position) const {
+        return world_position_to_index_.contains(position);
+    }
+
+    void push_back(ChunkPos position, const util::PackedMesh& mesh);
 
-    void replace(ChunkPos position, const util::Mesh& mesh);
+    void replace(ChunkPos position, const util::PackedMesh& mesh);
 
     void remove(ChunkPos ChunkPos);
 
+    /**
+     * @brief Set the solid faces of a chunk that has no mesh
+     *
+     * @details A solid chunk has no faces to draw, but it still hides the
+     * chunks around it.
+     */
+    inline void
+    set_opaque_faces(ChunkPos position, uint8_t opaque_faces) {
+        culler_.set_opaque_faces(position, opaque_faces);
+    }
+
+    /**
+     * @brief Find the chunks the camera can see, see get_visible_draws
+     *
+     * @param view_projection projection matrix times view matrix of the camera
+     * @param camera_position position of the camera in tiles
+     */
+    void cull(const glm::mat4& view_projection, glm::vec3 camera_position);
+
+    /**
+     * @brief Get the draws that passed the last cull
+     *
+     * @details Draw this from the camera. Shadows should draw the TerrainMesh,
+     * as chunks the camera can not see may cast shadows it can see.
+     */
+    [[nodiscard]] inline const VisibleTerrainDraws&
+    get_visible_draws() const noexcept {
+        return visible_draws_;
+    }
+
+    /**
+     * @brief Get the number of chunks culled by the last cull
+     */
+    [[nodiscard]] inline const terrain::ChunkCuller::Counts&
+    get_cull_counts() const noexcept {
+        return culler_.get_counts();
+    }
+
     inline void
     bind() const override {
         LOG_BACKTRACE(logging::opengl_logger, "Binding Terrain Mesh.");
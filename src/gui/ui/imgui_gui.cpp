@@ -131,6 +131,12 @@ imgui_entry(GLFWwindow* window, world::World& world, world::Climate& climate) {
         main_scene.update_light_direction();
 
         world.update_entities();
+        world.update_nodegroups();
+
+        world.get_terrain_mesh()->cull(
+            controller->get_projection_matrix() * controller->get_view_matrix(),
+            controller->get_position()
+        );
 
         main_scene.update(window_width, window_height);
 
@@ -172,6 +178,13 @@ imgui_entry(GLFWwindow* window, world::World& world, world::Climate& climate) {
                 "Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate,
                 io.Framerate
             );
+            const terrain::ChunkCuller::Counts& cull_counts =
+                world.get_terrain_mesh()->get_cull_counts();
+            ImGui::Text(
+                "Drawing %zu of %zu chunks (%zu outside view, %zu occluded)",
+                cull_counts.visible(), cull_counts.total, cull_counts.outside_frustum,
+                cull_counts.occluded
+            );
             static int breadth_first_search_start[3];
             ImGui::DragInt3(
                 "Start Position", breadth_first_search_start, (1.0F), 0, world.height
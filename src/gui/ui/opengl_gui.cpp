@@ -60,6 +60,11 @@ opengl_entry(GLFWwindow* window, world::World& world, world::Climate& climate) {
         //        controls::computeMatricesFromInputs(window);
         glfwGetWindowSize(window, &window_width, &window_height);
 
+        world.get_terrain_mesh()->cull(
+            controller->get_projection_matrix() * controller->get_view_matrix(),
+            controller->get_position()
+        );
+
         main_scene.update(window_width, window_width);
 
         main_scene.copy_to_window(window_width, window_height);
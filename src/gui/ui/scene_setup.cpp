@@ -298,7 +298,8 @@ setup(
     terrain_mesh->set_shadow_texture(
         scene.get_shadow_map().get_depth_buffer()->value()
     );
-    chunks_render_pipeline->data.push_back(terrain_mesh.get());
+    // chunks the camera can not see may still cast shadows
+    chunks_render_pipeline->data.push_back(&terrain_mesh->get_visible_draws());
     chunks_shadow_pipeline->data.push_back(terrain_mesh.get());
 
     auto z = world.get_terrain_main().get_Z_solid(5, 5, 50);
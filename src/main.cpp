@@ -11,6 +11,7 @@
 #include "world/biome.hpp"
 #include "world/terrain/generation/terrain_map.hpp"
 #include "world/terrain/terrain.hpp"
+#include "world/tests.hpp"
 #include "world/world.hpp"
 
 #include <argh.h>
@@ -445,6 +446,10 @@ tests(const argh::parser& cmdl) {
         return MacroMap(cmdl);
     } else if (run_function == "NoiseTest") {
         return NoiseTest();
+    } else if (run_function == "NoiseGridTest") {
+        return world::noise_grid_test();
+    } else if (run_function == "WorleyNoiseTest") {
+        return world::worley_noise_test();
     } else if (run_function == "SaveTest") {
         return save_test(cmdl);
     } else if (run_function == "PathFinder") {
@@ -455,6 +460,78 @@ tests(const argh::parser& cmdl) {
         return LogTest();
     } else if (run_function == "ChunkDataTest") {
         return ChunkDataTest();
+    } else if (run_function == "TileAccessBenchmark") {
+        size_t size;
+        cmdl("size", 6) >> size;
+        return world::tile_access_benchmark(size);
+    } else if (run_function == "BulkPassBenchmark") {
+        size_t size;
+        cmdl("size", 6) >> size;
+        return world::bulk_pass_benchmark(size);
+    } else if (run_function == "ChunkMemoryReport") {
+        size_t size;
+        cmdl("size", 4) >> size;
+        return world::chunk_memory_report(size);
+    } else if (run_function == "ColumnHeightTest") {
+        return world::column_height_test();
+    } else if (run_function == "PathQueryBenchmark") {
+        size_t size;
+        cmdl("size", 6) >> size;
+        return world::path_query_benchmark(size);
+    } else if (run_function == "NodeGroupGraphTest") {
+        return world::node_group_graph_test();
+    } else if (run_function == "NodeGroupUpdateBenchmark") {
+        return world::nodegroup_update_benchmark();
+    } else if (run_function == "RouteCacheTest") {
+        return world::route_cache_test();
+    } else if (run_function == "PathServiceTest") {
+        return world::path_service_test();
+    } else if (run_function == "DistanceFieldTest") {
+        return world::distance_field_test();
+    } else if (run_function == "MeshingBenchmark") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::meshing_benchmark(size);
+    } else if (run_function == "MeshDedupeBenchmark") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::mesh_dedupe_benchmark(size);
+    } else if (run_function == "FaceMaskTest") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::face_mask_test(size);
+    } else if (run_function == "PackedMeshTest") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::packed_mesh_test(size);
+    } else if (run_function == "RemeshSchedulerTest") {
+        return world::remesh_scheduler_test();
+    } else if (run_function == "RangeAllocatorTest") {
+        return world::range_allocator_test();
+    } else if (run_function == "MeshAllocationBenchmark") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::mesh_allocation_benchmark(size);
+    } else if (run_function == "LodMeshTest") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::lod_mesh_test(size);
+    } else if (run_function == "ChunkCullingTest") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::chunk_culling_test(size);
+    } else if (run_function == "CoalescedDataTest") {
+        size_t size;
+        cmdl("size", 2) >> size;
+        return world::coalesced_data_test(size);
+    } else if (run_function == "BiomeMapTest") {
+        size_t size;
+        cmdl("size", 8) >> size;
+        return world::biome_map_test(size);
+    } else if (run_function == "StampBenchmark") {
+        size_t size;
+        cmdl("size", 16) >> size;
+        return world::stamp_benchmark(size);
     } else if (run_function == "imageTest") {
         return image_test(cmdl);
     } else if (run_function == "LoadManifest") {
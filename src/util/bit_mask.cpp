@@ -0,0 +1,90 @@
+#include "bit_mask.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#  define FUNGAME_AVX2_TARGET 1
+#  include <immintrin.h>
+#endif
+
+namespace bits {
+
+void
+exposed_faces_scalar(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+) {
+    for (size_t i = 0; i < count; i++) {
+        positive[i] = ((below[i] & ~above[i]) >> shift) & keep;
+        negative[i] = ((above[i] & ~below[i]) >> shift) & keep;
+    }
+}
+
+#ifdef FUNGAME_AVX2_TARGET
+
+// The rest of the program is not built with avx2, so only this function uses
+// it. has_avx2 checks the cpu before it is called.
+__attribute__((target("avx2"))) void
+exposed_faces_avx2(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+) {
+    const __m256i keep_mask = _mm256_set1_epi32(static_cast<int>(keep));
+    const __m128i shift_count = _mm_cvtsi32_si128(static_cast<int>(shift));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i row_below =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + i));
+        __m256i row_above =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + i));
+        // andnot(a, b) is ~a & b
+        __m256i out_positive = _mm256_and_si256(
+            _mm256_srl_epi32(_mm256_andnot_si256(row_above, row_below), shift_count),
+            keep_mask
+        );
+        __m256i out_negative = _mm256_and_si256(
+            _mm256_srl_epi32(_mm256_andnot_si256(row_below, row_above), shift_count),
+            keep_mask
+        );
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(positive + i), out_positive);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(negative + i), out_negative);
+    }
+    exposed_faces_scalar(
+        below + i, above + i, positive + i, negative + i, count - i, shift, keep
+    );
+}
+
+bool
+has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#else
+
+void
+exposed_faces_avx2(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+) {
+    exposed_faces_scalar(below, above, positive, negative, count, shift, keep);
+}
+
+bool
+has_avx2() {
+    return false;
+}
+
+#endif
+
+void
+exposed_faces(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+) {
+    if (has_avx2()) {
+        exposed_faces_avx2(below, above, positive, negative, count, shift, keep);
+    } else {
+        exposed_faces_scalar(below, above, positive, negative, count, shift, keep);
+    }
+}
+
+} // namespace bits
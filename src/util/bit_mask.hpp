@@ -0,0 +1,71 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file bit_mask.hpp
+ *
+ * @brief Defines functions that find faces from rows of solid bit masks.
+ *
+ * @ingroup Util
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bits {
+
+/**
+ * @brief Find the faces between two layers of voxels
+ *
+ * @details Each row is a bit mask of which voxels are solid. Row i of below
+ * is next to row i of above. A face points from the solid voxel to the air.
+ * Both output masks are shifted right by shift.
+ *
+ * @param below masks of the first layer
+ * @param above masks of the second layer
+ * @param positive out solid in below and air in above
+ * @param negative out air in below and solid in above
+ * @param count number of rows
+ * @param shift number of bits to shift the result right
+ * @param keep mask of bits to keep after shifting
+ */
+void exposed_faces(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+);
+
+/**
+ * @brief exposed_faces one row at a time.
+ */
+void exposed_faces_scalar(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+);
+
+/**
+ * @brief exposed_faces eight rows at a time. Only call when has_avx2 is true.
+ */
+void exposed_faces_avx2(
+    const uint32_t* below, const uint32_t* above, uint32_t* positive,
+    uint32_t* negative, size_t count, uint32_t shift, uint32_t keep
+);
+
+/**
+ * @brief True if this cpu and build can use exposed_faces_avx2.
+ */
+[[nodiscard]] bool has_avx2();
+
+} // namespace bits
@@ -8,19 +8,42 @@
 
 namespace util {
 
+namespace {
+
+uint16_t
+get_gpu_color_id(
+    const std::unordered_map<MaterialId, const terrain::material_t>& materials,
+    const std::unordered_map<ColorInt, uint16_t>& mapping, MatColorId mat_color_id
+) {
+    MaterialId material_id = (mat_color_id >> 8) & 0xff;
+    ColorId color_id = mat_color_id & 0xff;
+
+    const terrain::material_t& mat = materials.at(material_id);
+    ColorInt color = mat.color.at(color_id).hex_color;
+
+    return mapping.at(color);
+}
+
+} // namespace
+
 void
 Mesh::change_color_indexing(
     const std::unordered_map<MaterialId, const terrain::material_t>& materials,
     const std::unordered_map<ColorInt, uint16_t>& mapping
 ) {
     for (auto& elem : indexed_color_ids_) {
-        MaterialId material_id = (elem >> 8) & 0xff;
-        ColorId color_id = elem & 0xff;
-
-        terrain::material_t mat = materials.at(material_id);
-        ColorInt color = mat.color.at(color_id).hex_color;
+        elem = get_gpu_color_id(materials, mapping, elem);
+    }
+}
 
-        elem = mapping.at(color);
+void
+PackedMesh::change_color_indexing(
+    const std::unordered_map<MaterialId, const terrain::material_t>& materials,
+    const std::unordered_map<ColorInt, uint16_t>& mapping
+) {
+    for (auto& vertex : packed_vertices_) {
+        vertex.y =
+            get_gpu_color_id(materials, mapping, packed_vertex::get_color_id(vertex));
     }
 }
 
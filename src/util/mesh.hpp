@@ -26,10 +26,16 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
 #include <filesystem>
 #include <map>
-#include <optional>
+#include <span>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace util {
@@ -136,37 +142,248 @@ class Mesh {
 }; // class Mesh
 
 /**
- * @brief Analyzes two voxels and returns a vertex representation of the face
+ * @brief Mesh of a chunk with packed vertices
+ *
+ * @details Each vertex is a PackedVertex, eight bytes, instead of the
+ * seventeen bytes of position, color, and normal in Mesh. Positions are
+ * relative to the chunk, and the shader adds the chunk origin, given by
+ * get_center. A mesh of a coarser level of detail has voxels get_scale tiles
+ * wide, and the shader multiplies positions by the scale.
+ *
+ * PackedMesh can only be moved. When a mesh is no longer needed give it to
+ * PackedMeshPool::recycle so its vectors are reused by the next mesh.
+ */
+class PackedMesh {
+    friend class PackedMeshPool;
+
+ protected:
+    // x, y, z length of the mesh
+    glm::ivec3 size_;
+    // position of the chunk, added to every vertex
+    glm::ivec3 center_;
+    // width of each voxel in tiles, every vertex is multiplied by this
+    VoxelDim scale_;
+    // faces of the voxel object that are completely solid, see opaque_faces
+    uint8_t opaque_faces_ = 0;
+    // indices of each vertex that is drawn
+    std::vector<std::uint16_t> indices_;
+    // position, normal, ambient occlusion, and color of each vertex
+    std::vector<PackedVertex> packed_vertices_;
+
+ public:
+    PackedMesh(
+        std::vector<uint16_t>&& indices, std::vector<PackedVertex>&& packed_vertices,
+        glm::ivec3 size, glm::ivec3 center, VoxelDim scale = 1
+    ) :
+        size_(size), center_(center), scale_(scale), indices_(std::move(indices)),
+        packed_vertices_(std::move(packed_vertices)) {}
+
+    PackedMesh() : size_({0, 0, 0}), center_({0, 0, 0}), scale_(1) {}
+
+    PackedMesh(const PackedMesh& other) = delete;
+    PackedMesh(PackedMesh&& other) = default;
+    PackedMesh& operator=(const PackedMesh& other) = delete;
+    PackedMesh& operator=(PackedMesh&& other) = default;
+
+    // x, y, z length of the mesh
+    [[nodiscard]] inline const glm::ivec3&
+    get_size() const noexcept {
+        return size_;
+    }
+
+    // position of the chunk
+    [[nodiscard]] inline const glm::ivec3&
+    get_center() const noexcept {
+        return center_;
+    }
+
+    // width of each voxel in tiles
+    [[nodiscard]] inline VoxelDim
+    get_scale() const noexcept {
+        return scale_;
+    }
+
+    // faces of the voxel object that are completely solid, see opaque_faces
+    [[nodiscard]] inline uint8_t
+    get_opaque_faces() const noexcept {
+        return opaque_faces_;
+    }
+
+    inline void
+    set_opaque_faces(uint8_t opaque_faces) noexcept {
+        opaque_faces_ = opaque_faces;
+    }
+
+    // indices of each vertex that is drawn
+    [[nodiscard]] inline const std::vector<uint16_t>&
+    get_indices() const noexcept {
+        return indices_;
+    }
+
+    // packed vertex data
+    [[nodiscard]] inline const std::vector<PackedVertex>&
+    get_packed_vertices() const noexcept {
+        return packed_vertices_;
+    }
+
+    // number of bytes used by indices and vertices
+    [[nodiscard]] inline size_t
+    get_data_size() const noexcept {
+        return indices_.size() * sizeof(uint16_t)
+               + packed_vertices_.size() * sizeof(PackedVertex);
+    }
+
+    /**
+     * @brief Set the color indexing to what the GPU uses
+     *
+     * @details See Mesh::change_color_indexing.
+     */
+    void change_color_indexing(
+        const std::unordered_map<MaterialId, const terrain::material_t>& materials,
+        const std::unordered_map<ColorInt, uint16_t>& mapping
+    );
+
+}; // class PackedMesh
+
+/**
+ * @brief Per thread pool of the vectors used by PackedMesh
+ *
+ * @details Meshes are remade every time a chunk changes. Instead of freeing
+ * the vectors of the old mesh, they are kept here, and the next mesh made on
+ * this thread uses them. Vectors are grown to the largest mesh seen so far
+ * when they are taken, so once every pooled vector is that large remeshing
+ * does not allocate.
+ */
+class PackedMeshPool {
+    // more than this many vectors are freed
+    static constexpr size_t MAX_POOLED = 256;
+
+    std::vector<std::vector<uint16_t>> indices_;
+    std::vector<std::vector<PackedVertex>> vertices_;
+    // largest vectors given back to this pool
+    size_t max_indices_ = 0;
+    size_t max_vertices_ = 0;
+    // vectors that needed more memory than the pool had, on any thread
+    inline static std::atomic<size_t> allocations_ = 0;
+
+    PackedMeshPool() {
+        indices_.reserve(MAX_POOLED);
+        vertices_.reserve(MAX_POOLED);
+    }
+
+ public:
+    /**
+     * @brief Get the pool of this thread
+     */
+    [[nodiscard]] inline static PackedMeshPool&
+    local() {
+        thread_local PackedMeshPool pool;
+        return pool;
+    }
+
+    // empty vector with the capacity of the largest recycled indices
+    [[nodiscard]] inline std::vector<uint16_t>
+    get_indices() {
+        return take_(indices_, max_indices_);
+    }
+
+    // empty vector with the capacity of the largest recycled vertices
+    [[nodiscard]] inline std::vector<PackedVertex>
+    get_vertices() {
+        return take_(vertices_, max_vertices_);
+    }
+
+    /**
+     * @brief Keep the vectors of mesh to be used again
+     */
+    inline void
+    recycle(PackedMesh&& mesh) {
+        give_(indices_, max_indices_, std::move(mesh.indices_));
+        give_(vertices_, max_vertices_, std::move(mesh.packed_vertices_));
+    }
+
+    // number of vectors in this pool
+    [[nodiscard]] inline size_t
+    size() const noexcept {
+        return indices_.size() + vertices_.size();
+    }
+
+    /**
+     * @brief Number of vectors, on any thread, that needed more memory than
+     * the pool had
+     *
+     * @details Counts vectors taken with less capacity than the largest mesh,
+     * and vectors given back larger than any before, which had to grow while
+     * the mesh was made. Once every pooled vector is as large as the largest
+     * mesh this stops changing.
+     */
+    [[nodiscard]] inline static size_t
+    get_allocations() noexcept {
+        return allocations_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    template <class T>
+    [[nodiscard]] inline static std::vector<T>
+    take_(std::vector<std::vector<T>>& pool, size_t max_size) {
+        std::vector<T> out;
+        if (!pool.empty()) {
+            out = std::move(pool.back());
+            pool.pop_back();
+        }
+        if (out.capacity() < max_size) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+        }
+        out.reserve(max_size);
+        return out;
+    }
+
+    template <class T>
+    inline static void
+    give_(std::vector<std::vector<T>>& pool, size_t& max_size, std::vector<T>&& data) {
+        if (data.size() > max_size) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+        }
+        max_size = std::max(max_size, data.size());
+        if (data.capacity() == 0 || pool.size() >= MAX_POOLED) {
+            return;
+        }
+        data.clear();
+        pool.push_back(std::move(data));
+    }
+};
+
+/**
+ * @brief Analyzes two voxels and writes a vertex representation of the face
  * between them.
  *
  * @details 80+% of this works
  *
- * @return std::optional<std::vector<Vertex>> an optional vector of four
- * vertices. Returned object has a value only if there is a visible interface
- * between the two given voxels.
+ * @param out four vertices of the face, only written if there is a face
+ * @return true if there is a visible interface between the two given voxels
  */
 template <voxel_utility::VoxelLike T>
-std::optional<std::vector<Vertex>>
+bool
 analyze_voxel_interface(
     const T& voxel_object, VoxelOffset position, VoxelOffset major_direction,
-    VoxelOffset minor_direction_1, VoxelOffset minor_direction_2
+    VoxelOffset minor_direction_1, VoxelOffset minor_direction_2,
+    std::array<Vertex, 4>& out
 ) {
     VoxelColorId voxel_a = voxel_object.get_voxel_color_id(position);
 
     VoxelColorId voxel_b = voxel_object.get_voxel_color_id(position + major_direction);
 
     // This tests if there is a visible face between the two voxels
-    // returns a optional without a value when there is not face
+    // returns false when there is not face
     if ((voxel_a == AIR_MAT_COLOR_ID) && (voxel_b == AIR_MAT_COLOR_ID))
-        return {};
+        return false;
     if ((voxel_a != AIR_MAT_COLOR_ID) && (voxel_b != AIR_MAT_COLOR_ID))
-        return {};
+        return false;
 
     VoxelOffset normal = major_direction;
 
     bool should_reverse = false;
 
-    std::vector<Vertex> out;
     // Set color as voxel that is not air
     // set the normal to point from solid to air
     // may need to reverse the direction of drawn vertices so that normal and
@@ -207,14 +424,346 @@ analyze_voxel_interface(
                                         + position_2 * minor_direction_2
                                         + major_direction;
             // clang-format on
-            out.emplace_back(
+            out[x * 2 + y] = Vertex{
                 vertex_position, glm::i8vec3(normal), color, ambient_occlusion
-            );
+            };
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes a vertex representation of a face that is known to be visible
+ *
+ * @details Same as analyze_voxel_interface, but ambient occlusion is read from
+ * the solid masks of the voxel object instead of looking up four voxels.
+ *
+ * @param should_reverse true if the voxel at position + major_direction is
+ * the solid one
+ */
+template <voxel_utility::FaceMaskLike T>
+void
+analyze_exposed_face(
+    const T& voxel_object, VoxelOffset position, size_t dim_major_index,
+    VoxelOffset major_direction, VoxelOffset minor_direction_1,
+    VoxelOffset minor_direction_2, bool should_reverse, std::array<Vertex, 4>& out
+) {
+    size_t dim_minor_index_1 = (dim_major_index + 1) % 3;
+    size_t dim_minor_index_2 = (dim_major_index + 2) % 3;
+
+    VoxelOffset normal = should_reverse ? -major_direction : major_direction;
+    VoxelColorId color = voxel_object.get_voxel_color_id(
+        should_reverse ? position + major_direction : position
+    );
+
+    // masks along minor direction 2 in the layer the normal points to
+    VoxelDim layer = position[dim_major_index] + normal[dim_major_index];
+    VoxelDim minor_index_1 = position[dim_minor_index_1];
+    VoxelDim minor_index_2 = position[dim_minor_index_2];
+    uint32_t row_before =
+        voxel_object.get_solid_mask(dim_minor_index_2, layer, minor_index_1 - 1);
+    uint32_t row = voxel_object.get_solid_mask(dim_minor_index_2, layer, minor_index_1);
+    uint32_t row_after =
+        voxel_object.get_solid_mask(dim_minor_index_2, layer, minor_index_1 + 1);
+    // bit minor_index_2 + 1 is the voxel at minor_index_2
+    bool solid_before_2 = (row >> minor_index_2) & 1;
+    bool solid_after_2 = (row >> (minor_index_2 + 2)) & 1;
+    bool solid_before_1 = (row_before >> (minor_index_2 + 1)) & 1;
+    bool solid_after_1 = (row_after >> (minor_index_2 + 1)) & 1;
+
+    for (VoxelDim x = 0; x < 2; x++) {
+        for (VoxelDim y = 0; y < 2; y++) {
+            VoxelDim position_1;
+            VoxelDim position_2;
+            if (should_reverse) {
+                position_1 = y;
+                position_2 = x;
+            } else {
+                position_1 = x;
+                position_2 = y;
+            }
+            bool solid_1 = position_1 ? solid_after_1 : solid_before_1;
+            bool solid_2 = position_2 ? solid_after_2 : solid_before_2;
+            uint8_t ambient_occlusion = solid_1 + solid_2;
+
+            // clang-format off
+            VoxelOffset vertex_position = position
+                                        + position_1 * minor_direction_1
+                                        + position_2 * minor_direction_2
+                                        + major_direction;
+            // clang-format on
+            out[x * 2 + y] = Vertex{
+                vertex_position, glm::i8vec3(normal), color, ambient_occlusion
+            };
         }
     }
-    return out;
 }
 
+/**
+ * @brief Calls on_face for every visible face in one slice
+ *
+ * @details The slice is the faces between the voxels at major_index and
+ * major_index + 1. Faces are visited in order of minor index 1, then minor
+ * index 2. When the voxel object has solid masks, invisible faces are skipped
+ * with bit operations, otherwise every interface is analyzed.
+ *
+ * @param on_face called with minor index 1, minor index 2, and the corners
+ */
+template <voxel_utility::VoxelLike T, class F>
+void
+for_each_slice_face(
+    const T& voxel_object, size_t dim_major_index, VoxelDim major_index, F&& on_face
+) {
+    size_t dim_minor_index_1 = (dim_major_index + 1) % 3;
+    size_t dim_minor_index_2 = (dim_major_index + 2) % 3;
+
+    VoxelOffset major_direction({0, 0, 0});
+    major_direction[dim_major_index] = 1;
+
+    VoxelOffset minor_direction_1({0, 0, 0});
+    minor_direction_1[dim_minor_index_1] = 1;
+
+    VoxelOffset minor_direction_2({0, 0, 0});
+    minor_direction_2[dim_minor_index_2] = 1;
+
+    VoxelOffset size = voxel_object.get_size();
+    std::array<Vertex, 4> corners;
+
+    if constexpr (voxel_utility::FaceMaskLike<T>) {
+        // one mask per row, so each row must fit in 32 bits
+        std::array<uint32_t, 32> positive;
+        std::array<uint32_t, 32> negative;
+        size_t size_1 = static_cast<size_t>(size[dim_minor_index_1]);
+        assert(size_1 <= positive.size() && size[dim_minor_index_2] <= 32);
+        voxel_object.get_exposed_faces(
+            dim_major_index, major_index, std::span(positive.data(), size_1),
+            std::span(negative.data(), size_1)
+        );
+
+        for (VoxelDim minor_index_1 = 0; minor_index_1 < static_cast<VoxelDim>(size_1);
+             minor_index_1++) {
+            uint32_t exposed = positive[minor_index_1] | negative[minor_index_1];
+            while (exposed) {
+                VoxelDim minor_index_2 = std::countr_zero(exposed);
+                exposed &= exposed - 1;
+
+                VoxelOffset position;
+                position[dim_major_index] = major_index;
+                position[dim_minor_index_1] = minor_index_1;
+                position[dim_minor_index_2] = minor_index_2;
+
+                bool should_reverse = (negative[minor_index_1] >> minor_index_2) & 1;
+                analyze_exposed_face(
+                    voxel_object, position, dim_major_index, major_direction,
+                    minor_direction_1, minor_direction_2, should_reverse, corners
+                );
+                on_face(minor_index_1, minor_index_2, corners);
+            }
+        }
+    } else {
+        for (VoxelDim minor_index_1 = 0; minor_index_1 < size[dim_minor_index_1];
+             minor_index_1++) {
+            for (VoxelDim minor_index_2 = 0; minor_index_2 < size[dim_minor_index_2];
+                 minor_index_2++) {
+                // is there a better way to write this?
+                VoxelOffset position;
+                position[dim_major_index] = major_index;
+                position[dim_minor_index_1] = minor_index_1;
+                position[dim_minor_index_2] = minor_index_2;
+
+                if (analyze_voxel_interface(
+                        voxel_object, position, major_direction, minor_direction_1,
+                        minor_direction_2, corners
+                    )) {
+                    on_face(minor_index_1, minor_index_2, corners);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Collects the vertices and indices of a mesh one slice at a time
+ *
+ * @details Every vertex of a face lies in the plane between the two voxels of
+ * the face, so vertices can only be shared within one slice. Instead of
+ * hashing vertices, each slice has a grid with one entry per vertex position.
+ * At most four faces in a slice meet at a position, so each entry has four
+ * slots for vertex indices. Nothing is allocated per face, and the grid is
+ * reused for every slice.
+ */
+class SliceMeshBuilder {
+    static constexpr uint8_t SLOTS = 4;
+
+    std::vector<uint16_t> indices_;
+    std::vector<VoxelOffset> indexed_vertices_;
+    std::vector<MatColorId> indexed_colors_;
+    std::vector<glm::i8vec3> indexed_normals_;
+    std::vector<uint8_t> indexed_occlusions_;
+
+    VoxelOffset offset_;
+    size_t dim_minor_index_1_ = 0;
+    size_t dim_minor_index_2_ = 1;
+    VoxelDim grid_size_2_ = 0;
+    std::vector<std::array<uint16_t, SLOTS>> slots_;
+    std::vector<uint8_t> slot_counts_;
+
+ public:
+    explicit SliceMeshBuilder(VoxelOffset offset = VoxelOffset(0, 0, 0)) :
+        offset_(offset) {}
+
+    /**
+     * @brief Empty the builder, keeping the allocated memory
+     */
+    inline void
+    reset(VoxelOffset offset) {
+        offset_ = offset;
+        indices_.clear();
+        indexed_vertices_.clear();
+        indexed_colors_.clear();
+        indexed_normals_.clear();
+        indexed_occlusions_.clear();
+    }
+
+    /**
+     * @brief Start a new slice
+     *
+     * @param dim_minor_index_1 first axis of the slice
+     * @param dim_minor_index_2 second axis of the slice
+     * @param size size of the voxel object
+     */
+    inline void
+    begin_slice(size_t dim_minor_index_1, size_t dim_minor_index_2, VoxelOffset size) {
+        dim_minor_index_1_ = dim_minor_index_1;
+        dim_minor_index_2_ = dim_minor_index_2;
+        grid_size_2_ = size[dim_minor_index_2] + 1;
+        size_t grid_size = static_cast<size_t>(size[dim_minor_index_1] + 1)
+                           * static_cast<size_t>(grid_size_2_);
+        slots_.resize(grid_size);
+        slot_counts_.assign(grid_size, 0);
+    }
+
+    /**
+     * @brief Get the index of vertex, adding it if it is not in this slice
+     */
+    inline uint16_t
+    add_vertex(const Vertex& vertex) {
+        size_t grid_index = vertex.position[dim_minor_index_1_] * grid_size_2_
+                            + vertex.position[dim_minor_index_2_];
+        std::array<uint16_t, SLOTS>& slots = slots_[grid_index];
+        uint8_t& count = slot_counts_[grid_index];
+        for (uint8_t slot = 0; slot < count; slot++) {
+            uint16_t index = slots[slot];
+            if (indexed_colors_[index] == vertex.mat_color_id
+                && indexed_normals_[index] == vertex.normal
+                && indexed_occlusions_[index] == vertex.ambient_occlusion) {
+                return index;
+            }
+        }
+
+        uint16_t index = static_cast<uint16_t>(indexed_vertices_.size());
+        indexed_vertices_.push_back(vertex.position + offset_);
+        indexed_colors_.push_back(vertex.mat_color_id);
+        indexed_normals_.push_back(vertex.normal);
+        indexed_occlusions_.push_back(vertex.ambient_occlusion);
+        if (count < SLOTS) {
+            slots[count] = index;
+            count++;
+        }
+        return index;
+    }
+
+    /**
+     * @brief Add the two triangles of a face
+     *
+     * @param corners four corners in the order given by
+     * analyze_voxel_interface
+     */
+    inline void
+    add_face(const std::array<Vertex, 4>& corners) {
+        uint16_t corner_indicies[4];
+        for (size_t i = 0; i < 4; i++) {
+            corner_indicies[i] = add_vertex(corners[i]);
+        }
+        //clang-format off
+
+        /* Figure 1 a
+          0 ------- 1  Wow did you know a square a actually two
+          |       / |  triangles?! This is high level geometry
+          |  1  /   |  that many people don't know. Now add the
+          |   /  2  |  vertices in a counter-clock wise direction
+          | /       |  so that the opengl thinks the normal is
+          2 ------- 3  pointing toward the viewer.
+        */
+
+        //clang-format on
+
+        // triangle 1
+        indices_.push_back(corner_indicies[2]);
+        indices_.push_back(corner_indicies[1]);
+        indices_.push_back(corner_indicies[0]);
+        // triangle 2
+        indices_.push_back(corner_indicies[2]);
+        indices_.push_back(corner_indicies[3]);
+        indices_.push_back(corner_indicies[1]);
+    }
+
+    /**
+     * @brief Create the mesh
+     */
+    [[nodiscard]] inline Mesh
+    build(const std::vector<ColorInt>& color_map, VoxelOffset size) const {
+        return Mesh(
+            indices_, indexed_vertices_, indexed_colors_, indexed_normals_, color_map,
+            size, offset_
+        );
+    }
+
+    /**
+     * @brief Create the mesh with packed vertices
+     *
+     * @details Positions are stored relative to the offset, so every vertex
+     * must be within 31 of the offset. The vectors come from the
+     * PackedMeshPool of this thread.
+     *
+     * @param scale width of each voxel in tiles, the center and size of the
+     * mesh are multiplied by this
+     */
+    [[nodiscard]] inline PackedMesh
+    build_packed(VoxelOffset size, VoxelDim scale = 1) const {
+        PackedMeshPool& pool = PackedMeshPool::local();
+        std::vector<uint16_t> indices = pool.get_indices();
+        indices.assign(indices_.begin(), indices_.end());
+        std::vector<PackedVertex> packed_vertices = pool.get_vertices();
+        packed_vertices.reserve(indexed_vertices_.size());
+        for (size_t i = 0; i < indexed_vertices_.size(); i++) {
+            assert(
+                indexed_vertices_[i].x - offset_.x <= 31
+                && indexed_vertices_[i].y - offset_.y <= 31
+                && indexed_vertices_[i].z - offset_.z <= 31
+            );
+            packed_vertices.push_back(packed_vertex::pack(
+                indexed_vertices_[i] - offset_, indexed_normals_[i],
+                indexed_colors_[i], indexed_occlusions_[i]
+            ));
+        }
+        return PackedMesh(
+            std::move(indices), std::move(packed_vertices), size * scale,
+            offset_ * scale, scale
+        );
+    }
+};
+
+/**
+ * @brief How faces are turned into triangles
+ */
+enum class MeshMode : uint8_t {
+    // two triangles for every visible voxel face
+    FACES,
+    // coplanar faces with the same color and ambient occlusion are merged
+    GREEDY
+};
+
 /*psudocode time
 
 create outs
@@ -231,8 +780,8 @@ for dimension (x,y,z direction)
         unit vector_major = x, y, or z which ever we are on.
         unit minor_axis_1, 2 = the other two
 
-        unordered_map(vertex -> voxel index)
-        (hash map)
+        slice grid(vertex position -> up to four voxel indices)
+        (reset every slice, no hash map)
 
         for minor_position in volume[minor_axis1]:
         for minor_position in volume[minor_axis2]:
@@ -257,38 +806,79 @@ for dimension (x,y,z direction)
 
                     crate vertex object
 
-                    hash vertex into unordered_map
-                    if it is already there use that index
+                    look up vertex position in slice grid
+                    if a vertex with the same normal, color and ambient
+                    occlusion is already there use that index
                         ie add that index to indicies
                     if not
-                        add vertex_object to to hash map
+                        add index to slice grid
                             with index current vertex index
                         add vertex_object to Mesh
                         current_vertex_index +=1
 */
 
 /**
- * @brief Generates a Mesh given a voxel object
- *
- * @details Given a Voxel Object iterates over all the voxels and adds
- * unobscured surfaces to the Mesh.This mesher will have pre-backed ambient
- * occlusion, and will use the same vertex when possible.
+ * @brief Adds every unobscured face of a voxel object to builder
  */
 template <voxel_utility::VoxelLike T>
-Mesh
-ambient_occlusion_mesher(const T& voxel_object) {
-    std::vector<uint16_t> indicies;
-    std::vector<VoxelOffset> indexed_vertices;
-    std::vector<MatColorId> indexed_colors;
-    std::vector<glm::i8vec3> indexed_normals;
-    std::vector<uint8_t> indexed_occlusions;
+void
+add_faces(const T& voxel_object, SliceMeshBuilder& builder) {
+    VoxelOffset size = voxel_object.get_size();
+
+    for (size_t dim_major_index = 0; dim_major_index < 3; dim_major_index++) {
+        size_t dim_minor_index_1 = (dim_major_index + 1) % 3;
+        size_t dim_minor_index_2 = (dim_major_index + 2) % 3;
+
+        for (VoxelDim major_index = -1; major_index < size[dim_major_index];
+             major_index++) {
+            builder.begin_slice(dim_minor_index_1, dim_minor_index_2, size);
+            for_each_slice_face(
+                voxel_object, dim_major_index, major_index,
+                [&builder](VoxelDim, VoxelDim, const std::array<Vertex, 4>& corners) {
+                    builder.add_face(corners);
+                }
+            );
+        }
+    }
+}
 
+/**
+ * @brief Adds every unobscured face of a voxel object to builder, merging
+ * faces into larger quads
+ *
+ * @details Each slice of faces between two layers of voxels is collected into
+ * a 2D grid. A face is described by its color, normal, and the ambient
+ * occlusion of its four corners. Faces whose four corners have the same
+ * ambient occlusion are merged with neighboring faces that are described the
+ * same way, first along minor direction 2, then along minor direction 1.
+ * Faces with different ambient occlusion at the corners are not merged, so
+ * the mesh looks the same as the one from ambient_occlusion_mesher.
+ */
+template <voxel_utility::VoxelLike T>
+void
+add_greedy_faces(const T& voxel_object, SliceMeshBuilder& builder) {
     VoxelOffset size = voxel_object.get_size();
-    VoxelOffset offset = voxel_object.get_offset();
 
-    std::unordered_map<Vertex, uint16_t> vertex_ids;
+    struct Face {
+        bool visible;
+        // can this face be merged with others
+        bool mergeable;
+        // vertices are reversed when the normal points the negative direction
+        bool reversed;
+        std::array<Vertex, 4> corners;
 
-    uint16_t current_vertex_index = 0;
+        [[nodiscard]] inline bool
+        merges_with(const Face& other) const {
+            return visible && other.visible && mergeable && other.mergeable
+                   && corners[0].normal == other.corners[0].normal
+                   && corners[0].mat_color_id == other.corners[0].mat_color_id
+                   && corners[0].ambient_occlusion
+                          == other.corners[0].ambient_occlusion;
+        }
+    };
+
+    // reused so that meshing does not allocate
+    thread_local std::vector<Face> faces;
     for (size_t dim_major_index = 0; dim_major_index < 3; dim_major_index++) {
         size_t dim_minor_index_1 = (dim_major_index + 1) % 3;
         size_t dim_minor_index_2 = (dim_major_index + 2) % 3;
@@ -302,81 +892,218 @@ ambient_occlusion_mesher(const T& voxel_object) {
         VoxelOffset minor_direction_2({0, 0, 0});
         minor_direction_2[dim_minor_index_2] = 1;
 
+        VoxelDim size_1 = size[dim_minor_index_1];
+        VoxelDim size_2 = size[dim_minor_index_2];
+        faces.resize(static_cast<size_t>(size_1) * size_2);
+        auto face_at = [size_2](VoxelDim index_1, VoxelDim index_2) -> Face& {
+            return faces[index_1 * size_2 + index_2];
+        };
+
         for (VoxelDim major_index = -1; major_index < size[dim_major_index];
              major_index++) {
-            for (VoxelDim minor_index_1 = 0; minor_index_1 < size[dim_minor_index_1];
-                 minor_index_1++) {
-                for (VoxelDim minor_index_2 = 0;
-                     minor_index_2 < size[dim_minor_index_2]; minor_index_2++) {
-                    // is there a better way to write this?
-                    VoxelOffset position;
-                    position[dim_major_index] = major_index;
-                    position[dim_minor_index_1] = minor_index_1;
-                    position[dim_minor_index_2] = minor_index_2;
-
-                    auto corners = analyze_voxel_interface(
-                        voxel_object, position, major_direction, minor_direction_1,
-                        minor_direction_2
-                    );
+            builder.begin_slice(dim_minor_index_1, dim_minor_index_2, size);
+            // collect the faces in this slice
+            for (Face& face : faces) {
+                face.visible = false;
+            }
+            for_each_slice_face(
+                voxel_object, dim_major_index, major_index,
+                [&](VoxelDim minor_index_1, VoxelDim minor_index_2,
+                    const std::array<Vertex, 4>& corners) {
+                    Face& face = face_at(minor_index_1, minor_index_2);
+                    face.visible = true;
+                    face.corners = corners;
+                    face.reversed =
+                        corners[0].normal != glm::i8vec3(major_direction);
+                    face.mergeable = true;
+                    for (const Vertex& vertex : corners) {
+                        face.mergeable &=
+                            vertex.ambient_occlusion == corners[0].ambient_occlusion;
+                    }
+                }
+            );
 
-                    if (!corners) {
+            // merge faces into quads
+            for (VoxelDim minor_index_1 = 0; minor_index_1 < size_1; minor_index_1++) {
+                for (VoxelDim minor_index_2 = 0; minor_index_2 < size_2;) {
+                    Face& face = face_at(minor_index_1, minor_index_2);
+                    if (!face.visible) {
+                        minor_index_2++;
                         continue;
                     }
 
-                    uint16_t corner_indicies[4] = {0, 0, 0, 0};
-                    // if the vertex already exists
+                    VoxelDim width_2 = 1;
+                    VoxelDim width_1 = 1;
+                    if (face.mergeable) {
+                        while (minor_index_2 + width_2 < size_2
+                               && face.merges_with(
+                                   face_at(minor_index_1, minor_index_2 + width_2)
+                               )) {
+                            width_2++;
+                        }
+                        while (minor_index_1 + width_1 < size_1) {
+                            bool row_merges = true;
+                            for (VoxelDim index_2 = minor_index_2;
+                                 index_2 < minor_index_2 + width_2; index_2++) {
+                                if (!face.merges_with(
+                                        face_at(minor_index_1 + width_1, index_2)
+                                    )) {
+                                    row_merges = false;
+                                    break;
+                                }
+                            }
+                            if (!row_merges) {
+                                break;
+                            }
+                            width_1++;
+                        }
+                    }
+
+                    // Corners are in the same order as analyze_voxel_interface.
+                    // Stretch each corner that is on the far side of the face.
+                    std::array<Vertex, 4> corners = face.corners;
                     for (size_t i = 0; i < 4; i++) {
-                        const Vertex& vertex = corners.value()[i];
-                        auto index_itr = vertex_ids.find(vertex);
-                        if (index_itr != vertex_ids.end()) {
-                            // The vertex exists add the index
-                            corner_indicies[i] = vertex_ids.at(vertex);
-
-                        } else {
-                            // if the vertex does not already exist
-                            // add the vertex to the map
-                            vertex_ids.insert({vertex, current_vertex_index});
-
-                            indexed_colors.push_back(vertex.mat_color_id);
-                            indexed_normals.push_back(vertex.normal);
-                            indexed_occlusions.push_back(vertex.ambient_occlusion);
-                            indexed_vertices.push_back(vertex.position + offset);
-                            // assign the corner to that index
-                            corner_indicies[i] = current_vertex_index;
-
-                            // increment the index by one
-                            current_vertex_index++;
+                        VoxelDim position_1 = static_cast<VoxelDim>(i / 2);
+                        VoxelDim position_2 = static_cast<VoxelDim>(i % 2);
+                        if (face.reversed) {
+                            std::swap(position_1, position_2);
+                        }
+                        corners[i].position +=
+                            position_1 * (width_1 - 1) * minor_direction_1
+                            + position_2 * (width_2 - 1) * minor_direction_2;
+                    }
+                    builder.add_face(corners);
+
+                    for (VoxelDim index_1 = minor_index_1;
+                         index_1 < minor_index_1 + width_1; index_1++) {
+                        for (VoxelDim index_2 = minor_index_2;
+                             index_2 < minor_index_2 + width_2; index_2++) {
+                            face_at(index_1, index_2).visible = false;
                         }
                     }
-                    //clang-format off
-
-                    /* Figure 1 a
-                      0 ------- 1  Wow did you know a square a actually two
-                      |       / |  triangles?! This is high level geometry
-                      |  1  /   |  that many people don't know. Now add the
-                      |   /  2  |  vertices in a counter-clock wise direction
-                      | /       |  so that the opengl thinks the normal is
-                      2 ------- 3  pointing toward the viewer.
-                    */
-
-                    //clang-format on
-
-                    // triangle 1
-                    indicies.push_back(corner_indicies[2]);
-                    indicies.push_back(corner_indicies[1]);
-                    indicies.push_back(corner_indicies[0]);
-                    // triangle 2
-                    indicies.push_back(corner_indicies[2]);
-                    indicies.push_back(corner_indicies[3]);
-                    indicies.push_back(corner_indicies[1]);
+                    minor_index_2 += width_2;
                 }
             }
         }
     }
-    return Mesh(
-        indicies, indexed_vertices, indexed_colors, indexed_normals,
-        voxel_object.get_color_ids(), size, offset
-    );
+}
+
+/**
+ * @brief Generates a Mesh given a voxel object
+ *
+ * @details Given a Voxel Object iterates over all the voxels and adds
+ * unobscured surfaces to the Mesh.This mesher will have pre-backed ambient
+ * occlusion, and will use the same vertex when possible.
+ *
+ * @param mode MeshMode::GREEDY to merge faces (see add_greedy_faces)
+ */
+template <voxel_utility::VoxelLike T>
+Mesh
+ambient_occlusion_mesher(const T& voxel_object, MeshMode mode = MeshMode::FACES) {
+    SliceMeshBuilder builder(voxel_object.get_offset());
+    if (mode == MeshMode::GREEDY) {
+        add_greedy_faces(voxel_object, builder);
+    } else {
+        add_faces(voxel_object, builder);
+    }
+    return builder.build(voxel_object.get_color_ids(), voxel_object.get_size());
+}
+
+/**
+ * @brief Generates a Mesh given a voxel object, merging faces into larger
+ * quads (see add_greedy_faces)
+ */
+template <voxel_utility::VoxelLike T>
+Mesh
+greedy_ambient_occlusion_mesher(const T& voxel_object) {
+    return ambient_occlusion_mesher(voxel_object, MeshMode::GREEDY);
+}
+
+/**
+ * @brief Find the faces of a voxel object where every voxel is solid
+ *
+ * @details Nothing can be seen through these faces, so a chunk that is
+ * surrounded by such faces of its neighbors does not need to be drawn.
+ *
+ * @return uint8_t bit 2 * axis is set if the face at the low end of axis is
+ * solid, and bit 2 * axis + 1 for the high end, like terrain::ChunkLod::seams
+ */
+template <voxel_utility::VoxelLike T>
+uint8_t
+opaque_faces(const T& voxel_object) {
+    VoxelOffset size(voxel_object.get_size());
+    uint8_t out = 0;
+    for (size_t axis = 0; axis < 3; axis++) {
+        size_t axis_1 = (axis + 1) % 3;
+        size_t axis_2 = (axis + 2) % 3;
+        for (bool above : {false, true}) {
+            bool opaque = true;
+            if constexpr (voxel_utility::FaceMaskLike<T>) {
+                // bit k + 1 of each row is the voxel at k
+                uint32_t bit = 1u << (above ? size[axis] : 1);
+                for (VoxelDim i = 0; i < size[axis_1] && opaque; i++) {
+                    for (VoxelDim j = 0; j < size[axis_2]; j++) {
+                        if (!(voxel_object.get_solid_mask(axis, i, j) & bit)) {
+                            opaque = false;
+                            break;
+                        }
+                    }
+                }
+            } else {
+                VoxelOffset position(0, 0, 0);
+                position[axis] = above ? size[axis] - 1 : 0;
+                for (VoxelDim i = 0; i < size[axis_1] && opaque; i++) {
+                    for (VoxelDim j = 0; j < size[axis_2]; j++) {
+                        position[axis_1] = i;
+                        position[axis_2] = j;
+                        if (voxel_object.get_voxel_color_id(position)
+                            == AIR_MAT_COLOR_ID) {
+                            opaque = false;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (opaque) {
+                out |= 1u << (2 * axis + above);
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Generates a PackedMesh given a voxel object
+ *
+ * @details Same as ambient_occlusion_mesher, but the vertices are packed and
+ * relative to the offset of the voxel object. The voxel object must be at
+ * most 31 voxels along each axis. Once the PackedMeshPool of this thread has
+ * vectors this does not allocate.
+ *
+ * If the voxel object is ScaledVoxelLike, its offset is in units of its
+ * voxels, and the mesh is scaled to tiles (see PackedMesh::get_scale).
+ */
+template <voxel_utility::VoxelLike T>
+PackedMesh
+packed_ambient_occlusion_mesher(
+    const T& voxel_object, MeshMode mode = MeshMode::FACES
+) {
+    // reused so that meshing does not allocate
+    thread_local SliceMeshBuilder builder;
+    builder.reset(voxel_object.get_offset());
+    if (mode == MeshMode::GREEDY) {
+        add_greedy_faces(voxel_object, builder);
+    } else {
+        add_faces(voxel_object, builder);
+    }
+    PackedMesh mesh;
+    if constexpr (voxel_utility::ScaledVoxelLike<T>) {
+        mesh = builder.build_packed(voxel_object.get_size(), voxel_object.get_scale());
+    } else {
+        mesh = builder.build_packed(voxel_object.get_size());
+    }
+    mesh.set_opaque_faces(opaque_faces(voxel_object));
+    return mesh;
 }
 
 } // namespace util
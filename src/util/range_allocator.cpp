@@ -0,0 +1,163 @@
+#include "range_allocator.hpp"
+
+#include <cassert>
+#include <iterator>
+
+namespace util {
+
+RangeAllocator::RangeAllocator(size_t capacity) : capacity_(capacity) {
+    if (capacity > 0) {
+        insert_free_(0, capacity);
+    }
+}
+
+std::optional<RangeAllocator::Range>
+RangeAllocator::allocate(size_t size) {
+    if (size == 0) {
+        return Range{};
+    }
+    auto best = free_by_size_.lower_bound({size, 0});
+    if (best == free_by_size_.end()) {
+        return std::nullopt;
+    }
+    auto [free_size, offset] = *best;
+    erase_free_(free_.find(offset));
+    if (free_size > size) {
+        insert_free_(offset + size, free_size - size);
+    }
+    allocated_.emplace(offset, size);
+    used_ += size;
+    return Range{offset, size};
+}
+
+void
+RangeAllocator::free(Range range) {
+    if (range.size == 0) {
+        return;
+    }
+    auto allocated = allocated_.find(range.offset);
+    assert(allocated != allocated_.end() && allocated->second == range.size);
+    allocated_.erase(allocated);
+    used_ -= range.size;
+    insert_free_(range.offset, range.size);
+}
+
+std::optional<RangeAllocator::Range>
+RangeAllocator::reallocate(Range range, size_t size) {
+    if (range.size == 0) {
+        return allocate(size);
+    }
+    assert(is_allocated(range));
+    if (size == 0) {
+        free(range);
+        return Range{};
+    }
+
+    if (size <= range.size) {
+        if (size * 2 >= range.size) {
+            return range;
+        }
+        // give the back of the range away
+        allocated_[range.offset] = size;
+        used_ -= range.size - size;
+        insert_free_(range.offset + size, range.size - size);
+        return Range{range.offset, size};
+    }
+
+    auto next = free_.find(range.offset + range.size);
+    if (next != free_.end() && range.size + next->second >= size) {
+        size_t extra = size - range.size;
+        size_t next_size = next->second;
+        erase_free_(next);
+        if (next_size > extra) {
+            insert_free_(range.offset + size, next_size - extra);
+        }
+        allocated_[range.offset] = size;
+        used_ += extra;
+        return Range{range.offset, size};
+    }
+
+    // freed first so that it can merge with the free ranges around it
+    free(range);
+    return allocate(size);
+}
+
+void
+RangeAllocator::grow(size_t capacity) {
+    assert(capacity >= capacity_ && "Buffers only grow");
+    if (capacity > capacity_) {
+        insert_free_(capacity_, capacity - capacity_);
+        capacity_ = capacity;
+    }
+}
+
+std::vector<RangeAllocator::Move>
+RangeAllocator::compact() {
+    std::vector<Move> moves;
+    moves.reserve(allocated_.size());
+    std::map<size_t, size_t> compacted;
+    size_t offset = 0;
+    for (const auto& [from, size] : allocated_) {
+        moves.push_back({from, offset, size});
+        compacted.emplace_hint(compacted.end(), offset, size);
+        offset += size;
+    }
+    allocated_ = std::move(compacted);
+
+    free_.clear();
+    free_by_size_.clear();
+    if (offset < capacity_) {
+        insert_free_(offset, capacity_ - offset);
+    }
+    return moves;
+}
+
+bool
+RangeAllocator::is_allocated(Range range) const {
+    auto allocated = allocated_.find(range.offset);
+    return allocated != allocated_.end() && allocated->second == range.size;
+}
+
+size_t
+RangeAllocator::get_largest_free() const {
+    if (free_by_size_.empty()) {
+        return 0;
+    }
+    return free_by_size_.rbegin()->first;
+}
+
+float
+RangeAllocator::get_fragmentation() const {
+    size_t free_size = capacity_ - used_;
+    if (free_size == 0) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(get_largest_free()) / free_size;
+}
+
+void
+RangeAllocator::insert_free_(size_t offset, size_t size) {
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && offset + size == next->first) {
+        size += next->second;
+        next = erase_free_(next);
+    }
+    if (next != free_.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            erase_free_(previous);
+        }
+    }
+    free_.emplace(offset, size);
+    free_by_size_.emplace(size, offset);
+}
+
+std::map<size_t, size_t>::iterator
+RangeAllocator::erase_free_(std::map<size_t, size_t>::iterator it) {
+    free_by_size_.erase({it->second, it->first});
+    return free_.erase(it);
+}
+
+} // namespace util
@@ -0,0 +1,165 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file range_allocator.hpp
+ *
+ * @brief Defines RangeAllocator class
+ *
+ * @ingroup Util
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief Hands out ranges of a buffer, and keeps a list of the free ranges
+ *
+ * @details Sizes and offsets are in elements, not bytes. Allocation takes the
+ * smallest free range that fits. Freed ranges are merged with free neighbors.
+ * Only the bookkeeping is done here. The owner of the buffer copies the data,
+ * so this can be tested without OpenGL.
+ *
+ * Ranges of size zero are never stored. Allocating zero elements returns an
+ * empty range, and freeing an empty range does nothing.
+ */
+class RangeAllocator {
+ public:
+    struct Range {
+        size_t offset = 0;
+        size_t size = 0;
+
+        bool operator==(const Range& other) const = default;
+    };
+
+    // data from offset `from` must be copied to offset `to`
+    struct Move {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+
+ private:
+    size_t capacity_;
+    size_t used_ = 0;
+
+    // offset -> size
+    std::map<size_t, size_t> free_;
+    // (size, offset), to find the smallest free range that fits
+    std::set<std::pair<size_t, size_t>> free_by_size_;
+    // offset -> size
+    std::map<size_t, size_t> allocated_;
+
+ public:
+    /**
+     * @brief Construct a new RangeAllocator with every element free
+     *
+     * @param capacity number of elements in the buffer
+     */
+    explicit RangeAllocator(size_t capacity = 0);
+
+    /**
+     * @brief Allocate a range
+     *
+     * @return std::optional<Range> the range, or nullopt if no free range is
+     * large enough
+     */
+    [[nodiscard]] std::optional<Range> allocate(size_t size);
+
+    /**
+     * @brief Free an allocated range
+     */
+    void free(Range range);
+
+    /**
+     * @brief Resize an allocated range, in place if possible
+     *
+     * @details A range that shrinks to less than half its size keeps only the
+     * front. A range that grows extends into the free range after it if that
+     * is large enough. Otherwise it is moved. The data is not copied, and the
+     * old range is freed even when nullopt is returned.
+     *
+     * @return std::optional<Range> the new range, or nullopt if no free range
+     * is large enough
+     */
+    [[nodiscard]] std::optional<Range> reallocate(Range range, size_t size);
+
+    /**
+     * @brief Add free elements to the end of the buffer
+     */
+    void grow(size_t capacity);
+
+    /**
+     * @brief Move every range to the front of the buffer, keeping their order
+     *
+     * @return std::vector<Move> one move for each allocated range, ordered by
+     * offset. Ranges that do not move have from == to.
+     */
+    [[nodiscard]] std::vector<Move> compact();
+
+    /**
+     * @brief Test if a range is allocated
+     */
+    [[nodiscard]] bool is_allocated(Range range) const;
+
+    [[nodiscard]] inline size_t
+    get_capacity() const noexcept {
+        return capacity_;
+    }
+
+    // number of allocated elements
+    [[nodiscard]] inline size_t
+    get_used() const noexcept {
+        return used_;
+    }
+
+    [[nodiscard]] inline size_t
+    get_num_allocated() const noexcept {
+        return allocated_.size();
+    }
+
+    [[nodiscard]] inline size_t
+    get_num_free_ranges() const noexcept {
+        return free_.size();
+    }
+
+    /**
+     * @brief Get the size of the largest free range
+     */
+    [[nodiscard]] size_t get_largest_free() const;
+
+    /**
+     * @brief Get the part of the free elements not in the largest free range
+     *
+     * @return float 0 if all free elements are in one range, and close to 1 if
+     * they are in many small ranges
+     */
+    [[nodiscard]] float get_fragmentation() const;
+
+ private:
+    void insert_free_(size_t offset, size_t size);
+
+    std::map<size_t, size_t>::iterator
+    erase_free_(std::map<size_t, size_t>::iterator it);
+};
+
+} // namespace util
@@ -13,7 +13,7 @@
 /**
  * @file vertex.hpp
  *
- * @brief Defines Vertex Struct
+ * @brief Defines Vertex Struct and PackedVertex
  *
  * @ingroup ENTITY
  *
@@ -53,6 +53,85 @@ struct Vertex {
     }
 };
 
+/**
+ * @brief Vertex of a chunk mesh packed into eight bytes
+ *
+ * @details x holds the position in the chunk (five bits for each axis), then
+ * the normal index (three bits), then the ambient occlusion (two bits). y is
+ * the color id. The position is relative to the chunk, so it must be between
+ * 0 and 31. The terrain vertex shader unpacks it.
+ */
+using PackedVertex = glm::u32vec2;
+
+namespace packed_vertex {
+
+constexpr uint32_t POSITION_BITS = 5;
+constexpr uint32_t POSITION_MASK = (1u << POSITION_BITS) - 1;
+constexpr uint32_t NORMAL_SHIFT = 3 * POSITION_BITS;
+constexpr uint32_t NORMAL_MASK = 0x7;
+constexpr uint32_t AMBIENT_OCCLUSION_SHIFT = NORMAL_SHIFT + 3;
+constexpr uint32_t AMBIENT_OCCLUSION_MASK = 0x3;
+
+/**
+ * @brief Index of an axis aligned normal. 2 * axis, plus 1 if the normal
+ * points in the negative direction.
+ */
+[[nodiscard]] inline uint32_t
+normal_index(glm::i8vec3 normal) {
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        if (normal[axis] != 0) {
+            return 2 * axis + (normal[axis] < 0);
+        }
+    }
+    return 0;
+}
+
+[[nodiscard]] inline glm::i8vec3
+normal_from_index(uint32_t index) {
+    glm::i8vec3 normal(0, 0, 0);
+    normal[index / 2] = (index % 2) ? -1 : 1;
+    return normal;
+}
+
+[[nodiscard]] inline PackedVertex
+pack(
+    VoxelOffset position, glm::i8vec3 normal, MatColorId color_id,
+    uint8_t ambient_occlusion
+) {
+    uint32_t data = (position.x & POSITION_MASK)
+                    | ((position.y & POSITION_MASK) << POSITION_BITS)
+                    | ((position.z & POSITION_MASK) << (2 * POSITION_BITS))
+                    | (normal_index(normal) << NORMAL_SHIFT)
+                    | ((ambient_occlusion & AMBIENT_OCCLUSION_MASK)
+                       << AMBIENT_OCCLUSION_SHIFT);
+    return PackedVertex(data, color_id);
+}
+
+[[nodiscard]] inline VoxelOffset
+get_position(PackedVertex vertex) {
+    return VoxelOffset(
+        vertex.x & POSITION_MASK, (vertex.x >> POSITION_BITS) & POSITION_MASK,
+        (vertex.x >> (2 * POSITION_BITS)) & POSITION_MASK
+    );
+}
+
+[[nodiscard]] inline glm::i8vec3
+get_normal(PackedVertex vertex) {
+    return normal_from_index((vertex.x >> NORMAL_SHIFT) & NORMAL_MASK);
+}
+
+[[nodiscard]] inline uint8_t
+get_ambient_occlusion(PackedVertex vertex) {
+    return (vertex.x >> AMBIENT_OCCLUSION_SHIFT) & AMBIENT_OCCLUSION_MASK;
+}
+
+[[nodiscard]] inline MatColorId
+get_color_id(PackedVertex vertex) {
+    return static_cast<MatColorId>(vertex.y);
+}
+
+} // namespace packed_vertex
+
 } // namespace util
 
 template <>
@@ -26,8 +26,10 @@
 #include "types.hpp"
 
 #include <array>
+#include <concepts>
 #include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -47,6 +49,38 @@ class VoxelBase {
 template <class T>
 concept VoxelLike = std::is_base_of<voxel_utility::VoxelBase, T>::value;
 
+/**
+ * @brief A VoxelLike object that also stores bit masks of its solid voxels
+ *
+ * @details get_solid_mask(axis, i, j) is a row of voxels along axis, where i
+ * and j are the positions on the axes (axis + 1) % 3 and (axis + 2) % 3. Bit
+ * k + 1 is set if the voxel at k is solid. get_exposed_faces(axis, index,
+ * positive, negative) finds the faces between the voxels at index and
+ * index + 1 on axis. See ChunkData for an example.
+ */
+template <class T>
+concept FaceMaskLike = VoxelLike<T>
+                       && requires(
+                           const T& voxel_object, size_t axis, VoxelDim index,
+                           std::span<uint32_t> out
+                       ) {
+                              {
+                                  voxel_object.get_solid_mask(axis, index, index)
+                              } -> std::same_as<uint32_t>;
+                              voxel_object.get_exposed_faces(axis, index, out, out);
+                          };
+
+/**
+ * @brief A VoxelLike object where each voxel is get_scale tiles wide
+ *
+ * @details The offset of the object is in units of its voxels. See
+ * ChunkLodData for an example.
+ */
+template <class T>
+concept ScaledVoxelLike = VoxelLike<T> && requires(const T& voxel_object) {
+    { voxel_object.get_scale() } -> std::same_as<VoxelDim>;
+};
+
 class VoxelObject : VoxelBase {
  private:
     std::vector<VoxelColorId> data_;
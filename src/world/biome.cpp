@@ -5,14 +5,20 @@
 #include "logging.hpp"
 #include "util/files.hpp"
 
+#include <scriptarray.h>
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmissing-braces"
 #include <glaze/glaze.hpp>
 #pragma clang diagnostic pop
 
+#include <algorithm>
+#include <cassert>
 #include <filesystem>
+#include <future>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace terrain {
@@ -83,10 +89,72 @@ Biome::Biome(biome_json_data biome_data, size_t seed) :
     }
 }
 
+namespace {
+
+// Split x in [0, length) into blocks, and call
+// function(local_context, biome_map, x_begin, x_end) for each block on the
+// thread pool. Every block makes its own biome map object, and runs it on the
+// script context of its thread, so sample methods must not depend on earlier
+// calls. Returns false if any block fails. Waits for every block, so calling
+// this from a task on the GlobalContext thread pool can deadlock; it must run on
+// the main thread.
+template <class F>
+bool
+for_each_map_block(
+    AngelScript::asIScriptFunction* factory_function, size_t length, size_t num_tasks,
+    F function
+) {
+    if (num_tasks == 0) {
+        num_tasks = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    num_tasks = std::min(num_tasks, length);
+
+    auto run_block = [&function, factory_function](size_t x_begin, size_t x_end) {
+        auto& local_context = LocalContext::instance();
+
+        auto result = local_context.run_function(factory_function);
+        if (!result) {
+            LOG_ERROR(logging::main_logger, "Failed AngelScript getting biome map");
+            return false;
+        }
+        AngelScript::asIScriptObject* biome_map = local_context.get_return_object();
+        if (biome_map == nullptr) {
+            LOG_ERROR(logging::main_logger, "Failed to get object");
+            return false;
+        }
+        biome_map->AddRef();
+        bool success = function(local_context, biome_map, x_begin, x_end);
+        biome_map->Release();
+        return success;
+    };
+
+    GlobalContext& global_context = GlobalContext::instance();
+    assert(
+        global_context.is_main_thread()
+        && "Biome maps must not be sampled from the thread pool."
+    );
+    std::vector<std::future<bool>> futures;
+    futures.reserve(num_tasks);
+    for (size_t task = 0; task < num_tasks; task++) {
+        size_t x_begin = length * task / num_tasks;
+        size_t x_end = length * (task + 1) / num_tasks;
+        futures.push_back(global_context.submit_task([&run_block, x_begin, x_end]() {
+            return run_block(x_begin, x_end);
+        }));
+    }
+    // every task uses run_block, so wait for all of them
+    bool success = true;
+    for (auto& future : futures) {
+        success = future.get() && success;
+    }
+    return success;
+}
+
+} // namespace
+
 TerrainMacroMap
-Biome::get_map(MacroDim size) const {
+Biome::get_map(MacroDim size, size_t num_tasks) const {
     auto& global_context = GlobalContext::instance();
-    auto& local_context = LocalContext::instance();
 
     auto type = global_context.get_type("Base", "Base::biomes::biome_map");
     if (type == nullptr) {
@@ -95,125 +163,200 @@ Biome::get_map(MacroDim size) const {
     auto factory_function =
         type->GetFactoryByDecl("Base::biomes::biome_map@ biome_map()");
 
-    auto result = local_context.run_function(factory_function);
-    if (!result) {
-        LOG_ERROR(logging::main_logger, "Failed AngelScript getting biome map");
-        return {};
-    }
-    AngelScript::asIScriptObject* biome_map = local_context.get_return_object();
-    if (biome_map == nullptr) {
-        LOG_ERROR(logging::main_logger, "Failed to get object");
-        return {};
-    }
-    biome_map->AddRef();
-
     AngelScript::asIScriptFunction* method =
         type->GetMethodByDecl("int sample(int, int)");
     if (method == nullptr) {
         LOG_WARNING(logging::main_logger, "Could not find biome map function.");
         return {};
     }
-    result = local_context.run_method(biome_map, method, 5, 5);
 
-    std::vector<MapTile> out;
+    AngelScript::asIScriptFunction* row_method = nullptr;
+    if (use_row_methods_) {
+        row_method = type->GetMethodByDecl("void sample_row(int, array<int>@)");
+    }
+    AngelScript::asITypeInfo* row_type =
+        global_context.as_engine()->GetTypeInfoByDecl("array<int>");
 
     MacroDim x_map_tiles = size;
     MacroDim y_map_tiles = size;
 
+    // each block writes the tile ids of its own x values
+    std::vector<int> tile_ids(x_map_tiles * y_map_tiles);
+    bool success = for_each_map_block(
+        factory_function, x_map_tiles, num_tasks,
+        [&tile_ids, method, row_method, row_type, y_map_tiles](
+            LocalContext& local_context, AngelScript::asIScriptObject* biome_map,
+            size_t x_begin, size_t x_end
+        ) {
+            if (row_method != nullptr) {
+                // one script call for each x
+                AngelScript::CScriptArray* row =
+                    AngelScript::CScriptArray::Create(row_type, y_map_tiles);
+                for (size_t x = x_begin; x < x_end; x++) {
+                    int x_copy = x;
+                    auto result = local_context.run_method(
+                        biome_map, row_method, std::move(x_copy),
+                        static_cast<void*>(row)
+                    );
+                    if (!result || row->GetSize() != y_map_tiles) {
+                        LOG_ERROR(logging::main_logger, "Could not sample map row.");
+                        row->Release();
+                        return false;
+                    }
+                    const int* row_ids = static_cast<const int*>(row->GetBuffer());
+                    std::copy_n(row_ids, y_map_tiles, &tile_ids[x * y_map_tiles]);
+                }
+                row->Release();
+                return true;
+            }
+
+            for (size_t x = x_begin; x < x_end; x++) {
+                for (MacroDim y = 0; y < y_map_tiles; y++) {
+                    int x_copy = x;
+                    int y_copy = y;
+                    auto result = local_context.run_method<int>(
+                        biome_map, method, std::move(x_copy), std::move(y_copy)
+                    );
+                    if (!result) {
+                        LOG_ERROR(
+                            logging::main_logger, "Error code {}",
+                            static_cast<int>(result.error())
+                        );
+                        return false;
+                    }
+                    tile_ids[x * y_map_tiles + y] = result.value();
+                }
+            }
+            return true;
+        }
+    );
+    if (!success) {
+        return {};
+    }
+
+    std::vector<MapTile> out;
     out.reserve(x_map_tiles * y_map_tiles);
     for (MacroDim x = 0; x < x_map_tiles; x++) {
         for (MacroDim y = 0; y < y_map_tiles; y++) {
-            int x_copy = x;
-            int y_copy = y;
-            auto result_2 = local_context.run_method<int>(
-                biome_map, method, std::move(x_copy), std::move(y_copy)
-            );
-            if (!result_2) {
-                LOG_ERROR(
-                    logging::main_logger, "Error code {}",
-                    static_cast<int>(result_2.error())
-                );
-                return {};
-            }
-
-            int tile_id = result_2.value();
+            int tile_id = tile_ids[x * y_map_tiles + y];
             const TileType& tile_type = macro_tile_types_[tile_id];
             out.emplace_back(tile_type, seed, x, y);
         }
     }
 
-    biome_map->Release();
-
     return TerrainMacroMap(out, x_map_tiles, y_map_tiles);
 }
 
 const std::unordered_map<std::string, PlantMap>
-Biome::get_plant_map(Dim length) const {
+Biome::get_plant_map(Dim length, size_t num_tasks) const {
     std::unordered_map<std::string, PlantMap> out;
 
     auto& global_context = GlobalContext::instance();
-    auto& local_context = LocalContext::instance();
-
-    //    global_context.load_file("Base", files::get_data_path() / "Base" /
-    //    "biome_map.as");
 
     auto type = global_context.get_type("Base", "Base::biomes::biome_map");
-    auto factory_function =
-        type->GetFactoryByDecl("Base::biomes::biome_map@ biome_map()");
-
-    auto result = local_context.run_function(factory_function);
-    if (!result) {
-        LOG_ERROR(logging::main_logger, "Failed AngelScript getting biome map");
-        return {};
-    }
-    AngelScript::asIScriptObject* biome_map = local_context.get_return_object();
-    if (biome_map == nullptr) {
-        LOG_ERROR(logging::main_logger, "Failed to get object");
+    if (type == nullptr) {
         return {};
     }
-    biome_map->AddRef();
+    auto factory_function =
+        type->GetFactoryByDecl("Base::biomes::biome_map@ biome_map()");
 
     AngelScript::asIScriptFunction* script_method =
         type->GetMethodByDecl("float sample_plants(string, int, int)");
-    result = local_context.run_method(biome_map, script_method, 5, 5);
     if (script_method == nullptr) {
         LOG_WARNING(logging::main_logger, "Could not find biome map function.");
         return {};
     }
 
-    for (auto& plant : generate_plants_) {
-        std::string plant_map_name = plant.map_name;
-
-        std::vector<float> plant_data;
-
-        MacroDim x_map_tiles = length;
-        MacroDim y_map_tiles = length;
+    AngelScript::asIScriptFunction* row_method = nullptr;
+    if (use_row_methods_) {
+        row_method =
+            type->GetMethodByDecl("void sample_plants_row(string, int, array<float>@)");
+    }
+    AngelScript::asITypeInfo* row_type =
+        global_context.as_engine()->GetTypeInfoByDecl("array<float>");
+
+    MacroDim x_map_tiles = length;
+    MacroDim y_map_tiles = length;
+
+    // every plant is sampled in one pass over the map
+    std::vector<std::string> plant_map_names;
+    std::vector<std::vector<float>> plant_data;
+    for (const auto& plant : generate_plants_) {
+        plant_map_names.push_back(plant.map_name);
+        plant_data.emplace_back(x_map_tiles * y_map_tiles);
+    }
 
-        out.reserve(x_map_tiles * y_map_tiles);
-        for (MacroDim x = 0; x < x_map_tiles; x++) {
-            for (MacroDim y = 0; y < y_map_tiles; y++) {
-                int x_copy = x;
-                int y_copy = y;
-                auto result_2 = local_context.run_method<float>(
-                    biome_map, script_method, &plant_map_name, std::move(x_copy),
-                    std::move(y_copy)
-                );
-                if (!result) {
-                    LOG_ERROR(
-                        logging::script_logger, "Error code {}",
-                        static_cast<int>(result.error())
-                    );
-                    return {};
+    bool success = for_each_map_block(
+        factory_function, x_map_tiles, num_tasks,
+        [&plant_map_names, &plant_data, script_method, row_method, row_type,
+         y_map_tiles](
+            LocalContext& local_context, AngelScript::asIScriptObject* biome_map,
+            size_t x_begin, size_t x_end
+        ) {
+            // the script gets a copy of each name, so blocks do not share them
+            std::vector<std::string> names = plant_map_names;
+            if (row_method != nullptr) {
+                // one script call for each plant and x
+                AngelScript::CScriptArray* row =
+                    AngelScript::CScriptArray::Create(row_type, y_map_tiles);
+                for (size_t plant = 0; plant < names.size(); plant++) {
+                    for (size_t x = x_begin; x < x_end; x++) {
+                        int x_copy = x;
+                        auto result = local_context.run_method(
+                            biome_map, row_method, &names[plant], std::move(x_copy),
+                            static_cast<void*>(row)
+                        );
+                        if (!result || row->GetSize() != y_map_tiles) {
+                            LOG_ERROR(
+                                logging::script_logger, "Could not sample plant row."
+                            );
+                            row->Release();
+                            return false;
+                        }
+                        const float* row_data =
+                            static_cast<const float*>(row->GetBuffer());
+                        std::copy_n(
+                            row_data, y_map_tiles, &plant_data[plant][x * y_map_tiles]
+                        );
+                    }
                 }
+                row->Release();
+                return true;
+            }
 
-                float plant_probability = result_2.value();
-                plant_data.push_back(plant_probability);
+            for (size_t plant = 0; plant < names.size(); plant++) {
+                for (size_t x = x_begin; x < x_end; x++) {
+                    for (MacroDim y = 0; y < y_map_tiles; y++) {
+                        int x_copy = x;
+                        int y_copy = y;
+                        auto result = local_context.run_method<float>(
+                            biome_map, script_method, &names[plant], std::move(x_copy),
+                            std::move(y_copy)
+                        );
+                        if (!result) {
+                            LOG_ERROR(
+                                logging::script_logger, "Error code {}",
+                                static_cast<int>(result.error())
+                            );
+                            return false;
+                        }
+                        plant_data[plant][x * y_map_tiles + y] = result.value();
+                    }
+                }
             }
+            return true;
         }
-        out.emplace(plant_map_name, PlantMap(plant_data, length, length));
+    );
+    if (!success) {
+        return {};
     }
 
-    biome_map->Release();
+    for (size_t plant = 0; plant < plant_map_names.size(); plant++) {
+        out.emplace(
+            plant_map_names[plant],
+            PlantMap(std::move(plant_data[plant]), length, length)
+        );
+    }
 
     return out;
 }
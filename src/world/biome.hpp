@@ -127,6 +127,9 @@ class Biome {
     // unique identifier name
     const std::string id_name_;
 
+    // use the row methods of the biome map script when it has them
+    bool use_row_methods_ = true;
+
  public:
     const size_t seed;
 
@@ -147,21 +150,52 @@ class Biome {
     /**
      * @brief Get macro tile map
      *
+     * @details Blocks of the map are sampled in parallel on the thread pool,
+     * each with its own biome map object. The map does not depend on the
+     * number of tasks as long as sample does not depend on earlier calls.
+     * Blocks until every block is done, so only call from the main thread, not
+     * from a task on the GlobalContext thread pool.
+     *
+     * If the script defines void sample_row(int x, array<int>@ out), it is
+     * called once for each x to set out[y] to sample(x, y) for every y, instead
+     * of calling sample once for each tile.
+     *
      * @param length side length of square map
+     * @param num_tasks number of blocks sampled in parallel, 0 for one for each
+     * hardware thread
      *
      * @return 2D map of map tiles
      */
-    [[nodiscard]] TerrainMacroMap get_map(MacroDim length) const;
+    [[nodiscard]] TerrainMacroMap get_map(MacroDim length, size_t num_tasks = 0) const;
+
+    /**
+     * @brief Choose between the row methods of the biome map script, and the
+     * per tile methods
+     *
+     * @details Row methods are used by default when the script has them. Both
+     * give the same maps, so this is only useful for comparing them.
+     */
+    inline void
+    set_use_row_methods(bool use_row_methods) {
+        use_row_methods_ = use_row_methods;
+    }
 
     /**
      * @brief Get plant map
      *
+     * @details Sampled in parallel like get_map, and also only from the main
+     * thread. If the script defines
+     * void sample_plants_row(string plant_id, int x, array<float>@ out), it is
+     * used like sample_row.
+     *
      * @param length side length of square map
+     * @param num_tasks number of blocks sampled in parallel, 0 for one for each
+     * hardware thread
      *
      * @return 2D map of plant percentages
      */
     [[nodiscard]] const std::unordered_map<std::string, PlantMap>
-    get_plant_map(MacroDim length) const;
+    get_plant_map(MacroDim length, size_t num_tasks = 0) const;
 
     // TODO pass seed
     inline TerrainMacroMap
@@ -106,6 +106,8 @@ EntityController::spawn_tile_object(
         );
     }
 
+    tile_object_versions_[identification]++;
+
     // tile_object_instances_.at(position).insert(object);
     auto inserted = object_instances_.at(chunk_position)
                         .insert(
@@ -123,7 +125,23 @@ EntityController::remove_tile_object(
 ) {
     ChunkPos chunk_position =
         util::position::chunk_pos_from_vec(entity_instance->get_position());
-    object_instances_.at(chunk_position).erase(entity_instance);
+    if (object_instances_.at(chunk_position).erase(entity_instance)) {
+        tile_object_versions_[entity_instance->get_object()->identification()]++;
+    }
+}
+
+std::unordered_set<TerrainOffset3>
+EntityController::get_tile_object_positions(const std::string& identification
+) const {
+    std::unordered_set<TerrainOffset3> out;
+    for (const auto& [chunk_position, instances] : object_instances_) {
+        for (const auto& instance : instances) {
+            if (instance->get_object()->identification() == identification) {
+                out.insert(instance->get_terrain_position());
+            }
+        }
+    }
+    return out;
 }
 
 void
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -22,6 +23,9 @@ class EntityController {
     std::unordered_map<
         glm::ivec3, std::unordered_set<std::shared_ptr<entity::TileObjectInstance>>>
         object_instances_;
+    // incremented when a tile object with the identification is spawned or
+    // removed
+    std::unordered_map<std::string, size_t> tile_object_versions_;
 
  public:
     EntityController(manifest::ObjectHandler* object_handler) :
@@ -44,6 +48,28 @@ class EntityController {
 
     void load_to_gup();
 
+    /**
+     * @brief Get the positions of all tile objects with identification
+     */
+    [[nodiscard]] std::unordered_set<TerrainOffset3>
+    get_tile_object_positions(const std::string& identification) const;
+
+    /**
+     * @brief Number of times tile objects with identification were spawned or
+     * removed
+     *
+     * @details Used to know when anything computed from the tile object
+     * positions is out of date.
+     */
+    [[nodiscard]] size_t
+    get_tile_object_version(const std::string& identification) const {
+        auto version = tile_object_versions_.find(identification);
+        if (version == tile_object_versions_.end()) {
+            return 0;
+        }
+        return version->second;
+    }
+
     /**
      * @brief Get object handler
      */
@@ -0,0 +1,202 @@
+#include "remesh_scheduler.hpp"
+
+#include "terrain/chunk.hpp"
+#include "terrain/level_of_detail.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace world {
+
+void
+RemeshScheduler::mark(ChunkPos chunk_position) {
+    util::PackedMesh superseded_mesh;
+    {
+        std::scoped_lock lock(mutex_);
+        ChunkState& state = states_[chunk_position];
+        state.generation++;
+        if (!state.pending) {
+            state.pending = true;
+            state.first_marked = clock::now();
+        }
+        queued_.insert(chunk_position);
+
+        // a finished mesh of the old generation is out of date
+        auto ready = ready_.find(chunk_position);
+        if (ready != ready_.end()) {
+            superseded_mesh = std::move(ready->second.mesh);
+            ready_.erase(ready);
+            superseded_++;
+        }
+    }
+    util::PackedMeshPool::local().recycle(std::move(superseded_mesh));
+}
+
+std::vector<RemeshScheduler::Job>
+RemeshScheduler::take_jobs(glm::vec3 camera_position, glm::vec3 view_direction) {
+    std::scoped_lock lock(mutex_);
+    std::vector<Job> jobs;
+    if (in_flight_ >= max_in_flight_ || queued_.empty()) {
+        return jobs;
+    }
+    size_t num_jobs = std::min(max_in_flight_ - in_flight_, queued_.size());
+
+    // chunks behind the camera go after every chunk in front of it
+    float behind_penalty = std::numeric_limits<float>::max() / 2;
+    glm::vec3 half_chunk(terrain::Chunk::SIZE / 2.0f);
+    candidates_.clear();
+    for (ChunkPos chunk_position : queued_) {
+        float priority =
+            terrain::LodSelector::distance_to_chunk(camera_position, chunk_position);
+        glm::vec3 to_center =
+            glm::vec3(chunk_position) * static_cast<float>(terrain::Chunk::SIZE)
+            + half_chunk - camera_position;
+        if (glm::dot(to_center, view_direction) < -glm::length(half_chunk)) {
+            priority += behind_penalty;
+        }
+        candidates_.emplace_back(priority, chunk_position);
+    }
+    std::partial_sort(
+        candidates_.begin(), candidates_.begin() + num_jobs, candidates_.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; }
+    );
+
+    jobs.reserve(num_jobs);
+    for (size_t i = 0; i < num_jobs; i++) {
+        ChunkPos chunk_position = candidates_[i].second;
+        queued_.erase(chunk_position);
+        jobs.push_back({chunk_position, states_[chunk_position].generation});
+    }
+    in_flight_ += num_jobs;
+    return jobs;
+}
+
+bool
+RemeshScheduler::is_current(const Job& job) const {
+    std::scoped_lock lock(mutex_);
+    auto state = states_.find(job.chunk_position);
+    return state == states_.end() || state->second.generation == job.generation;
+}
+
+void
+RemeshScheduler::cancel([[maybe_unused]] const Job& job) {
+    std::scoped_lock lock(mutex_);
+    assert(in_flight_ > 0);
+    assert(states_.contains(job.chunk_position));
+    in_flight_--;
+    superseded_++;
+}
+
+void
+RemeshScheduler::complete(const Job& job, util::PackedMesh&& mesh) {
+    {
+        std::scoped_lock lock(mutex_);
+        assert(in_flight_ > 0);
+        in_flight_--;
+        ChunkState& state = states_[job.chunk_position];
+        if (state.generation == job.generation) {
+            ReadyMesh& ready = ready_[job.chunk_position];
+            std::swap(ready.mesh, mesh);
+            ready.first_marked = state.first_marked;
+            ready.marked = state.pending;
+        } else {
+            superseded_++;
+        }
+    }
+    // either the superseded mesh, or the mesh it replaced
+    util::PackedMeshPool::local().recycle(std::move(mesh));
+}
+
+void
+RemeshScheduler::store(ChunkPos chunk_position, util::PackedMesh&& mesh) {
+    {
+        std::scoped_lock lock(mutex_);
+        // swap so that the old mesh of this chunk is recycled below
+        auto [ready, inserted] = ready_.try_emplace(chunk_position);
+        std::swap(ready->second.mesh, mesh);
+        auto state = states_.find(chunk_position);
+        ready->second.marked = state != states_.end() && state->second.pending;
+        if (ready->second.marked) {
+            ready->second.first_marked = state->second.first_marked;
+        }
+    }
+    util::PackedMeshPool::local().recycle(std::move(mesh));
+}
+
+size_t
+RemeshScheduler::select_uploads_() {
+    std::scoped_lock lock(mutex_);
+    ready_order_.clear();
+    for (const auto& [chunk_position, ready] : ready_) {
+        ready_order_.emplace_back(ready.first_marked, chunk_position);
+    }
+    std::sort(
+        ready_order_.begin(), ready_order_.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; }
+    );
+
+    clock::time_point now = clock::now();
+    size_t bytes = 0;
+    for (const auto& [first_marked, chunk_position] : ready_order_) {
+        auto ready = ready_.find(chunk_position);
+        size_t mesh_bytes = ready->second.mesh.get_data_size();
+        if (!uploads_.empty() && bytes + mesh_bytes > upload_budget_) {
+            break;
+        }
+        bytes += mesh_bytes;
+
+        if (ready->second.marked) {
+            clock::duration latency = now - ready->second.first_marked;
+            latency_sum_ += latency;
+            latency_max_ = std::max(latency_max_, latency);
+            latency_count_++;
+            states_[chunk_position].pending = false;
+        }
+        uploads_.emplace_back(chunk_position, std::move(ready->second.mesh));
+        ready_.erase(ready);
+        uploaded_++;
+    }
+    return bytes;
+}
+
+uint32_t
+RemeshScheduler::get_generation(ChunkPos chunk_position) const {
+    std::scoped_lock lock(mutex_);
+    auto state = states_.find(chunk_position);
+    if (state == states_.end()) {
+        return 0;
+    }
+    return state->second.generation;
+}
+
+RemeshScheduler::Metrics
+RemeshScheduler::get_metrics() const {
+    std::scoped_lock lock(mutex_);
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    double mean_latency = 0.0;
+    if (latency_count_ > 0) {
+        mean_latency = milliseconds(latency_sum_).count() / latency_count_;
+    }
+    return {
+        queued_.size(),
+        in_flight_,
+        ready_.size(),
+        superseded_,
+        uploaded_,
+        mean_latency,
+        milliseconds(latency_max_).count()
+    };
+}
+
+void
+RemeshScheduler::reset_metrics() {
+    std::scoped_lock lock(mutex_);
+    superseded_ = 0;
+    uploaded_ = 0;
+    latency_count_ = 0;
+    latency_sum_ = clock::duration(0);
+    latency_max_ = clock::duration(0);
+}
+
+} // namespace world
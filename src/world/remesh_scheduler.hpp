@@ -0,0 +1,225 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file remesh_scheduler.hpp
+ *
+ * @brief Defines RemeshScheduler class
+ *
+ * @ingroup World
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include "util/mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace world {
+
+/**
+ * @brief Orders, limits, and tracks remeshing of changed chunks
+ *
+ * @details Chunks are marked when they change. Marking a chunk that is
+ * already waiting does nothing, so many edits to one chunk are one job. Each
+ * frame take_jobs starts the most important chunks, up to a limit on jobs in
+ * flight. Chunks in front of the camera come first, then by distance.
+ *
+ * Every mark increases the generation of the chunk. A job that finishes after
+ * its chunk was marked again is superseded, and its mesh is dropped. Workers
+ * check is_current before meshing, so superseded jobs that have not started
+ * are skipped.
+ *
+ * Finished meshes wait until take_uploads, which sends at most the upload
+ * budget of bytes each frame, oldest changes first.
+ *
+ * mark, take_jobs, and take_uploads are called from the main thread. The
+ * others may be called from any thread.
+ */
+class RemeshScheduler {
+ public:
+    using clock = std::chrono::steady_clock;
+
+    struct Job {
+        ChunkPos chunk_position;
+        // generation of the chunk when the job was started
+        uint32_t generation;
+    };
+
+    struct Metrics {
+        // chunks marked, and not started
+        size_t queued;
+        // jobs started, and not finished
+        size_t in_flight;
+        // meshes waiting to be uploaded
+        size_t ready;
+        // jobs skipped or dropped because the chunk changed again
+        size_t superseded;
+        // meshes uploaded
+        size_t uploaded;
+        // time from first mark to upload in milliseconds
+        double mean_latency_ms;
+        double max_latency_ms;
+    };
+
+ private:
+    struct ChunkState {
+        uint32_t generation = 0;
+        // time of the first mark not yet uploaded
+        clock::time_point first_marked;
+        // marked, and the mesh has not been uploaded
+        bool pending = false;
+    };
+
+    struct ReadyMesh {
+        util::PackedMesh mesh;
+        clock::time_point first_marked;
+        // false if the mesh was not made from a mark
+        bool marked = false;
+    };
+
+    mutable std::mutex mutex_;
+
+    std::unordered_map<ChunkPos, ChunkState> states_;
+    std::unordered_set<ChunkPos> queued_;
+    std::unordered_map<ChunkPos, ReadyMesh> ready_;
+    size_t in_flight_ = 0;
+
+    // most jobs running at once
+    size_t max_in_flight_;
+    // most bytes uploaded each frame, at least one mesh is always uploaded
+    size_t upload_budget_;
+
+    // metrics
+    size_t superseded_ = 0;
+    size_t uploaded_ = 0;
+    size_t latency_count_ = 0;
+    clock::duration latency_sum_{0};
+    clock::duration latency_max_{0};
+
+    // reused between frames
+    std::vector<std::pair<float, ChunkPos>> candidates_;
+    std::vector<std::pair<clock::time_point, ChunkPos>> ready_order_;
+    std::vector<std::pair<ChunkPos, util::PackedMesh>> uploads_;
+
+ public:
+    /**
+     * @brief Construct a new RemeshScheduler object
+     *
+     * @param max_in_flight most jobs running at once
+     * @param upload_budget most bytes of mesh data uploaded each frame
+     */
+    explicit RemeshScheduler(
+        size_t max_in_flight = 64, size_t upload_budget = 1 << 20
+    ) :
+        max_in_flight_(max_in_flight), upload_budget_(upload_budget) {}
+
+    /**
+     * @brief Mark a chunk as changed
+     */
+    void mark(ChunkPos chunk_position);
+
+    /**
+     * @brief Start the most important marked chunks
+     *
+     * @param camera_position position of the camera in tiles
+     * @param view_direction direction the camera faces, zero if unknown
+     * @return std::vector<Job> jobs to run, in order of importance
+     */
+    [[nodiscard]] std::vector<Job>
+    take_jobs(glm::vec3 camera_position, glm::vec3 view_direction);
+
+    /**
+     * @brief Test if the chunk has not been marked since job started
+     */
+    [[nodiscard]] bool is_current(const Job& job) const;
+
+    /**
+     * @brief Finish a job without a mesh, because it is not current
+     */
+    void cancel(const Job& job);
+
+    /**
+     * @brief Finish a job
+     *
+     * @details The mesh is kept for upload if the job is current. Otherwise it
+     * is recycled.
+     */
+    void complete(const Job& job, util::PackedMesh&& mesh);
+
+    /**
+     * @brief Keep a mesh for upload that was not made by a job
+     */
+    void store(ChunkPos chunk_position, util::PackedMesh&& mesh);
+
+    /**
+     * @brief Upload finished meshes, up to the upload budget
+     *
+     * @param upload called as upload(chunk_position, mesh) for each mesh
+     * @return size_t bytes uploaded
+     */
+    template <class F>
+    size_t
+    take_uploads(F&& upload) {
+        size_t bytes = select_uploads_();
+        for (auto& [chunk_position, mesh] : uploads_) {
+            upload(chunk_position, std::as_const(mesh));
+            util::PackedMeshPool::local().recycle(std::move(mesh));
+        }
+        uploads_.clear();
+        return bytes;
+    }
+
+    /**
+     * @brief Get the generation of a chunk, increased by every mark
+     */
+    [[nodiscard]] uint32_t get_generation(ChunkPos chunk_position) const;
+
+    /**
+     * @brief Get queue sizes, and latency since the last reset_metrics
+     */
+    [[nodiscard]] Metrics get_metrics() const;
+
+    /**
+     * @brief Reset the counts and latency in get_metrics
+     */
+    void reset_metrics();
+
+    inline void
+    set_max_in_flight(size_t max_in_flight) {
+        std::scoped_lock lock(mutex_);
+        max_in_flight_ = max_in_flight;
+    }
+
+    inline void
+    set_upload_budget(size_t upload_budget) {
+        std::scoped_lock lock(mutex_);
+        upload_budget_ = upload_budget;
+    }
+
+ private:
+    // move meshes within the budget from ready_ to uploads_
+    size_t select_uploads_();
+};
+
+} // namespace world
@@ -4,12 +4,171 @@
 #include "path/tile_iterators.hpp"
 #include "terrain.hpp"
 #include "tile.hpp"
+#include "util/bit_mask.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
 
 namespace terrain {
 
+// Chunks start compressed as all air
 Chunk::Chunk(TerrainDim3 chunk_position, Terrain* ter) :
-    ter_(ter), chunk_position_(chunk_position),
-    tiles_(SIZE * SIZE * SIZE, Tile(ter_->get_material(0), 0)) {}
+    ter_(ter), chunk_position_(chunk_position), compressed_(true),
+    palette_({Tile(ter_->get_material(0), 0)}), bits_per_index_(0) {}
+
+void
+Chunk::compress() {
+    // the old tiles are freed after the lock is released
+    std::vector<Tile> old_tiles;
+    std::scoped_lock lock(mut_);
+    if (tiles_.empty()) {
+        return;
+    }
+
+    std::vector<Tile> palette;
+    std::vector<uint8_t> indices;
+    indices.reserve(tiles_.size());
+
+    size_t previous = 0;
+    for (const Tile& tile : tiles_) {
+        // most tiles match the tile below them
+        if (!palette.empty() && palette[previous] == tile) {
+            indices.push_back(static_cast<uint8_t>(previous));
+            continue;
+        }
+        auto found = std::find(palette.begin(), palette.end(), tile);
+        if (found == palette.end()) {
+            if (palette.size() == 256) {
+                // too many unique tiles, stay expanded
+                return;
+            }
+            palette.push_back(tile);
+            found = palette.end() - 1;
+        }
+        previous = found - palette.begin();
+        indices.push_back(static_cast<uint8_t>(previous));
+    }
+
+    uint8_t bits = 0;
+    if (palette.size() > 16) {
+        bits = 8;
+    } else if (palette.size() > 4) {
+        bits = 4;
+    } else if (palette.size() > 2) {
+        bits = 2;
+    } else if (palette.size() > 1) {
+        bits = 1;
+    }
+
+    std::vector<uint64_t> packed;
+    if (bits > 0) {
+        packed.resize(indices.size() * bits / 64);
+        for (size_t index = 0; index < indices.size(); index++) {
+            size_t bit = index * bits;
+            packed[bit / 64] |= uint64_t(indices[index]) << (bit % 64);
+        }
+    }
+
+    palette_.swap(palette);
+    palette_indices_.swap(packed);
+    bits_per_index_ = bits;
+    tiles_.swap(old_tiles);
+    compressed_.store(true, std::memory_order_release);
+}
+
+void
+Chunk::expand_() {
+    // the palette is freed after the lock is released
+    std::vector<Tile> old_palette;
+    std::vector<uint64_t> old_palette_indices;
+    std::scoped_lock lock(mut_);
+    // another thread expanded the chunk first
+    if (!tiles_.empty()) {
+        return;
+    }
+    std::vector<Tile> tiles;
+    tiles.reserve(SIZE * SIZE * SIZE);
+    for (size_t index = 0; index < SIZE * SIZE * SIZE; index++) {
+        tiles.push_back(palette_[get_palette_index_(index)]);
+    }
+    tiles_.swap(tiles);
+    palette_.swap(old_palette);
+    palette_indices_.swap(old_palette_indices);
+    bits_per_index_ = 0;
+    compressed_.store(false, std::memory_order_release);
+}
+
+void
+Chunk::get_padded_mat_color_ids(VoxelDim padding, std::span<MatColorId> out) const {
+    size_t width = SIZE + 2 * padding;
+    assert(padding <= SIZE && out.size() >= width * width * width);
+    // tiles outside the terrain are air
+    std::fill(out.begin(), out.begin() + width * width * width, AIR_MAT_COLOR_ID);
+
+    TerrainOffset3 grid_size = ter_->get_chunk_grid_size();
+    // each chunk is read once, with its own lock
+    for (ChunkDim dx = -1; dx <= 1; dx++) {
+        for (ChunkDim dy = -1; dy <= 1; dy++) {
+            for (ChunkDim dz = -1; dz <= 1; dz++) {
+                ChunkPos direction(dx, dy, dz);
+                TerrainOffset3 position = TerrainOffset3(chunk_position_ + direction);
+                if (glm::any(glm::lessThan(position, TerrainOffset3(0)))
+                    || glm::any(glm::greaterThanEqual(position, grid_size))) {
+                    continue;
+                }
+                // local positions in this chunk of the tiles to read
+                TerrainOffset3 low;
+                TerrainOffset3 high;
+                for (size_t axis = 0; axis < 3; axis++) {
+                    low[axis] = direction[axis] < 0 ? -padding : direction[axis] * SIZE;
+                    high[axis] = direction[axis] > 0 ? SIZE + padding
+                                                     : (direction[axis] + 1) * SIZE;
+                }
+                if (glm::any(glm::equal(low, high))) {
+                    continue;
+                }
+
+                const Chunk* chunk =
+                    direction == ChunkPos(0) ? this : ter_->get_chunk(position);
+                TerrainOffset3 shift = TerrainOffset3(direction) * TerrainOffset(SIZE);
+                std::scoped_lock lock(chunk->mut_);
+                for (TerrainOffset x = low.x; x < high.x; x++) {
+                    for (TerrainOffset y = low.y; y < high.y; y++) {
+                        size_t index =
+                            ((x + padding) * width + (y + padding)) * width + padding;
+                        for (TerrainOffset z = low.z; z < high.z; z++) {
+                            out[index + z] =
+                                chunk->get_tile(x - shift.x, y - shift.y, z - shift.z)
+                                    ->get_mat_color_id();
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::span<const Tile>
+Chunk::get_tiles(std::vector<Tile>& buffer) const {
+    if (!tiles_.empty()) {
+        return tiles_;
+    }
+    buffer.clear();
+    buffer.reserve(SIZE * SIZE * SIZE);
+    for (size_t index = 0; index < SIZE * SIZE * SIZE; index++) {
+        buffer.push_back(palette_[get_palette_index_(index)]);
+    }
+    return buffer;
+}
+
+size_t
+Chunk::get_tile_memory_usage() const {
+    return tiles_.capacity() * sizeof(Tile) + palette_.capacity() * sizeof(Tile)
+           + palette_indices_.capacity() * sizeof(uint64_t);
+}
 
 // this is an incredibly cursed function
 // and I'm not going to do anything about it.
@@ -18,8 +177,9 @@ Chunk::Chunk(TerrainDim3 chunk_position, Terrain* ter) :
 // This would require a lot of code duplication.
 void
 Chunk::stamp_tile_region(
-    MaterialId mat, ColorId color_id, std::optional<MaterialGroup> elements_can_stamp,
-    LocalPosition xyz_start, LocalPosition xyz_end
+    MaterialId mat, ColorId color_id,
+    const std::optional<MaterialGroup>& elements_can_stamp, LocalPosition xyz_start,
+    LocalPosition xyz_end
 ) {
     for (TerrainOffset x = xyz_start.x; x < xyz_end.x; x++) {
         for (TerrainOffset y = xyz_start.y; y < xyz_end.y; y++) {
@@ -134,7 +294,7 @@ Chunk::init_nodegroups() {
     // need to lock here
     // modifying the length of nodegroups
     {
-        std::unique_lock terrain_lock(ter_->get_nodegroup_mutex());
+        std::scoped_lock terrain_lock(ter_->get_tile_to_group_mutex());
         for (auto& [position, node_group] : temporary_position_to_nodegroup_map) {
             ter_->add_node_group(&node_group);
         }
@@ -216,6 +376,13 @@ Chunk::add_nodegroup_adjacent_all() {
         }
 }
 
+void
+Chunk::clear_nodegroups() {
+    while (!node_groups_.empty()) {
+        delete_node_group_(node_groups_.front());
+    }
+}
+
 void
 Chunk::merge_(NodeGroup& G1, std::unordered_set<NodeGroup*> to_merge) {
     if (to_merge.size() == 0) {
@@ -278,22 +445,121 @@ terrain::Chunk::get_voxel_color_id(VoxelDim x, VoxelDim y, VoxelDim z) const {
     return get_tile(x, y, z)->get_mat_color_id();
 }
 
-std::vector<MatColorId>
+ChunkData::VoxelData
 ChunkData::get_mat_color_from_chunk(const Chunk& chunk) {
-    std::vector<MatColorId> out;
-    out.reserve(
-        (Chunk::SIZE + 2) * (terrain::Chunk::SIZE + 2) * (terrain::Chunk::SIZE + 2)
-    );
-    for (VoxelDim x = -1; x < SIZE - 1; x++) {
-        for (VoxelDim y = -1; y < SIZE - 1; y++) {
-            for (VoxelDim z = -1; z < SIZE - 1; z++) {
-                out.push_back(chunk.get_voxel_color_id(x, y, z));
+    VoxelData out;
+    // one voxel of padding from the neighboring chunks
+    chunk.get_padded_mat_color_ids(1, out);
+    return out;
+}
+
+ChunkData::SolidMasks
+ChunkData::get_solid_masks(const VoxelData& data) {
+    SolidMasks out{};
+    // positions here are shifted by one, so bit x is the voxel at x - 1
+    for (size_t x = 0; x < SIZE; x++) {
+        for (size_t y = 0; y < SIZE; y++) {
+            for (size_t z = 0; z < SIZE; z++) {
+                uint32_t solid = data[(x * SIZE + y) * SIZE + z] != AIR_MAT_COLOR_ID;
+                out[(0 * SIZE + y) * SIZE + z] |= solid << x;
+                out[(1 * SIZE + z) * SIZE + x] |= solid << y;
+                out[(2 * SIZE + x) * SIZE + y] |= solid << z;
             }
         }
     }
     return out;
 }
 
+void
+ChunkData::get_exposed_faces(
+    size_t dim_major_index, VoxelDim major_index, std::span<uint32_t> positive,
+    std::span<uint32_t> negative
+) const {
+    assert(positive.size() >= Chunk::SIZE && negative.size() >= Chunk::SIZE);
+    // Rows along the second minor axis, where the first minor axis is
+    // contiguous. The row at minor position -1 is skipped.
+    size_t axis = (dim_major_index + 2) % 3;
+    const uint32_t* below =
+        solid_masks_.data() + (axis * SIZE + (major_index + 1)) * SIZE + 1;
+    const uint32_t* above = below + SIZE;
+    // drop the padding voxels at -1 and Chunk::SIZE
+    bits::exposed_faces(
+        below, above, positive.data(), negative.data(), Chunk::SIZE, 1,
+        (1u << Chunk::SIZE) - 1
+    );
+}
+
+ChunkLodData::ChunkLodData(const Chunk& chunk, ChunkLod lod) :
+    size_(Chunk::SIZE / lod.get_scale() + 2), scale_(lod.get_scale()),
+    offset_(chunk.get_offset() / lod.get_scale()), color_ids_(chunk.get_color_ids()) {
+    assert(Chunk::SIZE % scale_ == 0);
+    // tiles of one block
+    constexpr VoxelDim MAX_SCALE = 1 << (LodSelector::NUM_LEVELS - 1);
+    std::array<MatColorId, MAX_SCALE * MAX_SCALE * MAX_SCALE> block_buffer;
+    assert(scale_ <= MAX_SCALE);
+    std::span<MatColorId> block(block_buffer.data(), scale_ * scale_ * scale_);
+
+    // the tiles of the chunk, and one block of padding on each side
+    thread_local std::vector<MatColorId> tiles;
+    size_t width = Chunk::SIZE + 2 * scale_;
+    tiles.resize(width * width * width);
+    chunk.get_padded_mat_color_ids(scale_, tiles);
+
+    size_t position = 0;
+    for (VoxelDim x = -1; x < size_ - 1; x++) {
+        for (VoxelDim y = -1; y < size_ - 1; y++) {
+            for (VoxelDim z = -1; z < size_ - 1; z++) {
+                VoxelOffset voxel(x, y, z);
+                bool across_seam = false;
+                for (size_t axis = 0; axis < 3; axis++) {
+                    across_seam |=
+                        (voxel[axis] == -1 && lod.has_seam(axis, false))
+                        || (voxel[axis] == size_ - 2 && lod.has_seam(axis, true));
+                }
+                if (across_seam) {
+                    data_[position++] = AIR_MAT_COLOR_ID;
+                    continue;
+                }
+                size_t tile_index = 0;
+                for (VoxelDim dx = 0; dx < scale_; dx++) {
+                    for (VoxelDim dy = 0; dy < scale_; dy++) {
+                        for (VoxelDim dz = 0; dz < scale_; dz++) {
+                            size_t tile_x = (x + 1) * scale_ + dx;
+                            size_t tile_y = (y + 1) * scale_ + dy;
+                            size_t tile_z = (z + 1) * scale_ + dz;
+                            block[tile_index++] =
+                                tiles[(tile_x * width + tile_y) * width + tile_z];
+                        }
+                    }
+                }
+                data_[position++] = majority_vote(block);
+            }
+        }
+    }
+}
+
+MatColorId
+ChunkLodData::majority_vote(std::span<MatColorId> voxels) {
+    // equal values are next to each other, and air (0) is first
+    std::sort(voxels.begin(), voxels.end());
+    auto solid_begin = std::upper_bound(voxels.begin(), voxels.end(), AIR_MAT_COLOR_ID);
+    if (2 * static_cast<size_t>(voxels.end() - solid_begin) < voxels.size()) {
+        return AIR_MAT_COLOR_ID;
+    }
+    MatColorId best = AIR_MAT_COLOR_ID;
+    std::ptrdiff_t best_count = 0;
+    for (auto run_begin = solid_begin; run_begin != voxels.end();) {
+        auto run_end = std::upper_bound(run_begin, voxels.end(), *run_begin);
+        // strictly greater, so ties go to the smaller value
+        if (run_end - run_begin > best_count) {
+            best = *run_begin;
+            best_count = run_end - run_begin;
+        }
+        run_begin = run_end;
+    }
+    return best;
+}
+
 MatColorId
 ChunkData::get_voxel_color_id(VoxelDim x, VoxelDim y, VoxelDim z) const {
     // out side of data -> return 0
@@ -20,12 +20,17 @@
 
 #pragma once
 
+#include "level_of_detail.hpp"
 #include "path/node_group.hpp"
 #include "types.hpp"
 #include "util/voxel.hpp"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <list>
 #include <mutex>
+#include <span>
 #include <unordered_set>
 
 namespace terrain {
@@ -40,8 +45,10 @@ class Terrain;
  * modifications can be made.
  */
 class Chunk : public voxel_utility::VoxelBase {
-    // lock when using tiles_ or node_groups_
-    mutable std::mutex mut_;
+    // Lock when using tiles_ or node_groups_. Expanding and compressing lock
+    // it while they swap the tile storage, and they can be called with it
+    // already held, so it is recursive.
+    mutable std::recursive_mutex mut_;
 
     Terrain* ter_;
 
@@ -49,8 +56,18 @@ class Chunk : public voxel_utility::VoxelBase {
     // Chunk::SIZE to get tile position.
     const ChunkPos chunk_position_;
 
-    // vector of voxels in terrain
+    // vector of voxels in terrain. Empty when the chunk is compressed.
     std::vector<Tile> tiles_;
+    // tiles_ is empty. Set with mut_ held after the storage is swapped, so
+    // it can be read without the lock.
+    std::atomic<bool> compressed_;
+
+    // unique tiles of a compressed chunk
+    std::vector<Tile> palette_;
+    // palette index of each tile, packed bits_per_index_ bits at a time
+    std::vector<uint64_t> palette_indices_;
+    // 0 when the chunk is one tile repeated, otherwise 1, 2, 4, or 8
+    uint8_t bits_per_index_;
 
     std::list<NodeGroup> node_groups_;
 
@@ -69,7 +86,25 @@ class Chunk : public voxel_utility::VoxelBase {
 
     Chunk(TerrainDim3 chunk_position, Terrain* ter);
 
-    [[nodiscard]] inline std::mutex&
+    /**
+     * @brief Move construct a Chunk
+     *
+     * @details Only used while Terrain builds its chunk array. The mutex is
+     * not moved; the new chunk gets its own.
+     */
+    Chunk(Chunk&& other) :
+        ter_(other.ter_), chunk_position_(other.chunk_position_),
+        tiles_(std::move(other.tiles_)), compressed_(other.compressed_.load()),
+        palette_(std::move(other.palette_)),
+        palette_indices_(std::move(other.palette_indices_)),
+        bits_per_index_(other.bits_per_index_),
+        node_groups_(std::move(other.node_groups_)) {}
+
+    Chunk(const Chunk& other) = delete;
+    Chunk& operator=(const Chunk& other) = delete;
+    Chunk& operator=(Chunk&& other) = delete;
+
+    [[nodiscard]] inline std::recursive_mutex&
     get_mutex() const {
         return mut_;
     }
@@ -87,6 +122,14 @@ class Chunk : public voxel_utility::VoxelBase {
 
     void add_nodegroup_adjacent_all();
 
+    /**
+     * @brief Delete every node group in this chunk
+     *
+     * @details Also removes the node groups from the terrain tile to group map,
+     * and from the adjacency of node groups in other chunks. Not thread safe.
+     */
+    void clear_nodegroups();
+
     /**
      * @brief adds node groups in this chunk to out
      *
@@ -94,6 +137,16 @@ class Chunk : public voxel_utility::VoxelBase {
      */
     void add_nodes_to(std::unordered_set<const NodeGroup*>& out) const;
 
+    /**
+     * @brief Get the node groups in this chunk
+     *
+     * @return const std::list<NodeGroup>& node groups
+     */
+    [[nodiscard]] inline const std::list<NodeGroup>&
+    get_node_groups() const {
+        return node_groups_;
+    }
+
     /**
      * @brief Chunk position relative to other chunks
      *
@@ -124,9 +177,15 @@ class Chunk : public voxel_utility::VoxelBase {
         return {Chunk::SIZE, Chunk::SIZE, Chunk::SIZE};
     }
 
+    /**
+     * @brief Get a tile that can be edited
+     *
+     * @details Expands the chunk if it is compressed.
+     */
     [[nodiscard]] inline Tile*
     get_tile(Dim x, Dim y, Dim z) {
-        return const_cast<Tile*>(std::as_const(*this).get_tile(x, y, z));
+        expand();
+        return &tiles_[x * SIZE * SIZE + y * SIZE + z];
     }
 
     [[nodiscard]] inline Tile*
@@ -136,10 +195,21 @@ class Chunk : public voxel_utility::VoxelBase {
         );
     }
 
+    /**
+     * @brief Get a tile to read
+     *
+     * @details Does not expand a compressed chunk. Tiles in a compressed chunk
+     * that are equal share one address, so do not compare tile pointers.
+     * Another thread expanding the chunk frees the palette, so lock the chunk
+     * mutex, or use get_padded_mat_color_ids, when the chunk may be edited.
+     */
     [[nodiscard]] inline const Tile*
     get_tile(Dim x, Dim y, Dim z) const {
         size_t index = x * SIZE * SIZE + y * SIZE + z;
-        return &tiles_[index];
+        if (!compressed_.load(std::memory_order_acquire)) {
+            return &tiles_[index];
+        }
+        return &palette_[get_palette_index_(index)];
     }
 
     [[nodiscard]] inline const Tile*
@@ -149,10 +219,119 @@ class Chunk : public voxel_utility::VoxelBase {
         );
     }
 
+    /**
+     * @brief Get all tiles in the chunk
+     *
+     * @details Tiles are ordered x, then y, then z, so the SIZE tiles with the
+     * same x and y are contiguous (see get_column). Expands the chunk if it is
+     * compressed.
+     *
+     * @return std::span<Tile> every tile in the chunk
+     */
+    [[nodiscard]] inline std::span<Tile>
+    get_tiles() {
+        expand();
+        return tiles_;
+    }
+
+    /**
+     * @brief Get all tiles in the chunk without expanding it
+     *
+     * @param buffer used to hold the tiles when the chunk is compressed
+     * @return std::span<const Tile> every tile in the chunk, ordered as get_tiles
+     */
+    [[nodiscard]] std::span<const Tile> get_tiles(std::vector<Tile>& buffer) const;
+
+    /**
+     * @brief Copy the MatColorId of the tiles in and around the chunk
+     *
+     * @details Reads from padding tiles below the chunk to padding tiles past
+     * it on each axis, ordered x, then y, then z. Tiles in the neighboring
+     * chunks are read from them, and tiles outside the terrain are air. Each
+     * chunk is locked while it is read, so this is safe while other threads
+     * expand chunks.
+     *
+     * @param padding number of tiles on each side, at most SIZE
+     * @param out (SIZE + 2 * padding)^3 values
+     */
+    void get_padded_mat_color_ids(VoxelDim padding, std::span<MatColorId> out) const;
+
+    /**
+     * @brief Get the column of tiles at the given local x and y
+     *
+     * @details Expands the chunk if it is compressed.
+     *
+     * @param x local x position
+     * @param y local y position
+     * @return std::span<Tile> SIZE tiles, index is the local z position
+     */
+    [[nodiscard]] inline std::span<Tile>
+    get_column(Dim x, Dim y) {
+        return get_tiles().subspan((x * SIZE + y) * SIZE, SIZE);
+    }
+
+    /**
+     * @brief Get the local position of the tile at index in get_tiles()
+     *
+     * @param index index of tile
+     * @return TerrainOffset3 position relative to get_offset()
+     */
+    [[nodiscard]] inline static TerrainOffset3
+    get_tile_position(size_t index) {
+        return TerrainOffset3(
+            index / (SIZE * SIZE), (index / SIZE) % SIZE, index % SIZE
+        );
+    }
+
+    /**
+     * @brief Store the tiles as a palette of unique tiles and packed indices
+     *
+     * @details Chunks that are one tile repeated (all air, all stone) only
+     * store that tile. Chunks with more than 256 unique tiles stay expanded.
+     * Any non const tile access expands the chunk again. The new storage is
+     * swapped in with the chunk mutex held.
+     */
+    void compress();
+
+    /**
+     * @brief Store every tile in the chunk so tiles can be edited
+     *
+     * @details The tiles are decoded into a new vector, and swapped in with
+     * the chunk mutex held, so readers that lock the chunk never see a half
+     * expanded chunk.
+     */
+    inline void
+    expand() {
+        if (compressed_.load(std::memory_order_acquire)) [[unlikely]] {
+            expand_();
+        }
+    }
+
+    /**
+     * @brief is the chunk compressed
+     */
+    [[nodiscard]] inline bool
+    is_compressed() const {
+        return compressed_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief is the chunk compressed and one tile repeated
+     */
+    [[nodiscard]] inline bool
+    is_uniform() const {
+        return is_compressed() && bits_per_index_ == 0;
+    }
+
+    /**
+     * @brief Get the number of bytes used to store tiles
+     */
+    [[nodiscard]] size_t get_tile_memory_usage() const;
+
     void stamp_tile_region(
         MaterialId mat, ColorId color_id,
-        std::optional<MaterialGroup> elements_can_stamp, LocalPosition xyz_start,
-        LocalPosition xyz_end
+        const std::optional<MaterialGroup>& elements_can_stamp,
+        LocalPosition xyz_start, LocalPosition xyz_end
     );
 
     // VoxelBase Specialization
@@ -211,6 +390,20 @@ class Chunk : public voxel_utility::VoxelBase {
     }
 
  private:
+    // palette index of tile at index in a compressed chunk
+    [[nodiscard]] inline size_t
+    get_palette_index_(size_t index) const {
+        if (bits_per_index_ == 0) {
+            return 0;
+        }
+        // bits_per_index_ divides 64 so an index never spans two words
+        size_t bit = index * bits_per_index_;
+        uint64_t mask = (uint64_t(1) << bits_per_index_) - 1;
+        return (palette_indices_[bit / 64] >> (bit % 64)) & mask;
+    }
+
+    void expand_();
+
     void delete_node_group_(NodeGroup& NG);
     void merge_node_group_(NodeGroup& g1, NodeGroup& g2);
     bool contains_node_group_(NodeGroup*);
@@ -224,21 +417,30 @@ class Chunk : public voxel_utility::VoxelBase {
  * important, but also the data that borders this chunk. The SIZE for ChunkData
  * is the SIZE for Chunk plus two, one for each edge.
  *
- * The total data saved in ChunkData is 4 * 18 * 18 * 18 ~ 23 kb, small enough
+ * The total data saved in ChunkData is 2 * 18 * 18 * 18 ~ 12 kb, small enough
  * for a L1 cache. (I think I'm not an EE)
  */
 class ChunkData : public voxel_utility::VoxelBase {
  public:
     static const VoxelDim SIZE = Chunk::SIZE + 2;
-    const std::vector<MatColorId> data_;
+    static_assert(SIZE <= 32, "solid masks use 32 bits");
+    // stored inline so that meshing a chunk does not allocate
+    using VoxelData = std::array<MatColorId, SIZE * SIZE * SIZE>;
+    using SolidMasks = std::array<uint32_t, 3 * SIZE * SIZE>;
+
+    const VoxelData data_;
+    // rows of solid voxels along each axis, see get_solid_mask
+    const SolidMasks solid_masks_;
     const VoxelOffset offset_;
     const std::vector<ColorInt>& color_ids_;
 
-    [[nodiscard]] std::vector<MatColorId> get_mat_color_from_chunk(const Chunk& chunk);
+    [[nodiscard]] static VoxelData get_mat_color_from_chunk(const Chunk& chunk);
+
+    [[nodiscard]] static SolidMasks get_solid_masks(const VoxelData& data);
 
     inline ChunkData(const Chunk& chunk) :
-        data_(get_mat_color_from_chunk(chunk)), offset_(chunk.get_offset()),
-        color_ids_(chunk.get_color_ids()) {};
+        data_(get_mat_color_from_chunk(chunk)), solid_masks_(get_solid_masks(data_)),
+        offset_(chunk.get_offset()), color_ids_(chunk.get_color_ids()) {};
 
     /**
      * @brief Used for getting mesh
@@ -299,6 +501,153 @@ class ChunkData : public voxel_utility::VoxelBase {
         return get_voxel_color_id(position.x, position.y, position.z);
     }
 
+    /**
+     * @brief Get a row of solid voxels
+     *
+     * @details The row is along axis. i and j are the positions on the axes
+     * (axis + 1) % 3 and (axis + 2) % 3. Bit k + 1 is set if the voxel at k on
+     * axis is solid. Rows outside of the data are all air.
+     *
+     * @param axis 0, 1, or 2 for x, y, or z
+     * @param i position on axis (axis + 1) % 3
+     * @param j position on axis (axis + 2) % 3
+     * @return uint32_t solid mask
+     */
+    [[nodiscard]] inline uint32_t
+    get_solid_mask(size_t axis, VoxelDim i, VoxelDim j) const {
+        if (i < -1 || j < -1 || i > SIZE - 2 || j > SIZE - 2) {
+            return 0;
+        }
+        return solid_masks_[(axis * SIZE + (i + 1)) * SIZE + (j + 1)];
+    }
+
+    /**
+     * @brief Find the faces between two layers of voxels
+     *
+     * @details The layers are at major_index and major_index + 1 on axis
+     * dim_major_index. Bit k of positive[i] is set if the voxel at
+     * (major_index, i, k) is solid and the voxel above it is air. negative is
+     * the other way around. i and k are positions on the axes
+     * (dim_major_index + 1) % 3 and (dim_major_index + 2) % 3.
+     *
+     * @param dim_major_index axis normal to the faces
+     * @param major_index position of the first layer, from -1 to Chunk::SIZE - 1
+     * @param positive out faces that point up the axis, Chunk::SIZE rows
+     * @param negative out faces that point down the axis, Chunk::SIZE rows
+     */
+    void get_exposed_faces(
+        size_t dim_major_index, VoxelDim major_index, std::span<uint32_t> positive,
+        std::span<uint32_t> negative
+    ) const;
+
+    /**
+     * @brief Get the colors used in terrain.
+     *
+     * @return const std::vector<ColorInt>&
+     */
+    [[nodiscard]] const inline std::vector<ColorInt>&
+    get_color_ids() const {
+        return color_ids_;
+    }
+};
+
+/**
+ * @brief Voxel data of a chunk at a coarser level of detail
+ *
+ * @details Each voxel is a block of get_scale() tiles along each axis. A
+ * block is solid if at least half of its tiles are solid, and then it has the
+ * most common material and color of its solid tiles. Ties go to the smaller
+ * MatColorId, so the result does not depend on the order tiles are read.
+ *
+ * Like ChunkData there is one voxel of padding on each side, read from the
+ * neighboring chunks. Blocks across a seam (see ChunkLod) are air instead.
+ *
+ * At level 0 with no seams this is the same as ChunkData, but ChunkData
+ * should be used as it has solid masks.
+ */
+class ChunkLodData : public voxel_utility::VoxelBase {
+ public:
+    // the size of ChunkData at level 0
+    static const VoxelDim MAX_SIZE = Chunk::SIZE + 2;
+    using VoxelData = std::array<MatColorId, MAX_SIZE * MAX_SIZE * MAX_SIZE>;
+
+ private:
+    // number of voxels on each axis, including padding
+    const VoxelDim size_;
+    const VoxelDim scale_;
+    // only the first size_^3 are used
+    VoxelData data_;
+    const VoxelOffset offset_;
+    const std::vector<ColorInt>& color_ids_;
+
+ public:
+    /**
+     * @brief Construct a new ChunkLodData object
+     *
+     * @param chunk chunk to down sample
+     * @param lod level of detail and seams
+     */
+    ChunkLodData(const Chunk& chunk, ChunkLod lod);
+
+    /**
+     * @brief Get the most common solid MatColorId of a block of tiles
+     *
+     * @param voxels MatColorId of each tile in the block, these are reordered
+     * @return MatColorId air if less than half of the tiles are solid
+     */
+    [[nodiscard]] static MatColorId majority_vote(std::span<MatColorId> voxels);
+
+    /**
+     * @brief Offset of the chunk in units of voxels of this level
+     */
+    [[nodiscard]] inline VoxelOffset
+    get_offset() const {
+        return offset_;
+    }
+
+    /**
+     * @brief Number of voxels along each axis, not including padding
+     */
+    [[nodiscard]] inline VoxelSize
+    get_size() const {
+        VoxelDim cells = size_ - 2;
+        return VoxelSize(cells, cells, cells);
+    }
+
+    /**
+     * @brief Width of each voxel in tiles
+     */
+    [[nodiscard]] inline VoxelDim
+    get_scale() const {
+        return scale_;
+    }
+
+    /**
+     * @brief Get the voxel color id
+     *
+     * @details Positions from -1 to get_size() are valid. Others are air.
+     *
+     * @return MatColorId material and color id
+     */
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelDim x, VoxelDim y, VoxelDim z) const {
+        if (x < -1 || y < -1 || z < -1 || x > size_ - 2 || y > size_ - 2
+            || z > size_ - 2) {
+            return AIR_MAT_COLOR_ID;
+        }
+        return data_[((x + 1) * size_ + (y + 1)) * size_ + (z + 1)];
+    }
+
+    /**
+     * @brief Get the voxel color id
+     *
+     * @return MatColorId material and color id
+     */
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelOffset position) const {
+        return get_voxel_color_id(position.x, position.y, position.z);
+    }
+
     /**
      * @brief Get the colors used in terrain.
      *
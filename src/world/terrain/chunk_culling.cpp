@@ -0,0 +1,94 @@
+#include "chunk_culling.hpp"
+
+#include "chunk.hpp"
+
+namespace terrain {
+
+Frustum::Frustum(const glm::mat4& view_projection) {
+    // rows of the matrix, glm is column major
+    std::array<glm::vec4, 4> rows;
+    for (glm::length_t row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(
+            view_projection[0][row], view_projection[1][row], view_projection[2][row],
+            view_projection[3][row]
+        );
+    }
+    // a point is in clip space if -w <= x, y, z <= w
+    for (size_t axis = 0; axis < 3; axis++) {
+        planes_[2 * axis] = rows[3] + rows[axis];
+        planes_[2 * axis + 1] = rows[3] - rows[axis];
+    }
+}
+
+bool
+Frustum::intersects_box(glm::vec3 low, glm::vec3 high) const {
+    for (const glm::vec4& plane : planes_) {
+        // corner of the box furthest along the normal
+        glm::vec3 corner(
+            plane.x >= 0.0f ? high.x : low.x, plane.y >= 0.0f ? high.y : low.y,
+            plane.z >= 0.0f ? high.z : low.z
+        );
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t
+ChunkCuller::get_opaque_faces(ChunkPos chunk_position) const {
+    auto opaque_faces = opaque_faces_.find(chunk_position);
+    if (opaque_faces == opaque_faces_.end()) {
+        return 0;
+    }
+    return opaque_faces->second;
+}
+
+bool
+ChunkCuller::is_occluded(ChunkPos chunk_position, glm::vec3 camera_position) const {
+    glm::vec3 low = glm::vec3(chunk_position) * static_cast<float>(Chunk::SIZE);
+    glm::vec3 high = low + static_cast<float>(Chunk::SIZE);
+    if (camera_position.x >= low.x && camera_position.x <= high.x
+        && camera_position.y >= low.y && camera_position.y <= high.y
+        && camera_position.z >= low.z && camera_position.z <= high.z) {
+        return false;
+    }
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        for (bool above : {false, true}) {
+            ChunkPos neighbor = chunk_position;
+            neighbor[axis] += above ? 1 : -1;
+            // the neighbor above touches this chunk with its low face
+            uint8_t face = 1u << (2 * axis + !above);
+            if (!(get_opaque_faces(neighbor) & face)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const std::vector<size_t>&
+ChunkCuller::cull(
+    std::span<const ChunkPos> chunk_positions, const Frustum& frustum,
+    glm::vec3 camera_position
+) {
+    visible_.clear();
+    counts_ = {};
+    counts_.total = chunk_positions.size();
+    for (size_t index = 0; index < chunk_positions.size(); index++) {
+        ChunkPos chunk_position = chunk_positions[index];
+        glm::vec3 low = glm::vec3(chunk_position) * static_cast<float>(Chunk::SIZE);
+        glm::vec3 high = low + static_cast<float>(Chunk::SIZE);
+        if (!frustum.intersects_box(low, high)) {
+            counts_.outside_frustum++;
+        } else if (is_occluded(chunk_position, camera_position)) {
+            counts_.occluded++;
+        } else {
+            visible_.push_back(index);
+        }
+    }
+    return visible_;
+}
+
+} // namespace terrain
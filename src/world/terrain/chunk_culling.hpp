@@ -0,0 +1,148 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file chunk_culling.hpp
+ *
+ * @brief Defines Frustum and ChunkCuller
+ *
+ * @ingroup Terrain
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace terrain {
+
+/**
+ * @brief The volume a camera can see, as six planes
+ */
+class Frustum {
+ private:
+    // xyz is the normal pointing into the frustum, and w the distance
+    std::array<glm::vec4, 6> planes_;
+
+ public:
+    /**
+     * @brief Construct a new Frustum from a matrix
+     *
+     * @param view_projection projection matrix times view matrix
+     */
+    explicit Frustum(const glm::mat4& view_projection);
+
+    /**
+     * @brief Test if any part of an axis aligned box may be visible
+     *
+     * @details Boxes near a corner of the frustum may be outside it and still
+     * pass. Boxes that fail are never visible.
+     */
+    [[nodiscard]] bool intersects_box(glm::vec3 low, glm::vec3 high) const;
+};
+
+/**
+ * @brief Finds the chunks that need to be drawn
+ *
+ * @details A chunk is culled if it is outside the frustum, or if it is
+ * occluded. A chunk is occluded if the face of each of its six neighbors that
+ * touches it is completely solid (see util::opaque_faces), and the camera is
+ * not in it. Chunks without a known neighbor on a side are not occluded.
+ *
+ * This does not use OpenGL, so it can be tested headless.
+ */
+class ChunkCuller {
+ public:
+    struct Counts {
+        // chunks tested
+        size_t total = 0;
+        // chunks outside the frustum
+        size_t outside_frustum = 0;
+        // chunks in the frustum, but hidden by their neighbors
+        size_t occluded = 0;
+
+        [[nodiscard]] inline size_t
+        visible() const noexcept {
+            return total - outside_frustum - occluded;
+        }
+    };
+
+ private:
+    // solid faces of each chunk, see util::opaque_faces
+    std::unordered_map<ChunkPos, uint8_t> opaque_faces_;
+    // indices of the visible chunks from the last cull, reused between frames
+    std::vector<size_t> visible_;
+    Counts counts_;
+
+ public:
+    /**
+     * @brief Set the solid faces of a chunk
+     */
+    inline void
+    set_opaque_faces(ChunkPos chunk_position, uint8_t opaque_faces) {
+        opaque_faces_[chunk_position] = opaque_faces;
+    }
+
+    /**
+     * @brief Forget the solid faces of a chunk
+     */
+    inline void
+    remove(ChunkPos chunk_position) {
+        opaque_faces_.erase(chunk_position);
+    }
+
+    /**
+     * @brief Get the solid faces of a chunk, none if it is not known
+     */
+    [[nodiscard]] uint8_t get_opaque_faces(ChunkPos chunk_position) const;
+
+    /**
+     * @brief Test if a chunk is hidden by its neighbors
+     *
+     * @param camera_position position of the camera in tiles
+     */
+    [[nodiscard]] bool
+    is_occluded(ChunkPos chunk_position, glm::vec3 camera_position) const;
+
+    /**
+     * @brief Find the chunks that need to be drawn
+     *
+     * @param chunk_positions chunks to test
+     * @param frustum volume the camera can see
+     * @param camera_position position of the camera in tiles
+     * @return const std::vector<size_t>& indices into chunk_positions of the
+     * visible chunks, in order. Valid until the next call.
+     */
+    const std::vector<size_t>& cull(
+        std::span<const ChunkPos> chunk_positions, const Frustum& frustum,
+        glm::vec3 camera_position
+    );
+
+    /**
+     * @brief Get the number of chunks culled by the last call to cull
+     */
+    [[nodiscard]] inline const Counts&
+    get_counts() const noexcept {
+        return counts_;
+    }
+};
+
+} // namespace terrain
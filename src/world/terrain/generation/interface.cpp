@@ -5,6 +5,10 @@
 #include "util/angel_script/error_checks.hpp"
 #include "worley_noise.hpp"
 
+#include <scriptarray.h>
+
+#include <span>
+
 namespace terrain {
 namespace generation {
 
@@ -28,10 +32,33 @@ AlternativeWorleyNoise_factory(NoisePosition x, double y, NoisePosition z) {
     return new AlternativeWorleyNoise(x, y, z);
 }
 
+// Sets out to the samples of noise on a grid, see FractalNoise::sample_grid
+template <class T>
+void
+sample_grid(
+    NoisePosition x0, NoisePosition y0, NoisePosition dx, NoisePosition dy,
+    uint32_t width, uint32_t height, AngelScript::CScriptArray* out, const T* noise
+) {
+    if (out == nullptr) {
+        AngelScript::asGetActiveContext()->SetException("Null array");
+        return;
+    }
+    out->Resize(width * height);
+    noise->sample_grid(
+        x0, y0, dx, dy, width, height,
+        std::span<double>(static_cast<double*>(out->GetBuffer()), out->GetSize())
+    );
+    // the handle was given to this function, so it releases it
+    out->Release();
+}
+
 } // namespace
 
 void
 init_as_interface(AngelScript::asIScriptEngine* engine) {
+    // biome maps can fill a whole row of a map in one call
+    AngelScript::RegisterScriptArray(engine, true);
+
     int r = engine->SetDefaultNamespace("TerrainGeneration");
 
     if (util::scripting::check_SetDefaultNamespace(r)) {
@@ -71,6 +98,15 @@ init_as_interface(AngelScript::asIScriptEngine* engine) {
     if (util::scripting::check_RegisterObjectMethod(r)) {
         return;
     }
+    r = engine->RegisterObjectMethod(
+        "FractalNoise",
+        "void sample_grid(double, double, double, double, uint, uint, array<double>@)",
+        AngelScript::asFUNCTION(sample_grid<FractalNoise>),
+        AngelScript::asCALL_CDECL_OBJLAST
+    );
+    if (util::scripting::check_RegisterObjectMethod(r)) {
+        return;
+    }
     r = engine->RegisterObjectType("WorleyNoise", 0, AngelScript::asOBJ_REF);
 
     if (util::scripting::check_RegisterObjectType(r)) {
@@ -104,6 +140,15 @@ init_as_interface(AngelScript::asIScriptEngine* engine) {
     if (util::scripting::check_RegisterObjectMethod(r)) {
         return;
     }
+    r = engine->RegisterObjectMethod(
+        "WorleyNoise",
+        "void sample_grid(double, double, double, double, uint, uint, array<double>@)",
+        AngelScript::asFUNCTION(sample_grid<WorleyNoise>),
+        AngelScript::asCALL_CDECL_OBJLAST
+    );
+    if (util::scripting::check_RegisterObjectMethod(r)) {
+        return;
+    }
     r = engine->RegisterObjectType("AlternativeWorleyNoise", 0, AngelScript::asOBJ_REF);
     if (util::scripting::check_RegisterObjectType(r)) {
         return;
@@ -141,6 +186,15 @@ init_as_interface(AngelScript::asIScriptEngine* engine) {
     if (util::scripting::check_RegisterObjectMethod(r)) {
         return;
     }
+    r = engine->RegisterObjectMethod(
+        "AlternativeWorleyNoise",
+        "void sample_grid(double, double, double, double, uint, uint, array<double>@)",
+        AngelScript::asFUNCTION(sample_grid<AlternativeWorleyNoise>),
+        AngelScript::asCALL_CDECL_OBJLAST
+    );
+    if (util::scripting::check_RegisterObjectMethod(r)) {
+        return;
+    }
 }
 
 } // namespace generation
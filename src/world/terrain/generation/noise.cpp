@@ -4,13 +4,176 @@
 
 #include "noise.hpp"
 
+#include "util/bit_mask.hpp"
+
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <limits>
 #include <numbers>
+#include <utility>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#  define FUNGAME_AVX2_TARGET 1
+#  include <immintrin.h>
+#endif
 
 namespace terrain {
 
 namespace generation {
 
+namespace {
+
+// weight of b in the cosine interpolation of a, and b at x
+inline double
+cosine_weight(NoisePosition x) {
+    double ft = x * std::numbers::pi;
+    return (1 - cos(ft)) / 2.0;
+}
+
+inline double
+lerp(double a, double b, double weight) {
+    return a * (1 - weight) + b * weight;
+}
+
+// The lattice point and the interpolation weight of each sample along one axis.
+// Returns the lowest and the highest lattice point.
+std::pair<NoiseTileIndex, NoiseTileIndex>
+lattice_axis(
+    NoisePosition start, NoisePosition step, double frequency,
+    std::vector<NoiseTileIndex>& points, std::vector<double>& weights
+) {
+    NoiseTileIndex low = std::numeric_limits<NoiseTileIndex>::max();
+    NoiseTileIndex high = std::numeric_limits<NoiseTileIndex>::min();
+    for (size_t k = 0; k < points.size(); k++) {
+        NoisePosition position = (start + k * step) / frequency;
+        // truncates like interpolated_noise_
+        NoiseTileIndex point = position;
+        points[k] = point;
+        weights[k] = cosine_weight(position - point);
+        low = std::min(low, point);
+        high = std::max(high, point);
+    }
+    return {low, high};
+}
+
+// Smoothed noise of count lattice points from the noise of the rows below, at,
+// and above them. Each of those rows starts one point to the left.
+void
+smooth_row_scalar(
+    const double* below, const double* center, const double* above, double* out,
+    size_t count
+) {
+    for (size_t k = 0; k < count; k++) {
+        // same order as smoothed_noise_, so the sums round the same way
+        double corners = (below[k] + below[k + 2] + above[k] + above[k + 2]) / 16;
+        double sides = (center[k] + center[k + 2] + below[k + 1] + above[k + 1]) / 8;
+        double middle = center[k + 1] / 4;
+        out[k] = corners + sides + middle;
+    }
+}
+
+// total[k] += lerp(low[k], high[k], weight) * amplitude
+void
+blend_row_scalar(
+    const double* low, const double* high, double weight, double amplitude,
+    double* total, size_t count
+) {
+    for (size_t k = 0; k < count; k++) {
+        total[k] += lerp(low[k], high[k], weight) * amplitude;
+    }
+}
+
+#ifdef FUNGAME_AVX2_TARGET
+
+// No multiply is fused with an add, so each lane rounds like the scalar code.
+__attribute__((target("avx2"))) void
+smooth_row_avx2(
+    const double* below, const double* center, const double* above, double* out,
+    size_t count
+) {
+    const __m256d sixteen = _mm256_set1_pd(16.0);
+    const __m256d eight = _mm256_set1_pd(8.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m256d corners = _mm256_add_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(
+                    _mm256_loadu_pd(below + k), _mm256_loadu_pd(below + k + 2)
+                ),
+                _mm256_loadu_pd(above + k)
+            ),
+            _mm256_loadu_pd(above + k + 2)
+        );
+        __m256d sides = _mm256_add_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(
+                    _mm256_loadu_pd(center + k), _mm256_loadu_pd(center + k + 2)
+                ),
+                _mm256_loadu_pd(below + k + 1)
+            ),
+            _mm256_loadu_pd(above + k + 1)
+        );
+        __m256d middle = _mm256_div_pd(_mm256_loadu_pd(center + k + 1), four);
+        _mm256_storeu_pd(
+            out + k,
+            _mm256_add_pd(
+                _mm256_add_pd(
+                    _mm256_div_pd(corners, sixteen), _mm256_div_pd(sides, eight)
+                ),
+                middle
+            )
+        );
+    }
+    smooth_row_scalar(below + k, center + k, above + k, out + k, count - k);
+}
+
+__attribute__((target("avx2"))) void
+blend_row_avx2(
+    const double* low, const double* high, double weight, double amplitude,
+    double* total, size_t count
+) {
+    const __m256d low_weight = _mm256_set1_pd(1 - weight);
+    const __m256d high_weight = _mm256_set1_pd(weight);
+    const __m256d amplitudes = _mm256_set1_pd(amplitude);
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m256d value = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(low + k), low_weight),
+            _mm256_mul_pd(_mm256_loadu_pd(high + k), high_weight)
+        );
+        _mm256_storeu_pd(
+            total + k,
+            _mm256_add_pd(_mm256_loadu_pd(total + k), _mm256_mul_pd(value, amplitudes))
+        );
+    }
+    blend_row_scalar(low + k, high + k, weight, amplitude, total + k, count - k);
+}
+
+#else
+
+void
+smooth_row_avx2(
+    const double* below, const double* center, const double* above, double* out,
+    size_t count
+) {
+    smooth_row_scalar(below, center, above, out, count);
+}
+
+void
+blend_row_avx2(
+    const double* low, const double* high, double weight, double amplitude,
+    double* total, size_t count
+) {
+    blend_row_scalar(low, high, weight, amplitude, total, count);
+}
+
+#endif
+
+} // namespace
+
 double
 generation::FractalNoise::get_noise(NoisePosition x, NoisePosition y) const {
     double total = 0, frequency = pow(2, num_octaves_), amplitude = 1;
@@ -25,6 +188,114 @@ generation::FractalNoise::get_noise(NoisePosition x, NoisePosition y) const {
     return total / frequency;
 }
 
+void
+generation::FractalNoise::sample_grid(
+    NoisePosition x0, NoisePosition y0, NoisePosition dx, NoisePosition dy,
+    size_t width, size_t height, std::span<double> out
+) const {
+    size_t num_samples = width * height;
+    assert(out.size() >= num_samples && "Not enough room for the samples");
+    std::fill_n(out.begin(), num_samples, 0.0);
+    if (num_samples == 0) {
+        return;
+    }
+    bool avx2 = bits::has_avx2();
+
+    std::vector<NoiseTileIndex> columns(width);
+    std::vector<double> column_weights(width);
+    std::vector<NoiseTileIndex> rows(height);
+    std::vector<double> row_weights(height);
+    // noise, smoothed noise, and smoothed noise interpolated along x, of the
+    // lattice points near the samples
+    std::vector<double> raw;
+    std::vector<double> smoothed;
+    std::vector<double> blended;
+
+    double frequency = pow(2, num_octaves_), amplitude = 1;
+    for (int octave = 0; octave < num_octaves_; ++octave) {
+        frequency /= 2;
+        amplitude *= persistence_;
+        size_t prime = (primeIndex_ + octave) % NUM_PRIMES;
+
+        auto [column_low, column_high] =
+            lattice_axis(x0, dx, frequency, columns, column_weights);
+        auto [row_low, row_high] = lattice_axis(y0, dy, frequency, rows, row_weights);
+        // samples interpolate to the next lattice point as well
+        size_t lattice_width = static_cast<int64_t>(column_high) - column_low + 2;
+        size_t lattice_height = static_cast<int64_t>(row_high) - row_low + 2;
+
+        if (lattice_width > 2 * width + 2 || lattice_height > 2 * height + 2) {
+            // samples are far apart, so there is little to share
+            for (size_t j = 0; j < height; j++) {
+                for (size_t i = 0; i < width; i++) {
+                    out[j * width + i] += interpolated_noise_(
+                                              prime, (x0 + i * dx) / frequency,
+                                              (y0 + j * dy) / frequency
+                                          )
+                                          * amplitude;
+                }
+            }
+            continue;
+        }
+
+        // one extra point on each side for smoothing
+        size_t raw_width = lattice_width + 2;
+        raw.resize(raw_width * (lattice_height + 2));
+        for (size_t r = 0; r < lattice_height + 2; r++) {
+            get_doubles(
+                prime, column_low - 1, row_low - 1 + static_cast<NoiseTileIndex>(r),
+                raw_width, raw.data() + r * raw_width
+            );
+        }
+
+        smoothed.resize(lattice_width * lattice_height);
+        for (size_t r = 0; r < lattice_height; r++) {
+            const double* below = raw.data() + r * raw_width;
+            double* smoothed_row = smoothed.data() + r * lattice_width;
+            if (avx2) {
+                smooth_row_avx2(
+                    below, below + raw_width, below + 2 * raw_width, smoothed_row,
+                    lattice_width
+                );
+            } else {
+                smooth_row_scalar(
+                    below, below + raw_width, below + 2 * raw_width, smoothed_row,
+                    lattice_width
+                );
+            }
+        }
+
+        blended.resize(width * lattice_height);
+        for (size_t r = 0; r < lattice_height; r++) {
+            const double* smoothed_row = smoothed.data() + r * lattice_width;
+            double* blended_row = blended.data() + r * width;
+            for (size_t i = 0; i < width; i++) {
+                size_t k = columns[i] - column_low;
+                blended_row[i] =
+                    lerp(smoothed_row[k], smoothed_row[k + 1], column_weights[i]);
+            }
+        }
+
+        for (size_t j = 0; j < height; j++) {
+            const double* low = blended.data() + (rows[j] - row_low) * width;
+            if (avx2) {
+                blend_row_avx2(
+                    low, low + width, row_weights[j], amplitude, out.data() + j * width,
+                    width
+                );
+            } else {
+                blend_row_scalar(
+                    low, low + width, row_weights[j], amplitude, out.data() + j * width,
+                    width
+                );
+            }
+        }
+    }
+    for (size_t k = 0; k < num_samples; k++) {
+        out[k] /= frequency;
+    }
+}
+
 // returns a value between [0, 1)
 double
 Noise::get_double(size_t i, NoiseTileIndex x, NoiseTileIndex y) {
@@ -37,6 +308,74 @@ Noise::get_double(size_t i, NoiseTileIndex x, NoiseTileIndex y) {
     return static_cast<double>(t) / INT32_MAX;
 }
 
+void
+Noise::get_doubles(
+    size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+) {
+    if (bits::has_avx2()) {
+        get_doubles_avx2(i, x, y, count, out);
+    } else {
+        get_doubles_scalar(i, x, y, count, out);
+    }
+}
+
+void
+Noise::get_doubles_scalar(
+    size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+) {
+    for (size_t k = 0; k < count; k++) {
+        out[k] = get_double(i, x + static_cast<NoiseTileIndex>(k), y);
+    }
+}
+
+#ifdef FUNGAME_AVX2_TARGET
+
+// 32 bit multiplies wrap in each lane, as they do in get_double
+__attribute__((target("avx2"))) void
+Noise::get_doubles_avx2(
+    size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+) {
+    const __m256i a = _mm256_set1_epi32(PRIMES[i][0]);
+    const __m256i b = _mm256_set1_epi32(PRIMES[i][1]);
+    const __m256i c = _mm256_set1_epi32(PRIMES[i][2]);
+    const __m256i x_prime = _mm256_set1_epi32(53);
+    const __m256i y_term =
+        _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(y) * 59u));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i positive = _mm256_set1_epi32(INT32_MAX);
+    const __m256d scale = _mm256_set1_pd(INT32_MAX);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i column = _mm256_add_epi32(
+            _mm256_set1_epi32(x + static_cast<NoiseTileIndex>(k)), lanes
+        );
+        __m256i n = _mm256_add_epi32(_mm256_mullo_epi32(column, x_prime), y_term);
+        n = _mm256_xor_si256(_mm256_slli_epi32(n, 13), n);
+        __m256i t =
+            _mm256_add_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(n, n), a), b);
+        t = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(n, t), c), positive);
+        _mm256_storeu_pd(
+            out + k, _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(t)), scale)
+        );
+        _mm256_storeu_pd(
+            out + k + 4,
+            _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(t, 1)), scale)
+        );
+    }
+    get_doubles_scalar(i, x + static_cast<NoiseTileIndex>(k), y, count - k, out + k);
+}
+
+#else
+
+void
+Noise::get_doubles_avx2(
+    size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+) {
+    get_doubles_scalar(i, x, y, count, out);
+}
+
+#endif
+
 double
 generation::FractalNoise::smoothed_noise_(
     size_t i, NoiseTileIndex x, NoiseTileIndex y
@@ -61,9 +400,7 @@ double
 generation::FractalNoise::interpolate_(
     NoisePosition a, NoisePosition b, NoisePosition x
 ) const { // cosine interpolation
-    double ft = x * std::numbers::pi;
-    double f = (1 - cos(ft)) / 2.0;
-    return a * (1 - f) + b * f;
+    return lerp(a, b, cosine_weight(x));
 }
 
 double
@@ -17,6 +17,7 @@
 
 #include <cmath>
 #include <cstdint>
+#include <span>
 
 namespace terrain {
 
@@ -50,6 +51,28 @@ class Noise {
      */
     static double get_double(size_t i, NoiseTileIndex x, NoiseTileIndex y);
 
+    /**
+     * @brief get_double of count points in a row, (x, y) to (x + count - 1, y)
+     */
+    static void get_doubles(
+        size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+    );
+
+    /**
+     * @brief get_doubles one point at a time.
+     */
+    static void get_doubles_scalar(
+        size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+    );
+
+    /**
+     * @brief get_doubles eight points at a time. Only call when bits::has_avx2
+     * is true.
+     */
+    static void get_doubles_avx2(
+        size_t i, NoiseTileIndex x, NoiseTileIndex y, size_t count, double* out
+    );
+
     /**
      * @brief Virtual function that returns a value depending on the position.
      * This function should be continuous.
@@ -115,6 +138,31 @@ class FractalNoise : protected Noise {
      */
     virtual double get_noise(NoisePosition x, NoisePosition y) const override;
 
+    /**
+     * @brief Get the value of the noise on a grid.
+     *
+     * @details Sets out[j * width + i] to get_noise(x0 + i * dx, y0 + j * dy),
+     * and the values are exactly equal. Each octave finds the smoothed noise of
+     * each lattice point once, instead of for every sample next to it.
+     *
+     * Exact equality relies on noise.cpp being built without fused multiply
+     * adds (-ffp-contract=off on GCC and Clang, /fp:precise on MSVC 2022 or
+     * later). Older MSVC may contract under /fp:precise, and then the values
+     * can differ in the last bit.
+     *
+     * @param x0 postion of the first sample in x direction
+     * @param y0 postion of the first sample in y direction
+     * @param dx distance between samples in x direction
+     * @param dy distance between samples in y direction
+     * @param width number of samples in x direction
+     * @param height number of samples in y direction
+     * @param out at least width * height values, row major
+     */
+    void sample_grid(
+        NoisePosition x0, NoisePosition y0, NoisePosition dx, NoisePosition dy,
+        size_t width, size_t height, std::span<double> out
+    ) const;
+
     using Noise::add_ref;
     using Noise::release_ref;
 
@@ -54,6 +54,18 @@ struct TileStamp {
     std::optional<MaterialGroup> elements_can_stamp;
 };
 
+/**
+ * @brief A TileStamp moved to its place in the terrain
+ *
+ * @details start and end are terrain positions, with end not included. The
+ * offsets of stamp are not used once it is placed.
+ */
+struct PlacedStamp {
+    TerrainOffset3 start; // lowest corner in the terrain
+    TerrainOffset3 end;   // one past the highest corner in the terrain
+    TileStamp stamp;      // material, color, and tiles that can be changed
+};
+
 } // namespace generation
 
 } // namespace terrain
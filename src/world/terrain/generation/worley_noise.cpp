@@ -1,5 +1,8 @@
 #include "worley_noise.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <mutex>
 #include <numbers>
 
 namespace terrain {
@@ -13,17 +16,78 @@ WorleyNoise::distance_(NoisePosition x, NoisePosition y, WorleyPoint point) {
     );
 }
 
+namespace {
+
+// round towards negative infinity
+inline NoiseTileIndex
+floor_div(NoiseTileIndex value, NoiseTileIndex divisor) {
+    NoiseTileIndex quotient = value / divisor;
+    if (value % divisor != 0 && value < 0) {
+        quotient--;
+    }
+    return quotient;
+}
+
+} // namespace
+
 double
 WorleyNoise::get_noise(NoisePosition x, NoisePosition y) const {
     NoiseTileIndex x_tile = x / tile_size_;
     NoiseTileIndex y_tile = y / tile_size_;
 
-    NoiseTileIndex range = point_radius_ / tile_size_ + 1;
+    thread_local std::vector<OrderedPoint> worley_points;
+    get_points_(x_tile, y_tile, get_range_(), worley_points);
+
+    return noise_from_points_(x, y, worley_points);
+}
+
+void
+WorleyNoise::sample_grid(
+    NoisePosition x0, NoisePosition y0, NoisePosition dx, NoisePosition dy,
+    size_t width, size_t height, std::span<double> out
+) const {
+    assert(out.size() >= width * height && "Not enough room for the samples");
+    NoiseTileIndex range = get_range_();
+
+    std::vector<OrderedPoint> worley_points;
+    bool have_points = false;
+    NoiseTileIndex points_x_tile = 0;
+    NoiseTileIndex points_y_tile = 0;
+    for (size_t j = 0; j < height; j++) {
+        for (size_t i = 0; i < width; i++) {
+            NoisePosition x = x0 + i * dx;
+            NoisePosition y = y0 + j * dy;
+            NoiseTileIndex x_tile = x / tile_size_;
+            NoiseTileIndex y_tile = y / tile_size_;
+            // neighboring samples are usually in the same grid square
+            if (!have_points || x_tile != points_x_tile || y_tile != points_y_tile) {
+                get_points_(x_tile, y_tile, range, worley_points);
+                have_points = true;
+                points_x_tile = x_tile;
+                points_y_tile = y_tile;
+            }
+            out[j * width + i] = noise_from_points_(x, y, worley_points);
+        }
+    }
+}
 
-    auto worley_points = get_points_(x_tile, y_tile, range);
+size_t
+WorleyNoise::get_num_cached_blocks() const {
+    std::shared_lock lock(point_cache_mutex_);
+    return point_cache_.size();
+}
+
+NoiseTileIndex
+WorleyNoise::get_range_() const {
+    return static_cast<NoiseTileIndex>(point_radius_ / tile_size_ + 1);
+}
 
+double
+WorleyNoise::noise_from_points_(
+    NoisePosition x, NoisePosition y, const std::vector<OrderedPoint>& points
+) const {
     NoisePosition value = tile_size_ * 2;
-    for (const auto& point : worley_points) {
+    for (const auto& [point, order] : points) {
         NoisePosition d = distance_(x, y, point);
         if (d < value)
             value = d;
@@ -32,42 +96,116 @@ WorleyNoise::get_noise(NoisePosition x, NoisePosition y) const {
     return value;
 }
 
-std::set<WorleyPoint>
+void
 WorleyNoise::get_points_(
-    NoiseTileIndex xt, NoiseTileIndex yt, NoiseTileIndex range
+    NoiseTileIndex xt, NoiseTileIndex yt, NoiseTileIndex range,
+    std::vector<OrderedPoint>& points
 ) const {
-    // assert(range % 2 == 0 && "range must be even");
-    std::set<WorleyPoint> out;
-    // compute index of worley tile
-    for (NoiseTileIndex x_index = xt - range; x_index <= xt + range; x_index++) {
-        for (NoiseTileIndex y_index = yt - range; y_index <= yt + range; y_index++) {
-            // determine where the worley point is in the tile
-            NoisePosition x_position =
-                (get_double(0, x_index, y_index) + x_index - 0.5) * tile_size_;
-            NoisePosition y_position =
-                (get_double(1, x_index, y_index) + y_index - 0.5) * tile_size_;
-            bool positive = get_double(2, x_index, y_index) < positive_chance_;
-            WorleyPoint point({x_position, y_position, tile_size_ / 2, positive});
-            out.insert(std::move(point));
+    points.clear();
+    NoiseTileIndex x_low = xt - range;
+    NoiseTileIndex y_low = yt - range;
+    // one past the last square
+    NoiseTileIndex x_end = xt + range + 1;
+    NoiseTileIndex y_end = yt + range + 1;
+    NoiseTileIndex side = 2 * range + 1;
+
+    // one cache lookup for each block the squares are in
+    NoiseTileIndex block_x_end = floor_div(x_end - 1, CACHE_BLOCK_SIZE) + 1;
+    NoiseTileIndex block_y_end = floor_div(y_end - 1, CACHE_BLOCK_SIZE) + 1;
+    for (NoiseTileIndex block_x = floor_div(x_low, CACHE_BLOCK_SIZE);
+         block_x < block_x_end; block_x++) {
+        for (NoiseTileIndex block_y = floor_div(y_low, CACHE_BLOCK_SIZE);
+             block_y < block_y_end; block_y++) {
+            const PointBlock& block = get_block_(block_x, block_y);
+            NoiseTileIndex block_x_low = block_x * CACHE_BLOCK_SIZE;
+            NoiseTileIndex block_y_low = block_y * CACHE_BLOCK_SIZE;
+            NoiseTileIndex x_begin = std::max(x_low, block_x_low);
+            NoiseTileIndex y_begin = std::max(y_low, block_y_low);
+            NoiseTileIndex block_x_stop =
+                std::min(x_end, block_x_low + CACHE_BLOCK_SIZE);
+            NoiseTileIndex block_y_stop =
+                std::min(y_end, block_y_low + CACHE_BLOCK_SIZE);
+            for (NoiseTileIndex x_index = x_begin; x_index < block_x_stop; x_index++) {
+                for (NoiseTileIndex y_index = y_begin; y_index < block_y_stop;
+                     y_index++) {
+                    // squares used to be visited x major
+                    uint32_t order = (x_index - x_low) * side + (y_index - y_low);
+                    points.push_back(
+                        {block[(x_index - block_x_low) * CACHE_BLOCK_SIZE
+                               + (y_index - block_y_low)],
+                         order}
+                    );
+                }
+            }
         }
     }
-    return out;
+
+    std::sort(points.begin(), points.end(), [](const auto& a, const auto& b) {
+        if (a.point.x_position != b.point.x_position) {
+            return a.point.x_position < b.point.x_position;
+        }
+        return a.order < b.order;
+    });
+    points.erase(
+        std::unique(
+            points.begin(), points.end(),
+            [](const auto& a, const auto& b) {
+                return a.point.x_position == b.point.x_position;
+            }
+        ),
+        points.end()
+    );
 }
 
-double
-AlternativeWorleyNoise::get_noise(NoisePosition x, NoisePosition y) const {
-    NoiseTileIndex xt = x / tile_size_;
-    NoiseTileIndex yt = y / tile_size_;
+WorleyPoint
+WorleyNoise::make_point_(NoiseTileIndex x_index, NoiseTileIndex y_index) const {
+    // determine where the worley point is in the tile
+    NoisePosition x_position =
+        (get_double(0, x_index, y_index) + x_index - 0.5) * tile_size_;
+    NoisePosition y_position =
+        (get_double(1, x_index, y_index) + y_index - 0.5) * tile_size_;
+    bool positive = get_double(2, x_index, y_index) < positive_chance_;
+    return WorleyPoint({x_position, y_position, tile_size_ / 2, positive});
+}
+
+const WorleyNoise::PointBlock&
+WorleyNoise::get_block_(NoiseTileIndex block_x, NoiseTileIndex block_y) const {
+    uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(block_x)) << 32)
+                   | static_cast<uint32_t>(block_y);
+    {
+        std::shared_lock lock(point_cache_mutex_);
+        auto block = point_cache_.find(key);
+        if (block != point_cache_.end()) {
+            return *block->second;
+        }
+    }
+
+    // made without the lock, if another thread makes it first its block is used
+    auto block = std::make_unique<PointBlock>();
+    NoiseTileIndex x_low = block_x * CACHE_BLOCK_SIZE;
+    NoiseTileIndex y_low = block_y * CACHE_BLOCK_SIZE;
+    for (NoiseTileIndex x = 0; x < CACHE_BLOCK_SIZE; x++) {
+        for (NoiseTileIndex y = 0; y < CACHE_BLOCK_SIZE; y++) {
+            (*block)[x * CACHE_BLOCK_SIZE + y] = make_point_(x_low + x, y_low + y);
+        }
+    }
 
-    // the range is determined by the ratio between
-    // point_radius_, and tile_size_
-    // plus 2 I don't exactly know why, but it seems to work.
-    NoiseTileIndex range = point_radius_ / tile_size_ + 2;
+    std::unique_lock lock(point_cache_mutex_);
+    auto [inserted, is_new] = point_cache_.try_emplace(key, std::move(block));
+    return *inserted->second;
+}
 
-    auto worley_points = get_points_(xt, yt, range);
+NoiseTileIndex
+AlternativeWorleyNoise::get_range_() const {
+    return static_cast<NoiseTileIndex>(point_radius_ / tile_size_ + 2);
+}
 
+double
+AlternativeWorleyNoise::noise_from_points_(
+    NoisePosition x, NoisePosition y, const std::vector<OrderedPoint>& points
+) const {
     NoisePosition value = 0;
-    for (const auto& point : worley_points) {
+    for (const auto& [point, order] : points) {
         NoisePosition d = distance_(x, y, point);
         // change is 1 when point.positive is T, and -1 when positive is F.
         double change = point.positive ? 1.0 : -1.0;
@@ -25,9 +25,14 @@
 #include "noise.hpp"
 #include "types.hpp"
 
+#include <array>
 #include <cmath>
 #include <cstdint>
-#include <set>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
 
 namespace terrain {
 
@@ -64,6 +69,9 @@ struct WorleyPoint {
  *
  * @details This implementation uses one point per grid square and returns the
  * minimum distance to any point.
+ *
+ * The point of each grid square is made once, in blocks of squares, and kept
+ * for every later sample. Any thread can sample the noise.
  */
 class WorleyNoise : protected Noise {
  protected:
@@ -73,6 +81,22 @@ class WorleyNoise : protected Noise {
     // chance that any point is positive
     double positive_chance_ = 1;
 
+    // a point, and the order its grid square was visited in
+    struct OrderedPoint {
+        WorleyPoint point;
+        uint32_t order;
+    };
+
+ private:
+    // grid squares on each side of a block of cached points
+    static constexpr NoiseTileIndex CACHE_BLOCK_SIZE = 16;
+    using PointBlock = std::array<WorleyPoint, CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE>;
+
+    // blocks are never removed, so pointers to them stay valid
+    mutable std::unordered_map<uint64_t, std::unique_ptr<const PointBlock>>
+        point_cache_;
+    mutable std::shared_mutex point_cache_mutex_;
+
  public:
     /**
      * @brief Create a new WorleyNoise object.
@@ -88,15 +112,66 @@ class WorleyNoise : protected Noise {
     [[nodiscard]] virtual double
     get_noise(NoisePosition x, NoisePosition y) const override;
 
+    /**
+     * @brief Get the value of the noise on a grid.
+     *
+     * @details Sets out[j * width + i] to get_noise(x0 + i * dx, y0 + j * dy),
+     * and the values are exactly equal. Samples in the same grid square share
+     * the list of points near them.
+     *
+     * @param x0 postion of the first sample in x direction
+     * @param y0 postion of the first sample in y direction
+     * @param dx distance between samples in x direction
+     * @param dy distance between samples in y direction
+     * @param width number of samples in x direction
+     * @param height number of samples in y direction
+     * @param out at least width * height values, row major
+     */
+    void sample_grid(
+        NoisePosition x0, NoisePosition y0, NoisePosition dx, NoisePosition dy,
+        size_t width, size_t height, std::span<double> out
+    ) const;
+
+    /**
+     * @brief Get the number of blocks of points that have been made.
+     */
+    [[nodiscard]] size_t get_num_cached_blocks() const;
+
     using Noise::add_ref;
     using Noise::release_ref;
 
  protected:
-    [[nodiscard]] std::set<WorleyPoint>
-    get_points_(NoiseTileIndex x_t, NoiseTileIndex y_t, NoiseTileIndex range) const;
+    /**
+     * @brief Get the points of the grid squares within range of (x_t, y_t).
+     *
+     * @details Points are ordered by x position. Of points with the same x
+     * position only the first one visited is kept. The points were once kept
+     * in a std::set that did this, and sums over them must add in the same
+     * order to give the same noise.
+     */
+    void get_points_(
+        NoiseTileIndex x_t, NoiseTileIndex y_t, NoiseTileIndex range,
+        std::vector<OrderedPoint>& points
+    ) const;
+
+    // number of grid squares around the sample's square that can change it
+    [[nodiscard]] virtual NoiseTileIndex get_range_() const;
+
+    // value of the noise at (x, y) given the points from get_points_
+    [[nodiscard]] virtual double noise_from_points_(
+        NoisePosition x, NoisePosition y, const std::vector<OrderedPoint>& points
+    ) const;
 
     [[nodiscard]] static double
     distance_(NoisePosition x, NoisePosition y, WorleyPoint point);
+
+ private:
+    // make the point of one grid square
+    [[nodiscard]] WorleyPoint make_point_(NoiseTileIndex x, NoiseTileIndex y) const;
+
+    // get a block of points, and make it if it does not exist
+    [[nodiscard]] const PointBlock&
+    get_block_(NoiseTileIndex block_x, NoiseTileIndex block_y) const;
 };
 
 /**
@@ -119,12 +194,18 @@ class AlternativeWorleyNoise : public WorleyNoise {
         positive_chance_ = positive_chance;
     }
 
-    [[nodiscard]] virtual double
-    get_noise(NoisePosition x, NoisePosition y) const override;
-
     using WorleyNoise::add_ref;
     using WorleyNoise::release_ref;
 
+ protected:
+    // the range is determined by the ratio between point_radius_, and
+    // tile_size_ plus 2 I don't exactly know why, but it seems to work.
+    [[nodiscard]] NoiseTileIndex get_range_() const override;
+
+    [[nodiscard]] double noise_from_points_(
+        NoisePosition x, NoisePosition y, const std::vector<OrderedPoint>& points
+    ) const override;
+
  private:
     [[nodiscard]] double
     modified_cos_(NoisePosition distance, NoisePosition effective_radius) const;
@@ -0,0 +1,100 @@
+#include "level_of_detail.hpp"
+
+#include "chunk.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace terrain {
+
+LodSelector::LodSelector(
+    TerrainOffset3 grid_size, Thresholds thresholds, float hysteresis
+) :
+    grid_size_(grid_size), thresholds_(thresholds), hysteresis_(hysteresis),
+    lods_(static_cast<size_t>(grid_size.x) * grid_size.y * grid_size.z) {
+    assert(std::is_sorted(thresholds_.begin(), thresholds_.end()));
+}
+
+ChunkLod
+LodSelector::get_lod(ChunkPos chunk_position) const {
+    if (!in_range_(chunk_position)) {
+        return {};
+    }
+    return lods_[get_index_(chunk_position)];
+}
+
+uint8_t
+LodSelector::select_level(uint8_t current, float distance) const {
+    uint8_t level = current;
+    while (level + 1 < NUM_LEVELS && distance > thresholds_[level] + hysteresis_) {
+        level++;
+    }
+    while (level > 0 && distance < thresholds_[level - 1] - hysteresis_) {
+        level--;
+    }
+    return level;
+}
+
+float
+LodSelector::distance_to_chunk(glm::vec3 position, ChunkPos chunk_position) {
+    glm::vec3 low = glm::vec3(chunk_position) * static_cast<float>(Chunk::SIZE);
+    glm::vec3 high = low + static_cast<float>(Chunk::SIZE);
+    // zero on each axis where position is within the chunk
+    glm::vec3 outside = glm::max(glm::max(low - position, position - high), 0.0f);
+    return glm::length(outside);
+}
+
+std::vector<ChunkPos>
+LodSelector::update(glm::vec3 camera_position) {
+    std::vector<ChunkLod> previous = lods_;
+
+    for (TerrainOffset x = 0; x < grid_size_.x; x++) {
+        for (TerrainOffset y = 0; y < grid_size_.y; y++) {
+            for (TerrainOffset z = 0; z < grid_size_.z; z++) {
+                ChunkPos chunk_position(x, y, z);
+                ChunkLod& lod = lods_[get_index_(chunk_position)];
+                lod.level = select_level(
+                    lod.level, distance_to_chunk(camera_position, chunk_position)
+                );
+            }
+        }
+    }
+
+    // seams depend on the new level of every neighbor
+    std::vector<ChunkPos> changed;
+    for (TerrainOffset x = 0; x < grid_size_.x; x++) {
+        for (TerrainOffset y = 0; y < grid_size_.y; y++) {
+            for (TerrainOffset z = 0; z < grid_size_.z; z++) {
+                ChunkPos chunk_position(x, y, z);
+                size_t index = get_index_(chunk_position);
+                ChunkLod& lod = lods_[index];
+                lod.seams = 0;
+                for (size_t axis = 0; axis < 3; axis++) {
+                    for (bool above : {false, true}) {
+                        ChunkPos neighbor = chunk_position;
+                        neighbor[axis] += above ? 1 : -1;
+                        if (in_range_(neighbor)
+                            && lods_[get_index_(neighbor)].level != lod.level) {
+                            lod.seams |= 1u << (2 * axis + above);
+                        }
+                    }
+                }
+                if (lod != previous[index]) {
+                    changed.push_back(chunk_position);
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+std::array<size_t, LodSelector::NUM_LEVELS>
+LodSelector::count_levels() const {
+    std::array<size_t, NUM_LEVELS> out{};
+    for (const ChunkLod& lod : lods_) {
+        out[lod.level]++;
+    }
+    return out;
+}
+
+} // namespace terrain
@@ -0,0 +1,156 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file level_of_detail.hpp
+ *
+ * @brief Defines ChunkLod and LodSelector
+ *
+ * @ingroup Terrain
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace terrain {
+
+/**
+ * @brief Level of detail a chunk is meshed at
+ *
+ * @details At level n each voxel of the mesh is 2^n tiles wide. Neighboring
+ * chunks at different levels do not line up, so the mesh of each chunk treats
+ * the voxels across those faces as air (the seams). Both chunks then draw a
+ * wall on their shared face, and there are no gaps.
+ */
+struct ChunkLod {
+    // voxels of the mesh are 2^level tiles wide
+    uint8_t level = 0;
+    // bit 2 * axis is set if the chunk below on axis has a different level,
+    // and bit 2 * axis + 1 if the chunk above does
+    uint8_t seams = 0;
+
+    // width of each voxel in tiles
+    [[nodiscard]] inline VoxelDim
+    get_scale() const noexcept {
+        return VoxelDim(1) << level;
+    }
+
+    [[nodiscard]] inline bool
+    has_seam(size_t axis, bool above) const noexcept {
+        return seams & (1u << (2 * axis + above));
+    }
+
+    bool operator==(const ChunkLod& other) const = default;
+};
+
+/**
+ * @brief Chooses the level of detail of every chunk from the camera position
+ *
+ * @details A chunk uses level n + 1 once its distance to the camera is past
+ * thresholds[n] + hysteresis, and goes back to level n once it is closer than
+ * thresholds[n] - hysteresis. A camera moving back and forth near a threshold
+ * does not cause chunks to be remeshed every frame.
+ *
+ * This does not use OpenGL, so it can be tested headless.
+ */
+class LodSelector {
+ public:
+    // levels 0, 1, and 2. Voxels are 1, 2, or 4 tiles wide
+    static constexpr uint8_t NUM_LEVELS = 3;
+    using Thresholds = std::array<float, NUM_LEVELS - 1>;
+
+ private:
+    // number of chunks in the x, y, and z directions
+    TerrainOffset3 grid_size_;
+    // distance in tiles past which the next level is used
+    Thresholds thresholds_;
+    // distance in tiles past a threshold before the level changes
+    float hysteresis_;
+    // level of detail of each chunk, ordered x, then y, then z
+    std::vector<ChunkLod> lods_;
+
+ public:
+    /**
+     * @brief Construct a new LodSelector. Every chunk starts at level 0.
+     *
+     * @param grid_size number of chunks in the x, y, and z directions
+     * @param thresholds distance in tiles past which each level is used
+     * @param hysteresis distance in tiles past a threshold before the level
+     * changes
+     */
+    explicit LodSelector(
+        TerrainOffset3 grid_size, Thresholds thresholds = {128.0f, 256.0f},
+        float hysteresis = 8.0f
+    );
+
+    /**
+     * @brief Get the level of detail of a chunk
+     *
+     * @return ChunkLod level 0 without seams if chunk_position is out of range
+     */
+    [[nodiscard]] ChunkLod get_lod(ChunkPos chunk_position) const;
+
+    /**
+     * @brief Choose the level of detail of every chunk
+     *
+     * @param camera_position position of the camera in tiles
+     * @return std::vector<ChunkPos> chunks whose level or seams changed, and
+     * must be remeshed
+     */
+    [[nodiscard]] std::vector<ChunkPos> update(glm::vec3 camera_position);
+
+    /**
+     * @brief Choose the level of a chunk at some distance from the camera
+     *
+     * @param current level the chunk is at now
+     * @param distance distance in tiles from the camera to the chunk
+     * @return uint8_t new level
+     */
+    [[nodiscard]] uint8_t select_level(uint8_t current, float distance) const;
+
+    /**
+     * @brief Get the distance from a point to the closest tile of a chunk
+     */
+    [[nodiscard]] static float
+    distance_to_chunk(glm::vec3 position, ChunkPos chunk_position);
+
+    /**
+     * @brief Get the number of chunks at each level
+     */
+    [[nodiscard]] std::array<size_t, NUM_LEVELS> count_levels() const;
+
+ private:
+    [[nodiscard]] inline bool
+    in_range_(ChunkPos chunk_position) const {
+        return chunk_position.x >= 0 && chunk_position.x < grid_size_.x
+               && chunk_position.y >= 0 && chunk_position.y < grid_size_.y
+               && chunk_position.z >= 0 && chunk_position.z < grid_size_.z;
+    }
+
+    [[nodiscard]] inline size_t
+    get_index_(ChunkPos chunk_position) const {
+        return (static_cast<size_t>(chunk_position.x) * grid_size_.y + chunk_position.y)
+                   * grid_size_.z
+               + chunk_position.z;
+    }
+};
+
+} // namespace terrain
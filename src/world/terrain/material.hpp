@@ -261,6 +261,20 @@ class MaterialGroup {
         return materials_no_color_requirement_.contains(material_id);
     }
 
+    /**
+     * @brief Check if the material is in the group with at least one color id.
+     *
+     * @param MaterialId material_id
+     *
+     * @return True some color of the material is in the group
+     * @return False no color of the material is in the group
+     */
+    [[nodiscard]] inline bool
+    any_color_in(MaterialId material_id) const {
+        return material_in(material_id)
+               || materials_with_color_requirement_.contains(material_id);
+    }
+
     bool insert(
         const std::variant<bool, MaterialId, std::vector<MaterialId>>& material,
         const std::variant<bool, ColorId, std::vector<ColorId>>& color
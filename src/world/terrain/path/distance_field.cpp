@@ -0,0 +1,238 @@
+#include "distance_field.hpp"
+
+#include "path_search.hpp"
+#include "world/terrain/terrain.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace terrain {
+
+namespace path {
+
+namespace {
+
+struct FieldNode {
+    // index in the heap, NONE when not in the open set
+    uint32_t heap_index;
+    // index of the next node toward the closest goal
+    uint32_t next;
+    // time to the closest goal, the heap is sorted by this
+    float priority;
+    bool closed;
+};
+
+constexpr float INFINITE = std::numeric_limits<float>::infinity();
+
+} // namespace
+
+DistanceField::DistanceField(
+    const Terrain& terrain, std::unordered_set<TerrainOffset3> goals,
+    UnitPath path_type
+) :
+    goals_(std::move(goals)), path_type_(path_type),
+    graph_version_(terrain.get_node_group_graph().get_version()) {
+    std::vector<uint32_t> goal_ids;
+    for (const TerrainOffset3& goal : goals_) {
+        uint32_t id = get_id_(terrain, goal);
+        if (id != NONE) {
+            goal_ids.push_back(id);
+        }
+    }
+    std::sort(goal_ids.begin(), goal_ids.end());
+    goal_ids.erase(std::unique(goal_ids.begin(), goal_ids.end()), goal_ids.end());
+
+    search_groups_(terrain, goal_ids);
+    search_tiles_(terrain, goal_ids);
+}
+
+bool
+DistanceField::is_current(const Terrain& terrain) const {
+    return graph_version_ == terrain.get_node_group_graph().get_version();
+}
+
+float
+DistanceField::get_distance(const Terrain& terrain, TerrainOffset3 position) const {
+    auto tile_step = tile_steps_.find(position);
+    if (tile_step != tile_steps_.end()) {
+        return tile_step->second.distance;
+    }
+    uint32_t id = get_id_(terrain, position);
+    if (id == NONE || id >= group_distance_.size()) {
+        return INFINITE;
+    }
+    return group_distance_[id];
+}
+
+std::optional<TerrainOffset3>
+DistanceField::get_next_tile(TerrainOffset3 position) const {
+    auto tile_step = tile_steps_.find(position);
+    if (tile_step == tile_steps_.end()) {
+        return {};
+    }
+    return tile_step->second.next;
+}
+
+const NodeGroup*
+DistanceField::get_next_node_group(const Terrain& terrain, TerrainOffset3 position)
+    const {
+    uint32_t id = get_id_(terrain, position);
+    if (id == NONE || id >= next_group_.size() || next_group_[id] == NONE) {
+        return nullptr;
+    }
+    return terrain.get_node_group_graph().get_node_group(next_group_[id]);
+}
+
+std::optional<std::vector<TerrainOffset3>>
+DistanceField::get_path(const Terrain& terrain, TerrainOffset3 start) const {
+    // near a goal follow the tile steps
+    if (tile_steps_.contains(start)) {
+        std::vector<TerrainOffset3> path;
+        TerrainOffset3 position = start;
+        while (true) {
+            path.push_back(position);
+            TerrainOffset3 next = tile_steps_.at(position).next;
+            if (next == position) {
+                break;
+            }
+            position = next;
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    uint32_t id = get_id_(terrain, start);
+    if (id == NONE || id >= group_distance_.size() || group_distance_[id] == INFINITE) {
+        return {};
+    }
+
+    // follow the node groups to a goal then search the tiles in them
+    const NodeGroupGraph& graph = terrain.get_node_group_graph();
+    std::vector<NodeGroupWrapper> node_path;
+    for (; id != NONE; id = next_group_[id]) {
+        node_path.emplace_back(graph.get_node_group(id));
+    }
+    std::reverse(node_path.begin(), node_path.end());
+    return terrain.get_path_through(start, goals_, node_path, path_type_);
+}
+
+void
+DistanceField::search_groups_(
+    const Terrain& terrain, const std::vector<uint32_t>& goal_ids
+) {
+    const NodeGroupGraph& graph = terrain.get_node_group_graph();
+    std::vector<FieldNode> nodes(graph.size(), FieldNode{NONE, NONE, INFINITE, false});
+    IndexedHeap<FieldNode> heap;
+
+    for (uint32_t goal : goal_ids) {
+        nodes[goal].priority = 0;
+        heap.push_or_decrease(nodes, goal);
+    }
+
+    while (!heap.empty()) {
+        uint32_t choice = heap.pop(nodes);
+        nodes[choice].closed = true;
+        float distance = nodes[choice].priority;
+        // node group adjacency goes both ways, so searching out from the
+        // goals gives the time to the goals
+        auto relax = [&](uint32_t adjacent, float cost) {
+            FieldNode& node = nodes[adjacent];
+            if (node.closed || distance + cost >= node.priority) {
+                return;
+            }
+            node.priority = distance + cost;
+            node.next = choice;
+            heap.push_or_decrease(nodes, adjacent);
+        };
+        graph.for_each_adjacent_clear(choice, path_type_, relax);
+    }
+
+    group_distance_.resize(nodes.size());
+    next_group_.resize(nodes.size());
+    for (size_t id = 0; id < nodes.size(); id++) {
+        group_distance_[id] = nodes[id].priority;
+        next_group_[id] = nodes[id].next;
+    }
+}
+
+void
+DistanceField::search_tiles_(
+    const Terrain& terrain, const std::vector<uint32_t>& goal_ids
+) {
+    const NodeGroupGraph& graph = terrain.get_node_group_graph();
+
+    // tiles in node groups with a goal, and the node groups next to them
+    std::unordered_set<uint32_t> near_ids(goal_ids.begin(), goal_ids.end());
+    for (uint32_t goal : goal_ids) {
+        graph.for_each_adjacent_clear(goal, path_type_, [&](uint32_t adjacent, float) {
+            near_ids.insert(adjacent);
+        });
+    }
+
+    std::vector<TerrainOffset3> positions;
+    std::unordered_map<TerrainOffset3, uint32_t> index_of;
+    for (uint32_t id : near_ids) {
+        for (const TerrainOffset3& position : graph.get_node_group(id)->get_tiles()) {
+            index_of.emplace(position, static_cast<uint32_t>(positions.size()));
+            positions.push_back(position);
+        }
+    }
+
+    std::vector<FieldNode> nodes(
+        positions.size(), FieldNode{NONE, NONE, INFINITE, false}
+    );
+    IndexedHeap<FieldNode> heap;
+    for (const TerrainOffset3& goal : goals_) {
+        auto index = index_of.find(goal);
+        if (index == index_of.end()) {
+            continue;
+        }
+        nodes[index->second].priority = 0;
+        nodes[index->second].next = index->second;
+        heap.push_or_decrease(nodes, index->second);
+    }
+
+    while (!heap.empty()) {
+        uint32_t choice = heap.pop(nodes);
+        nodes[choice].closed = true;
+        float distance = nodes[choice].priority;
+        auto tile_it =
+            terrain.get_tile_adjacent_iterator(positions[choice], path_type_);
+        for (; !tile_it.end(); tile_it++) {
+            auto index = index_of.find(tile_it.get_pos());
+            if (index == index_of.end()) {
+                continue;
+            }
+            FieldNode& node = nodes[index->second];
+            float cost = Terrain::get_H_cost(positions[choice], tile_it.get_pos());
+            if (node.closed || distance + cost >= node.priority) {
+                continue;
+            }
+            node.priority = distance + cost;
+            node.next = choice;
+            heap.push_or_decrease(nodes, index->second);
+        }
+    }
+
+    tile_steps_.reserve(positions.size());
+    for (size_t index = 0; index < positions.size(); index++) {
+        if (nodes[index].next == NONE) {
+            continue;
+        }
+        TileStep step{positions[nodes[index].next], nodes[index].priority};
+        tile_steps_.emplace(positions[index], step);
+    }
+}
+
+uint32_t
+DistanceField::get_id_(const Terrain& terrain, TerrainOffset3 position) const {
+    const NodeGroup* node_group = terrain.get_node_group(position);
+    if (!node_group) {
+        return NONE;
+    }
+    return terrain.get_node_group_graph().get_id(node_group);
+}
+
+} // namespace path
+
+} // namespace terrain
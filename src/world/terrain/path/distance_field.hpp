@@ -0,0 +1,154 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file distance_field.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Defines DistanceField class
+ *
+ * @ingroup terrain::path
+ *
+ */
+
+#pragma once
+
+#include "node_group.hpp"
+#include "types.hpp"
+#include "unit_path.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace terrain {
+
+class Terrain;
+
+namespace path {
+
+/**
+ * @brief Distance from every node group to the closest of a set of goals
+ *
+ * @details One multi-source Dijkstra search runs outward from all goals over
+ * the NodeGroupGraph. Each node group stores its time to the closest goal, and
+ * the next node group toward it. A second search at tile level covers the
+ * node groups with a goal, and the node groups next to them, so agents close
+ * to a goal can read their next tile directly.
+ *
+ * The field stores graph ids, so it is out of date once the graph changes
+ * (see is_current).
+ */
+class DistanceField {
+ public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    struct TileStep {
+        // next tile toward the closest goal, same as the tile at a goal
+        TerrainOffset3 next;
+        // time to the closest goal
+        float distance;
+    };
+
+ private:
+    std::unordered_set<TerrainOffset3> goals_;
+    UnitPath path_type_;
+    // graph version the field was built from
+    size_t graph_version_;
+
+    // indexed by graph id
+    std::vector<float> group_distance_;
+    std::vector<uint32_t> next_group_;
+
+    std::unordered_map<TerrainOffset3, TileStep> tile_steps_;
+
+ public:
+    /**
+     * @brief Build the distance field
+     *
+     * @param terrain terrain to search
+     * @param goals goal tiles, goals without a node group are ignored
+     * @param path_type type of paths that are allowed
+     */
+    DistanceField(
+        const Terrain& terrain, std::unordered_set<TerrainOffset3> goals,
+        UnitPath path_type = 31
+    );
+
+    /**
+     * @brief Was the field built from the current node group graph
+     */
+    [[nodiscard]] bool is_current(const Terrain& terrain) const;
+
+    /**
+     * @brief Get the goal tiles
+     */
+    [[nodiscard]] inline const std::unordered_set<TerrainOffset3>&
+    get_goals() const {
+        return goals_;
+    }
+
+    /**
+     * @brief Get the time from position to the closest goal
+     *
+     * @return float time, infinity if no goal can be reached
+     */
+    [[nodiscard]] float
+    get_distance(const Terrain& terrain, TerrainOffset3 position) const;
+
+    /**
+     * @brief Get the next tile toward the closest goal
+     *
+     * @details Only tiles near a goal have a next tile.
+     *
+     * @return std::optional<TerrainOffset3> next tile, empty if position is
+     * not near a goal
+     */
+    [[nodiscard]] std::optional<TerrainOffset3> get_next_tile(TerrainOffset3 position
+    ) const;
+
+    /**
+     * @brief Get the next node group toward the closest goal
+     *
+     * @return const NodeGroup* next node group, nullptr if position is in a
+     * node group with a goal, or no goal can be reached
+     */
+    [[nodiscard]] const NodeGroup*
+    get_next_node_group(const Terrain& terrain, TerrainOffset3 position) const;
+
+    /**
+     * @brief Get a path from start to the closest goal
+     *
+     * @return std::optional<std::vector<TerrainOffset3>> path from the goal
+     * back to start
+     */
+    [[nodiscard]] std::optional<std::vector<TerrainOffset3>>
+    get_path(const Terrain& terrain, TerrainOffset3 start) const;
+
+ private:
+    void search_groups_(const Terrain& terrain, const std::vector<uint32_t>& goal_ids);
+
+    void search_tiles_(const Terrain& terrain, const std::vector<uint32_t>& goal_ids);
+
+    // graph id of the node group at position, NONE if there is none
+    [[nodiscard]] uint32_t
+    get_id_(const Terrain& terrain, TerrainOffset3 position) const;
+};
+
+} // namespace path
+
+} // namespace terrain
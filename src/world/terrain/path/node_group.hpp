@@ -112,6 +112,20 @@ class NodeGroup {
     [[nodiscard]] std::unordered_set<const NodeGroup*>
     get_adjacent_clear(UnitPath path_type) const;
 
+    /**
+     * @brief Call function on each adjacent node group
+     *
+     * @param function called with const NodeGroup*, and the UnitPath between
+     * the two node groups
+     */
+    template <class F>
+    inline void
+    for_each_adjacent(F function) const {
+        for (const auto& [node_group, adjacent_path] : adjacent) {
+            function(static_cast<const NodeGroup*>(node_group), adjacent_path);
+        }
+    }
+
     /**
      * @brief Remove node group from adjacency
      *
@@ -0,0 +1,270 @@
+#include "node_group_graph.hpp"
+
+#include "path_search.hpp"
+#include "world/terrain/chunk.hpp"
+#include "world/terrain/terrain.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace terrain {
+
+namespace path {
+
+void
+NodeGroupGraph::build(const Terrain& terrain) {
+    groups_.clear();
+    centers_.clear();
+    edge_begin_.clear();
+    edge_count_.clear();
+    edge_targets_.clear();
+    edge_paths_.clear();
+    edge_costs_.clear();
+    unused_edges_ = 0;
+    free_ids_.clear();
+    id_of_.clear();
+    chunk_ids_.clear();
+    version_++;
+
+    for (const Chunk& chunk : terrain.get_chunks()) {
+        std::vector<uint32_t>& ids = chunk_ids_[chunk.get_chunk_position()];
+        for (const NodeGroup& node_group : chunk.get_node_groups()) {
+            ids.push_back(add_group_(&node_group));
+        }
+    }
+    // ids were given out in order, so rows are written in order
+    for (uint32_t id = 0; id < groups_.size(); id++) {
+        write_row_(id);
+    }
+}
+
+std::vector<uint32_t>
+NodeGroupGraph::update(
+    const Terrain& terrain, const std::vector<ChunkPos>& changed_chunks
+) {
+    version_++;
+    std::vector<uint32_t> changed_ids;
+    for (ChunkPos chunk_position : changed_chunks) {
+        std::vector<uint32_t>& ids = chunk_ids_[chunk_position];
+        for (uint32_t id : ids) {
+            remove_group_(id);
+            changed_ids.push_back(id);
+        }
+        ids.clear();
+    }
+
+    for (ChunkPos chunk_position : changed_chunks) {
+        const Chunk* chunk = terrain.get_chunk(chunk_position);
+        if (!chunk) {
+            continue;
+        }
+        std::vector<uint32_t>& ids = chunk_ids_[chunk_position];
+        for (const NodeGroup& node_group : chunk->get_node_groups()) {
+            ids.push_back(add_group_(&node_group));
+        }
+    }
+
+    // node groups are only adjacent to node groups in bordering chunks, so
+    // those are the only rows that can point to a removed or added id
+    std::unordered_set<ChunkPos> rewrite;
+    for (ChunkPos chunk_position : changed_chunks) {
+        for (int16_t x = -1; x <= 1; x++) {
+            for (int16_t y = -1; y <= 1; y++) {
+                for (int16_t z = -1; z <= 1; z++) {
+                    rewrite.insert(chunk_position + ChunkPos(x, y, z));
+                }
+            }
+        }
+    }
+    for (ChunkPos chunk_position : rewrite) {
+        auto ids = chunk_ids_.find(chunk_position);
+        if (ids == chunk_ids_.end()) {
+            continue;
+        }
+        for (uint32_t id : ids->second) {
+            if (write_row_(id)) {
+                changed_ids.push_back(id);
+            }
+        }
+    }
+
+    if (unused_edges_ > edge_targets_.size() / 2) {
+        compact_edges_();
+    }
+
+    return changed_ids;
+}
+
+uint32_t
+NodeGroupGraph::get_id(const NodeGroup* node_group) const {
+    auto id = id_of_.find(node_group);
+    if (id == id_of_.end()) {
+        return NONE;
+    }
+    return id->second;
+}
+
+std::optional<std::vector<uint32_t>>
+NodeGroupGraph::find_path(
+    uint32_t start, const std::vector<uint32_t>& goals, bool use_heuristic,
+    UnitPath path_type
+) const {
+    if (goals.empty() || goals.front() >= groups_.size() || start >= groups_.size()
+        || !groups_[start]) {
+        return {};
+    }
+
+    // ids are dense keys, so the graph search shares the tile search arena
+    SearchArena& arena = SearchArena::local();
+    arena.reset(groups_.size());
+
+    for (uint32_t goal : goals) {
+        if (goal < groups_.size()) {
+            arena[arena.touch(goal)].goal = true;
+        }
+    }
+
+    const glm::vec3 heuristic_goal = centers_[goals.front()];
+    auto heuristic = [&](uint32_t id) -> float {
+        if (use_heuristic) {
+            return Terrain::get_H_cost(centers_[id], heuristic_goal);
+        } else {
+            return 0;
+        }
+    };
+
+    uint32_t start_index = arena.touch(start);
+    arena[start_index].g_cost = 0;
+    arena[start_index].priority = heuristic(start);
+    arena.push_or_decrease(start_index);
+
+    while (!arena.empty()) {
+        uint32_t choice = arena.pop();
+        arena[choice].closed = true;
+        uint32_t choice_id = arena[choice].key;
+
+        if (arena[choice].goal) {
+            std::vector<uint32_t> path;
+            for (uint32_t index = choice; index != SearchArena::NONE;
+                 index = arena[index].parent) {
+                path.push_back(arena[index].key);
+            }
+            return path;
+        }
+
+        float choice_g_cost = arena[choice].g_cost;
+        auto relax = [&](uint32_t adjacent, float cost) {
+            // touch may reallocate, so look nodes up by index after
+            uint32_t index = arena.touch(adjacent);
+            if (arena[index].closed) {
+                return;
+            }
+            float g_cost = choice_g_cost + cost;
+            if (g_cost < arena[index].g_cost) {
+                arena[index].g_cost = g_cost;
+                arena[index].parent = choice;
+                arena[index].priority = g_cost + heuristic(adjacent);
+                arena.push_or_decrease(index);
+            }
+        };
+        for_each_adjacent_clear(choice_id, path_type, relax);
+    }
+    return {};
+}
+
+uint32_t
+NodeGroupGraph::add_group_(const NodeGroup* node_group) {
+    uint32_t id;
+    if (free_ids_.empty()) {
+        id = static_cast<uint32_t>(groups_.size());
+        groups_.push_back(node_group);
+        centers_.push_back(node_group->sop());
+        edge_begin_.push_back(0);
+        edge_count_.push_back(0);
+    } else {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+        groups_[id] = node_group;
+        centers_[id] = node_group->sop();
+    }
+    id_of_[node_group] = id;
+    return id;
+}
+
+void
+NodeGroupGraph::remove_group_(uint32_t id) {
+    id_of_.erase(groups_[id]);
+    groups_[id] = nullptr;
+    unused_edges_ += edge_count_[id];
+    edge_count_[id] = 0;
+    free_ids_.push_back(id);
+}
+
+bool
+NodeGroupGraph::write_row_(uint32_t id) {
+    uint32_t old_begin = edge_begin_[id];
+    uint32_t old_count = edge_count_[id];
+    unused_edges_ += old_count;
+    edge_begin_[id] = static_cast<uint32_t>(edge_targets_.size());
+    uint32_t count = 0;
+    groups_[id]->for_each_adjacent([&](const NodeGroup* adjacent, UnitPath path_type) {
+        uint32_t adjacent_id = get_id(adjacent);
+        if (adjacent_id == NONE) {
+            return;
+        }
+        edge_targets_.push_back(adjacent_id);
+        edge_paths_.push_back(path_type);
+        edge_costs_.push_back(Terrain::get_H_cost(centers_[id], centers_[adjacent_id]));
+        count++;
+    });
+    edge_count_[id] = count;
+
+    // the old row is still in the edge arrays, so compare against it
+    if (count != old_count) {
+        return true;
+    }
+    auto old_targets = edge_targets_.begin() + old_begin;
+    auto old_paths = edge_paths_.begin() + old_begin;
+    return !std::equal(
+               old_targets, old_targets + old_count,
+               edge_targets_.begin() + edge_begin_[id]
+           )
+           || !std::equal(
+               old_paths, old_paths + old_count, edge_paths_.begin() + edge_begin_[id]
+           );
+}
+
+void
+NodeGroupGraph::compact_edges_() {
+    std::vector<uint32_t> edge_targets;
+    std::vector<UnitPath> edge_paths;
+    std::vector<float> edge_costs;
+    edge_targets.reserve(num_edges());
+    edge_paths.reserve(num_edges());
+    edge_costs.reserve(num_edges());
+
+    for (uint32_t id = 0; id < groups_.size(); id++) {
+        uint32_t begin = edge_begin_[id];
+        uint32_t end = begin + edge_count_[id];
+        edge_begin_[id] = static_cast<uint32_t>(edge_targets.size());
+        edge_targets.insert(
+            edge_targets.end(), edge_targets_.begin() + begin,
+            edge_targets_.begin() + end
+        );
+        edge_paths.insert(
+            edge_paths.end(), edge_paths_.begin() + begin, edge_paths_.begin() + end
+        );
+        edge_costs.insert(
+            edge_costs.end(), edge_costs_.begin() + begin, edge_costs_.begin() + end
+        );
+    }
+
+    edge_targets_ = std::move(edge_targets);
+    edge_paths_ = std::move(edge_paths);
+    edge_costs_ = std::move(edge_costs);
+    unused_edges_ = 0;
+}
+
+} // namespace path
+
+} // namespace terrain
@@ -0,0 +1,202 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file node_group_graph.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Defines NodeGroupGraph class
+ *
+ * @ingroup terrain::path
+ *
+ */
+
+#pragma once
+
+#include "node_group.hpp"
+#include "types.hpp"
+#include "unit_path.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace terrain {
+
+class Terrain;
+
+namespace path {
+
+/**
+ * @brief Adjacency graph of every NodeGroup in compressed sparse row form
+ *
+ * @details Each NodeGroup gets an integer id that does not change while the
+ * group exists. Ids of removed groups are reused by new groups. The edges of
+ * id are edge_targets_[edge_begin_[id]] to
+ * edge_targets_[edge_begin_[id] + edge_count_[id]], with the UnitPath and time
+ * of each edge stored at the same index.
+ *
+ * When chunks change only the rows of node groups in and next to those chunks
+ * are rewritten. Rewritten rows are appended to the end of the edge arrays,
+ * and the arrays are compacted once more than half of the edges are unused.
+ *
+ * Searches only read the graph, so any number can run at once. Updates must
+ * not run at the same time as a search.
+ */
+class NodeGroupGraph {
+ public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+ private:
+    // node group for each id, nullptr for unused ids
+    std::vector<const NodeGroup*> groups_;
+    // volumetric center of each node group
+    std::vector<glm::vec3> centers_;
+    // index of the first edge of each id
+    std::vector<uint32_t> edge_begin_;
+    // number of edges of each id
+    std::vector<uint32_t> edge_count_;
+
+    std::vector<uint32_t> edge_targets_;
+    std::vector<UnitPath> edge_paths_;
+    std::vector<float> edge_costs_;
+    // number of edges no row points to
+    size_t unused_edges_ = 0;
+
+    std::vector<uint32_t> free_ids_;
+    std::unordered_map<const NodeGroup*, uint32_t> id_of_;
+    std::unordered_map<ChunkPos, std::vector<uint32_t>> chunk_ids_;
+    // incremented every time the graph changes
+    size_t version_ = 0;
+
+ public:
+    /**
+     * @brief Build the graph from every node group in terrain
+     *
+     * @param terrain terrain to get node groups from
+     */
+    void build(const Terrain& terrain);
+
+    /**
+     * @brief Update the graph after the node groups in some chunks changed
+     *
+     * @param terrain terrain to get node groups from
+     * @param changed_chunks chunks whose node groups changed
+     * @return std::vector<uint32_t> ids that were removed, or whose edges
+     * changed
+     */
+    std::vector<uint32_t>
+    update(const Terrain& terrain, const std::vector<ChunkPos>& changed_chunks);
+
+    /**
+     * @brief Get the id of node group
+     *
+     * @param node_group node group in the graph
+     * @return uint32_t id, NONE if node group is not in the graph
+     */
+    [[nodiscard]] uint32_t get_id(const NodeGroup* node_group) const;
+
+    /**
+     * @brief Get the node group with id
+     *
+     * @param id id in the graph
+     * @return const NodeGroup* node group, nullptr if id is unused
+     */
+    [[nodiscard]] inline const NodeGroup*
+    get_node_group(uint32_t id) const {
+        return groups_[id];
+    }
+
+    /**
+     * @brief Number of ids, including unused ids
+     */
+    [[nodiscard]] inline size_t
+    size() const {
+        return groups_.size();
+    }
+
+    /**
+     * @brief Number of times the graph has changed
+     *
+     * @details Anything that stores ids can compare this to know when they
+     * are out of date.
+     */
+    [[nodiscard]] inline size_t
+    get_version() const {
+        return version_;
+    }
+
+    /**
+     * @brief Number of edges rows point to
+     */
+    [[nodiscard]] inline size_t
+    num_edges() const {
+        return edge_targets_.size() - unused_edges_;
+    }
+
+    /**
+     * @brief Call function on each edge of id compatible with path type
+     *
+     * @param id id of node group
+     * @param path_type type of paths that are allowed
+     * @param function called with the target id, and the time of the edge
+     */
+    template <class F>
+    inline void
+    for_each_adjacent_clear(uint32_t id, UnitPath path_type, F function) const {
+        uint32_t end = edge_begin_[id] + edge_count_[id];
+        for (uint32_t edge = edge_begin_[id]; edge < end; edge++) {
+            const UnitPath& edge_path = edge_paths_[edge];
+            if (edge_path.compatible(path_type) && edge_path.is_open()) {
+                function(edge_targets_[edge], edge_costs_[edge]);
+            }
+        }
+    }
+
+    /**
+     * @brief Find the fastest path from start to any goal
+     *
+     * @details With use_heuristic this is A* using the distance to the first
+     * goal, otherwise it is Dijkstra's algorithm and finds the closest goal.
+     * Uses the thread local SearchArena with ids as keys, so nothing is
+     * allocated or cleared in proportion to the world size.
+     *
+     * @param start start id
+     * @param goals goal ids
+     * @param use_heuristic use the distance to the goal to guide the search
+     * @param path_type type of paths that are allowed
+     * @return std::optional<std::vector<uint32_t>> path from the goal back to
+     * start
+     */
+    [[nodiscard]] std::optional<std::vector<uint32_t>> find_path(
+        uint32_t start, const std::vector<uint32_t>& goals, bool use_heuristic,
+        UnitPath path_type = 31
+    ) const;
+
+ private:
+    uint32_t add_group_(const NodeGroup* node_group);
+
+    void remove_group_(uint32_t id);
+
+    // returns true if the edges of id changed
+    bool write_row_(uint32_t id);
+
+    void compact_edges_();
+};
+
+} // namespace path
+
+} // namespace terrain
@@ -49,6 +49,11 @@ class NodeGroupWrapper {
         return nodegroup_->get_chunk_position();
     }
 
+    [[nodiscard]] inline const NodeGroup*
+    get_node_group() const {
+        return nodegroup_;
+    }
+
     [[nodiscard]] inline std::unordered_set<const NodeGroup*>
     get_adjacent_clear(UnitPath path_type) const {
         return nodegroup_->get_adjacent_clear(path_type);
@@ -0,0 +1,375 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file path_search.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Defines IndexedHeap, SearchArena, and find_path
+ *
+ * @ingroup terrain::path
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace terrain {
+
+namespace path {
+
+/**
+ * @brief Binary heap of node indices with decrease-key.
+ *
+ * @details Node must have a float priority and a uint32_t heap_index. Each
+ * node knows its position in the heap, so a node whose priority fell can be
+ * moved up in O(log n) instead of rebuilding the heap.
+ *
+ * @tparam Node node type
+ */
+template <class Node>
+class IndexedHeap {
+ public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+ private:
+    std::vector<uint32_t> heap_;
+
+ public:
+    inline void
+    clear() {
+        heap_.clear();
+    }
+
+    [[nodiscard]] inline bool
+    empty() const {
+        return heap_.empty();
+    }
+
+    /**
+     * @brief Add node to the heap, or move it up if its priority fell
+     */
+    inline void
+    push_or_decrease(std::vector<Node>& nodes, uint32_t index) {
+        if (nodes[index].heap_index == NONE) {
+            nodes[index].heap_index = static_cast<uint32_t>(heap_.size());
+            heap_.push_back(index);
+        }
+        sift_up_(nodes, nodes[index].heap_index);
+    }
+
+    /**
+     * @brief Remove and return the node with the lowest priority
+     */
+    inline uint32_t
+    pop(std::vector<Node>& nodes) {
+        uint32_t top = heap_.front();
+        nodes[top].heap_index = NONE;
+        uint32_t last = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) {
+            heap_.front() = last;
+            nodes[last].heap_index = 0;
+            sift_down_(nodes, 0);
+        }
+        return top;
+    }
+
+ private:
+    inline void
+    swap_(std::vector<Node>& nodes, uint32_t heap_a, uint32_t heap_b) {
+        std::swap(heap_[heap_a], heap_[heap_b]);
+        nodes[heap_[heap_a]].heap_index = heap_a;
+        nodes[heap_[heap_b]].heap_index = heap_b;
+    }
+
+    [[nodiscard]] inline bool
+    less_(const std::vector<Node>& nodes, uint32_t heap_a, uint32_t heap_b) const {
+        return nodes[heap_[heap_a]].priority < nodes[heap_[heap_b]].priority;
+    }
+
+    inline void
+    sift_up_(std::vector<Node>& nodes, uint32_t heap_index) {
+        while (heap_index > 0) {
+            uint32_t parent = (heap_index - 1) / 2;
+            if (!less_(nodes, heap_index, parent)) {
+                return;
+            }
+            swap_(nodes, heap_index, parent);
+            heap_index = parent;
+        }
+    }
+
+    inline void
+    sift_down_(std::vector<Node>& nodes, uint32_t heap_index) {
+        uint32_t size = static_cast<uint32_t>(heap_.size());
+        while (true) {
+            uint32_t smallest = heap_index;
+            uint32_t left = 2 * heap_index + 1;
+            uint32_t right = left + 1;
+            if (left < size && less_(nodes, left, smallest)) {
+                smallest = left;
+            }
+            if (right < size && less_(nodes, right, smallest)) {
+                smallest = right;
+            }
+            if (smallest == heap_index) {
+                return;
+            }
+            swap_(nodes, heap_index, smallest);
+            heap_index = smallest;
+        }
+    }
+};
+
+/**
+ * @brief Memory used by one path search, indexed by a dense key.
+ *
+ * @details Keys are 0 to the number of keys given to reset, for example a node
+ * group id or a tile index. Keys are split into pages of PAGE_SIZE, and a page
+ * gets storage the first time a search touches it, so memory grows with the
+ * area searched rather than the number of keys. Nodes refer to each other by
+ * index in the arena, and the open set is an IndexedHeap.
+ *
+ * Each node and page keeps the stamp of the search that last touched it.
+ * reset increments the stamp instead of clearing nodes, and a node with an old
+ * stamp is reset when it is touched. Use local() to get an arena for this
+ * thread.
+ */
+class SearchArena {
+ public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    // keys per page, one chunk of tiles
+    static constexpr uint32_t PAGE_SIZE = 4096;
+
+    struct SearchNode {
+        // search this node was last touched by
+        uint32_t stamp;
+        // key of this node
+        uint32_t key;
+        // index of the node this one was reached from
+        uint32_t parent;
+        // index in the heap, NONE when not in the open set
+        uint32_t heap_index;
+        // time from start to this node
+        float g_cost;
+        // value the heap is sorted by
+        float priority;
+        // has the fastest path to this node been found
+        bool closed;
+        bool goal;
+    };
+
+ private:
+    // pages of nodes, in the order this search touched them
+    std::vector<SearchNode> nodes_;
+    // page of nodes_ used by each page of keys
+    std::vector<uint32_t> page_index_;
+    // search that set page_index_
+    std::vector<uint32_t> page_stamp_;
+    // pages of nodes_ used by this search
+    uint32_t num_pages_ = 0;
+    uint32_t stamp_ = 0;
+    IndexedHeap<SearchNode> heap_;
+
+ public:
+    /**
+     * @brief Get the arena for this thread
+     */
+    [[nodiscard]] static SearchArena&
+    local() {
+        thread_local SearchArena arena;
+        return arena;
+    }
+
+    /**
+     * @brief Start a new search over num_keys keys
+     */
+    inline void
+    reset(size_t num_keys) {
+        heap_.clear();
+        num_pages_ = 0;
+        size_t num_key_pages = (num_keys + PAGE_SIZE - 1) / PAGE_SIZE;
+        if (page_stamp_.size() < num_key_pages) {
+            page_stamp_.resize(num_key_pages, 0);
+            page_index_.resize(num_key_pages, 0);
+        }
+        stamp_++;
+        if (stamp_ == 0) {
+            // stamp wrapped around, old stamps could match again
+            std::fill(page_stamp_.begin(), page_stamp_.end(), 0);
+            for (SearchNode& node : nodes_) {
+                node.stamp = 0;
+            }
+            stamp_ = 1;
+        }
+    }
+
+    /**
+     * @brief Get the index of the node with key, resetting it if this search
+     * has not touched it
+     *
+     * @details May reallocate, so hold indices rather than references across
+     * calls.
+     */
+    inline uint32_t
+    touch(uint32_t key) {
+        uint32_t key_page = key / PAGE_SIZE;
+        if (page_stamp_[key_page] != stamp_) {
+            page_stamp_[key_page] = stamp_;
+            page_index_[key_page] = num_pages_++;
+            if (nodes_.size() < size_t(num_pages_) * PAGE_SIZE) {
+                nodes_.resize(size_t(num_pages_) * PAGE_SIZE, SearchNode{});
+            }
+        }
+        uint32_t index = page_index_[key_page] * PAGE_SIZE + key % PAGE_SIZE;
+        SearchNode& node = nodes_[index];
+        if (node.stamp != stamp_) {
+            node = SearchNode{
+                stamp_,
+                key,
+                NONE,
+                NONE,
+                std::numeric_limits<float>::infinity(),
+                std::numeric_limits<float>::infinity(),
+                false,
+                false
+            };
+        }
+        return index;
+    }
+
+    [[nodiscard]] inline SearchNode&
+    operator[](uint32_t index) {
+        return nodes_[index];
+    }
+
+    [[nodiscard]] inline bool
+    empty() const {
+        return heap_.empty();
+    }
+
+    inline void
+    push_or_decrease(uint32_t index) {
+        heap_.push_or_decrease(nodes_, index);
+    }
+
+    inline uint32_t
+    pop() {
+        return heap_.pop(nodes_);
+    }
+};
+
+/**
+ * @brief Find the fastest path from start to any goal
+ *
+ * @details With use_heuristic this is A* using the distance to the first goal,
+ * otherwise it is Dijkstra's algorithm and finds the closest goal. Uses the
+ * thread local SearchArena, so positions are stored by their dense key.
+ *
+ * @tparam T position type
+ * @tparam use_heuristic use the distance to the goal to guide the search
+ * @param start start position
+ * @param goal goal positions
+ * @param num_keys number of keys, every key_of is less than this
+ * @param key_of key_of(position) dense key of position
+ * @param position_of position_of(key) position with key
+ * @param cost cost(a, b) time between two positions
+ * @param for_each_adjacent for_each_adjacent(position, visit) calls visit on
+ * each position that can be reached from position
+ * @param allowed allowed(position) can the path pass through position
+ * @return std::optional<std::vector<T>> path from the goal back to start
+ */
+template <
+    class T, bool use_heuristic, class KeyOf, class PositionOf, class Cost,
+    class ForEachAdjacent, class Allowed>
+[[nodiscard]] std::optional<std::vector<T>>
+find_path(
+    const T& start, const std::unordered_set<T>& goal, size_t num_keys,
+    KeyOf key_of, PositionOf position_of, Cost cost,
+    ForEachAdjacent for_each_adjacent, Allowed allowed
+) {
+    if (goal.empty()) {
+        return {};
+    }
+
+    SearchArena& arena = SearchArena::local();
+    arena.reset(num_keys);
+
+    for (const T& goal_position : goal) {
+        arena[arena.touch(key_of(goal_position))].goal = true;
+    }
+
+    const T& heuristic_goal = *goal.begin();
+    auto heuristic = [&](const T& position) -> float {
+        if constexpr (use_heuristic) {
+            return cost(position, heuristic_goal);
+        } else {
+            return 0;
+        }
+    };
+
+    uint32_t start_index = arena.touch(key_of(start));
+    arena[start_index].g_cost = 0;
+    arena[start_index].priority = heuristic(start);
+    arena.push_or_decrease(start_index);
+
+    while (!arena.empty()) {
+        uint32_t choice = arena.pop();
+        arena[choice].closed = true;
+        const T position = position_of(arena[choice].key);
+
+        if (arena[choice].goal) {
+            std::vector<T> path;
+            for (uint32_t index = choice; index != SearchArena::NONE;
+                 index = arena[index].parent) {
+                path.push_back(position_of(arena[index].key));
+            }
+            return path;
+        }
+
+        float choice_g_cost = arena[choice].g_cost;
+        for_each_adjacent(position, [&](const T& adjacent) {
+            if (!allowed(adjacent)) {
+                return;
+            }
+            // touch may reallocate, so look nodes up by index after
+            uint32_t index = arena.touch(key_of(adjacent));
+            if (arena[index].closed) {
+                return;
+            }
+            float g_cost = choice_g_cost + cost(position, adjacent);
+            if (g_cost < arena[index].g_cost) {
+                arena[index].g_cost = g_cost;
+                arena[index].parent = choice;
+                arena[index].priority = g_cost + heuristic(adjacent);
+                arena.push_or_decrease(index);
+            }
+        });
+    }
+    return {};
+}
+
+} // namespace path
+
+} // namespace terrain
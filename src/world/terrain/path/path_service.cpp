@@ -0,0 +1,167 @@
+#include "path_service.hpp"
+
+#include "global_context.hpp"
+#include "world/terrain/terrain.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+
+namespace terrain {
+
+namespace path {
+
+namespace {
+
+// requests are the same if they have the same start, goals, and path type
+struct RequestKey {
+    TerrainOffset3 start;
+    std::vector<TerrainOffset3> goals;
+    path_t path_type;
+
+    explicit RequestKey(const PathRequest& request) :
+        start(request.start), goals(request.goals.begin(), request.goals.end()),
+        path_type(request.path_type.get_type()) {
+        std::sort(
+            goals.begin(), goals.end(),
+            [](const TerrainOffset3& lhs, const TerrainOffset3& rhs) {
+                return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+            }
+        );
+    }
+
+    [[nodiscard]] bool
+    operator==(const RequestKey& other) const {
+        return start == other.start && path_type == other.path_type
+               && goals == other.goals;
+    }
+};
+
+struct RequestKeyHash {
+    [[nodiscard]] size_t
+    operator()(const RequestKey& key) const {
+        size_t result = std::hash<TerrainOffset3>()(key.start);
+        utils::hash_combine(result, key.path_type);
+        for (const TerrainOffset3& goal : key.goals) {
+            utils::hash_combine(result, std::hash<TerrainOffset3>()(goal));
+        }
+        return result;
+    }
+};
+
+} // namespace
+
+std::vector<std::shared_future<PathResult>>
+PathService::submit(const std::vector<PathRequest>& requests) const {
+    std::vector<std::shared_future<PathResult>> out(requests.size());
+
+    for (const std::vector<size_t>& group : group_requests_(requests)) {
+        auto promise = std::make_shared<std::promise<PathResult>>();
+        std::shared_future<PathResult> future = promise->get_future().share();
+        for (size_t index : group) {
+            out[index] = future;
+        }
+        schedule_(requests[group.front()], [promise](PathResult result) {
+            promise->set_value(std::move(result));
+        });
+    }
+    return out;
+}
+
+void
+PathService::submit(
+    const std::vector<PathRequest>& requests,
+    std::function<void(size_t, const PathResult&)> callback
+) const {
+    for (std::vector<size_t>& group : group_requests_(requests)) {
+        const PathRequest& request = requests[group.front()];
+        schedule_(
+            request,
+            [callback, group = std::move(group)](PathResult result) {
+                for (size_t index : group) {
+                    callback(index, result);
+                }
+            }
+        );
+    }
+}
+
+PathResult
+PathService::find_path(const PathRequest& request) const {
+    std::shared_lock lock(terrain_.get_nodegroup_mutex());
+    return search_(request);
+}
+
+void
+PathService::schedule_(
+    PathRequest request, std::function<void(PathResult)> deliver
+) const {
+    GlobalContext& context = GlobalContext::instance();
+    context.push_task(
+        [this, request = std::move(request), deliver = std::move(deliver)]() {
+            std::shared_lock lock(terrain_.get_nodegroup_mutex(), std::try_to_lock);
+            if (!lock.owns_lock()) {
+                // The node groups are being rebuilt, and the rebuild waits for
+                // tasks on this thread pool. Blocking here could stop those
+                // tasks from running, so wait for resume_pending instead.
+                std::scoped_lock pending_lock(pending_mutex_);
+                // resume_pending holds pending_mutex_, so a writer that
+                // finished after the first try is not missed
+                if (!lock.try_lock()) {
+                    pending_.push_back({request, deliver});
+                    return;
+                }
+            }
+            deliver(search_(request));
+        },
+        BS::pr::low
+    );
+}
+
+void
+PathService::resume_pending() const {
+    std::vector<PendingRequest> pending;
+    {
+        std::scoped_lock lock(pending_mutex_);
+        pending.swap(pending_);
+    }
+    for (PendingRequest& pending_request : pending) {
+        schedule_(
+            std::move(pending_request.request), std::move(pending_request.deliver)
+        );
+    }
+}
+
+PathResult
+PathService::search_(const PathRequest& request) const {
+    if (request.goals.size() == 1) {
+        return terrain_.get_path_Astar(
+            request.start, *request.goals.begin(), request.path_type
+        );
+    }
+    return terrain_.get_path_breadth_first(
+        request.start, request.goals, request.path_type
+    );
+}
+
+std::vector<std::vector<size_t>>
+PathService::group_requests_(const std::vector<PathRequest>& requests) {
+    std::vector<std::vector<size_t>> groups;
+    std::unordered_map<RequestKey, size_t, RequestKeyHash> group_of;
+    group_of.reserve(requests.size());
+    for (size_t index = 0; index < requests.size(); index++) {
+        auto [group, inserted] =
+            group_of.try_emplace(RequestKey(requests[index]), groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[group->second].push_back(index);
+    }
+    return groups;
+}
+
+} // namespace path
+
+} // namespace terrain
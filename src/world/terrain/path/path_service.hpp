@@ -0,0 +1,142 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file path_service.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Defines PathService class
+ *
+ * @ingroup terrain::path
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include "unit_path.hpp"
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace terrain {
+
+class Terrain;
+
+namespace path {
+
+/**
+ * @brief Request for a path from start to the closest goal
+ */
+struct PathRequest {
+    TerrainOffset3 start;
+    // A* is used when there is one goal, otherwise breadth first
+    std::unordered_set<TerrainOffset3> goals;
+    UnitPath path_type = 31;
+};
+
+using PathResult = std::optional<std::vector<TerrainOffset3>>;
+
+/**
+ * @brief Runs batches of path requests on the thread pool
+ *
+ * @details Identical requests in a batch are only searched once. Each search
+ * holds a shared lock on the terrain node group mutex, so searches can run at
+ * the same time as each other, but not while the node groups are rebuilt or a
+ * tile is changed. A task that cannot get the lock does not block a worker.
+ * It waits in a pending list until resume_pending is called, after the
+ * writer releases the lock. Search memory is kept per thread by the search
+ * functions.
+ *
+ * The terrain must outlive all submitted requests.
+ */
+class PathService {
+    // a request waiting for the node group mutex
+    struct PendingRequest {
+        PathRequest request;
+        std::function<void(PathResult)> deliver;
+    };
+
+    const Terrain& terrain_;
+
+    mutable std::mutex pending_mutex_;
+    mutable std::vector<PendingRequest> pending_;
+
+ public:
+    explicit PathService(const Terrain& terrain) : terrain_(terrain) {}
+
+    /**
+     * @brief Find paths for a batch of requests
+     *
+     * @param requests requests to search
+     * @return std::vector<std::shared_future<PathResult>> result of each
+     * request, in the same order as requests
+     */
+    [[nodiscard]] std::vector<std::shared_future<PathResult>>
+    submit(const std::vector<PathRequest>& requests) const;
+
+    /**
+     * @brief Find paths for a batch of requests, and pass each result to
+     * callback
+     *
+     * @details callback is run on a worker thread with the index of the
+     * request and its result. It may be called by several threads at once.
+     *
+     * @param requests requests to search
+     * @param callback function called once for each request
+     */
+    void submit(
+        const std::vector<PathRequest>& requests,
+        std::function<void(size_t, const PathResult&)> callback
+    ) const;
+
+    /**
+     * @brief Find the path for one request on this thread
+     *
+     * @details Blocks until it gets the same lock as the batched searches.
+     * Do not call from a task on the thread pool.
+     *
+     * @param request request to search
+     * @return PathResult path from the goal back to start
+     */
+    [[nodiscard]] PathResult find_path(const PathRequest& request) const;
+
+    /**
+     * @brief Queue the requests that were waiting for the node group mutex
+     *
+     * @details Call after releasing a unique lock on the node group mutex,
+     * like World::update_nodegroups does.
+     */
+    void resume_pending() const;
+
+ private:
+    // run request on the thread pool, and pass the result to deliver
+    void
+    schedule_(PathRequest request, std::function<void(PathResult)> deliver) const;
+
+    // search without locking
+    [[nodiscard]] PathResult search_(const PathRequest& request) const;
+
+    // groups the indices of identical requests
+    [[nodiscard]] static std::vector<std::vector<size_t>>
+    group_requests_(const std::vector<PathRequest>& requests);
+};
+
+} // namespace path
+
+} // namespace terrain
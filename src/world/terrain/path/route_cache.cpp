@@ -0,0 +1,124 @@
+#include "route_cache.hpp"
+
+namespace terrain {
+
+namespace path {
+
+std::optional<std::vector<uint32_t>>
+RouteCache::get(uint32_t start, uint32_t goal, UnitPath path_type) {
+    std::scoped_lock lock(mut_);
+    auto entry = lookup_.find(Key{start, goal, path_type.get_type()});
+    if (entry == lookup_.end()) {
+        misses_++;
+        return {};
+    }
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, entry->second);
+    return entry->second->route;
+}
+
+void
+RouteCache::insert(
+    uint32_t start, uint32_t goal, UnitPath path_type,
+    const std::vector<uint32_t>& route
+) {
+    std::scoped_lock lock(mut_);
+    if (capacity_ == 0) {
+        return;
+    }
+    Key key{start, goal, path_type.get_type()};
+    auto existing = lookup_.find(key);
+    if (existing != lookup_.end()) {
+        erase_(existing->second);
+    }
+    while (entries_.size() >= capacity_) {
+        erase_(std::prev(entries_.end()));
+    }
+
+    entries_.push_front(Entry{key, route});
+    lookup_.emplace(key, entries_.begin());
+    for (uint32_t id : route) {
+        routes_through_[id].insert(key);
+    }
+}
+
+void
+RouteCache::invalidate(const std::vector<uint32_t>& ids) {
+    std::scoped_lock lock(mut_);
+    for (uint32_t id : ids) {
+        auto keys = routes_through_.find(id);
+        if (keys == routes_through_.end()) {
+            continue;
+        }
+        // erase_ edits the set being looped over
+        std::vector<Key> to_erase(keys->second.begin(), keys->second.end());
+        for (const Key& key : to_erase) {
+            auto entry = lookup_.find(key);
+            if (entry != lookup_.end()) {
+                erase_(entry->second);
+            }
+        }
+    }
+}
+
+void
+RouteCache::clear() {
+    std::scoped_lock lock(mut_);
+    entries_.clear();
+    lookup_.clear();
+    routes_through_.clear();
+}
+
+void
+RouteCache::set_capacity(size_t capacity) {
+    std::scoped_lock lock(mut_);
+    capacity_ = capacity;
+    while (entries_.size() > capacity_) {
+        erase_(std::prev(entries_.end()));
+    }
+}
+
+size_t
+RouteCache::size() const {
+    std::scoped_lock lock(mut_);
+    return entries_.size();
+}
+
+size_t
+RouteCache::get_hits() const {
+    std::scoped_lock lock(mut_);
+    return hits_;
+}
+
+size_t
+RouteCache::get_misses() const {
+    std::scoped_lock lock(mut_);
+    return misses_;
+}
+
+void
+RouteCache::reset_counters() {
+    std::scoped_lock lock(mut_);
+    hits_ = 0;
+    misses_ = 0;
+}
+
+void
+RouteCache::erase_(std::list<Entry>::iterator entry) {
+    for (uint32_t id : entry->route) {
+        auto keys = routes_through_.find(id);
+        if (keys == routes_through_.end()) {
+            continue;
+        }
+        keys->second.erase(entry->key);
+        if (keys->second.empty()) {
+            routes_through_.erase(keys);
+        }
+    }
+    lookup_.erase(entry->key);
+    entries_.erase(entry);
+}
+
+} // namespace path
+
+} // namespace terrain
@@ -0,0 +1,174 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file route_cache.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Defines RouteCache class
+ *
+ * @ingroup terrain::path
+ *
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include "unit_path.hpp"
+
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace terrain {
+
+namespace path {
+
+/**
+ * @brief Least recently used cache of node group routes
+ *
+ * @details Routes are keyed by the NodeGroupGraph ids of the start and goal,
+ * and the type of path used to find them. Routes are stored as they are
+ * returned by NodeGroupGraph::find_path, from the goal back to the start.
+ *
+ * When the graph changes, every route through an id whose edges changed, or
+ * that was removed, is dropped. A route that is still valid is kept even if a
+ * faster route was added elsewhere.
+ *
+ * Thread safe.
+ */
+class RouteCache {
+ public:
+    struct Key {
+        uint32_t start;
+        uint32_t goal;
+        path_t path_type;
+
+        [[nodiscard]] inline bool
+        operator==(const Key& other) const {
+            return start == other.start && goal == other.goal
+                   && path_type == other.path_type;
+        }
+    };
+
+    struct KeyHash {
+        [[nodiscard]] inline size_t
+        operator()(const Key& key) const noexcept {
+            size_t seed = key.start;
+            seed ^= key.goal + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= key.path_type + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+ private:
+    struct Entry {
+        Key key;
+        std::vector<uint32_t> route;
+    };
+
+    // most recently used first
+    std::list<Entry> entries_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup_;
+    // keys of the routes through each id
+    std::unordered_map<uint32_t, std::unordered_set<Key, KeyHash>> routes_through_;
+
+    size_t capacity_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+
+    mutable std::mutex mut_;
+
+ public:
+    /**
+     * @brief Construct a new RouteCache
+     *
+     * @param capacity largest number of routes to keep
+     */
+    explicit RouteCache(size_t capacity = 1024) : capacity_(capacity) {}
+
+    /**
+     * @brief Get the cached route from start to goal
+     *
+     * @param start start id
+     * @param goal goal id
+     * @param path_type type of paths the route was found with
+     * @return std::optional<std::vector<uint32_t>> route, empty on a miss
+     */
+    [[nodiscard]] std::optional<std::vector<uint32_t>>
+    get(uint32_t start, uint32_t goal, UnitPath path_type);
+
+    /**
+     * @brief Add a route to the cache, evicting the least recently used route
+     * when full
+     *
+     * @param start start id
+     * @param goal goal id
+     * @param path_type type of paths the route was found with
+     * @param route route from goal back to start
+     */
+    void insert(
+        uint32_t start, uint32_t goal, UnitPath path_type,
+        const std::vector<uint32_t>& route
+    );
+
+    /**
+     * @brief Drop every route through any of the given ids
+     *
+     * @param ids ids that were removed, or whose edges changed
+     */
+    void invalidate(const std::vector<uint32_t>& ids);
+
+    /**
+     * @brief Drop every route
+     */
+    void clear();
+
+    /**
+     * @brief Set the largest number of routes to keep
+     */
+    void set_capacity(size_t capacity);
+
+    /**
+     * @brief Number of routes in the cache
+     */
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * @brief Number of lookups that found a route
+     */
+    [[nodiscard]] size_t get_hits() const;
+
+    /**
+     * @brief Number of lookups that did not find a route
+     */
+    [[nodiscard]] size_t get_misses() const;
+
+    /**
+     * @brief Set the hit and miss counters to zero
+     */
+    void reset_counters();
+
+ private:
+    void erase_(std::list<Entry>::iterator entry);
+};
+
+} // namespace path
+
+} // namespace terrain
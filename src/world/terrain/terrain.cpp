@@ -14,33 +14,21 @@
 #include "util/voxel.hpp"
 #include "util/voxel_io.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <map>
 #include <queue>
 #include <set>
+#include <span>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace terrain {
 
-namespace helper {
-
-template <class T>
-inline bool
-astar_compare(Node<T>* lhs, Node<T>* rhs) {
-    return lhs->get_total_predicted_cost() > rhs->get_total_predicted_cost();
-}
-
-template <class T>
-inline bool
-breadth_first_compare(Node<T>* lhs, Node<T>* rhs) {
-    return lhs->get_time_cost() > rhs->get_time_cost();
-}
-
-} // namespace helper
-
 Terrain::Terrain(const std::string& path, const generation::Biome& biome) :
     Terrain(biome, voxel_utility::from_qb(path)) {}
 
@@ -49,8 +37,6 @@ Terrain::Terrain(const generation::Biome& biome, voxel_utility::qb_data_t data)
     Z_MAX(data.size.z) {
     LOG_INFO(logging::terrain_logger, "Start of read from qb.");
 
-    chunks_.reserve(X_MAX * Y_MAX * Z_MAX / Chunk::SIZE / Chunk::SIZE / Chunk::SIZE);
-
     init_chunks();
 
     auto materials_inverse = biome.get_colors_inverse_map();
@@ -67,6 +53,10 @@ Terrain::Terrain(const generation::Biome& biome, voxel_utility::qb_data_t data)
 
     LOG_DEBUG(logging::terrain_logger, "End of land generator: qb_read.");
 
+    init_column_heights();
+
+    LOG_DEBUG(logging::terrain_logger, "End of land generator: init_column_heights.");
+
     // grows the grass
     init_grass();
 
@@ -75,6 +65,10 @@ Terrain::Terrain(const generation::Biome& biome, voxel_utility::qb_data_t data)
     init_nodegroups();
 
     LOG_DEBUG(logging::terrain_logger, "End of land generator: init_nodegroups.");
+
+    compress_chunks();
+
+    LOG_DEBUG(logging::terrain_logger, "End of land generator: compress_chunks.");
 }
 
 Terrain::Terrain(
@@ -90,21 +84,14 @@ Terrain::Terrain(
     init_chunks();
     LOG_INFO(logging::terrain_logger, "End of land generator: init_chunks.");
 
-    GlobalContext& context = GlobalContext::instance();
-    std::future<std::vector<std::vector<std::future<void>>>> map_tile_async_status =
-        context.submit_task([&x_map_tiles, &y_map_tiles, &macro_map, this]() {
-            return this->init_all_map_tile_regions(x_map_tiles, y_map_tiles, macro_map);
-        });
-
-    auto futures = map_tile_async_status.get();
-    for (const auto& sub_future : futures) {
-        for (const auto& sub_sub_future : sub_future) {
-            sub_sub_future.wait();
-        }
-    }
+    apply_stamps(get_map_tile_stamps(x_map_tiles, y_map_tiles, macro_map));
 
     LOG_INFO(logging::terrain_logger, "End of land generator: place tiles.");
 
+    init_column_heights();
+
+    LOG_INFO(logging::terrain_logger, "End of land generator: init_column_heights.");
+
     // TODO make this faster 3
     for (const generation::AddToTop& top_data : biome.get_top_generators()) {
         add_to_top(top_data);
@@ -120,27 +107,10 @@ Terrain::Terrain(
     init_nodegroups();
 
     LOG_DEBUG(logging::terrain_logger, "End of land generator: init_nodegroups.");
-}
-
-const Tile*
-Terrain::get_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) const {
-    TerrainOffset3 chunk_position = get_chunk_from_tile({x, y, z});
-    auto chunk_iter = chunks_.find(chunk_position);
-
-    if (chunk_iter == chunks_.end()) {
-        LOG_BACKTRACE(
-            logging::terrain_logger,
-            "Tile position ({}, {}, {}), out of range because the chunk ({}, {}, "
-            "{}) does not exist.",
-            x, y, z, chunk_position.x, chunk_position.y, chunk_position.z
-        );
-        return nullptr;
-    }
 
-    auto& chunk = chunk_iter->second;
+    compress_chunks();
 
-    TerrainOffset3 tile_position(x % Chunk::SIZE, y % Chunk::SIZE, z % Chunk::SIZE);
-    return chunk.get_tile(tile_position);
+    LOG_DEBUG(logging::terrain_logger, "End of land generator: compress_chunks.");
 }
 
 void
@@ -153,7 +123,7 @@ Terrain::qb_read(
 
     GlobalContext& context = GlobalContext::instance();
 
-    for (auto& [chunk_position, chunk] : chunks_) {
+    for (auto& chunk : chunks_) {
         context.submit_task([&chunk, &materials_inverse, &data, &unknown_colors,
                              &unknown_colors_mutex_, X_MAX = this->X_MAX,
                              Y_MAX = this->Y_MAX, Z_MAX = this->Z_MAX]() {
@@ -209,7 +179,14 @@ Terrain::get_first_not(
     } else if (static_cast<TerrainOffset>(guess) >= Z_MAX) {
         guess = Z_MAX - 1;
     }
-    if (has_tile_material(materials, x, y, guess - 1)) {
+    // Tiles above the cached surface are air. When air is not in materials the
+    // search down can skip them. The search up and columns with air in
+    // materials still probe tile by tile.
+    TerrainOffset skip_above = Z_MAX;
+    if (!highest_surface_.empty() && !materials.any_color_in(AIR_ID)) {
+        skip_above = highest_surface_[get_column_index_(x, y)];
+    }
+    if (guess - 1 <= skip_above && has_tile_material(materials, x, y, guess - 1)) {
         if (!has_tile_material(materials, x, y, guess)) {
             return guess;
         } else {
@@ -226,7 +203,7 @@ Terrain::get_first_not(
         return 0;
     } else {
         // go down
-        for (TerrainOffset z = guess - 2; z != 0; z--) {
+        for (TerrainOffset z = std::min(guess - 2, skip_above); z > 0; z--) {
             if (has_tile_material(materials, x, y, z)) {
                 return z + 1;
             }
@@ -242,6 +219,8 @@ Terrain::add_to_top(const generation::AddToTop& top_data) {
     for (TerrainOffset x = 0; x < X_MAX; x++)
         for (TerrainOffset y = 0; y < Y_MAX; y++) {
             // get first (not) z of material
+            // Seeded with the previous column. Starting from the surface
+            // instead changes the result for columns with caves or overhangs.
             guess = get_first_not(top_data.get_elements_above(), x, y, guess);
             // if z is between some bounds
             // stop_h = get stop height (guess, top_data["how_to_add"])
@@ -260,166 +239,142 @@ Terrain::add_to_top(const generation::AddToTop& top_data) {
         }
 }
 
-std::vector<std::future<void>>
-Terrain::stamp_tile_region(
-    const generation::TileStamp& stamp, TerrainOffset x_offset = 0,
-    TerrainOffset y_offset = 0
-) {
-    // set tiles in region to mat and color_id if the current material is in
-    // elements_can_stamp.
-    TerrainOffset x_start = stamp.x_start + x_offset * area_size_ + area_size_ / 2;
-    TerrainOffset y_start = stamp.y_start + y_offset * area_size_ + area_size_ / 2;
-    TerrainOffset x_end = stamp.x_end + x_offset * area_size_ + area_size_ / 2;
-    TerrainOffset y_end = stamp.y_end + y_offset * area_size_ + area_size_ / 2;
-
-    TerrainOffset3 start(x_start, y_start, stamp.z_start);
-    TerrainOffset3 end(x_end, y_end, stamp.z_end);
-
-    std::vector<std::future<void>> futures;
-
-    // iterate through chunks
-
-    ChunkPos chunk_start = get_chunk_from_tile(start);
-    ChunkPos chunk_end = get_chunk_from_tile(end - TerrainOffset3(1, 1, 1));
-
-    ChunkPos size_number_chunks = chunk_end - chunk_start;
-
-    futures.reserve(
-        (size_number_chunks.x + 1) * (size_number_chunks.y + 1)
-        * (size_number_chunks.z + 1)
-    );
-
-    GlobalContext& context = GlobalContext::instance();
-
-    for (ChunkDim x = chunk_start.x; x <= chunk_end.x; x++) {
-        for (ChunkDim y = chunk_start.y; y <= chunk_end.y; y++) {
-            for (ChunkDim z = chunk_start.z; z <= chunk_end.z; z++) {
-                ChunkPos chunk_pos(x, y, z);
-                auto future = context.submit_task(
-                    [chunk_pos, start, end, stamp, this] {
-                        TerrainOffset3 local_start =
-                            start
-                            - TerrainOffset3(chunk_pos) * TerrainOffset(Chunk::SIZE);
-                        TerrainOffset3 local_end =
-                            end
-                            - TerrainOffset3(chunk_pos) * TerrainOffset(Chunk::SIZE);
-
-                        if (local_start.x < 0) {
-                            local_start.x = 0;
-                        }
-                        if (local_start.x >= Chunk::SIZE) {
-                            local_start.x = Chunk::SIZE;
-                        }
-                        if (local_start.y < 0) {
-                            local_start.y = 0;
-                        }
-                        if (local_start.y >= Chunk::SIZE) {
-                            local_start.y = Chunk::SIZE;
-                        }
-                        if (local_start.z < 0) {
-                            local_start.z = 0;
-                        }
-                        if (local_start.z >= Chunk::SIZE) {
-                            local_start.z = Chunk::SIZE;
-                        }
-
-                        if (local_end.x < 0) {
-                            local_end.x = 0;
-                        }
-                        if (local_end.x >= Chunk::SIZE) {
-                            local_end.x = Chunk::SIZE;
-                        }
-                        if (local_end.y < 0) {
-                            local_end.y = 0;
-                        }
-                        if (local_end.y >= Chunk::SIZE) {
-                            local_end.y = Chunk::SIZE;
-                        }
-                        if (local_end.z < 0) {
-                            local_end.z = 0;
-                        }
-                        if (local_end.z >= Chunk::SIZE) {
-                            local_end.z = Chunk::SIZE;
-                        }
-
-                        if (local_start.x == local_end.x || local_start.y == local_end.y
-                            || local_start.z == local_end.z) {
-                            return;
-                        }
-
-                        Chunk* chunk = get_chunk(chunk_pos);
-                        if (!chunk) {
-                            return;
-                        }
-
-                        std::unique_lock chunk_lock(chunk->get_mutex());
+std::vector<generation::PlacedStamp>
+Terrain::get_map_tile_stamps(
+    TerrainOffset x_map_tiles, TerrainOffset y_map_tiles,
+    generation::TerrainMacroMap& macro_map
+) const {
+    std::vector<generation::PlacedStamp> stamps;
 
-                        chunk->stamp_tile_region(
-                            stamp.mat, stamp.color_id, stamp.elements_can_stamp,
-                            local_start, local_end
-                        );
-                        return;
-                    },
-                    BS::pr::highest
+    for (size_t start_index = 0; start_index < 4; start_index++) {
+        for (TerrainOffset i = start_index % 2; i < x_map_tiles; i += 2) {
+            for (TerrainOffset j = start_index / 2; j < y_map_tiles; j += 2) {
+                generation::MapTile& map_tile = macro_map.get_tile(i, j);
+                // stamps are centered on the map tile
+                TerrainOffset3 offset(
+                    map_tile.get_x() * area_size_ + area_size_ / 2,
+                    map_tile.get_y() * area_size_ + area_size_ / 2, 0
                 );
 
-                futures.push_back(std::move(future));
+                for (auto generator_macro : map_tile.get_type()) {
+                    generation::LandGenerator gen = *generator_macro;
+                    while (!gen.empty()) {
+                        generation::TileStamp stamp =
+                            gen.get_stamp(map_tile.get_rand_engine());
+                        TerrainOffset3 start(
+                            stamp.x_start, stamp.y_start, stamp.z_start
+                        );
+                        TerrainOffset3 end(stamp.x_end, stamp.y_end, stamp.z_end);
+                        stamps.push_back(
+                            {start + offset, end + offset, std::move(stamp)}
+                        );
+                        gen.next();
+                    }
+                }
             }
         }
     }
-    return futures;
+    return stamps;
 }
 
-std::vector<std::future<void>>
-Terrain::init_area(generation::MapTile& map_tile, generation::LandGenerator gen) {
-    std::vector<std::future<void>> area_async_status;
-    while (!gen.empty()) {
-        std::vector<std::future<void>> async_status = stamp_tile_region(
-            gen.get_stamp(map_tile.get_rand_engine()), map_tile.get_x(),
-            map_tile.get_y()
+void
+Terrain::apply_stamps(const std::vector<generation::PlacedStamp>& stamps) {
+    // indices of the stamps that overlap each chunk, in order
+    std::vector<std::vector<uint32_t>> chunk_stamps(chunks_.size());
+    TerrainOffset3 last_chunk = chunk_grid_size_ - TerrainOffset3(1, 1, 1);
+    for (uint32_t index = 0; index < stamps.size(); index++) {
+        const generation::PlacedStamp& placed = stamps[index];
+        if (glm::any(glm::greaterThanEqual(placed.start, placed.end))) {
+            continue;
+        }
+        TerrainOffset3 chunk_start = glm::max(
+            TerrainOffset3(get_chunk_from_tile(placed.start)), TerrainOffset3(0)
         );
-
-        // might need to be moved
-        // area_async_status.insert(async_status.begin(), async_status.end());
-
-        for (auto& future : async_status) {
-            area_async_status.push_back(std::move(future));
+        TerrainOffset3 chunk_end = glm::min(
+            TerrainOffset3(get_chunk_from_tile(placed.end - TerrainOffset3(1, 1, 1))),
+            last_chunk
+        );
+        for (TerrainOffset x = chunk_start.x; x <= chunk_end.x; x++) {
+            for (TerrainOffset y = chunk_start.y; y <= chunk_end.y; y++) {
+                for (TerrainOffset z = chunk_start.z; z <= chunk_end.z; z++) {
+                    chunk_stamps[get_chunk_index_(x, y, z)].push_back(index);
+                }
+            }
         }
-
-        gen.next();
     }
-    return area_async_status;
+
+    // each chunk is only written by its own task, so there is nothing to lock
+    parallel_for_(chunks_.size(), [this, &stamps, &chunk_stamps](size_t index) {
+        Chunk& chunk = chunks_[index];
+        TerrainOffset3 chunk_offset = chunk.get_offset();
+        for (uint32_t stamp_index : chunk_stamps[index]) {
+            const generation::PlacedStamp& placed = stamps[stamp_index];
+            TerrainOffset3 local_start = glm::clamp(
+                placed.start - chunk_offset, TerrainOffset3(0),
+                TerrainOffset3(Chunk::SIZE)
+            );
+            TerrainOffset3 local_end = glm::clamp(
+                placed.end - chunk_offset, TerrainOffset3(0),
+                TerrainOffset3(Chunk::SIZE)
+            );
+            chunk.stamp_tile_region(
+                placed.stamp.mat, placed.stamp.color_id,
+                placed.stamp.elements_can_stamp, local_start, local_end
+            );
+        }
+    });
 }
 
 void
 Terrain::init_chunks() {
-    chunks_.reserve(X_MAX * Y_MAX * Z_MAX / Chunk::SIZE / Chunk::SIZE / Chunk::SIZE);
-
     // chunk length in _ direction
     TerrainOffset C_length_X = ((X_MAX - 1) / Chunk::SIZE + 1);
     TerrainOffset C_length_Y = ((Y_MAX - 1) / Chunk::SIZE + 1);
     TerrainOffset C_length_Z = ((Z_MAX - 1) / Chunk::SIZE + 1);
+    chunk_grid_size_ = TerrainOffset3(C_length_X, C_length_Y, C_length_Z);
+
+    chunks_.clear();
+    chunks_.reserve(C_length_X * C_length_Y * C_length_Z);
+
+    // order must match get_chunk_index_
     for (TerrainOffset x = 0; x < C_length_X; x++) {
         for (TerrainOffset y = 0; y < C_length_Y; y++) {
             for (TerrainOffset z = 0; z < C_length_Z; z++) {
                 TerrainOffset3 chunk_position(x, y, z);
-                chunks_.emplace(
-                    std::piecewise_construct, std::forward_as_tuple(chunk_position),
-                    std::forward_as_tuple(chunk_position, this)
-                );
+                chunks_.emplace_back(chunk_position, this);
             }
         }
     }
 }
 
+void
+Terrain::compress_chunks() {
+    parallel_for_(chunks_.size(), [this](size_t index) {
+        Chunk& chunk = chunks_[index];
+        std::scoped_lock lock(chunk.get_mutex());
+        chunk.compress();
+    });
+}
+
+size_t
+Terrain::get_tile_memory_usage() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks_) {
+        total += chunk.get_tile_memory_usage();
+    }
+    return total;
+}
+
 void
 Terrain::init_nodegroups() {
+    std::unique_lock nodegroup_lock(nodegroup_mutex_);
     GlobalContext& context = GlobalContext::instance();
 
     std::vector<std::future<void>> futures;
     futures.reserve(num_chunks());
 
-    for (auto& [position, chunk] : chunks_) {
+    for (const auto& chunk : chunks_) {
+        ChunkPos position = chunk.get_chunk_position();
         futures.push_back(context.submit_task([position, this]() {
             Chunk* chunk = get_chunk(position);
             if (!chunk) {
@@ -436,7 +391,8 @@ Terrain::init_nodegroups() {
 
     futures.clear();
 
-    for (auto& [position, chunk] : chunks_) {
+    for (const auto& chunk : chunks_) {
+        ChunkPos position = chunk.get_chunk_position();
         futures.push_back(context.submit_task([position, this]() {
             Chunk* chunk = get_chunk(position);
             if (!chunk) {
@@ -450,33 +406,123 @@ Terrain::init_nodegroups() {
     for (const auto& future : futures) {
         future.wait();
     }
+
+    node_group_graph_.build(*this);
+    route_cache_.clear();
 }
 
-std::vector<std::vector<std::future<void>>>
-Terrain::init_all_map_tile_regions(
-    TerrainOffset x_map_tiles, TerrainOffset y_map_tiles,
-    generation::TerrainMacroMap& macro_map
-) {
-    std::vector<std::vector<std::future<void>>> futures;
+void
+Terrain::update_node_group_graph(const std::vector<ChunkPos>& changed_chunks) {
+    route_cache_.invalidate(node_group_graph_.update(*this, changed_chunks));
+}
 
-    for (size_t start_index = 0; start_index < 4; start_index++) {
-        for (TerrainOffset i = start_index % 2; i < x_map_tiles; i += 2) {
-            for (TerrainOffset j = start_index / 2; j < y_map_tiles; j += 2) {
-                generation::MapTile& map_tile = macro_map.get_tile(i, j);
+void
+Terrain::mark_nodegroups_dirty(TerrainOffset3 xyz) {
+    // can_stand looks one tile down and up to four tiles up, and paths look one
+    // tile to the side of that. One more tile to every side covers the
+    // adjacency between those tiles.
+    TerrainOffset3 start = glm::max(xyz - TerrainOffset3(2, 2, 2), TerrainOffset3(0));
+    TerrainOffset3 end =
+        glm::min(xyz + TerrainOffset3(2, 2, 5), TerrainOffset3(X_MAX, Y_MAX, Z_MAX) - 1);
+    if (glm::any(glm::greaterThan(start, end))) {
+        return;
+    }
 
-                for (auto generator_macro : map_tile.get_type()) {
-                    std::vector<std::future<void>> future =
-                        init_area(map_tile, *generator_macro);
-                    futures.push_back(std::move(future));
+    ChunkPos chunk_start = get_chunk_from_tile(start);
+    ChunkPos chunk_end = get_chunk_from_tile(end);
+
+    for (auto x = chunk_start.x; x <= chunk_end.x; x++) {
+        for (auto y = chunk_start.y; y <= chunk_end.y; y++) {
+            for (auto z = chunk_start.z; z <= chunk_end.z; z++) {
+                mark_chunk_nodegroups_dirty(ChunkPos(x, y, z));
+            }
+        }
+    }
+}
+
+size_t
+Terrain::update_dirty_nodegroups() {
+    std::vector<ChunkPos> dirty;
+    {
+        std::scoped_lock lock(dirty_nodegroup_chunks_mutex_);
+        dirty.assign(dirty_nodegroup_chunks_.begin(), dirty_nodegroup_chunks_.end());
+        dirty_nodegroup_chunks_.clear();
+    }
+    if (dirty.empty()) {
+        return 0;
+    }
+
+    // wait for searches reading the node groups to finish
+    std::unique_lock nodegroup_lock(nodegroup_mutex_);
+
+    // deleting node groups edits node groups in other chunks, and the tile to
+    // group map, so this is done one chunk at a time
+    for (ChunkPos chunk_position : dirty) {
+        get_chunk(chunk_position)->clear_nodegroups();
+    }
+
+    parallel_for_(dirty.size(), [this, &dirty](size_t index) {
+        get_chunk(dirty[index])->init_nodegroups();
+    });
+
+    // add_nodegroup_adjacent_mp only connects a chunk to bordering chunks in
+    // the positive direction, so the chunks that connect to a dirty chunk from
+    // the negative direction must also run it.
+    std::unordered_set<ChunkPos> to_connect(dirty.begin(), dirty.end());
+    for (ChunkPos chunk_position : dirty) {
+        for (int16_t x = -1; x <= 1; x++) {
+            for (int16_t y = -1; y <= 1; y++) {
+                for (int16_t z = -1; z <= 1; z++) {
+                    if (x * 4 + y * 2 + z <= 0) {
+                        continue;
+                    }
+                    ChunkPos other = chunk_position - ChunkPos(x, y, z);
+                    if (get_chunk(other)) {
+                        to_connect.insert(other);
+                    }
                 }
             }
         }
     }
-    return futures;
+    std::vector<ChunkPos> connect(to_connect.begin(), to_connect.end());
+    parallel_for_(connect.size(), [this, &connect](size_t index) {
+        get_chunk(connect[index])->add_nodegroup_adjacent_mp();
+    });
+
+    update_node_group_graph(dirty);
+
+    return dirty.size();
 }
 
 TerrainOffset
 Terrain::get_Z_solid(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) const {
+    if (!highest_solid_.empty()) {
+        TerrainOffset highest = highest_solid_[get_column_index_(x, y)];
+        if (z_start >= highest) {
+            return highest;
+        }
+    }
+    return scan_Z_solid_(x, y, z_start);
+}
+
+TerrainOffset
+Terrain::get_Z_solid(TerrainOffset x, TerrainOffset y) const {
+    return get_Z_solid(x, y, Z_MAX - 1);
+}
+
+TerrainOffset
+Terrain::get_Z_surface(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) const {
+    if (!highest_surface_.empty()) {
+        TerrainOffset highest = highest_surface_[get_column_index_(x, y)];
+        if (z_start >= highest) {
+            return highest;
+        }
+    }
+    return scan_Z_surface_(x, y, z_start);
+}
+
+TerrainOffset
+Terrain::scan_Z_solid_(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) const {
     for (TerrainOffset z = z_start; z >= 0; z--) {
         if (this->get_tile(x, y, z)->is_solid()) {
             return z;
@@ -486,8 +532,83 @@ Terrain::get_Z_solid(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) co
 }
 
 TerrainOffset
-Terrain::get_Z_solid(TerrainOffset x, TerrainOffset y) const {
-    return get_Z_solid(x, y, Z_MAX - 1);
+Terrain::scan_Z_surface_(TerrainOffset x, TerrainOffset y, TerrainOffset z_start)
+    const {
+    for (TerrainOffset z = z_start; z >= 0; z--) {
+        if (this->get_tile(x, y, z)->get_material_id() != AIR_ID) {
+            return z;
+        }
+    }
+    return 0;
+}
+
+TerrainOffset
+Terrain::get_Z_surface(TerrainOffset x, TerrainOffset y) const {
+    return get_Z_surface(x, y, Z_MAX - 1);
+}
+
+void
+Terrain::init_column_heights() {
+    size_t num_columns = static_cast<size_t>(X_MAX) * Y_MAX;
+    std::vector<TerrainOffset> highest_solid(num_columns, 0);
+    std::vector<TerrainOffset> highest_surface(num_columns, 0);
+
+    std::as_const(*this).for_each_chunk_column([this, &highest_solid,
+                                                &highest_surface](
+                                                   std::span<const Chunk> column
+                                               ) {
+        TerrainOffset3 offset = column.front().get_offset();
+        for (Dim x = 0; x < Chunk::SIZE; x++) {
+            for (Dim y = 0; y < Chunk::SIZE; y++) {
+                if (!in_range(offset.x + x, offset.y + y, 0)) {
+                    continue;
+                }
+                size_t index = get_column_index_(offset.x + x, offset.y + y);
+                bool found_surface = false;
+                // walk down from the top of the column
+                for (TerrainOffset z = Z_MAX - 1; z >= 0; z--) {
+                    const Tile* tile = column[z / Chunk::SIZE].get_tile(
+                        x, y, static_cast<Dim>(z % Chunk::SIZE)
+                    );
+                    if (!found_surface && tile->get_material_id() != AIR_ID) {
+                        highest_surface[index] = z;
+                        found_surface = true;
+                    }
+                    if (tile->is_solid()) {
+                        highest_solid[index] = z;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    highest_solid_ = std::move(highest_solid);
+    highest_surface_ = std::move(highest_surface);
+}
+
+void
+Terrain::update_column_height(TerrainOffset3 xyz) {
+    if (highest_solid_.empty() || !in_range(xyz)) {
+        return;
+    }
+    size_t index = get_column_index_(xyz.x, xyz.y);
+    const Tile* tile = std::as_const(*this).get_tile_unchecked(xyz);
+
+    TerrainOffset& highest_solid = highest_solid_[index];
+    if (tile->is_solid()) {
+        highest_solid = std::max(highest_solid, xyz.z);
+    } else if (xyz.z == highest_solid) {
+        // the top was removed, find the next one down
+        highest_solid = scan_Z_solid_(xyz.x, xyz.y, xyz.z - 1);
+    }
+
+    TerrainOffset& highest_surface = highest_surface_[index];
+    if (tile->get_material_id() != AIR_ID) {
+        highest_surface = std::max(highest_surface, xyz.z);
+    } else if (xyz.z == highest_surface) {
+        highest_surface = scan_Z_surface_(xyz.x, xyz.y, xyz.z - 1);
+    }
 }
 
 bool
@@ -542,6 +663,7 @@ Terrain::set_tile_material(
 ) {
     if (auto tile = get_tile(xyz)) {
         tile->set_material(mat, natural_color(xyz, mat, color_id));
+        update_column_height(xyz);
     }
 }
 
@@ -559,45 +681,65 @@ Terrain::natural_color(
     return color_id;
 }
 
-bool
-Terrain::player_set_tile_material(
-    TerrainOffset3 xyz, const material_t* mat, ColorId color_id
-) {
-    Tile* tile = get_tile(xyz);
-    if (tile->is_solid() && mat->solid) {
-        // Can't change something from one material to another.
-        return 0;
-    }
-    get_tile(xyz)->set_material(mat, color_id);
-    return 1;
-}
-
 void
 Terrain::init_grass() {
     std::unordered_set<TerrainOffset3> all_grass;
-
-    // Test all ties to see if they can be grass.
-    for (TerrainOffset x = 0; x < X_MAX; x++)
-        for (TerrainOffset y = 0; y < Y_MAX; y++)
-            for (TerrainOffset z = 0; z < static_cast<TerrainOffset>(Z_MAX - 1); z++) {
-                if (!get_tile(x, y, z + 1)->is_solid()) {
-                    get_tile(x, y, z)->try_grow_grass(); // add to sources and sinks
-                    // if grass add to some set
-                    if (get_tile(x, y, z)->is_grass()) {
-                        all_grass.insert({x, y, z});
+    std::mutex all_grass_mutex;
+
+    // Test all tiles to see if they can be grass. Done one column of chunks at a
+    // time because the tile above the top of a chunk is in the next chunk up.
+    for_each_chunk_column([this, &all_grass,
+                           &all_grass_mutex](std::span<Chunk> column) {
+        std::vector<TerrainOffset3> column_grass;
+        for (size_t chunk_z = 0; chunk_z < column.size(); chunk_z++) {
+            Chunk& chunk = column[chunk_z];
+            // only dirt can become grass, so leave chunks that are all one
+            // other material compressed
+            if (chunk.is_uniform()
+                && std::as_const(chunk).get_tile(0, 0, 0)->get_material_id()
+                       != DIRT_ID) {
+                continue;
+            }
+            TerrainOffset3 offset = chunk.get_offset();
+            for (Dim x = 0; x < Chunk::SIZE; x++) {
+                for (Dim y = 0; y < Chunk::SIZE; y++) {
+                    if (!in_range(offset.x + x, offset.y + y, offset.z)) {
+                        continue;
+                    }
+                    std::span<Tile> tiles = chunk.get_column(x, y);
+                    for (Dim z = 0; z < Chunk::SIZE; z++) {
+                        TerrainOffset global_z = offset.z + z;
+                        if (global_z >= Z_MAX) {
+                            break;
+                        }
+                        // the top of the world is always open
+                        bool open_above = true;
+                        if (global_z < Z_MAX - 1) {
+                            if (z + 1 < Chunk::SIZE) {
+                                open_above = !tiles[z + 1].is_solid();
+                            } else {
+                                const Chunk& chunk_above = column[chunk_z + 1];
+                                open_above = !chunk_above.get_tile(x, y, 0)->is_solid();
+                            }
+                        }
+                        if (!open_above) {
+                            continue;
+                        }
+                        tiles[z].try_grow_grass(); // add to sources and sinks
+                        // if grass add to some set
+                        if (tiles[z].is_grass()) {
+                            column_grass.emplace_back(
+                                offset.x + x, offset.y + y, global_z
+                            );
+                        }
                     }
-                    // both higher, and lower set
                 }
             }
-    TerrainOffset z = Z_MAX - 1;
-    for (TerrainOffset x = 0; x < X_MAX; x++)
-        for (TerrainOffset y = 0; y < Y_MAX; y++) {
-            get_tile(x, y, z)->try_grow_grass(); // add to sources and sinks
-            if (get_tile(x, y, z)->is_grass()) {
-                all_grass.insert({x, y, z});
-            }
-            // same thing here as above
         }
+        std::scoped_lock lock(all_grass_mutex);
+        all_grass.insert(column_grass.begin(), column_grass.end());
+    });
+
     grow_grass_low(all_grass);
     grow_grass_high(all_grass);
     for (const auto t : all_grass) {
@@ -648,13 +790,6 @@ Terrain::get_H_cost(TerrainOffset3 position1, TerrainOffset3 position2) {
     return (DZ * D3 + abs(DX - DY) * D1 + D2 * std::min(DX, DY));
 }
 
-template <class T>
-float
-Terrain::get_G_cost(const T tile, const Node<const T> node) {
-    return node.get_time_cost()
-           + get_H_cost(tile.average_position(), node.get_tile()->average_position());
-}
-
 ChunkPos
 Terrain::get_chunk_from_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) {
     if (x < 0) {
@@ -671,41 +806,6 @@ Terrain::get_chunk_from_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z)
     return chunk_position;
 }
 
-std::unordered_set<Node<const NodeGroupWrapper>*>
-Terrain::get_adjacent_nodes(
-    const Node<const NodeGroupWrapper>* const node,
-    std::unordered_map<TerrainOffset3, Node<const NodeGroupWrapper>>& nodes,
-    path_t path_type
-) const {
-    std::unordered_set<Node<const NodeGroupWrapper>*> out;
-    for (const NodeGroup* t : node->get_tile()->get_adjacent_clear(path_type)) {
-        auto adj_node = nodes.find(t->unique_position());
-        if (adj_node != nodes.end()) {
-            out.emplace(&adj_node->second);
-        }
-    }
-    return out;
-}
-
-std::unordered_set<Node<const PositionWrapper>*>
-Terrain::get_adjacent_nodes(
-    const Node<const PositionWrapper>* node,
-    std::unordered_map<TerrainOffset3, Node<const PositionWrapper>>& nodes,
-    path_t path_type
-) const {
-    std::unordered_set<Node<const PositionWrapper>*> out;
-    auto tile_it =
-        get_tile_adjacent_iterator(node->get_tile()->unique_position(), path_type);
-    while (!tile_it.end()) {
-        auto adj_node = nodes.find(tile_it.get_pos());
-        if (adj_node != nodes.end()) {
-            out.emplace(&adj_node->second);
-        }
-        tile_it++;
-    }
-    return out;
-}
-
 // this feels like it's wrong
 // it's fine NodeGroup*s are stored in a linked list. Shouldn't move
 // idk seams like there could be a better way to do this.
@@ -828,28 +928,37 @@ Terrain::get_path_type(
 std::unordered_set<const NodeGroup*>
 Terrain::get_all_node_groups() const {
     std::unordered_set<const NodeGroup*> out;
-    for (const auto& [position, chunk] : chunks_) {
+    for (const auto& chunk : chunks_) {
         chunk.add_nodes_to(out);
     }
     return out;
 }
 
 std::optional<std::vector<NodeGroupWrapper>>
-Terrain::get_path_Astar(const NodeGroup* start, const NodeGroup* goal) const {
-    std::unordered_set<const NodeGroup*> search_through = get_all_node_groups();
-
-    std::unordered_set<NodeGroupWrapper> search_through_wrapped({});
-    for (const auto& node : search_through) {
-        search_through_wrapped.emplace(node);
+Terrain::get_path_Astar(
+    const NodeGroup* start, const NodeGroup* goal, UnitPath path_type
+) const {
+    uint32_t start_id = node_group_graph_.get_id(start);
+    uint32_t goal_id = node_group_graph_.get_id(goal);
+    if (start_id == path::NodeGroupGraph::NONE || goal_id == path::NodeGroupGraph::NONE) {
+        return {};
     }
 
-    return get_path<NodeGroupWrapper, helper::astar_compare>(
-        NodeGroupWrapper(start), {NodeGroupWrapper(goal)}, search_through_wrapped
-    );
+    std::optional<std::vector<uint32_t>> route =
+        route_cache_.get(start_id, goal_id, path_type);
+    if (!route) {
+        route = node_group_graph_.find_path(start_id, {goal_id}, true, path_type);
+        if (route) {
+            route_cache_.insert(start_id, goal_id, path_type, route.value());
+        }
+    }
+    return get_node_group_path_(route);
 }
 
 std::optional<std::vector<TerrainOffset3>>
-Terrain::get_path_Astar(TerrainOffset3 start, TerrainOffset3 goal) const {
+Terrain::get_path_Astar(
+    TerrainOffset3 start, TerrainOffset3 goal, UnitPath path_type
+) const {
     const NodeGroup* goal_node;
     const NodeGroup* start_node;
 
@@ -857,7 +966,7 @@ Terrain::get_path_Astar(TerrainOffset3 start, TerrainOffset3 goal) const {
         return {};
     if (!(start_node = get_node_group(start)))
         return {};
-    auto node_path = get_path_Astar(start_node, goal_node);
+    auto node_path = get_path_Astar(start_node, goal_node, path_type);
     // if node_path is empty then return
     if (!node_path.has_value())
         return {};
@@ -868,8 +977,8 @@ Terrain::get_path_Astar(TerrainOffset3 start, TerrainOffset3 goal) const {
         search_through.insert(tiles.begin(), tiles.end());
     }
 
-    auto wrapped_path = get_path<PositionWrapper, helper::astar_compare>(
-        PositionWrapper(start), {PositionWrapper(goal)}, search_through
+    auto wrapped_path = get_path<PositionWrapper, true>(
+        PositionWrapper(start), {PositionWrapper(goal)}, &search_through, path_type
     );
 
     if (!wrapped_path) {
@@ -884,22 +993,44 @@ Terrain::get_path_Astar(TerrainOffset3 start, TerrainOffset3 goal) const {
 
 std::optional<std::vector<NodeGroupWrapper>>
 Terrain::get_path_breadth_first(
-    const NodeGroupWrapper start, const std::unordered_set<NodeGroupWrapper> goal
+    const NodeGroupWrapper start, const std::unordered_set<NodeGroupWrapper> goal,
+    UnitPath path_type
 ) const {
-    std::unordered_set<const NodeGroup*> search_through = get_all_node_groups();
-
-    std::unordered_set<NodeGroupWrapper> search_through_wrapped({});
-    for (const auto& node : search_through) {
-        search_through_wrapped.emplace(node);
+    uint32_t start_id = node_group_graph_.get_id(start.get_node_group());
+    if (start_id == path::NodeGroupGraph::NONE) {
+        return {};
+    }
+    std::vector<uint32_t> goal_ids;
+    goal_ids.reserve(goal.size());
+    for (const NodeGroupWrapper& node_group : goal) {
+        uint32_t goal_id = node_group_graph_.get_id(node_group.get_node_group());
+        if (goal_id != path::NodeGroupGraph::NONE) {
+            goal_ids.push_back(goal_id);
+        }
     }
-    return get_path<NodeGroupWrapper, helper::breadth_first_compare>(
-        start, goal, search_through_wrapped
+    return get_node_group_path_(
+        node_group_graph_.find_path(start_id, goal_ids, false, path_type)
     );
 }
 
+std::optional<std::vector<NodeGroupWrapper>>
+Terrain::get_node_group_path_(const std::optional<std::vector<uint32_t>>& id_path
+) const {
+    if (!id_path) {
+        return {};
+    }
+    std::vector<NodeGroupWrapper> path;
+    path.reserve(id_path->size());
+    for (uint32_t id : id_path.value()) {
+        path.emplace_back(node_group_graph_.get_node_group(id));
+    }
+    return path;
+}
+
 std::optional<std::vector<TerrainOffset3>>
 Terrain::get_path_breadth_first(
-    const TerrainOffset3 start, const std::unordered_set<TerrainOffset3> goal_
+    const TerrainOffset3 start, const std::unordered_set<TerrainOffset3> goal_,
+    UnitPath path_type
 ) const {
     std::unordered_set<NodeGroupWrapper> goal_nodes({});
     bool no_goal = true;
@@ -917,10 +1048,20 @@ Terrain::get_path_breadth_first(
     auto start_node = get_node_group(start);
     if (!start_node)
         return {};
-    auto node_path = get_path_breadth_first(start_node, goal_nodes);
+    auto node_path = get_path_breadth_first(start_node, goal_nodes, path_type);
     if (!node_path)
         return {};
-    NodeGroupWrapper end = node_path.value().front();
+    return get_path_through(start, goal_, node_path.value(), path_type);
+}
+
+std::optional<std::vector<TerrainOffset3>>
+Terrain::get_path_through(
+    const TerrainOffset3 start, const std::unordered_set<TerrainOffset3>& goal_,
+    const std::vector<NodeGroupWrapper>& node_path, UnitPath path_type
+) const {
+    if (node_path.empty())
+        return {};
+    NodeGroupWrapper end = node_path.front();
     ChunkPos chunk_position = end.get_chunk_position();
 
     std::unordered_set<PositionWrapper> goal({});
@@ -934,14 +1075,13 @@ Terrain::get_path_breadth_first(
     if (goal.size() == 0)
         return {};
     std::unordered_set<PositionWrapper> search_through({});
-    for (const NodeGroupWrapper& group : node_path.value()) {
+    for (const NodeGroupWrapper& group : node_path) {
         auto tiles = group.get_tiles();
         search_through.insert(tiles.begin(), tiles.end());
     }
 
-    auto wrapped_path = get_path<PositionWrapper, helper::breadth_first_compare>(
-        start, goal, search_through
-    );
+    auto wrapped_path =
+        get_path<PositionWrapper, false>(start, goal, &search_through, path_type);
 
     if (!wrapped_path) {
         return {};
@@ -953,69 +1093,67 @@ Terrain::get_path_breadth_first(
     return path;
 }
 
-template <class T, bool compare(Node<const T>*, Node<const T>*)>
+template <class T, bool use_heuristic>
 std::optional<std::vector<T>>
 Terrain::get_path(
-    const T start, const std::unordered_set<T> goal,
-    const std::unordered_set<T> search_through
+    const T& start, const std::unordered_set<T>& goal,
+    const std::unordered_set<T>* search_through, UnitPath path_type
 ) const {
-    std::priority_queue<Node<const T>*, std::vector<Node<const T>*>, decltype(compare)>
-        openNodes(compare);
-
-    std::unordered_map<TerrainOffset3, Node<const T>>
-        nodes; // The nodes that can be walked through
-    for (const T& t : search_through) {
-        nodes[t.unique_position()] = Node<const T>(
-            &t, get_H_cost(t.average_position(), (*goal.begin()).average_position())
-        );
+    auto cost = [](const T& from, const T& to) {
+        return get_H_cost(from.average_position(), to.average_position());
+    };
+
+    auto for_each_adjacent = [this, path_type](const T& position, auto visit) {
+        auto tile_it =
+            get_tile_adjacent_iterator(position.unique_position(), path_type);
+        while (!tile_it.end()) {
+            visit(T(tile_it.get_pos()));
+            tile_it++;
+        }
+    };
+
+    auto allowed = [search_through](const T& position) {
+        return search_through == nullptr || search_through->contains(position);
+    };
+
+    auto key_of = [this](const T& position) {
+        return get_tile_key_(position.unique_position());
+    };
+    auto position_of = [this](uint32_t key) { return T(get_key_tile_(key)); };
+
+    // tiles outside the terrain have no key
+    auto tile_in_range = [this](const T& position) {
+        return in_range(position.unique_position());
+    };
+    if (!tile_in_range(start)) {
+        return {};
     }
-    Node<const T> start_node = nodes[start.unique_position()];
-    openNodes.push(&start_node); // gotta start somewhere
-    start_node.explore();
-
-    while (!openNodes.empty()) {
-        Node<const T>* choice = openNodes.top();
-        openNodes.pop(); // Remove the chosen node from openNodes
-        // Expand openNodes around the best choice
-        std::unordered_set<Node<const T>*> adjacent_nodes =
-            get_adjacent_nodes(choice, nodes, 31);
-        for (Node<const T>* n : adjacent_nodes) {
-            // if can stand on the tile    and the tile is not explored
-            // get_adjacent should only give open nodes
-
-            if (!n->is_explored()) {
-                n->explore(choice, get_G_cost(*(n->get_tile()), *choice));
-                if (goal.find(*(n->get_tile())) != goal.end()) {
-                    std::vector<T> path;
-                    get_path_through_nodes(n, path, start);
-                    return path;
-                }
-                openNodes.push(n); // n can be chose to expand around
-            } else {
-                if (n->get_time_cost() > get_G_cost(*(n->get_tile()), *choice)) {
-                    n->explore(choice, get_G_cost(*(n->get_tile()), *choice));
-
-                    // will update open nodes if the fastest path has changed.
-                    std::make_heap(
-                        const_cast<Node<const T>**>(&openNodes.top()),
-                        const_cast<Node<const T>**>(&openNodes.top())
-                            + openNodes.size(),
-                        compare
-                    );
-                } else {
-                    n->explore(choice, get_G_cost(*(n->get_tile()), *choice));
-                }
+    const std::unordered_set<T>* goal_in_range = &goal;
+    std::unordered_set<T> filtered_goal;
+    if (!std::ranges::all_of(goal, tile_in_range)) {
+        for (const T& position : goal) {
+            if (tile_in_range(position)) {
+                filtered_goal.insert(position);
             }
         }
+        goal_in_range = &filtered_goal;
     }
-    return {};
+
+    static_assert(
+        path::SearchArena::PAGE_SIZE == Chunk::SIZE * Chunk::SIZE * Chunk::SIZE,
+        "An arena page should hold one chunk of tiles"
+    );
+    return path::find_path<T, use_heuristic>(
+        start, *goal_in_range, chunks_.size() * path::SearchArena::PAGE_SIZE, key_of,
+        position_of, cost, for_each_adjacent, allowed
+    );
 }
 
 void
 Terrain::qb_save_debug(const std::string path) {
     // used to determine a debug color for each node group
     size_t debug_color = 0;
-    for (auto& [pos, c] : chunks_) {
+    for (auto& c : chunks_) {
         std::unordered_set<const NodeGroup*> node_groups;
         c.add_nodes_to(node_groups);
         for (const NodeGroup* NG : node_groups) {
@@ -1043,24 +1181,39 @@ Terrain::qb_save(const std::string path) const {
 
 std::pair<TerrainOffset3, TerrainOffset3>
 Terrain::get_start_end_test() const {
-    std::pair<TerrainOffset3, TerrainOffset3> out;
-    bool first = true;
-    for (TerrainOffset x = 0; x < X_MAX; x++) {
-        for (TerrainOffset y = 0; y < Y_MAX; y++) {
-            for (TerrainOffset z = 0; z < Z_MAX; z++) {
-                const Tile* tile = get_tile(x, y, z);
-                if (tile->get_material_id() == DEBUG_MATERIAL
-                    && tile->get_color_id() == 4) {
-                    if (first) {
-                        out.first = {x, y, z + 1};
-                        first = false;
-                    } else {
-                        out.second = {x, y, z + 1};
-                        return out;
-                    }
+    std::vector<TerrainOffset3> markers;
+    std::mutex markers_mutex;
+
+    for_each_chunk_span([this, &markers, &markers_mutex](
+                            TerrainOffset3 offset, std::span<const Tile> tiles
+                        ) {
+        for (size_t index = 0; index < tiles.size(); index++) {
+            const Tile& tile = tiles[index];
+            if (tile.get_material_id() == DEBUG_MATERIAL && tile.get_color_id() == 4) {
+                TerrainOffset3 position = offset + Chunk::get_tile_position(index);
+                if (!in_range(position)) {
+                    continue;
                 }
+                std::scoped_lock lock(markers_mutex);
+                markers.push_back(position);
             }
         }
+    });
+
+    // return the first two markers in x, then y, then z order
+    std::sort(
+        markers.begin(), markers.end(),
+        [](const TerrainOffset3& lhs, const TerrainOffset3& rhs) {
+            return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+        }
+    );
+
+    std::pair<TerrainOffset3, TerrainOffset3> out;
+    if (markers.size() >= 1) {
+        out.first = markers[0] + TerrainOffset3(0, 0, 1);
+    }
+    if (markers.size() >= 2) {
+        out.second = markers[1] + TerrainOffset3(0, 0, 1);
     }
     return out;
 }
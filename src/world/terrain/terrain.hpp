@@ -24,6 +24,7 @@
 #pragma once
 
 #include "chunk.hpp"
+#include "global_context.hpp"
 #include "generation/land_generator.hpp"
 #include "generation/map_tile.hpp"
 #include "generation/noise.hpp"
@@ -33,7 +34,10 @@
 #include "material.hpp"
 #include "path/node.hpp"
 #include "path/node_group.hpp"
+#include "path/node_group_graph.hpp"
 #include "path/node_wrappers.hpp"
+#include "path/path_search.hpp"
+#include "path/route_cache.hpp"
 #include "path/tile_iterators.hpp"
 #include "path/unit_path.hpp"
 #include "terrain_helper.hpp"
@@ -46,8 +50,11 @@
 #include <array>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -106,10 +113,30 @@ class Terrain : public voxel_utility::VoxelBase {
     // mat of material id to material that describes materials in this terrain
     const generation::Biome& biome_;
 
-    mutable std::mutex nodegroup_mutex_;
-
-    std::unordered_map<TerrainOffset3, Chunk> chunks_;
+    // Node groups are read with a shared lock (see PathService), and changed
+    // with a unique lock.
+    mutable std::shared_mutex nodegroup_mutex_;
+    // held while chunks add their node groups to tile_to_group_
+    std::mutex tile_to_group_mutex_;
+
+    // number of chunks in the x, y, and z directions
+    TerrainOffset3 chunk_grid_size_;
+    // dense grid of chunks. Chunk index is computed from the chunk position
+    // (see get_chunk_index_)
+    std::vector<Chunk> chunks_;
     std::unordered_map<TerrainOffset3, NodeGroup*> tile_to_group_;
+    // node group adjacency used by high level path finding
+    path::NodeGroupGraph node_group_graph_;
+    // recently found node group routes
+    mutable path::RouteCache route_cache_;
+    // chunks whose node groups need to be rebuilt
+    std::unordered_set<ChunkPos> dirty_nodegroup_chunks_;
+    std::mutex dirty_nodegroup_chunks_mutex_;
+
+    // highest solid z in each column (see get_column_index_)
+    std::vector<TerrainOffset> highest_solid_;
+    // highest non air z in each column
+    std::vector<TerrainOffset> highest_surface_;
 
  public:
     // length in the x direction
@@ -119,11 +146,16 @@ class Terrain : public voxel_utility::VoxelBase {
     // length in the z direction
     const TerrainOffset Z_MAX;
 
-    [[nodiscard]] inline std::mutex&
+    [[nodiscard]] inline std::shared_mutex&
     get_nodegroup_mutex() const {
         return nodegroup_mutex_;
     }
 
+    [[nodiscard]] inline std::mutex&
+    get_tile_to_group_mutex() {
+        return tile_to_group_mutex_;
+    }
+
     /**
      * @brief Get the size of terrain
      *
@@ -146,6 +178,14 @@ class Terrain : public voxel_utility::VoxelBase {
         return {0, 0, 0};
     }
 
+    /**
+     * @brief Get the number of chunks in the x, y, and z directions
+     */
+    [[nodiscard]] inline TerrainOffset3
+    get_chunk_grid_size() const noexcept {
+        return chunk_grid_size_;
+    }
+
     /**
      * @brief test if tile position is within terrain bounds
      *
@@ -157,16 +197,18 @@ class Terrain : public voxel_utility::VoxelBase {
      */
     [[nodiscard]] inline bool
     in_range(TerrainOffset x, TerrainOffset y, TerrainOffset z) const {
+        // negative values become large unsigned values, so one comparison per
+        // axis tests both bounds
         return (
-            static_cast<TerrainOffset>(x) < X_MAX && x >= 0
-            && static_cast<TerrainOffset>(y) < Y_MAX && y >= 0
-            && static_cast<TerrainOffset>(z) < Z_MAX && z >= 0
+            static_cast<uint32_t>(x) < static_cast<uint32_t>(X_MAX)
+            && static_cast<uint32_t>(y) < static_cast<uint32_t>(Y_MAX)
+            && static_cast<uint32_t>(z) < static_cast<uint32_t>(Z_MAX)
         );
     }
 
     [[nodiscard]] inline bool
     in_range(TerrainOffset3 xyz) const {
-        return (xyz.x < X_MAX && xyz.y < Y_MAX && xyz.z < Z_MAX);
+        return in_range(xyz.x, xyz.y, xyz.z);
     }
 
     /**
@@ -180,7 +222,14 @@ class Terrain : public voxel_utility::VoxelBase {
      */
     [[nodiscard]] inline Tile*
     get_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) {
-        return const_cast<Tile*>(std::as_const(*this).get_tile(x, y, z));
+        if (!in_range(x, y, z)) [[unlikely]] {
+            LOG_BACKTRACE(
+                logging::terrain_logger, "Tile position ({}, {}, {}), out of range.", x,
+                y, z
+            );
+            return nullptr;
+        }
+        return get_tile_unchecked(x, y, z);
     }
 
     [[nodiscard]] inline Tile*
@@ -191,19 +240,87 @@ class Terrain : public voxel_utility::VoxelBase {
     /**
      * @brief Get the tile at the given position
      *
+     * @details The chunk is found arithmetically from the position, so this is
+     * a bounds check and two array look ups.
+     *
      * @param x x position
      * @param y y position
      * @param z z position
-     * @return Tile* tile at given position
+     * @return Tile* tile at given position, nullptr if out of range
      */
-    [[nodiscard]] const Tile*
-    get_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) const;
+    [[nodiscard]] inline const Tile*
+    get_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) const {
+        if (!in_range(x, y, z)) [[unlikely]] {
+            LOG_BACKTRACE(
+                logging::terrain_logger, "Tile position ({}, {}, {}), out of range.", x,
+                y, z
+            );
+            return nullptr;
+        }
+        return get_tile_unchecked(x, y, z);
+    }
 
     [[nodiscard]] inline const Tile*
     get_tile(TerrainOffset3 xyz) const {
         return get_tile(xyz.x, xyz.y, xyz.z);
     }
 
+    /**
+     * @brief Get the tile at the given position without a bounds check
+     *
+     * @details The position must be in range (see in_range). Use in hot loops
+     * where the bounds are already known.
+     *
+     * @param x x position
+     * @param y y position
+     * @param z z position
+     * @return Tile* tile at given position
+     */
+    [[nodiscard]] inline Tile*
+    get_tile_unchecked(TerrainOffset x, TerrainOffset y, TerrainOffset z) {
+        // in range so all positions are non negative
+        uint32_t x_position = x;
+        uint32_t y_position = y;
+        uint32_t z_position = z;
+
+        // non const so the chunk expands if it is compressed
+        Chunk& chunk = chunks_[get_chunk_index_(
+            x_position / Chunk::SIZE, y_position / Chunk::SIZE, z_position / Chunk::SIZE
+        )];
+        return chunk.get_tile(
+            static_cast<Dim>(x_position % Chunk::SIZE),
+            static_cast<Dim>(y_position % Chunk::SIZE),
+            static_cast<Dim>(z_position % Chunk::SIZE)
+        );
+    }
+
+    [[nodiscard]] inline const Tile*
+    get_tile_unchecked(TerrainOffset x, TerrainOffset y, TerrainOffset z) const {
+        // in range so all positions are non negative
+        uint32_t x_position = x;
+        uint32_t y_position = y;
+        uint32_t z_position = z;
+
+        const Chunk& chunk = chunks_[get_chunk_index_(
+            x_position / Chunk::SIZE, y_position / Chunk::SIZE, z_position / Chunk::SIZE
+        )];
+        return chunk.get_tile(
+            static_cast<Dim>(x_position % Chunk::SIZE),
+            static_cast<Dim>(y_position % Chunk::SIZE),
+            static_cast<Dim>(z_position % Chunk::SIZE)
+        );
+    }
+
+    [[nodiscard]] inline const Tile*
+    get_tile_unchecked(TerrainOffset3 xyz) const {
+        return get_tile_unchecked(xyz.x, xyz.y, xyz.z);
+    }
+
+    [[nodiscard]] inline Tile*
+    get_tile_unchecked(TerrainOffset3 xyz) {
+        return get_tile_unchecked(xyz.x, xyz.y, xyz.z);
+    }
+
     /**
      * @brief Get the color of a tile
      *
@@ -263,6 +380,12 @@ class Terrain : public voxel_utility::VoxelBase {
     /**
      * @brief Get the heights z thats material is not in materials
      *
+     * @details Searches up or down from guess, so columns with more than one
+     * such height can give different results for different guesses. When air
+     * is not in materials the search down starts at the cached surface, so
+     * a guess above the column costs one lookup. Otherwise it checks one tile
+     * at a time.
+     *
      * @param materials materials to exclude
      * @param x x position
      * @param y y position
@@ -297,29 +420,35 @@ class Terrain : public voxel_utility::VoxelBase {
     }
 
     /**
-     * @brief initialize area of terrain
+     * @brief Get the stamps of every map tile, in the order they are applied
      *
-     * @param area_x area x coordinate
-     * @param area_y area y coordinate
-     * @param gen Generator object that generates tile types
+     * @details Stamps are made with the random engine of each map tile, so
+     * they only depend on the macro map. Map tiles are visited in four
+     * phases of a checkerboard, so neighboring map tiles stamp over each
+     * other in the same order every time.
+     *
+     * @param x_map_tiles number of map tiles in the x direction
+     * @param y_map_tiles number of map tiles in the y direction
+     * @param macro_map map tiles to make stamps for
+     * @return std::vector<generation::PlacedStamp> stamps in terrain positions
      */
-    [[nodiscard]] std::vector<std::future<void>>
-    init_area(generation::MapTile& map_tile, generation::LandGenerator gen);
-
-    [[nodiscard]] std::vector<std::vector<std::future<void>>> init_all_map_tile_regions(
+    [[nodiscard]] std::vector<generation::PlacedStamp> get_map_tile_stamps(
         TerrainOffset x_map_tiles, TerrainOffset y_map_tiles,
         generation::TerrainMacroMap& macro_map
-    );
+    ) const;
 
     /**
-     * @brief Set a group of tiles
+     * @brief Set the tiles of each stamp, in order
+     *
+     * @details The stamps are binned by the chunks they overlap, keeping their
+     * order, and then each chunk applies its own stamps on the thread pool.
+     * Chunks are not locked, so no other thread should edit the terrain while
+     * this runs. Blocks until every chunk is done, so do not call from a task
+     * on the GlobalContext thread pool.
      *
-     * @param tStamp where the stamp is, and material and color
-     * @param x macro map x position
-     * @param y macro map y position
+     * @param stamps stamps in terrain positions
      */
-    [[nodiscard]] std::vector<std::future<void>>
-    stamp_tile_region(const generation::TileStamp& tStamp, int x, int y);
+    void apply_stamps(const std::vector<generation::PlacedStamp>& stamps);
 
     /**
      * @brief add material on top of extant voxels
@@ -389,17 +518,6 @@ class Terrain : public voxel_utility::VoxelBase {
      * @return float time between positions
      */
     [[nodiscard]] static float get_H_cost(TerrainOffset3 xyz1, TerrainOffset3 xyz2);
-    /**
-     * @brief Get time required to get to node from start plus time required
-     * to get from node to tile
-     *
-     * @tparam T Type of underlying position
-     * @param tile final position of path
-     * @param node nodes path can pass through
-     * @return float time required
-     */
-    template <class T>
-    [[nodiscard]] static float get_G_cost(const T tile, const Node<const T> node);
 
     /**
      * @brief Construct a new Terrain object
@@ -461,34 +579,6 @@ class Terrain : public voxel_utility::VoxelBase {
         return iterator(*this, pos, path_type);
     }
 
-    /**
-     * @brief Get the nodes adjacent to this one
-     *
-     * @param node node to find the adjacent of
-     * @param nodes nodes that can be passed through
-     * @param type path type allowed
-     * @return std::unordered_set<Node<const T> *> adjacent nodes
-     */
-    [[nodiscard]] std::unordered_set<Node<const NodeGroupWrapper>*> get_adjacent_nodes(
-        const Node<const NodeGroupWrapper>* const node,
-        std::unordered_map<TerrainOffset3, Node<const NodeGroupWrapper>>& nodes,
-        path_t type
-    ) const;
-
-    /**
-     * @brief Get the nodes adjacent to this one
-     *
-     * @param node node to find the adjacent of
-     * @param nodes nodes that can be passed through
-     * @param type path type allowed
-     * @return std::unordered_set<Node<const T> *> adjacent nodes
-     */
-    [[nodiscard]] std::unordered_set<Node<const PositionWrapper>*> get_adjacent_nodes(
-        const Node<const PositionWrapper>* const node,
-        std::unordered_map<TerrainOffset3, Node<const PositionWrapper>>& nodes,
-        path_t type
-    ) const;
-
     /**
      * @brief Get the node group from tile index
      *
@@ -533,20 +623,116 @@ class Terrain : public voxel_utility::VoxelBase {
 
     [[nodiscard]] inline Chunk*
     get_chunk(ChunkPos chunk_position) {
-        auto chunk = chunks_.find(chunk_position);
+        return const_cast<Chunk*>(std::as_const(*this).get_chunk(chunk_position));
+    }
 
-        if (chunk == chunks_.end()) {
+    [[nodiscard]] inline const Chunk*
+    get_chunk(ChunkPos chunk_position) const {
+        if (chunk_position.x < 0 || chunk_position.x >= chunk_grid_size_.x
+            || chunk_position.y < 0 || chunk_position.y >= chunk_grid_size_.y
+            || chunk_position.z < 0 || chunk_position.z >= chunk_grid_size_.z)
+            [[unlikely]] {
             LOG_BACKTRACE(
                 logging::terrain_logger, "Chunk position ({}, {}, {}), out of range.",
                 chunk_position.x, chunk_position.y, chunk_position.z
             );
             return nullptr;
         }
-        return &chunk->second;
+        return &chunks_[get_chunk_index_(
+            chunk_position.x, chunk_position.y, chunk_position.z
+        )];
     }
 
-    [[nodiscard]] inline const auto&
-    get_chunks() {
+    /**
+     * @brief Run function on the tiles of every chunk in parallel
+     *
+     * @details Called as function(chunk_offset, tiles) where chunk_offset is the
+     * position of the first tile in the chunk and tiles is Chunk::get_tiles().
+     * Tiles at or past X_MAX, Y_MAX, or Z_MAX are included when the terrain is
+     * not a multiple of Chunk::SIZE. The non const version expands compressed
+     * chunks. Each chunk is locked while function runs.
+     * Blocks until every chunk is done, so do not call from a task on the
+     * GlobalContext thread pool.
+     *
+     * @param function function to run on each chunk
+     */
+    template <class F>
+    void
+    for_each_chunk_span(F function) {
+        parallel_for_(chunks_.size(), [this, &function](size_t index) {
+            Chunk& chunk = chunks_[index];
+            std::scoped_lock lock(chunk.get_mutex());
+            function(chunk.get_offset(), chunk.get_tiles());
+        });
+    }
+
+    template <class F>
+    void
+    for_each_chunk_span(F function) const {
+        parallel_for_(chunks_.size(), [this, &function](size_t index) {
+            // holds the tiles of compressed chunks
+            thread_local std::vector<Tile> buffer;
+            const Chunk& chunk = chunks_[index];
+            std::scoped_lock lock(chunk.get_mutex());
+            function(chunk.get_offset(), chunk.get_tiles(buffer));
+        });
+    }
+
+    /**
+     * @brief Run function on every column of chunks in parallel
+     *
+     * @details Called as function(column) where column is every chunk with the
+     * same chunk x and y, ordered from the bottom up. Use this when a pass
+     * needs to look at the tile above or below across chunk boundaries.
+     * Chunks are not locked, so no other thread should edit the terrain while
+     * this runs. Blocks until every column is done.
+     *
+     * @param function function to run on each column
+     */
+    template <class F>
+    void
+    for_each_chunk_column(F function) {
+        size_t column_height = chunk_grid_size_.z;
+        size_t num_columns = chunk_grid_size_.x * chunk_grid_size_.y;
+        parallel_for_(num_columns, [this, &function, column_height](size_t index) {
+            function(std::span<Chunk>(chunks_).subspan(
+                index * column_height, column_height
+            ));
+        });
+    }
+
+    template <class F>
+    void
+    for_each_chunk_column(F function) const {
+        size_t column_height = chunk_grid_size_.z;
+        size_t num_columns = chunk_grid_size_.x * chunk_grid_size_.y;
+        parallel_for_(num_columns, [this, &function, column_height](size_t index) {
+            function(std::span<const Chunk>(chunks_).subspan(
+                index * column_height, column_height
+            ));
+        });
+    }
+
+    /**
+     * @brief Compress every chunk (see Chunk::compress)
+     *
+     * @details Chunks are expanded again when a tile is edited.
+     */
+    void compress_chunks();
+
+    /**
+     * @brief Get the number of bytes used to store tiles in all chunks
+     */
+    [[nodiscard]] size_t get_tile_memory_usage() const;
+
+    /**
+     * @brief Get all chunks
+     *
+     * @return const std::vector<Chunk>& every chunk in the terrain. Use
+     * Chunk::get_chunk_position to get the position of each chunk.
+     */
+    [[nodiscard]] inline const std::vector<Chunk>&
+    get_chunks() const {
         return chunks_;
     }
 
@@ -560,19 +746,6 @@ class Terrain : public voxel_utility::VoxelBase {
      * @return false unsuccessful change materials is different
      */
     bool paint(Tile* tile, const material_t* mat, ColorId color_id);
-    /**
-     * @brief add or remove tile, only works when either previous of materials
-     * or set material is air
-     *
-     * @param xyz tile index
-     * @param mat materials to set
-     * @param color_id color id to set
-     * @return true success
-     * @return false failure
-     */
-    bool player_set_tile_material(
-        TerrainOffset3 xyz, const material_t* mat, ColorId color_id
-    );
 
     ColorId
     natural_color(TerrainOffset3 xyz, const material_t* mat, ColorId color_id) const;
@@ -593,6 +766,60 @@ class Terrain : public voxel_utility::VoxelBase {
      */
     void init_grass();
 
+    /**
+     * @brief Build the per column highest solid and highest surface cache
+     *
+     * @details Run once after tiles are placed. set_tile_material and
+     * World::set_tile keep the cache up to date after that.
+     */
+    void init_column_heights();
+
+    /**
+     * @brief Mark node groups near xyz for rebuild after the tile at xyz
+     * changed
+     *
+     * @details Marks every chunk with a tile whose path finding can depend on
+     * xyz. Thread safe. The node groups are rebuilt by
+     * update_dirty_nodegroups.
+     *
+     * @param xyz position of changed tile
+     */
+    void mark_nodegroups_dirty(TerrainOffset3 xyz);
+
+    /**
+     * @brief Mark all node groups in a chunk for rebuild
+     *
+     * @details Thread safe.
+     *
+     * @param chunk_position position of chunk
+     */
+    void
+    mark_chunk_nodegroups_dirty(ChunkPos chunk_position) {
+        std::scoped_lock lock(dirty_nodegroup_chunks_mutex_);
+        dirty_nodegroup_chunks_.insert(chunk_position);
+    }
+
+    /**
+     * @brief Rebuild node groups in all marked chunks
+     *
+     * @details Node groups are recomputed on the thread pool for the marked
+     * chunks, then the adjacency between them and bordering chunks, and the
+     * node group graph are updated. Call once per frame. Holds a unique lock
+     * on the node group mutex, so waits for searches run by PathService.
+     *
+     * @return size_t number of chunks rebuilt
+     */
+    size_t update_dirty_nodegroups();
+
+    /**
+     * @brief Update the column height cache after the tile at xyz changed
+     *
+     * @details Only needed when a tile is edited directly through get_tile.
+     *
+     * @param xyz position of changed tile
+     */
+    void update_column_height(TerrainOffset3 xyz);
+
     /**
      * @brief set the upper bound for grass color
      *
@@ -694,6 +921,31 @@ class Terrain : public voxel_utility::VoxelBase {
      */
     void qb_save(const std::string path) const;
 
+    /**
+     * @brief Get the node group adjacency graph
+     *
+     * @return const path::NodeGroupGraph& graph of all node groups
+     */
+    [[nodiscard]] inline const path::NodeGroupGraph&
+    get_node_group_graph() const {
+        return node_group_graph_;
+    }
+
+    /**
+     * @brief Get the cache of node group routes found by get_path_Astar
+     */
+    [[nodiscard]] inline path::RouteCache&
+    get_route_cache() const {
+        return route_cache_;
+    }
+
+    /**
+     * @brief Update the node group graph after node groups in chunks changed
+     *
+     * @param changed_chunks chunks whose node groups changed
+     */
+    void update_node_group_graph(const std::vector<ChunkPos>& changed_chunks);
+
     /**
      * @brief get all nod groups
      *
@@ -706,20 +958,24 @@ class Terrain : public voxel_utility::VoxelBase {
      *
      * @param start start tile
      * @param goal end tile
+     * @param path_type type of paths that are allowed
      * @return std::vector<const Tile *> path
      */
-    [[nodiscard]] std::optional<std::vector<TerrainOffset3>>
-    get_path_Astar(TerrainOffset3 start, TerrainOffset3 goal) const;
+    [[nodiscard]] std::optional<std::vector<TerrainOffset3>> get_path_Astar(
+        TerrainOffset3 start, TerrainOffset3 goal, UnitPath path_type = 31
+    ) const;
 
     /**
      * @brief Get a path between start, and goal using the A* algorithm
      *
      * @param start start NodeGroup
      * @param goal end NodeGroup
+     * @param path_type type of paths that are allowed
      * @return std::optional<std::vector<const NodeGroup*>> path
      */
-    [[nodiscard]] std::optional<std::vector<NodeGroupWrapper>>
-    get_path_Astar(const NodeGroup* start, const NodeGroup* goal) const;
+    [[nodiscard]] std::optional<std::vector<NodeGroupWrapper>> get_path_Astar(
+        const NodeGroup* start, const NodeGroup* goal, UnitPath path_type = 31
+    ) const;
 
     /**
      * @brief Get a path between start, and any goal using the breadth first
@@ -727,10 +983,12 @@ class Terrain : public voxel_utility::VoxelBase {
      *
      * @param start start tile
      * @param goal set of excitable goals
+     * @param path_type type of paths that are allowed
      * @return std::optional<std::vector<const Tile*>> path to closest goal
      */
     [[nodiscard]] std::optional<std::vector<TerrainOffset3>> get_path_breadth_first(
-        const TerrainOffset3, const std::unordered_set<TerrainOffset3> goal
+        const TerrainOffset3, const std::unordered_set<TerrainOffset3> goal,
+        UnitPath path_type = 31
     ) const;
 
     /**
@@ -739,26 +997,46 @@ class Terrain : public voxel_utility::VoxelBase {
      *
      * @param start start NodeGroup
      * @param goal set of excitable goals
+     * @param path_type type of paths that are allowed
      * @return std::optional<std::vector<const NodeGroup*>> path to closest goal
      */
     [[nodiscard]] std::optional<std::vector<NodeGroupWrapper>> get_path_breadth_first(
-        const NodeGroupWrapper start, const std::unordered_set<NodeGroupWrapper> goal
+        const NodeGroupWrapper start, const std::unordered_set<NodeGroupWrapper> goal,
+        UnitPath path_type = 31
+    ) const;
+
+    /**
+     * @brief Get a tile path from start to a goal through the given node
+     * groups
+     *
+     * @param start start tile
+     * @param goal set of excitable goals
+     * @param node_path node groups that may be used, from the node group
+     * with the goal back to the node group with start
+     * @param path_type type of paths that are allowed
+     * @return std::optional<std::vector<TerrainOffset3>> path from the goal
+     * back to start
+     */
+    [[nodiscard]] std::optional<std::vector<TerrainOffset3>> get_path_through(
+        const TerrainOffset3 start, const std::unordered_set<TerrainOffset3>& goal,
+        const std::vector<NodeGroupWrapper>& node_path, UnitPath path_type = 31
     ) const;
 
     /**
-     * @brief Get the path from start to a goal optimized by compare
+     * @brief Get the path from start to a goal
      *
      * @tparam T position type
+     * @tparam use_heuristic true for A*, false for breadth first
      * @param start start position
      * @param goal goal positions
-     * @param search_through available positions for path
-     * @param compare way to sort best path
-     * @return std::vector<const T *> path optimized by compare
+     * @param search_through available positions for path, nullptr for any
+     * @param path_type type of paths that are allowed
+     * @return std::optional<std::vector<T>> path from the goal back to start
      */
-    template <class T, bool compare(Node<const T>*, Node<const T>*)>
+    template <class T, bool use_heuristic>
     [[nodiscard]] std::optional<std::vector<T>> get_path(
-        const T start, const std::unordered_set<T> goal,
-        const std::unordered_set<T> search_through
+        const T& start, const std::unordered_set<T>& goal,
+        const std::unordered_set<T>* search_through, UnitPath path_type = 31
     ) const;
 
     /**
@@ -790,17 +1068,107 @@ class Terrain : public voxel_utility::VoxelBase {
     [[nodiscard]] TerrainOffset
     get_Z_solid(TerrainOffset x, TerrainOffset y, TerrainOffset z) const;
 
+    /**
+     * @brief Get the highest z at the x, y quadrates that is not air
+     *
+     * @param x x position
+     * @param y y position
+     *
+     * @return TerrainOffset height of highest non air z
+     */
+    [[nodiscard]] TerrainOffset get_Z_surface(TerrainOffset x, TerrainOffset y) const;
+
+    /**
+     * @brief Get the highest z below the given z that is not air
+     *
+     * @param x x position
+     * @param y y position
+     * @param z z height
+     * @return TerrainOffset height of highest non air z
+     */
+    [[nodiscard]] TerrainOffset
+    get_Z_surface(TerrainOffset x, TerrainOffset y, TerrainOffset z) const;
+
  private:
-    // TODO This is probably the least safe function that could possibly exist
-    // trace nodes through parents to reach start
-    template <class T>
-    void
-    get_path_through_nodes(Node<const T>* node, std::vector<T>& out, T start) const {
-        out.push_back(*node->get_tile());
-        if (start == *node->get_tile()) {
-            return;
+    // run function(i) for i in [0, count) on the thread pool and wait
+    template <class F>
+    static void
+    parallel_for_(size_t count, F function) {
+        GlobalContext& context = GlobalContext::instance();
+        std::vector<std::future<void>> futures;
+        futures.reserve(count);
+        for (size_t index = 0; index < count; index++) {
+            futures.push_back(context.submit_task([&function, index]() {
+                function(index);
+            }));
         }
-        get_path_through_nodes(node->get_parent(), out, start);
+        // every task uses function, so wait for all of them before get
+        // rethrows any exception
+        for (const auto& future : futures) {
+            future.wait();
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+
+    // convert a path of node group graph ids to node groups
+    [[nodiscard]] std::optional<std::vector<NodeGroupWrapper>>
+    get_node_group_path_(const std::optional<std::vector<uint32_t>>& id_path) const;
+
+    // highest solid z at or below z_start without using the cache
+    [[nodiscard]] TerrainOffset
+    scan_Z_solid_(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) const;
+
+    // highest non air z at or below z_start without using the cache
+    [[nodiscard]] TerrainOffset
+    scan_Z_surface_(TerrainOffset x, TerrainOffset y, TerrainOffset z_start) const;
+
+    // index of the x, y column in highest_solid_ and highest_surface_
+    [[nodiscard]] inline size_t
+    get_column_index_(TerrainOffset x, TerrainOffset y) const {
+        return static_cast<size_t>(x) * Y_MAX + y;
+    }
+
+    // dense key of a tile for path::SearchArena. Tiles in one chunk have
+    // contiguous keys, so a search touches one arena page per chunk.
+    [[nodiscard]] inline uint32_t
+    get_tile_key_(TerrainOffset3 xyz) const {
+        // in range so all positions are non negative
+        uint32_t x = xyz.x;
+        uint32_t y = xyz.y;
+        uint32_t z = xyz.z;
+        size_t chunk_index =
+            get_chunk_index_(x / Chunk::SIZE, y / Chunk::SIZE, z / Chunk::SIZE);
+        return static_cast<uint32_t>(chunk_index) * Chunk::SIZE * Chunk::SIZE
+                   * Chunk::SIZE
+               + ((x % Chunk::SIZE) * Chunk::SIZE + y % Chunk::SIZE) * Chunk::SIZE
+               + z % Chunk::SIZE;
+    }
+
+    // tile with key, inverse of get_tile_key_
+    [[nodiscard]] inline TerrainOffset3
+    get_key_tile_(uint32_t key) const {
+        uint32_t local = key % (Chunk::SIZE * Chunk::SIZE * Chunk::SIZE);
+        uint32_t chunk_index = key / (Chunk::SIZE * Chunk::SIZE * Chunk::SIZE);
+        uint32_t grid_y = chunk_grid_size_.y;
+        uint32_t grid_z = chunk_grid_size_.z;
+        uint32_t chunk_z = chunk_index % grid_z;
+        uint32_t chunk_y = chunk_index / grid_z % grid_y;
+        uint32_t chunk_x = chunk_index / grid_z / grid_y;
+        return TerrainOffset3(
+            chunk_x * Chunk::SIZE + local / (Chunk::SIZE * Chunk::SIZE),
+            chunk_y * Chunk::SIZE + local / Chunk::SIZE % Chunk::SIZE,
+            chunk_z * Chunk::SIZE + local % Chunk::SIZE
+        );
+    }
+
+    // index of chunk in chunks_. Chunks are ordered x, then y, then z.
+    [[nodiscard]] inline size_t
+    get_chunk_index_(size_t chunk_x, size_t chunk_y, size_t chunk_z) const {
+        return (chunk_x * static_cast<size_t>(chunk_grid_size_.y) + chunk_y)
+                   * static_cast<size_t>(chunk_grid_size_.z)
+               + chunk_z;
     }
 };
 
@@ -76,6 +76,8 @@ class Tile {
 
     Tile(Tile&&) = default;
 
+    [[nodiscard]] bool operator==(const Tile& other) const = default;
+
     // This probably should not be used.
     Tile() :
         mat_id_(0), color_id_(0), grow_data_high_(0), grow_data_low_(0),
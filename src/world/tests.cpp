@@ -0,0 +1,2784 @@
+#include "config.h"
+#include "global_context.hpp"
+#include "logging.hpp"
+#include "manifest/object_handler.hpp"
+#include "types.hpp"
+#include "util/bit_mask.hpp"
+#include "util/mesh.hpp"
+#include "util/range_allocator.hpp"
+#include "util/time.hpp"
+#include "world/biome.hpp"
+#include "world/terrain/chunk_culling.hpp"
+#include "world/terrain/generation/noise.hpp"
+#include "world/terrain/generation/worley_noise.hpp"
+#include "world/terrain/material.hpp"
+#include "world/terrain/path/distance_field.hpp"
+#include "world/terrain/path/path_service.hpp"
+#include "world/terrain/terrain.hpp"
+#include "world/remesh_scheduler.hpp"
+#include "world/world.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace world {
+
+namespace {
+
+// Chunk look up the way it was done before chunks were stored in a flat
+// array. Used as a baseline.
+class HashedChunkLookup {
+    std::unordered_map<TerrainOffset3, const terrain::Chunk*> chunks_;
+
+ public:
+    explicit HashedChunkLookup(const terrain::Terrain& terrain) {
+        chunks_.reserve(terrain.num_chunks());
+        for (const auto& chunk : terrain.get_chunks()) {
+            chunks_.emplace(TerrainOffset3(chunk.get_chunk_position()), &chunk);
+        }
+    }
+
+    [[nodiscard]] const terrain::Tile*
+    get_tile(TerrainOffset x, TerrainOffset y, TerrainOffset z) const {
+        TerrainOffset3 chunk_position =
+            terrain::Terrain::get_chunk_from_tile(x, y, z);
+        auto chunk_iter = chunks_.find(chunk_position);
+        if (chunk_iter == chunks_.end()) {
+            return nullptr;
+        }
+        TerrainOffset3 tile_position(
+            x % terrain::Chunk::SIZE, y % terrain::Chunk::SIZE, z % terrain::Chunk::SIZE
+        );
+        return chunk_iter->second->get_tile(tile_position);
+    }
+};
+
+// Returns the time per access in nanoseconds. Solid tiles are counted so the
+// loop can not be optimized away.
+template <class Getter>
+double
+time_access(
+    const std::vector<TerrainOffset3>& positions, Getter getter, size_t& solid_count
+) {
+    auto start = time_util::get_time_nanoseconds();
+    for (const TerrainOffset3& position : positions) {
+        const terrain::Tile* tile = getter(position);
+        if (tile && tile->is_solid()) {
+            solid_count++;
+        }
+    }
+    auto end = time_util::get_time_nanoseconds();
+    return static_cast<double>((end - start).count()) / positions.size();
+}
+
+} // namespace
+
+int
+tile_access_benchmark(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::vector<TerrainOffset3> sequential;
+    sequential.reserve(
+        static_cast<size_t>(terrain.X_MAX) * terrain.Y_MAX * terrain.Z_MAX
+    );
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                sequential.emplace_back(x, y, z);
+            }
+        }
+    }
+
+    std::vector<TerrainOffset3> random = sequential;
+    std::default_random_engine rand_engine(SEED);
+    std::shuffle(random.begin(), random.end(), rand_engine);
+
+    HashedChunkLookup hashed(terrain);
+
+    auto flat_getter = [&terrain](TerrainOffset3 position) {
+        return terrain.get_tile(position);
+    };
+    auto hashed_getter = [&hashed](TerrainOffset3 position) {
+        return hashed.get_tile(position.x, position.y, position.z);
+    };
+
+    size_t flat_solid = 0;
+    size_t hashed_solid = 0;
+
+    double flat_sequential = time_access(sequential, flat_getter, flat_solid);
+    double hashed_sequential = time_access(sequential, hashed_getter, hashed_solid);
+    double flat_random = time_access(random, flat_getter, flat_solid);
+    double hashed_random = time_access(random, hashed_getter, hashed_solid);
+
+    LOG_INFO(
+        logging::main_logger, "Tile access over {} tiles ({} chunks).",
+        sequential.size(), terrain.num_chunks()
+    );
+    LOG_INFO(
+        logging::main_logger, "Sequential: {:.2f}ns per tile, {:.2f}ns with hash map.",
+        flat_sequential, hashed_sequential
+    );
+    LOG_INFO(
+        logging::main_logger, "Random: {:.2f}ns per tile, {:.2f}ns with hash map.",
+        flat_random, hashed_random
+    );
+
+    if (flat_solid != hashed_solid) {
+        LOG_ERROR(
+            logging::main_logger, "Flat and hashed access disagree ({} vs {}).",
+            flat_solid, hashed_solid
+        );
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+bulk_pass_benchmark(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    // Grass candidates: dirt tiles with an open tile above. This is the scan
+    // done by Terrain::init_grass.
+    auto start = time_util::get_time_nanoseconds();
+    size_t serial_count = 0;
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                const terrain::Tile* above = terrain.get_tile(x, y, z + 1);
+                if ((!above || !above->is_solid())
+                    && terrain.get_tile(x, y, z)->get_material_id() == DIRT_ID) {
+                    serial_count++;
+                }
+            }
+        }
+    }
+    auto serial_end = time_util::get_time_nanoseconds();
+
+    size_t column_count = 0;
+    std::mutex count_mutex;
+    terrain.for_each_chunk_column([&terrain, &column_count, &count_mutex](
+                                      std::span<const terrain::Chunk> column
+                                  ) {
+        size_t count = 0;
+        std::vector<terrain::Tile> buffer;
+        for (size_t chunk_z = 0; chunk_z < column.size(); chunk_z++) {
+            const terrain::Chunk& chunk = column[chunk_z];
+            TerrainOffset3 offset = chunk.get_offset();
+            std::span<const terrain::Tile> chunk_tiles = chunk.get_tiles(buffer);
+            for (Dim x = 0; x < terrain::Chunk::SIZE; x++) {
+                for (Dim y = 0; y < terrain::Chunk::SIZE; y++) {
+                    if (!terrain.in_range(offset.x + x, offset.y + y, offset.z)) {
+                        continue;
+                    }
+                    std::span<const terrain::Tile> tiles = chunk_tiles.subspan(
+                        (x * terrain::Chunk::SIZE + y) * terrain::Chunk::SIZE,
+                        terrain::Chunk::SIZE
+                    );
+                    for (Dim z = 0; z < terrain::Chunk::SIZE; z++) {
+                        TerrainOffset global_z = offset.z + z;
+                        if (global_z >= terrain.Z_MAX) {
+                            break;
+                        }
+                        bool open_above = true;
+                        if (global_z < terrain.Z_MAX - 1) {
+                            open_above = (z + 1 < terrain::Chunk::SIZE)
+                                             ? !tiles[z + 1].is_solid()
+                                             : !column[chunk_z + 1]
+                                                    .get_tile(x, y, 0)
+                                                    ->is_solid();
+                        }
+                        if (open_above && tiles[z].get_material_id() == DIRT_ID) {
+                            count++;
+                        }
+                    }
+                }
+            }
+        }
+        std::scoped_lock lock(count_mutex);
+        column_count += count;
+    });
+    auto column_end = time_util::get_time_nanoseconds();
+
+    // Path finding markers: the scan done by Terrain::get_start_end_test.
+    std::vector<TerrainOffset3> serial_markers;
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                const terrain::Tile* tile = terrain.get_tile(x, y, z);
+                if (tile->get_material_id() == DEBUG_MATERIAL
+                    && tile->get_color_id() == 4) {
+                    serial_markers.emplace_back(x, y, z + 1);
+                }
+            }
+        }
+    }
+    auto markers_serial_end = time_util::get_time_nanoseconds();
+
+    auto [first, second] = terrain.get_start_end_test();
+    auto markers_span_end = time_util::get_time_nanoseconds();
+
+    LOG_INFO(
+        logging::main_logger, "Grass scan: {}ms tile by tile, {}ms by chunk column.",
+        (serial_end - start).count() / 1'000'000,
+        (column_end - serial_end).count() / 1'000'000
+    );
+    LOG_INFO(
+        logging::main_logger, "Marker scan: {}ms tile by tile, {}ms by chunk span.",
+        (markers_serial_end - column_end).count() / 1'000'000,
+        (markers_span_end - markers_serial_end).count() / 1'000'000
+    );
+
+    if (serial_count != column_count) {
+        LOG_ERROR(
+            logging::main_logger, "Grass scans disagree ({} vs {}).", serial_count,
+            column_count
+        );
+        return 1;
+    }
+    if ((serial_markers.size() >= 1 && serial_markers[0] != first)
+        || (serial_markers.size() >= 2 && serial_markers[1] != second)) {
+        LOG_ERROR(logging::main_logger, "Marker scans disagree.");
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+chunk_memory_report(size_t max_size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    for (size_t size = 2; size <= max_size; size *= 2) {
+        World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+        terrain::Terrain& terrain = world.get_terrain_main();
+
+        size_t num_chunks = terrain.num_chunks();
+        size_t num_uniform = 0;
+        size_t num_compressed = 0;
+        for (const auto& chunk : terrain.get_chunks()) {
+            num_uniform += chunk.is_uniform();
+            num_compressed += chunk.is_compressed();
+        }
+        size_t compressed_bytes = terrain.get_tile_memory_usage();
+
+        std::vector<MatColorId> compressed_tiles;
+        compressed_tiles.reserve(
+            static_cast<size_t>(terrain.X_MAX) * terrain.Y_MAX * terrain.Z_MAX
+        );
+        for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+            for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+                for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                    compressed_tiles.push_back(
+                        std::as_const(terrain).get_tile(x, y, z)->get_mat_color_id()
+                    );
+                }
+            }
+        }
+
+        // non const access expands every chunk
+        terrain.for_each_chunk_span([](TerrainOffset3, std::span<terrain::Tile>) {});
+        size_t expanded_bytes = terrain.get_tile_memory_usage();
+
+        size_t index = 0;
+        for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+            for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+                for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                    if (std::as_const(terrain).get_tile(x, y, z)->get_mat_color_id()
+                        != compressed_tiles[index]) {
+                        LOG_ERROR(
+                            logging::main_logger,
+                            "Tile ({}, {}, {}) changed when expanded.", x, y, z
+                        );
+                        return 1;
+                    }
+                    index++;
+                }
+            }
+        }
+
+        terrain.compress_chunks();
+        if (terrain.get_tile_memory_usage() != compressed_bytes) {
+            LOG_ERROR(logging::main_logger, "Compressing again used different memory.");
+            return 1;
+        }
+
+        LOG_INFO(
+            logging::main_logger,
+            "World size {0}x{0}: {1} chunks, {2} compressed, {3} uniform. Tile "
+            "memory {4} KiB compressed, {5} KiB expanded.",
+            size, num_chunks, num_compressed, num_uniform, compressed_bytes / 1024,
+            expanded_bytes / 1024
+        );
+    }
+
+    return 0;
+}
+
+namespace {
+
+// Compare the column height cache to a scan of the column. Returns true when
+// they match.
+bool
+column_height_matches(const terrain::Terrain& terrain, TerrainOffset x, TerrainOffset y) {
+    TerrainOffset solid = 0;
+    TerrainOffset surface = 0;
+    bool found_surface = false;
+    for (TerrainOffset z = terrain.Z_MAX - 1; z >= 0; z--) {
+        const terrain::Tile* tile = terrain.get_tile(x, y, z);
+        if (!found_surface && tile->get_material_id() != AIR_ID) {
+            surface = z;
+            found_surface = true;
+        }
+        if (tile->is_solid()) {
+            solid = z;
+            break;
+        }
+    }
+    if (terrain.get_Z_solid(x, y) != solid || terrain.get_Z_surface(x, y) != surface) {
+        LOG_ERROR(
+            logging::main_logger,
+            "Column ({}, {}): cached solid {} surface {}, scanned solid {} surface {}.",
+            x, y, terrain.get_Z_solid(x, y), terrain.get_Z_surface(x, y), solid,
+            surface
+        );
+        return false;
+    }
+    return true;
+}
+
+// Compare get_first_not to the probe it did before the column cache. Returns
+// true when they match.
+bool
+first_not_matches(
+    const terrain::Terrain& terrain, const terrain::MaterialGroup& materials,
+    TerrainOffset x, TerrainOffset y, TerrainOffset guess
+) {
+    auto in_group = [&](TerrainOffset z) {
+        return terrain.has_tile_material(materials, x, y, z);
+    };
+    TerrainOffset start = std::clamp(guess, TerrainOffset(1), terrain.Z_MAX - 1);
+    TerrainOffset expected = 0;
+    if (in_group(start - 1)) {
+        expected = start;
+        while (expected < terrain.Z_MAX && in_group(expected)) {
+            expected++;
+        }
+    } else {
+        for (TerrainOffset z = start - 2; z > 0; z--) {
+            if (in_group(z)) {
+                expected = z + 1;
+                break;
+            }
+        }
+    }
+    TerrainOffset found = terrain.get_first_not(materials, x, y, guess);
+    if (found != expected) {
+        LOG_ERROR(
+            logging::main_logger, "Column ({}, {}) from {}: first not {}, probe {}.", x,
+            y, guess, found, expected
+        );
+        return false;
+    }
+    return true;
+}
+
+bool
+all_column_heights_match(const terrain::Terrain& terrain) {
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            if (!column_height_matches(terrain, x, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int
+column_height_test() {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+
+    if (!all_column_heights_match(terrain)) {
+        return 1;
+    }
+
+    const terrain::material_t* air = terrain.get_material(AIR_ID);
+    const terrain::material_t* dirt = terrain.get_material(DIRT_ID);
+
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<TerrainOffset> x_distribution(0, terrain.X_MAX - 1);
+    std::uniform_int_distribution<TerrainOffset> y_distribution(0, terrain.Y_MAX - 1);
+    std::uniform_int_distribution<int> edit_distribution(0, 3);
+
+    // get_first_not skips the air above the surface only for groups without air
+    terrain::MaterialGroup without_air(false);
+    without_air.insert(static_cast<MaterialId>(DIRT_ID), true);
+    terrain::MaterialGroup with_air(false);
+    with_air.insert(std::vector<MaterialId>({AIR_ID, DIRT_ID}), true);
+    std::uniform_int_distribution<TerrainOffset> z_distribution(0, terrain.Z_MAX);
+
+    for (size_t edit = 0; edit < 2000; edit++) {
+        TerrainOffset x = x_distribution(rand_engine);
+        TerrainOffset y = y_distribution(rand_engine);
+        TerrainOffset top = terrain.get_Z_solid(x, y);
+        TerrainOffset above = std::min(top + 3, terrain.Z_MAX - 1);
+
+        TerrainOffset guess = z_distribution(rand_engine);
+        if (!first_not_matches(terrain, without_air, x, y, guess)
+            || !first_not_matches(terrain, with_air, x, y, guess)) {
+            return 1;
+        }
+
+        switch (edit_distribution(rand_engine)) {
+            case 0: // dig the top tile
+                terrain.set_tile_material({x, y, top}, air, 0);
+                break;
+            case 1: // build above the top
+                terrain.set_tile_material({x, y, above}, dirt, 0);
+                break;
+            case 2: // dig through the world
+                world.set_tile({x, y, top}, air, 0);
+                break;
+            default: // build through the world
+                world.set_tile({x, y, above}, dirt, 0);
+                break;
+        }
+
+        if (!column_height_matches(terrain, x, y)) {
+            LOG_ERROR(logging::main_logger, "Cache wrong after edit {}.", edit);
+            return 1;
+        }
+    }
+
+    if (!all_column_heights_match(terrain)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// random positions an entity can stand on that are in a node group
+std::vector<TerrainOffset3>
+get_standing_positions(const terrain::Terrain& terrain, size_t count) {
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<TerrainOffset> x_distribution(0, terrain.X_MAX - 1);
+    std::uniform_int_distribution<TerrainOffset> y_distribution(0, terrain.Y_MAX - 1);
+
+    std::vector<TerrainOffset3> out;
+    out.reserve(count);
+    // give up eventually if the terrain has nowhere to stand
+    for (size_t attempt = 0; attempt < count * 100 && out.size() < count; attempt++) {
+        TerrainOffset x = x_distribution(rand_engine);
+        TerrainOffset y = y_distribution(rand_engine);
+        TerrainOffset3 position(x, y, terrain.get_Z_solid(x, y) + 1);
+        if (terrain.can_stand_1(position) && terrain.get_node_group(position)) {
+            out.push_back(position);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+int
+path_query_benchmark(size_t size) {
+    constexpr size_t num_queries = 200;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::vector<TerrainOffset3> positions =
+        get_standing_positions(terrain, num_queries * 2);
+    if (positions.size() < num_queries * 2) {
+        LOG_ERROR(logging::main_logger, "Could not find enough positions to stand.");
+        return 1;
+    }
+
+    auto start = time_util::get_time_nanoseconds();
+    size_t serial_found = 0;
+    for (size_t query = 0; query < num_queries; query++) {
+        if (terrain.get_path_Astar(positions[2 * query], positions[2 * query + 1])) {
+            serial_found++;
+        }
+    }
+    auto serial_end = time_util::get_time_nanoseconds();
+
+    GlobalContext& context = GlobalContext::instance();
+    std::vector<std::future<bool>> futures;
+    futures.reserve(num_queries);
+    for (size_t query = 0; query < num_queries; query++) {
+        futures.push_back(context.submit_task([&terrain, &positions, query]() {
+            return terrain
+                .get_path_Astar(positions[2 * query], positions[2 * query + 1])
+                .has_value();
+        }));
+    }
+    size_t parallel_found = 0;
+    for (auto& future : futures) {
+        parallel_found += future.get();
+    }
+    auto parallel_end = time_util::get_time_nanoseconds();
+
+    double serial_seconds = static_cast<double>((serial_end - start).count()) / 1e9;
+    double parallel_seconds =
+        static_cast<double>((parallel_end - serial_end).count()) / 1e9;
+
+    LOG_INFO(
+        logging::main_logger, "{} path queries, {} found.", num_queries, serial_found
+    );
+    LOG_INFO(
+        logging::main_logger, "Serial: {:.1f} paths/sec. Thread pool: {:.1f} paths/sec.",
+        num_queries / serial_seconds, num_queries / parallel_seconds
+    );
+
+    if (serial_found != parallel_found) {
+        LOG_ERROR(
+            logging::main_logger, "Serial and parallel searches disagree ({} vs {}).",
+            serial_found, parallel_found
+        );
+        return 1;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// does the graph have the same edges as the node groups
+bool
+node_group_graph_matches(const terrain::Terrain& terrain) {
+    const terrain::path::NodeGroupGraph& graph = terrain.get_node_group_graph();
+    size_t num_groups = 0;
+    size_t num_edges = 0;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        for (const terrain::NodeGroup& node_group : chunk.get_node_groups()) {
+            num_groups++;
+            uint32_t id = graph.get_id(&node_group);
+            if (id == terrain::path::NodeGroupGraph::NONE
+                || graph.get_node_group(id) != &node_group) {
+                LOG_ERROR(logging::main_logger, "Node group missing from graph.");
+                return false;
+            }
+            std::unordered_map<const terrain::NodeGroup*, terrain::UnitPath> adjacent =
+                node_group.get_adjacent_map();
+            size_t clear_edges = 0;
+            for (const auto& [adjacent_group, path_type] : adjacent) {
+                if (path_type.compatible(31) && path_type.is_open()) {
+                    clear_edges++;
+                }
+            }
+            size_t graph_edges = 0;
+            bool edges_match = true;
+            graph.for_each_adjacent_clear(id, 31, [&](uint32_t adjacent_id, float) {
+                graph_edges++;
+                if (!adjacent.contains(graph.get_node_group(adjacent_id))) {
+                    edges_match = false;
+                }
+            });
+            if (!edges_match || graph_edges != clear_edges) {
+                LOG_ERROR(logging::main_logger, "Graph edges do not match node group.");
+                return false;
+            }
+            num_edges += adjacent.size();
+        }
+    }
+    if (graph.num_edges() != num_edges) {
+        LOG_ERROR(
+            logging::main_logger, "Graph has {} edges, expected {}.", graph.num_edges(),
+            num_edges
+        );
+        return false;
+    }
+    LOG_INFO(
+        logging::main_logger, "Graph has {} node groups and {} edges.", num_groups,
+        num_edges
+    );
+    return true;
+}
+
+} // namespace
+
+int
+node_group_graph_test() {
+    constexpr size_t num_queries = 50;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+
+    if (!node_group_graph_matches(terrain)) {
+        return 1;
+    }
+
+    std::vector<TerrainOffset3> positions =
+        get_standing_positions(terrain, num_queries * 2);
+    std::vector<bool> found_before;
+    for (size_t query = 0; query + 1 < positions.size(); query += 2) {
+        found_before.push_back(
+            terrain.get_path_Astar(positions[query], positions[query + 1]).has_value()
+        );
+    }
+
+    // rebuilding every chunk should give an equivalent graph
+    std::vector<ChunkPos> all_chunks;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        all_chunks.push_back(chunk.get_chunk_position());
+    }
+    terrain.update_node_group_graph(all_chunks);
+
+    if (!node_group_graph_matches(terrain)) {
+        return 1;
+    }
+
+    for (size_t query = 0; query + 1 < positions.size(); query += 2) {
+        bool found =
+            terrain.get_path_Astar(positions[query], positions[query + 1]).has_value();
+        if (found != found_before[query / 2]) {
+            LOG_ERROR(logging::main_logger, "Path changed after graph update.");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+namespace {
+
+// is there a node group on every tile an entity can stand on, and only there
+bool
+node_groups_cover_standing_tiles(const terrain::Terrain& terrain) {
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                TerrainOffset3 position(x, y, z);
+                const terrain::NodeGroup* node_group = terrain.get_node_group(position);
+                if (terrain.can_stand_1(position) != (node_group != nullptr)) {
+                    LOG_ERROR(
+                        logging::main_logger, "Node group wrong at ({}, {}, {}).", x, y,
+                        z
+                    );
+                    return false;
+                }
+                if (node_group
+                    && node_group->get_chunk_position()
+                           != terrain.get_chunk_from_tile(position)) {
+                    LOG_ERROR(
+                        logging::main_logger, "Node group in wrong chunk at ({}, {}, {}).",
+                        x, y, z
+                    );
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<bool>
+find_paths(
+    const terrain::Terrain& terrain, const std::vector<TerrainOffset3>& positions
+) {
+    std::vector<bool> found;
+    found.reserve(positions.size() / 2);
+    for (size_t query = 0; query + 1 < positions.size(); query += 2) {
+        found.push_back(
+            terrain.get_path_Astar(positions[query], positions[query + 1]).has_value()
+        );
+    }
+    return found;
+}
+
+} // namespace
+
+int
+nodegroup_update_benchmark() {
+    constexpr size_t num_batches = 20;
+    constexpr size_t edits_per_batch = 25;
+    constexpr size_t num_queries = 50;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+
+    const terrain::material_t* air = terrain.get_material(AIR_ID);
+    const terrain::material_t* dirt = terrain.get_material(DIRT_ID);
+
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<TerrainOffset> x_distribution(0, terrain.X_MAX - 1);
+    std::uniform_int_distribution<TerrainOffset> y_distribution(0, terrain.Y_MAX - 1);
+    std::uniform_int_distribution<int> edit_distribution(0, 1);
+
+    std::chrono::nanoseconds update_time(0);
+    size_t chunks_rebuilt = 0;
+    for (size_t batch = 0; batch < num_batches; batch++) {
+        auto start = time_util::get_time_nanoseconds();
+        for (size_t edit = 0; edit < edits_per_batch; edit++) {
+            TerrainOffset x = x_distribution(rand_engine);
+            TerrainOffset y = y_distribution(rand_engine);
+            TerrainOffset top = terrain.get_Z_solid(x, y);
+            if (edit_distribution(rand_engine) == 0) {
+                world.set_tile({x, y, top}, air, 0);
+            } else {
+                world.set_tile({x, y, std::min(top + 1, terrain.Z_MAX - 1)}, dirt, 0);
+            }
+        }
+        chunks_rebuilt += terrain.update_dirty_nodegroups();
+        update_time += time_util::get_time_nanoseconds() - start;
+
+        if (!node_groups_cover_standing_tiles(terrain)
+            || !node_group_graph_matches(terrain)) {
+            LOG_ERROR(logging::main_logger, "Node groups wrong after batch {}.", batch);
+            return 1;
+        }
+
+        // the incremental update should find the same paths as rebuilding
+        // every chunk
+        std::vector<TerrainOffset3> positions =
+            get_standing_positions(terrain, num_queries * 2);
+        std::vector<bool> found = find_paths(terrain, positions);
+
+        for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+            terrain.mark_chunk_nodegroups_dirty(chunk.get_chunk_position());
+        }
+        terrain.update_dirty_nodegroups();
+
+        if (found != find_paths(terrain, positions)) {
+            LOG_ERROR(
+                logging::main_logger, "Paths differ from a full rebuild after batch {}.",
+                batch
+            );
+            return 1;
+        }
+    }
+
+    double seconds = static_cast<double>(update_time.count()) / 1e9;
+    LOG_INFO(
+        logging::main_logger, "{} edits, {} chunks rebuilt: {:.1f} edits/sec.",
+        num_batches * edits_per_batch, chunks_rebuilt,
+        num_batches * edits_per_batch / seconds
+    );
+
+    return 0;
+}
+
+namespace {
+
+// is every step of the path between adjacent node groups
+bool
+is_connected(const std::vector<terrain::NodeGroupWrapper>& path) {
+    for (size_t index = 0; index + 1 < path.size(); index++) {
+        const terrain::NodeGroup* from = path[index].get_node_group();
+        const terrain::NodeGroup* to = path[index + 1].get_node_group();
+        if (!from->get_adjacent_map().contains(to)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int
+route_cache_test() {
+    constexpr size_t num_queries = 50;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+    terrain::path::RouteCache& cache = terrain.get_route_cache();
+
+    std::vector<TerrainOffset3> positions =
+        get_standing_positions(terrain, num_queries * 2);
+
+    std::vector<const terrain::NodeGroup*> groups;
+    for (const TerrainOffset3& position : positions) {
+        groups.push_back(terrain.get_node_group(position));
+    }
+
+    std::vector<std::optional<std::vector<terrain::NodeGroupWrapper>>> first;
+    for (size_t query = 0; query + 1 < groups.size(); query += 2) {
+        first.push_back(terrain.get_path_Astar(groups[query], groups[query + 1]));
+    }
+    size_t found = std::count_if(first.begin(), first.end(), [](const auto& path) {
+        return path.has_value();
+    });
+
+    cache.reset_counters();
+    for (size_t query = 0; query + 1 < groups.size(); query += 2) {
+        auto path = terrain.get_path_Astar(groups[query], groups[query + 1]);
+        if (path.has_value() != first[query / 2].has_value()
+            || (path && path->size() != first[query / 2]->size())) {
+            LOG_ERROR(logging::main_logger, "Cached route differs from search.");
+            return 1;
+        }
+    }
+    if (cache.get_hits() != found) {
+        LOG_ERROR(
+            logging::main_logger, "Expected {} cache hits, got {}.", found,
+            cache.get_hits()
+        );
+        return 1;
+    }
+
+    // edit the world, then every route returned must still be walkable
+    const terrain::material_t* air = terrain.get_material(AIR_ID);
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<TerrainOffset> x_distribution(0, terrain.X_MAX - 1);
+    std::uniform_int_distribution<TerrainOffset> y_distribution(0, terrain.Y_MAX - 1);
+    for (size_t edit = 0; edit < 200; edit++) {
+        TerrainOffset x = x_distribution(rand_engine);
+        TerrainOffset y = y_distribution(rand_engine);
+        world.set_tile({x, y, terrain.get_Z_solid(x, y)}, air, 0);
+    }
+    terrain.update_dirty_nodegroups();
+
+    cache.reset_counters();
+    positions = get_standing_positions(terrain, num_queries * 2);
+    for (size_t query = 0; query + 1 < positions.size(); query += 2) {
+        auto path = terrain.get_path_Astar(
+            terrain.get_node_group(positions[query]),
+            terrain.get_node_group(positions[query + 1])
+        );
+        if (path && !is_connected(path.value())) {
+            LOG_ERROR(logging::main_logger, "Route uses a removed edge.");
+            return 1;
+        }
+    }
+
+    LOG_INFO(
+        logging::main_logger, "After edits: {} hits, {} misses, {} routes cached.",
+        cache.get_hits(), cache.get_misses(), cache.size()
+    );
+
+    return 0;
+}
+
+int
+path_service_test() {
+    constexpr size_t num_queries = 100;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+    const terrain::path::PathService& service = world.get_path_service();
+
+    std::vector<TerrainOffset3> positions =
+        get_standing_positions(terrain, num_queries * 2);
+
+    // every request twice so half of them are duplicates
+    std::vector<terrain::path::PathRequest> requests;
+    for (size_t query = 0; query + 1 < positions.size(); query += 2) {
+        requests.push_back({positions[query], {positions[query + 1]}});
+    }
+    requests.insert(requests.end(), requests.begin(), requests.end());
+
+    auto futures = service.submit(requests);
+    for (size_t index = 0; index < requests.size(); index++) {
+        const terrain::path::PathResult& result = futures[index].get();
+        terrain::path::PathResult expected = service.find_path(requests[index]);
+        if (result.has_value() != expected.has_value()
+            || (result && result->size() != expected->size())) {
+            LOG_ERROR(logging::main_logger, "Request {} differs from search.", index);
+            return 1;
+        }
+    }
+
+    // edit the terrain while callbacks are running
+    std::atomic<size_t> num_results = 0;
+    service.submit(requests, [&num_results](size_t, const terrain::path::PathResult&) {
+        num_results++;
+    });
+
+    const terrain::material_t* air = terrain.get_material(AIR_ID);
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<TerrainOffset> x_distribution(0, terrain.X_MAX - 1);
+    std::uniform_int_distribution<TerrainOffset> y_distribution(0, terrain.Y_MAX - 1);
+    for (size_t edit = 0; edit < 100; edit++) {
+        TerrainOffset x = x_distribution(rand_engine);
+        TerrainOffset y = y_distribution(rand_engine);
+        world.set_tile({x, y, terrain.get_Z_solid(x, y)}, air, 0);
+        if (edit % 10 == 0) {
+            world.update_nodegroups();
+        }
+    }
+    world.update_nodegroups();
+
+    GlobalContext::instance().wait_for_tasks();
+    if (num_results != requests.size()) {
+        LOG_ERROR(
+            logging::main_logger, "Expected {} callbacks, got {}.", requests.size(),
+            num_results.load()
+        );
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+distance_field_test() {
+    constexpr size_t num_goals = 10;
+    constexpr size_t num_queries = 100;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, 2, 2, SEED);
+    terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::vector<TerrainOffset3> positions =
+        get_standing_positions(terrain, num_goals + num_queries);
+    if (positions.size() < num_goals + num_queries) {
+        LOG_ERROR(logging::main_logger, "Could not find enough positions to stand.");
+        return 1;
+    }
+    std::unordered_set<TerrainOffset3> goals(
+        positions.begin(), positions.begin() + num_goals
+    );
+
+    auto start = time_util::get_time_nanoseconds();
+    terrain::path::DistanceField field(terrain, goals);
+    auto build_end = time_util::get_time_nanoseconds();
+
+    // the field should reach the same starts as searching to the goal set,
+    // and its paths should go from a goal back to start
+    size_t reached = 0;
+    for (size_t query = num_goals; query < positions.size(); query++) {
+        TerrainOffset3 position = positions[query];
+        bool searched = terrain.get_path_breadth_first(position, goals).has_value();
+        if (searched && std::isinf(field.get_distance(terrain, position))) {
+            LOG_ERROR(logging::main_logger, "Field does not reach a goal search does.");
+            return 1;
+        }
+        auto path = field.get_path(terrain, position);
+        if (!path) {
+            continue;
+        }
+        reached++;
+        if (!goals.contains(path->front()) || path->back() != position) {
+            LOG_ERROR(logging::main_logger, "Field path does not end at a goal.");
+            return 1;
+        }
+        auto next_tile = field.get_next_tile(position);
+        if (next_tile && field.get_distance(terrain, next_tile.value())
+                             > field.get_distance(terrain, position)) {
+            LOG_ERROR(logging::main_logger, "Next tile is further from the goals.");
+            return 1;
+        }
+    }
+    auto query_end = time_util::get_time_nanoseconds();
+
+    LOG_INFO(
+        logging::main_logger, "Field built in {} us. {} of {} starts reach a goal.",
+        (build_end - start).count() / 1000, reached, num_queries
+    );
+    LOG_INFO(
+        logging::main_logger, "{:.1f} field paths/sec.",
+        num_queries / (static_cast<double>((query_end - build_end).count()) / 1e9)
+    );
+
+    // editing the terrain makes the field out of date
+    if (!field.is_current(terrain)) {
+        LOG_ERROR(logging::main_logger, "New field is out of date.");
+        return 1;
+    }
+    TerrainOffset3 goal = *goals.begin();
+    world.set_tile(goal - TerrainOffset3(0, 0, 1), terrain.get_material(AIR_ID), 0);
+    world.update_nodegroups();
+    if (field.is_current(terrain)) {
+        LOG_ERROR(logging::main_logger, "Field is current after an edit.");
+        return 1;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// total area of the mesh for each normal and color
+std::map<std::tuple<int, int, int, MatColorId>, double>
+get_face_area(const util::Mesh& mesh) {
+    std::map<std::tuple<int, int, int, MatColorId>, double> out;
+    const auto& indices = mesh.get_indices();
+    const auto& vertices = mesh.get_indexed_vertices();
+    for (size_t index = 0; index + 2 < indices.size(); index += 3) {
+        glm::vec3 a = vertices[indices[index]];
+        glm::vec3 b = vertices[indices[index + 1]];
+        glm::vec3 c = vertices[indices[index + 2]];
+        glm::i8vec3 normal = mesh.get_indexed_normals()[indices[index]];
+        MatColorId color = mesh.get_indexed_color_ids()[indices[index]];
+        out[{normal.x, normal.y, normal.z, color}] +=
+            glm::length(glm::cross(b - a, c - a)) / 2.0;
+    }
+    return out;
+}
+
+} // namespace
+
+int
+meshing_benchmark(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    struct ModeTotals {
+        size_t triangles = 0;
+        size_t vertices = 0;
+        std::chrono::nanoseconds time{0};
+    };
+
+    ModeTotals faces;
+    ModeTotals greedy;
+    size_t num_chunks = 0;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        terrain::ChunkData chunk_data(chunk);
+
+        auto start = time_util::get_time_nanoseconds();
+        util::Mesh faces_mesh = util::ambient_occlusion_mesher(chunk_data);
+        auto faces_end = time_util::get_time_nanoseconds();
+        util::Mesh greedy_mesh =
+            util::ambient_occlusion_mesher(chunk_data, util::MeshMode::GREEDY);
+        auto greedy_end = time_util::get_time_nanoseconds();
+
+        faces.triangles += faces_mesh.get_indices().size() / 3;
+        faces.vertices += faces_mesh.get_indexed_vertices().size();
+        faces.time += faces_end - start;
+        greedy.triangles += greedy_mesh.get_indices().size() / 3;
+        greedy.vertices += greedy_mesh.get_indexed_vertices().size();
+        greedy.time += greedy_end - faces_end;
+        num_chunks++;
+
+        // both meshes should cover the same surface with the same colors
+        auto faces_area = get_face_area(faces_mesh);
+        auto greedy_area = get_face_area(greedy_mesh);
+        if (faces_area.size() != greedy_area.size()) {
+            LOG_ERROR(logging::main_logger, "Greedy mesh has different faces.");
+            return 1;
+        }
+        for (const auto& [key, area] : faces_area) {
+            auto greedy_face = greedy_area.find(key);
+            if (greedy_face == greedy_area.end()
+                || std::abs(greedy_face->second - area) > 1e-3) {
+                LOG_ERROR(logging::main_logger, "Greedy mesh has different area.");
+                return 1;
+            }
+        }
+    }
+    if (num_chunks == 0) {
+        return 1;
+    }
+
+    for (const auto& [name, totals] :
+         {std::pair{"Faces", faces}, std::pair{"Greedy", greedy}}) {
+        LOG_INFO(
+            logging::main_logger,
+            "{}: {:.1f} triangles, {:.1f} vertices, {:.1f} us per chunk.", name,
+            static_cast<double>(totals.triangles) / num_chunks,
+            static_cast<double>(totals.vertices) / num_chunks,
+            static_cast<double>(totals.time.count()) / 1000 / num_chunks
+        );
+    }
+
+    return 0;
+}
+
+namespace {
+
+// true if both meshes have the same vertices in the same order
+bool
+same_mesh(const util::Mesh& mesh_a, const util::Mesh& mesh_b) {
+    return mesh_a.get_indices() == mesh_b.get_indices()
+           && mesh_a.get_indexed_vertices() == mesh_b.get_indexed_vertices()
+           && mesh_a.get_indexed_color_ids() == mesh_b.get_indexed_color_ids()
+           && mesh_a.get_indexed_normals() == mesh_b.get_indexed_normals();
+}
+
+// Meshes voxel_object the way it was done before vertices were indexed per
+// slice. Each face is copied to a new vector and vertices are found with a
+// hash map. Used as a baseline.
+template <voxel_utility::VoxelLike T>
+util::Mesh
+hashed_ambient_occlusion_mesher(const T& voxel_object) {
+    std::vector<uint16_t> indices;
+    std::vector<VoxelOffset> indexed_vertices;
+    std::vector<MatColorId> indexed_colors;
+    std::vector<glm::i8vec3> indexed_normals;
+
+    VoxelOffset size = voxel_object.get_size();
+    VoxelOffset offset = voxel_object.get_offset();
+
+    std::unordered_map<util::Vertex, uint16_t> vertex_ids;
+    std::array<util::Vertex, 4> corners;
+
+    for (size_t dim_major_index = 0; dim_major_index < 3; dim_major_index++) {
+        size_t dim_minor_index_1 = (dim_major_index + 1) % 3;
+        size_t dim_minor_index_2 = (dim_major_index + 2) % 3;
+
+        VoxelOffset major_direction({0, 0, 0});
+        major_direction[dim_major_index] = 1;
+        VoxelOffset minor_direction_1({0, 0, 0});
+        minor_direction_1[dim_minor_index_1] = 1;
+        VoxelOffset minor_direction_2({0, 0, 0});
+        minor_direction_2[dim_minor_index_2] = 1;
+
+        for (VoxelDim major_index = -1; major_index < size[dim_major_index];
+             major_index++) {
+            for (VoxelDim minor_index_1 = 0; minor_index_1 < size[dim_minor_index_1];
+                 minor_index_1++) {
+                for (VoxelDim minor_index_2 = 0;
+                     minor_index_2 < size[dim_minor_index_2]; minor_index_2++) {
+                    VoxelOffset position;
+                    position[dim_major_index] = major_index;
+                    position[dim_minor_index_1] = minor_index_1;
+                    position[dim_minor_index_2] = minor_index_2;
+
+                    if (!util::analyze_voxel_interface(
+                            voxel_object, position, major_direction, minor_direction_1,
+                            minor_direction_2, corners
+                        )) {
+                        continue;
+                    }
+                    std::vector<util::Vertex> face(corners.begin(), corners.end());
+
+                    uint16_t corner_indicies[4];
+                    for (size_t i = 0; i < 4; i++) {
+                        auto [index_itr, inserted] = vertex_ids.try_emplace(
+                            face[i], static_cast<uint16_t>(indexed_vertices.size())
+                        );
+                        if (inserted) {
+                            indexed_vertices.push_back(face[i].position + offset);
+                            indexed_colors.push_back(face[i].mat_color_id);
+                            indexed_normals.push_back(face[i].normal);
+                        }
+                        corner_indicies[i] = index_itr->second;
+                    }
+                    for (size_t i : {2, 1, 0, 2, 3, 1}) {
+                        indices.push_back(corner_indicies[i]);
+                    }
+                }
+            }
+        }
+    }
+    return util::Mesh(
+        indices, indexed_vertices, indexed_colors, indexed_normals,
+        voxel_object.get_color_ids(), size, offset
+    );
+}
+
+} // namespace
+
+int
+mesh_dedupe_benchmark(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::vector<terrain::ChunkData> chunk_data;
+    chunk_data.reserve(terrain.num_chunks());
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        chunk_data.emplace_back(chunk);
+    }
+    if (chunk_data.empty()) {
+        return 1;
+    }
+
+    // both meshers should give the same mesh
+    for (const terrain::ChunkData& data : chunk_data) {
+        util::Mesh slice_mesh = util::ambient_occlusion_mesher(data);
+        util::Mesh hashed_mesh = hashed_ambient_occlusion_mesher(data);
+        if (!same_mesh(slice_mesh, hashed_mesh)) {
+            LOG_ERROR(logging::main_logger, "Slice indexed mesh is different.");
+            return 1;
+        }
+    }
+
+    // number of indices is summed so the meshing can not be optimized away
+    size_t hashed_indices = 0;
+    size_t num_indices = 0;
+    auto start = time_util::get_time_nanoseconds();
+    for (const terrain::ChunkData& data : chunk_data) {
+        hashed_indices += hashed_ambient_occlusion_mesher(data).get_indices().size();
+    }
+    auto hashed_end = time_util::get_time_nanoseconds();
+    for (const terrain::ChunkData& data : chunk_data) {
+        num_indices += util::ambient_occlusion_mesher(data).get_indices().size();
+    }
+    auto slice_end = time_util::get_time_nanoseconds();
+
+    auto chunks_per_second = [&](std::chrono::nanoseconds time) {
+        return static_cast<double>(chunk_data.size()) * 1e9
+               / static_cast<double>(std::max<int64_t>(time.count(), 1));
+    };
+    LOG_INFO(
+        logging::main_logger, "Meshed {} chunks ({} indices).", chunk_data.size(),
+        num_indices
+    );
+    if (hashed_indices != num_indices) {
+        return 1;
+    }
+    LOG_INFO(
+        logging::main_logger,
+        "Hash map: {:.1f} chunks per second, slice index: {:.1f} chunks per second.",
+        chunks_per_second(hashed_end - start), chunks_per_second(slice_end - hashed_end)
+    );
+
+    return 0;
+}
+
+namespace {
+
+// ChunkData without the solid masks, so the mesher looks up both voxels of
+// every interface. Used as a baseline.
+class UnmaskedChunkData : public voxel_utility::VoxelBase {
+    const terrain::ChunkData& data_;
+
+ public:
+    explicit UnmaskedChunkData(const terrain::ChunkData& data) : data_(data) {}
+
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelDim x, VoxelDim y, VoxelDim z) const {
+        return data_.get_voxel_color_id(x, y, z);
+    }
+
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelOffset position) const {
+        return data_.get_voxel_color_id(position);
+    }
+
+    [[nodiscard]] inline VoxelSize
+    get_size() const {
+        return data_.get_size();
+    }
+
+    [[nodiscard]] inline VoxelOffset
+    get_offset() const {
+        return data_.get_offset();
+    }
+
+    [[nodiscard]] inline const std::vector<ColorInt>&
+    get_color_ids() const {
+        return data_.get_color_ids();
+    }
+};
+
+} // namespace
+
+int
+face_mask_test(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    // the avx2 and scalar kernels should agree
+    std::default_random_engine rand_engine(SEED);
+    std::uniform_int_distribution<uint32_t> mask_distribution;
+    std::vector<uint32_t> below(37);
+    std::vector<uint32_t> above(37);
+    for (size_t i = 0; i < below.size(); i++) {
+        below[i] = mask_distribution(rand_engine);
+        above[i] = mask_distribution(rand_engine);
+    }
+    std::vector<uint32_t> scalar_positive(37);
+    std::vector<uint32_t> scalar_negative(37);
+    std::vector<uint32_t> simd_positive(37);
+    std::vector<uint32_t> simd_negative(37);
+    bits::exposed_faces_scalar(
+        below.data(), above.data(), scalar_positive.data(), scalar_negative.data(),
+        below.size(), 1, 0xffff
+    );
+    bits::exposed_faces_avx2(
+        below.data(), above.data(), simd_positive.data(), simd_negative.data(),
+        below.size(), 1, 0xffff
+    );
+    if (scalar_positive != simd_positive || scalar_negative != simd_negative) {
+        LOG_ERROR(logging::main_logger, "AVX2 faces are different.");
+        return 1;
+    }
+
+    std::vector<terrain::ChunkData> chunk_data;
+    chunk_data.reserve(terrain.num_chunks());
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        chunk_data.emplace_back(chunk);
+    }
+    if (chunk_data.empty()) {
+        return 1;
+    }
+
+    // masks should give the same mesh as looking up every voxel
+    for (const terrain::ChunkData& data : chunk_data) {
+        UnmaskedChunkData unmasked(data);
+        for (auto mode : {util::MeshMode::FACES, util::MeshMode::GREEDY}) {
+            if (!same_mesh(
+                    util::ambient_occlusion_mesher(data, mode),
+                    util::ambient_occlusion_mesher(unmasked, mode)
+                )) {
+                LOG_ERROR(logging::main_logger, "Mesh from solid masks is different.");
+                return 1;
+            }
+        }
+    }
+
+    size_t unmasked_indices = 0;
+    size_t num_indices = 0;
+    auto start = time_util::get_time_nanoseconds();
+    for (const terrain::ChunkData& data : chunk_data) {
+        UnmaskedChunkData unmasked(data);
+        unmasked_indices += util::ambient_occlusion_mesher(unmasked).get_indices().size();
+    }
+    auto unmasked_end = time_util::get_time_nanoseconds();
+    for (const terrain::ChunkData& data : chunk_data) {
+        num_indices += util::ambient_occlusion_mesher(data).get_indices().size();
+    }
+    auto masked_end = time_util::get_time_nanoseconds();
+    if (unmasked_indices != num_indices) {
+        return 1;
+    }
+
+    auto chunks_per_second = [&](std::chrono::nanoseconds time) {
+        return static_cast<double>(chunk_data.size()) * 1e9
+               / static_cast<double>(std::max<int64_t>(time.count(), 1));
+    };
+    LOG_INFO(
+        logging::main_logger, "Meshed {} chunks, AVX2 {}.", chunk_data.size(),
+        bits::has_avx2() ? "enabled" : "disabled"
+    );
+    LOG_INFO(
+        logging::main_logger,
+        "Voxel lookup: {:.1f} chunks per second, solid masks: {:.1f} chunks per "
+        "second.",
+        chunks_per_second(unmasked_end - start),
+        chunks_per_second(masked_end - unmasked_end)
+    );
+
+    return 0;
+}
+
+int
+packed_mesh_test(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    size_t num_chunks = 0;
+    size_t unpacked_bytes = 0;
+    size_t packed_bytes = 0;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        terrain::ChunkData chunk_data(chunk);
+        util::Mesh mesh = util::ambient_occlusion_mesher(chunk_data);
+        util::PackedMesh packed_mesh = util::packed_ambient_occlusion_mesher(chunk_data);
+
+        // same vertices, but relative to the chunk
+        const auto& packed_vertices = packed_mesh.get_packed_vertices();
+        if (packed_mesh.get_indices() != mesh.get_indices()
+            || packed_vertices.size() != mesh.get_indexed_vertices().size()) {
+            LOG_ERROR(logging::main_logger, "Packed mesh has different vertices.");
+            return 1;
+        }
+        for (size_t i = 0; i < packed_vertices.size(); i++) {
+            const util::PackedVertex& vertex = packed_vertices[i];
+            if (util::packed_vertex::get_position(vertex) + packed_mesh.get_center()
+                    != mesh.get_indexed_vertices()[i]
+                || util::packed_vertex::get_normal(vertex)
+                       != mesh.get_indexed_normals()[i]
+                || util::packed_vertex::get_color_id(vertex)
+                       != mesh.get_indexed_color_ids()[i]) {
+                LOG_ERROR(logging::main_logger, "Packed vertex {} is different.", i);
+                return 1;
+            }
+        }
+
+        // what each mesh sends to the gpu
+        unpacked_bytes += mesh.get_indices().size() * sizeof(uint16_t)
+                          + mesh.get_indexed_vertices().size()
+                                * (sizeof(glm::ivec3) + sizeof(MatColorId)
+                                   + sizeof(glm::i8vec3));
+        packed_bytes += packed_mesh.get_data_size() + sizeof(glm::ivec4);
+        num_chunks++;
+    }
+    if (num_chunks == 0) {
+        return 1;
+    }
+
+    LOG_INFO(
+        logging::main_logger,
+        "Bytes per chunk: {:.1f} unpacked, {:.1f} packed ({:.1f}%).",
+        static_cast<double>(unpacked_bytes) / num_chunks,
+        static_cast<double>(packed_bytes) / num_chunks,
+        100.0 * static_cast<double>(packed_bytes) / unpacked_bytes
+    );
+
+    return 0;
+}
+
+namespace {
+
+// mesh of n vertices and n indices, 10 * n bytes
+util::PackedMesh
+make_test_mesh(size_t n) {
+    return util::PackedMesh(
+        std::vector<uint16_t>(n), std::vector<util::PackedVertex>(n), {16, 16, 16},
+        {0, 0, 0}
+    );
+}
+
+} // namespace
+
+int
+remesh_scheduler_test() {
+    RemeshScheduler scheduler(2, 250);
+    ChunkPos near(0, 0, 0);
+    ChunkPos far(6, 0, 0);
+    ChunkPos behind(-2, 0, 0);
+    glm::vec3 camera(8.0f, 8.0f, 8.0f);
+    glm::vec3 view_direction(1.0f, 0.0f, 0.0f);
+
+    // repeated edits are one job
+    scheduler.mark(far);
+    scheduler.mark(behind);
+    scheduler.mark(far);
+    scheduler.mark(near);
+    if (scheduler.get_metrics().queued != 3 || scheduler.get_generation(far) != 2) {
+        LOG_ERROR(logging::main_logger, "Marks are not coalesced.");
+        return 1;
+    }
+
+    // in front of the camera first, then by distance, at most two at once
+    std::vector<RemeshScheduler::Job> jobs =
+        scheduler.take_jobs(camera, view_direction);
+    if (jobs.size() != 2 || jobs[0].chunk_position != near
+        || jobs[1].chunk_position != far
+        || !scheduler.take_jobs(camera, view_direction).empty()) {
+        LOG_ERROR(logging::main_logger, "Jobs are in the wrong order.");
+        return 1;
+    }
+
+    // far changes while its job runs, so its mesh is dropped
+    scheduler.mark(far);
+    if (scheduler.is_current(jobs[1]) || !scheduler.is_current(jobs[0])) {
+        LOG_ERROR(logging::main_logger, "Superseded job is current.");
+        return 1;
+    }
+    scheduler.complete(jobs[0], make_test_mesh(20));
+    scheduler.complete(jobs[1], make_test_mesh(20));
+    RemeshScheduler::Metrics metrics = scheduler.get_metrics();
+    if (metrics.ready != 1 || metrics.superseded != 1 || metrics.in_flight != 0
+        || metrics.queued != 2) {
+        LOG_ERROR(logging::main_logger, "Superseded job was kept.");
+        return 1;
+    }
+
+    // a job that has not started when its chunk changes is skipped
+    jobs = scheduler.take_jobs(camera, view_direction);
+    if (jobs.size() != 2 || jobs[0].chunk_position != far) {
+        LOG_ERROR(logging::main_logger, "Jobs are in the wrong order.");
+        return 1;
+    }
+    scheduler.mark(behind);
+    if (scheduler.is_current(jobs[1])) {
+        LOG_ERROR(logging::main_logger, "Superseded job is current.");
+        return 1;
+    }
+    scheduler.cancel(jobs[1]);
+    scheduler.complete(jobs[0], make_test_mesh(20));
+    jobs = scheduler.take_jobs(camera, view_direction);
+    if (jobs.size() != 1 || jobs[0].chunk_position != behind) {
+        LOG_ERROR(logging::main_logger, "Skipped job was not queued again.");
+        return 1;
+    }
+    scheduler.complete(jobs[0], make_test_mesh(20));
+
+    // 200 bytes each, so one mesh fits in each frame
+    std::vector<ChunkPos> uploaded;
+    auto upload = [&uploaded](ChunkPos chunk_position, const util::PackedMesh&) {
+        uploaded.push_back(chunk_position);
+    };
+    size_t frames = 0;
+    while (scheduler.get_metrics().ready > 0) {
+        size_t bytes = scheduler.take_uploads(upload);
+        if (bytes > 250) {
+            LOG_ERROR(logging::main_logger, "Upload budget exceeded.");
+            return 1;
+        }
+        frames++;
+    }
+    // oldest changes first, far was marked first and has not been uploaded
+    if (frames != 3 || uploaded != std::vector<ChunkPos>{far, behind, near}) {
+        LOG_ERROR(logging::main_logger, "Uploads are wrong.");
+        return 1;
+    }
+
+    // a mesh larger than the budget is still uploaded
+    scheduler.store(near, make_test_mesh(100));
+    if (scheduler.take_uploads(upload) != 1000) {
+        LOG_ERROR(logging::main_logger, "Large mesh is never uploaded.");
+        return 1;
+    }
+
+    metrics = scheduler.get_metrics();
+    LOG_INFO(
+        logging::main_logger,
+        "Queued {}, in flight {}, ready {}, superseded {}, uploaded {}. Latency "
+        "{:.3f} ms mean, {:.3f} ms max.",
+        metrics.queued, metrics.in_flight, metrics.ready, metrics.superseded,
+        metrics.uploaded, metrics.mean_latency_ms, metrics.max_latency_ms
+    );
+    if (metrics.uploaded != 4 || metrics.superseded != 2 || metrics.queued != 0) {
+        LOG_ERROR(logging::main_logger, "Metrics are wrong.");
+        return 1;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// true if no two ranges overlap, and the allocator agrees on their sizes
+bool
+ranges_are_valid(
+    const util::RangeAllocator& allocator,
+    std::vector<util::RangeAllocator::Range> ranges
+) {
+    std::erase_if(ranges, [](const auto& range) { return range.size == 0; });
+    std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+        return a.offset < b.offset;
+    });
+    size_t used = 0;
+    size_t end = 0;
+    for (const util::RangeAllocator::Range& range : ranges) {
+        if (range.offset < end || !allocator.is_allocated(range)) {
+            return false;
+        }
+        end = range.offset + range.size;
+        used += range.size;
+    }
+    return end <= allocator.get_capacity() && used == allocator.get_used()
+           && ranges.size() == allocator.get_num_allocated();
+}
+
+} // namespace
+
+int
+range_allocator_test() {
+    using Range = util::RangeAllocator::Range;
+    util::RangeAllocator allocator(100);
+
+    Range a = *allocator.allocate(10);
+    Range b = *allocator.allocate(20);
+    Range c = *allocator.allocate(30);
+    if (a != Range{0, 10} || b != Range{10, 20} || c != Range{30, 30}
+        || allocator.get_used() != 60) {
+        LOG_ERROR(logging::main_logger, "Ranges are not given out in order.");
+        return 1;
+    }
+
+    // the smallest free range that fits is used
+    allocator.free(b);
+    Range d = *allocator.allocate(15);
+    if (d != Range{10, 15} || allocator.get_num_free_ranges() != 2) {
+        LOG_ERROR(logging::main_logger, "Allocation is not best fit.");
+        return 1;
+    }
+
+    // a range that shrinks a little stays, one that shrinks a lot is split
+    if (*allocator.reallocate(d, 10) != d) {
+        LOG_ERROR(logging::main_logger, "Range moved when it still fits.");
+        return 1;
+    }
+    d = *allocator.reallocate(d, 5);
+    if (d != Range{10, 5} || allocator.get_largest_free() != 40) {
+        LOG_ERROR(logging::main_logger, "Range did not shrink.");
+        return 1;
+    }
+
+    // a range grows into the free range after it
+    d = *allocator.reallocate(d, 18);
+    if (d != Range{10, 18} || allocator.get_num_free_ranges() != 2) {
+        LOG_ERROR(logging::main_logger, "Range did not grow in place.");
+        return 1;
+    }
+
+    // a range that can not grow in place moves
+    a = *allocator.reallocate(a, 25);
+    if (a != Range{60, 25} || !ranges_are_valid(allocator, {a, c, d})) {
+        LOG_ERROR(logging::main_logger, "Range did not move.");
+        return 1;
+    }
+
+    // with no free range large enough the range is freed, and the buffer grows
+    if (allocator.reallocate(c, 40)) {
+        LOG_ERROR(logging::main_logger, "Range larger than free space.");
+        return 1;
+    }
+    allocator.grow(130);
+    c = *allocator.allocate(40);
+    if (!ranges_are_valid(allocator, {a, c, d}) || allocator.get_capacity() != 130) {
+        LOG_ERROR(logging::main_logger, "Buffer did not grow.");
+        return 1;
+    }
+
+    // compaction keeps the order, and leaves one free range
+    if (allocator.get_fragmentation() == 0.0f) {
+        LOG_ERROR(logging::main_logger, "Free space is not fragmented.");
+        return 1;
+    }
+    std::vector<util::RangeAllocator::Move> moves = allocator.compact();
+    std::vector<Range> ranges = {a, c, d};
+    for (Range& range : ranges) {
+        auto move = std::find_if(moves.begin(), moves.end(), [&range](const auto& m) {
+            return m.from == range.offset;
+        });
+        if (move == moves.end() || move->size != range.size) {
+            LOG_ERROR(logging::main_logger, "Range has no move.");
+            return 1;
+        }
+        range.offset = move->to;
+    }
+    if (moves.size() != 3 || moves[0].to != 0 || !ranges_are_valid(allocator, ranges)
+        || allocator.get_num_free_ranges() != 1
+        || allocator.get_fragmentation() != 0.0f
+        || allocator.get_largest_free() != 130 - allocator.get_used()) {
+        LOG_ERROR(logging::main_logger, "Compaction is wrong.");
+        return 1;
+    }
+
+    // freeing everything leaves one free range
+    for (const Range& range : ranges) {
+        allocator.free(range);
+    }
+    if (allocator.get_num_free_ranges() != 1 || allocator.get_largest_free() != 130) {
+        LOG_ERROR(logging::main_logger, "Free ranges are not merged.");
+        return 1;
+    }
+
+    // random allocations, frees, and resizes
+    std::mt19937 generator(SEED);
+    std::uniform_int_distribution<size_t> size_distribution(0, 64);
+    std::uniform_int_distribution<int> action_distribution(0, 2);
+    ranges.clear();
+    for (size_t step = 0; step < 10000; step++) {
+        int action = action_distribution(generator);
+        size_t size = size_distribution(generator);
+        if (action == 0 || ranges.empty()) {
+            std::optional<Range> range = allocator.allocate(size);
+            if (!range) {
+                allocator.grow(allocator.get_capacity() * 2 + size);
+                range = allocator.allocate(size);
+            }
+            ranges.push_back(*range);
+        } else {
+            size_t index = generator() % ranges.size();
+            if (action == 1) {
+                allocator.free(ranges[index]);
+                ranges[index] = ranges.back();
+                ranges.pop_back();
+            } else {
+                std::optional<Range> range = allocator.reallocate(ranges[index], size);
+                if (!range) {
+                    allocator.grow(allocator.get_capacity() * 2 + size);
+                    range = allocator.allocate(size);
+                }
+                ranges[index] = *range;
+            }
+        }
+        if (step % 1000 == 0) {
+            moves = allocator.compact();
+            for (Range& range : ranges) {
+                if (range.size > 0) {
+                    auto move = std::find_if(
+                        moves.begin(), moves.end(),
+                        [&range](const auto& m) { return m.from == range.offset; }
+                    );
+                    range.offset = move->to;
+                }
+            }
+        }
+        if (!ranges_are_valid(allocator, ranges)) {
+            LOG_ERROR(logging::main_logger, "Ranges overlap after step {}.", step);
+            return 1;
+        }
+    }
+
+    LOG_INFO(
+        logging::main_logger,
+        "{} ranges, {} of {} elements used, {} free ranges, fragmentation {:.3f}.",
+        allocator.get_num_allocated(), allocator.get_used(), allocator.get_capacity(),
+        allocator.get_num_free_ranges(), allocator.get_fragmentation()
+    );
+
+    return 0;
+}
+
+int
+mesh_allocation_benchmark(size_t size) {
+    constexpr size_t WARMUP_CYCLES = 2;
+    constexpr size_t MEASURED_CYCLES = 4;
+
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    terrain::TerrainColorMapping::assign_color_mapping(world.get_materials());
+
+    std::vector<ChunkPos> chunk_positions;
+    for (const terrain::Chunk& chunk : world.get_terrain_main().get_chunks()) {
+        chunk_positions.push_back(chunk.get_chunk_position());
+    }
+    if (chunk_positions.empty()) {
+        return 1;
+    }
+    size_t measured_chunks = MEASURED_CYCLES * chunk_positions.size();
+
+    // remesh every chunk on this thread
+    for (size_t cycle = 0; cycle < WARMUP_CYCLES; cycle++) {
+        for (ChunkPos chunk_pos : chunk_positions) {
+            world.update_single_mesh(chunk_pos);
+        }
+    }
+    // only the vectors of the mesh pool are counted
+    size_t serial_allocations = util::PackedMeshPool::get_allocations();
+    auto serial_start = time_util::get_time_nanoseconds();
+    for (size_t cycle = 0; cycle < MEASURED_CYCLES; cycle++) {
+        for (ChunkPos chunk_pos : chunk_positions) {
+            world.update_single_mesh(chunk_pos);
+        }
+    }
+    auto serial_end = time_util::get_time_nanoseconds();
+    serial_allocations = util::PackedMeshPool::get_allocations() - serial_allocations;
+
+    // remesh every chunk the way the game does, on the thread pool
+    GlobalContext& context = GlobalContext::instance();
+    auto remesh_all = [&]() {
+        for (ChunkPos chunk_pos : chunk_positions) {
+            world.mark_chunk_for_update(chunk_pos);
+        }
+        // the number of jobs started at once is limited
+        while (world.get_remesh_metrics().queued > 0) {
+            world.update_marked_chunks_mesh();
+            context.wait_for_tasks();
+        }
+    };
+    for (size_t cycle = 0; cycle < WARMUP_CYCLES; cycle++) {
+        remesh_all();
+    }
+    size_t parallel_allocations = util::PackedMeshPool::get_allocations();
+    auto parallel_start = time_util::get_time_nanoseconds();
+    for (size_t cycle = 0; cycle < MEASURED_CYCLES; cycle++) {
+        remesh_all();
+    }
+    auto parallel_end = time_util::get_time_nanoseconds();
+    parallel_allocations =
+        util::PackedMeshPool::get_allocations() - parallel_allocations;
+
+    LOG_INFO(
+        logging::main_logger,
+        "Serial remeshing: {} pool allocations over {} chunks, {:.1f} us per chunk.",
+        serial_allocations, measured_chunks,
+        static_cast<double>((serial_end - serial_start).count()) / 1000.0
+            / measured_chunks
+    );
+    // each thread of the pool warms its own mesh pool
+    LOG_INFO(
+        logging::main_logger,
+        "update_marked_chunks_mesh: {:.2f} pool allocations per chunk, {:.1f} us "
+        "per chunk.",
+        static_cast<double>(parallel_allocations) / measured_chunks,
+        static_cast<double>((parallel_end - parallel_start).count()) / 1000.0
+            / measured_chunks
+    );
+
+    if (serial_allocations != 0) {
+        LOG_ERROR(logging::main_logger, "Steady state remeshing allocated.");
+        return 1;
+    }
+    return 0;
+}
+
+int
+lod_mesh_test(size_t size) {
+    // majority vote, ties go to the smaller id, half solid is solid
+    std::array<MatColorId, 8> block_a = {0, 0, 2, 2, 0, 1, 0, 1};
+    std::array<MatColorId, 8> block_b = {0, 0, 0, 1, 0, 1, 0, 1};
+    if (terrain::ChunkLodData::majority_vote(block_a) != 1
+        || terrain::ChunkLodData::majority_vote(block_b) != AIR_MAT_COLOR_ID) {
+        LOG_ERROR(logging::main_logger, "Majority vote is wrong.");
+        return 1;
+    }
+
+    // level selection with hysteresis
+    TerrainOffset3 grid_size(8, 8, 2);
+    terrain::LodSelector selector(grid_size, {32.0f, 64.0f}, 4.0f);
+    if (selector.select_level(0, 35.0f) != 0 || selector.select_level(0, 37.0f) != 1
+        || selector.select_level(1, 29.0f) != 1 || selector.select_level(1, 27.0f) != 0
+        || selector.select_level(0, 100.0f) != 2
+        || selector.select_level(2, 0.0f) != 0) {
+        LOG_ERROR(logging::main_logger, "Level of detail selection is wrong.");
+        return 1;
+    }
+    glm::vec3 camera(10.0f, 10.0f, 20.0f);
+    if (selector.update(camera).empty()) {
+        LOG_ERROR(logging::main_logger, "No chunk changed level of detail.");
+        return 1;
+    }
+    // after moving less than the hysteresis once, moving back and forth does
+    // not change anything
+    (void)selector.update(camera + glm::vec3(1.0f, 0.0f, 0.0f));
+    if (!selector.update(camera).empty()
+        || !selector.update(camera + glm::vec3(1.0f, 0.0f, 0.0f)).empty()) {
+        LOG_ERROR(logging::main_logger, "Level of detail changes back and forth.");
+        return 1;
+    }
+    for (TerrainOffset x = 0; x < grid_size.x; x++) {
+        for (TerrainOffset y = 0; y < grid_size.y; y++) {
+            for (TerrainOffset z = 0; z < grid_size.z; z++) {
+                ChunkPos chunk_position(x, y, z);
+                terrain::ChunkLod lod = selector.get_lod(chunk_position);
+                for (size_t axis = 0; axis < 3; axis++) {
+                    for (bool above : {false, true}) {
+                        ChunkPos neighbor = chunk_position;
+                        neighbor[axis] += above ? 1 : -1;
+                        bool different =
+                            neighbor[axis] >= 0 && neighbor[axis] < grid_size[axis]
+                            && selector.get_lod(neighbor).level != lod.level;
+                        if (lod.has_seam(axis, above) != different) {
+                            LOG_ERROR(
+                                logging::main_logger,
+                                "Wrong seam on chunk ({}, {}, {}).", x, y, z
+                            );
+                            return 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    auto levels = selector.count_levels();
+    LOG_INFO(
+        logging::main_logger, "Chunks at each level: {}, {}, {}.", levels[0], levels[1],
+        levels[2]
+    );
+
+    // meshes
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::array<size_t, terrain::LodSelector::NUM_LEVELS> triangles{};
+    std::array<std::chrono::nanoseconds, terrain::LodSelector::NUM_LEVELS> times{};
+    size_t num_chunks = 0;
+    size_t sealed_chunks = 0;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        util::PackedMesh full_mesh =
+            util::packed_ambient_occlusion_mesher(terrain::ChunkData(chunk));
+        util::PackedMesh level_0_mesh = util::packed_ambient_occlusion_mesher(
+            terrain::ChunkLodData(chunk, terrain::ChunkLod())
+        );
+        if (level_0_mesh.get_indices() != full_mesh.get_indices()
+            || level_0_mesh.get_packed_vertices() != full_mesh.get_packed_vertices()) {
+            LOG_ERROR(logging::main_logger, "Level 0 mesh is not the full mesh.");
+            return 1;
+        }
+
+        for (uint8_t level = 0; level < terrain::LodSelector::NUM_LEVELS; level++) {
+            terrain::ChunkLod lod{level, 0};
+            auto start = time_util::get_time_nanoseconds();
+            terrain::ChunkLodData lod_data(chunk, lod);
+            util::PackedMesh mesh = util::packed_ambient_occlusion_mesher(lod_data);
+            times[level] += time_util::get_time_nanoseconds() - start;
+            triangles[level] += mesh.get_indices().size() / 3;
+
+            if (mesh.get_scale() != lod.get_scale()
+                || mesh.get_center() != chunk.get_offset()) {
+                LOG_ERROR(logging::main_logger, "Level {} mesh is misplaced.", level);
+                return 1;
+            }
+
+            // With every seam a chunk that is all solid is a closed box.
+            VoxelDim cells = lod_data.get_size().x;
+            bool all_solid = true;
+            for (VoxelDim x = 0; x < cells; x++) {
+                for (VoxelDim y = 0; y < cells; y++) {
+                    for (VoxelDim z = 0; z < cells; z++) {
+                        all_solid &=
+                            lod_data.get_voxel_color_id(x, y, z) != AIR_MAT_COLOR_ID;
+                    }
+                }
+            }
+            if (all_solid) {
+                util::PackedMesh sealed = util::packed_ambient_occlusion_mesher(
+                    terrain::ChunkLodData(chunk, {level, 0b111111})
+                );
+                if (sealed.get_indices().size()
+                    != static_cast<size_t>(6 * 2 * 3 * cells * cells)) {
+                    LOG_ERROR(
+                        logging::main_logger, "Seams of a solid chunk are not closed."
+                    );
+                    return 1;
+                }
+                sealed_chunks++;
+                util::PackedMeshPool::local().recycle(std::move(sealed));
+            }
+            util::PackedMeshPool::local().recycle(std::move(mesh));
+        }
+        num_chunks++;
+    }
+    if (num_chunks == 0) {
+        return 1;
+    }
+
+    for (uint8_t level = 0; level < terrain::LodSelector::NUM_LEVELS; level++) {
+        LOG_INFO(
+            logging::main_logger,
+            "Level {}: {:.1f} triangles per chunk ({:.1f}%), {:.1f} us per chunk.",
+            level, static_cast<double>(triangles[level]) / num_chunks,
+            100.0 * static_cast<double>(triangles[level]) / triangles[0],
+            static_cast<double>(times[level].count()) / 1000.0 / num_chunks
+        );
+    }
+    LOG_INFO(logging::main_logger, "Checked seams of {} solid chunks.", sealed_chunks);
+
+    return 0;
+}
+
+
+namespace {
+
+// a chunk sized voxel object where every voxel is solid
+class SolidVoxels : public voxel_utility::VoxelBase {
+    std::vector<ColorInt> color_ids_{0, 0xFFFFFFFF};
+
+ public:
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelDim, VoxelDim, VoxelDim) const {
+        return 1;
+    }
+
+    [[nodiscard]] inline MatColorId
+    get_voxel_color_id(VoxelOffset) const {
+        return 1;
+    }
+
+    [[nodiscard]] inline VoxelSize
+    get_size() const {
+        return VoxelSize(terrain::Chunk::SIZE);
+    }
+
+    [[nodiscard]] inline VoxelOffset
+    get_offset() const {
+        return VoxelOffset(0);
+    }
+
+    [[nodiscard]] inline const std::vector<ColorInt>&
+    get_color_ids() const {
+        return color_ids_;
+    }
+};
+
+} // namespace
+
+int
+chunk_culling_test(size_t size) {
+    // frustum of a camera in chunk (0, 0, 0) looking along x
+    glm::vec3 camera(8.0f, 8.0f, 8.0f);
+    glm::mat4 view_projection =
+        glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f)
+        * glm::lookAt(
+            camera, camera + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)
+        );
+    terrain::Frustum frustum(view_projection);
+
+    ChunkPos ahead(3, 0, 0);
+    ChunkPos behind(-3, 0, 0);
+    ChunkPos beside(3, 20, 0);
+    ChunkPos too_far(40, 0, 0);
+    ChunkPos buried(5, 0, 0);
+
+    // each neighbor of buried is solid only on the face that touches it
+    terrain::ChunkCuller culler;
+    for (size_t axis = 0; axis < 3; axis++) {
+        for (bool above : {false, true}) {
+            ChunkPos neighbor = buried;
+            neighbor[axis] += above ? 1 : -1;
+            culler.set_opaque_faces(neighbor, 1u << (2 * axis + !above));
+        }
+    }
+    if (!culler.is_occluded(buried, camera)) {
+        LOG_ERROR(logging::main_logger, "Surrounded chunk is not occluded.");
+        return 1;
+    }
+    // the wrong face of one neighbor is solid
+    culler.set_opaque_faces(buried + ChunkPos(1, 0, 0), 0b000010);
+    if (culler.is_occluded(buried, camera)) {
+        LOG_ERROR(logging::main_logger, "Chunk with an open side is occluded.");
+        return 1;
+    }
+    culler.set_opaque_faces(buried + ChunkPos(1, 0, 0), 0b111111);
+    // the camera is never occluded
+    for (size_t axis = 0; axis < 3; axis++) {
+        for (bool above : {false, true}) {
+            ChunkPos neighbor(0, 0, 0);
+            neighbor[axis] += above ? 1 : -1;
+            culler.set_opaque_faces(neighbor, 0b111111);
+        }
+    }
+    if (culler.is_occluded(ChunkPos(0, 0, 0), camera)) {
+        LOG_ERROR(logging::main_logger, "Chunk with the camera is occluded.");
+        return 1;
+    }
+
+    std::vector<ChunkPos> chunks = {ahead, behind, beside, too_far, buried};
+    const std::vector<size_t>& visible = culler.cull(chunks, frustum, camera);
+    terrain::ChunkCuller::Counts counts = culler.get_counts();
+    if (visible != std::vector<size_t>{0} || counts.total != 5
+        || counts.outside_frustum != 3 || counts.occluded != 1) {
+        LOG_ERROR(
+            logging::main_logger,
+            "Culling is wrong. {} visible, {} outside the frustum, {} occluded.",
+            visible.size(), counts.outside_frustum, counts.occluded
+        );
+        return 1;
+    }
+
+    // the mesher keeps the solid faces of a solid chunk
+    util::PackedMesh solid_mesh = util::packed_ambient_occlusion_mesher(SolidVoxels());
+    if (solid_mesh.get_opaque_faces() != 0b111111) {
+        LOG_ERROR(
+            logging::main_logger, "Solid chunk has solid faces {:#b}.",
+            solid_mesh.get_opaque_faces()
+        );
+        return 1;
+    }
+    util::PackedMeshPool::local().recycle(std::move(solid_mesh));
+
+    // solid faces found from solid masks and from voxels agree
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    terrain::ChunkCuller world_culler;
+    chunks.clear();
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        util::PackedMesh mesh =
+            util::packed_ambient_occlusion_mesher(terrain::ChunkData(chunk));
+        uint8_t from_voxels =
+            util::opaque_faces(terrain::ChunkLodData(chunk, terrain::ChunkLod()));
+        if (mesh.get_opaque_faces() != from_voxels) {
+            LOG_ERROR(
+                logging::main_logger, "Solid faces {:#b} and {:#b} are not equal.",
+                mesh.get_opaque_faces(), from_voxels
+            );
+            return 1;
+        }
+        world_culler.set_opaque_faces(chunk.get_chunk_position(), from_voxels);
+        if (!mesh.get_indices().empty()) {
+            chunks.push_back(chunk.get_chunk_position());
+        }
+        util::PackedMeshPool::local().recycle(std::move(mesh));
+    }
+
+    // above a corner of the world, looking at the far corner
+    TerrainOffset3 grid_size = terrain.get_chunk_grid_size();
+    glm::vec3 world_size =
+        glm::vec3(grid_size) * static_cast<float>(terrain::Chunk::SIZE);
+    glm::vec3 world_camera(-16.0f, -16.0f, world_size.z + 16.0f);
+    view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+                      * glm::lookAt(
+                          world_camera, glm::vec3(world_size.x, world_size.y, 0.0f),
+                          glm::vec3(0.0f, 0.0f, 1.0f)
+                      );
+
+    auto start = time_util::get_time_nanoseconds();
+    (void)world_culler.cull(chunks, terrain::Frustum(view_projection), world_camera);
+    auto time = time_util::get_time_nanoseconds() - start;
+
+    counts = world_culler.get_counts();
+    if (counts.total != chunks.size() || counts.visible() > counts.total) {
+        LOG_ERROR(logging::main_logger, "Culling counts are wrong.");
+        return 1;
+    }
+    LOG_INFO(
+        logging::main_logger,
+        "Drawing {} of {} chunks, {} outside the frustum, {} occluded, in {} us.",
+        counts.visible(), counts.total, counts.outside_frustum, counts.occluded,
+        static_cast<double>(time.count()) / 1000.0
+    );
+
+    return 0;
+}
+
+int
+coalesced_data_test(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    World world(&object_handler, BIOME_BASE_NAME, size, size, SEED);
+    const terrain::Terrain& terrain = world.get_terrain_main();
+
+    std::unordered_map<ChunkPos, util::PackedMesh> meshes;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        util::PackedMesh mesh =
+            util::packed_ambient_occlusion_mesher(terrain::ChunkData(chunk));
+        if (!mesh.get_indices().empty()) {
+            meshes.emplace(chunk.get_chunk_position(), std::move(mesh));
+        }
+    }
+
+    // serial concatenation, as the coalesced data was built before
+    auto start = time_util::get_time_nanoseconds();
+    std::vector<util::PackedVertex> serial_vertices;
+    std::vector<uint16_t> serial_elements;
+    for (const auto& [position, mesh] : meshes) {
+        serial_vertices.insert(
+            serial_vertices.end(), mesh.get_packed_vertices().begin(),
+            mesh.get_packed_vertices().end()
+        );
+        serial_elements.insert(
+            serial_elements.end(), mesh.get_indices().begin(), mesh.get_indices().end()
+        );
+    }
+    auto serial_end = time_util::get_time_nanoseconds();
+
+    gui::gpu_data::detail::coalesced_data data(meshes);
+    auto parallel_end = time_util::get_time_nanoseconds();
+
+    // the blocks are written one after another into the buffers
+    std::vector<util::PackedVertex> vertex_array;
+    std::vector<uint16_t> element_array;
+    for (const auto& block : data.blocks) {
+        vertex_array.insert(
+            vertex_array.end(), block.vertex_array.begin(), block.vertex_array.end()
+        );
+        element_array.insert(
+            element_array.end(), block.element_array.begin(), block.element_array.end()
+        );
+    }
+
+    if (vertex_array != serial_vertices || element_array != serial_elements
+        || data.num_vertices.size() != meshes.size()) {
+        LOG_ERROR(logging::main_logger, "Coalesced data is not the serial data.");
+        return 1;
+    }
+    size_t index = 0;
+    for (const auto& [position, mesh] : meshes) {
+        size_t first_element = data.elements_offsets[index] / sizeof(uint16_t);
+        glm::ivec4 origin(mesh.get_center(), mesh.get_scale());
+        if (data.num_vertices[index] != static_cast<GLsizei>(mesh.get_indices().size())
+            || element_array[first_element] != mesh.get_indices().front()
+            || vertex_array[data.base_vertex[index]]
+                   != mesh.get_packed_vertices().front()
+            || data.chunk_origins[index] != origin
+            || data.chunk_positions[index] != position) {
+            LOG_ERROR(logging::main_logger, "Draw {} is in the wrong slot.", index);
+            return 1;
+        }
+        index++;
+    }
+
+    LOG_INFO(
+        logging::main_logger,
+        "Coalesced {} meshes, {} vertices. Serial: {} ms, parallel: {} ms.",
+        meshes.size(), serial_vertices.size(),
+        static_cast<double>((serial_end - start).count()) / 1e6,
+        static_cast<double>((parallel_end - serial_end).count()) / 1e6
+    );
+
+    // startup meshing as update_all_chunks_mesh did it before: mesh every chunk
+    // on the thread pool, wait, then concatenate the meshes
+    terrain::TerrainColorMapping::assign_color_mapping(world.get_materials());
+    GlobalContext& context = GlobalContext::instance();
+    auto before_start = time_util::get_time_nanoseconds();
+    std::unordered_map<ChunkPos, util::PackedMesh> pool_meshes;
+    std::mutex pool_meshes_mutex;
+    std::vector<std::future<void>> futures;
+    for (const terrain::Chunk& chunk : terrain.get_chunks()) {
+        const terrain::Chunk* chunk_ptr = &chunk;
+        futures.push_back(context.submit_task([&, chunk_ptr]() {
+            util::PackedMesh mesh =
+                util::packed_ambient_occlusion_mesher(terrain::ChunkData(*chunk_ptr));
+            mesh.change_color_indexing(
+                world.get_materials(),
+                terrain::TerrainColorMapping::get_colors_inverse_map()
+            );
+            std::scoped_lock lock(pool_meshes_mutex);
+            if (!mesh.get_indices().empty()) {
+                pool_meshes.emplace(chunk_ptr->get_chunk_position(), std::move(mesh));
+            }
+        }));
+    }
+    for (const auto& future : futures) {
+        future.wait();
+    }
+    std::vector<util::PackedVertex> before_vertices;
+    std::vector<uint16_t> before_elements;
+    for (const auto& [position, mesh] : pool_meshes) {
+        before_vertices.insert(
+            before_vertices.end(), mesh.get_packed_vertices().begin(),
+            mesh.get_packed_vertices().end()
+        );
+        before_elements.insert(
+            before_elements.end(), mesh.get_indices().begin(), mesh.get_indices().end()
+        );
+    }
+    auto before_end = time_util::get_time_nanoseconds();
+
+    // and as it does now, copying blocks while other chunks are meshed
+    std::unordered_map<ChunkPos, uint8_t> empty_opaque_faces;
+    gui::gpu_data::detail::coalesced_data startup_data =
+        world.mesh_all_chunks(empty_opaque_faces);
+    auto after_end = time_util::get_time_nanoseconds();
+
+    if (startup_data.num_vertices.size() != pool_meshes.size()) {
+        LOG_ERROR(logging::main_logger, "Startup meshing has the wrong draws.");
+        return 1;
+    }
+    for (size_t draw = 0; draw < startup_data.num_vertices.size(); draw++) {
+        auto mesh = pool_meshes.find(startup_data.chunk_positions[draw]);
+        if (mesh == pool_meshes.end()
+            || static_cast<size_t>(startup_data.num_vertices[draw])
+                   != mesh->second.get_indices().size()) {
+            LOG_ERROR(logging::main_logger, "Startup draw {} is wrong.", draw);
+            return 1;
+        }
+    }
+
+    LOG_INFO(
+        logging::main_logger,
+        "Startup meshing of {} chunks. Mesh then copy: {} ms, copy while meshing: "
+        "{} ms.",
+        terrain.num_chunks(),
+        static_cast<double>((before_end - before_start).count()) / 1e6,
+        static_cast<double>((after_end - before_end).count()) / 1e6
+    );
+
+    return 0;
+}
+
+int
+noise_grid_test() {
+    // the batched hash matches get_double
+    std::vector<double> scalar_doubles(37);
+    std::vector<double> avx2_doubles(37);
+    for (size_t prime = 0; prime < 10; prime++) {
+        terrain::generation::Noise::get_doubles_scalar(
+            prime, -1000, 77, scalar_doubles.size(), scalar_doubles.data()
+        );
+        if (bits::has_avx2()) {
+            terrain::generation::Noise::get_doubles_avx2(
+                prime, -1000, 77, avx2_doubles.size(), avx2_doubles.data()
+            );
+            if (avx2_doubles != scalar_doubles) {
+                LOG_ERROR(logging::main_logger, "Vector random doubles are wrong.");
+                return 1;
+            }
+        }
+        for (size_t k = 0; k < scalar_doubles.size(); k++) {
+            NoiseTileIndex x = -1000 + static_cast<NoiseTileIndex>(k);
+            if (scalar_doubles[k]
+                != terrain::generation::Noise::get_double(prime, x, 77)) {
+                LOG_ERROR(logging::main_logger, "Random doubles are wrong.");
+                return 1;
+            }
+        }
+    }
+
+    // sample_grid is exactly get_noise, including negative positions, and
+    // samples further apart than the lattice. This needs noise.cpp built
+    // without contraction, see the compile options in CMakeLists.txt
+    struct GridCase {
+        int num_octaves;
+        double persistence;
+        NoisePosition x0, y0, dx, dy;
+        size_t width, height;
+    };
+    std::vector<GridCase> grid_cases = {
+        {1, 1.0, 0.0, 0.0, 0.3, 0.3, 37, 21},
+        {4, 0.5, -100.25, -33.5, 0.7, 1.1, 64, 64},
+        {6, 0.7, 12345.5, -999.1, 1.0, 1.0, 33, 17},
+        {3, 0.6, -5.0, 5.0, 250.0, 3.0, 9, 11},
+    };
+    std::vector<double> grid;
+    for (const GridCase& grid_case : grid_cases) {
+        terrain::generation::FractalNoise grid_noise(
+            grid_case.num_octaves, grid_case.persistence, 3
+        );
+        grid.resize(grid_case.width * grid_case.height);
+        grid_noise.sample_grid(
+            grid_case.x0, grid_case.y0, grid_case.dx, grid_case.dy, grid_case.width,
+            grid_case.height, grid
+        );
+        for (size_t j = 0; j < grid_case.height; j++) {
+            for (size_t i = 0; i < grid_case.width; i++) {
+                double expected = grid_noise.get_noise(
+                    grid_case.x0 + i * grid_case.dx, grid_case.y0 + j * grid_case.dy
+                );
+                if (grid[j * grid_case.width + i] != expected) {
+                    LOG_ERROR(
+                        logging::main_logger, "Grid sample ({}, {}) is {} not {}.",
+                        i, j, grid[j * grid_case.width + i], expected
+                    );
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // samples per second of a chunk sized grid, as terrain generation uses it
+    terrain::generation::FractalNoise bench_noise(6, 0.5, 3);
+    constexpr size_t bench_size = 256;
+    grid.resize(bench_size * bench_size);
+    double checksum = 0.0;
+    auto start = time_util::get_time_nanoseconds();
+    for (size_t j = 0; j < bench_size; j++) {
+        for (size_t i = 0; i < bench_size; i++) {
+            checksum += bench_noise.get_noise(i * 0.5, j * 0.5);
+        }
+    }
+    auto scalar_end = time_util::get_time_nanoseconds();
+    constexpr size_t grid_repeats = 10;
+    for (size_t repeat = 0; repeat < grid_repeats; repeat++) {
+        bench_noise.sample_grid(0.0, 0.0, 0.5, 0.5, bench_size, bench_size, grid);
+    }
+    auto grid_end = time_util::get_time_nanoseconds();
+
+    double num_samples = bench_size * bench_size;
+    LOG_INFO(
+        logging::main_logger,
+        "get_noise: {:.2f} million samples/s (checksum {}).",
+        num_samples / (scalar_end - start).count() * 1e3, checksum
+    );
+    LOG_INFO(
+        logging::main_logger, "sample_grid: {:.2f} million samples/s, avx2 {}.",
+        grid_repeats * num_samples / (grid_end - scalar_end).count() * 1e3,
+        bits::has_avx2()
+    );
+
+    return 0;
+}
+
+int
+worley_noise_test() {
+    terrain::generation::WorleyNoise worley(7.5, 11.0);
+    // the same as biome_map.as uses for flowers
+    terrain::generation::AlternativeWorleyNoise alternative(32, 0.5, 32);
+
+    // sample_grid is exactly get_noise, including negative positions
+    constexpr size_t width = 97;
+    constexpr size_t height = 53;
+    std::vector<double> grid(width * height);
+    for (const terrain::generation::WorleyNoise* noise :
+         {&worley, static_cast<terrain::generation::WorleyNoise*>(&alternative)}) {
+        noise->sample_grid(-400.3, -211.7, 1.3, 2.9, width, height, grid);
+        for (size_t j = 0; j < height; j++) {
+            for (size_t i = 0; i < width; i++) {
+                double expected = noise->get_noise(-400.3 + i * 1.3, -211.7 + j * 2.9);
+                if (grid[j * width + i] != expected) {
+                    LOG_ERROR(
+                        logging::main_logger, "Grid sample ({}, {}) is {} not {}.",
+                        i, j, grid[j * width + i], expected
+                    );
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // threads share the point cache
+    GlobalContext& context = GlobalContext::instance();
+    constexpr size_t num_tasks = 16;
+    constexpr size_t samples_per_task = 1000;
+    std::vector<std::future<double>> futures;
+    for (size_t task = 0; task < num_tasks; task++) {
+        futures.push_back(context.submit_task([&alternative, task]() {
+            double sum = 0.0;
+            for (size_t k = 0; k < samples_per_task; k++) {
+                sum += alternative.get_noise(100.0 * task + k * 0.37, k * -0.91);
+            }
+            return sum;
+        }));
+    }
+    for (size_t task = 0; task < num_tasks; task++) {
+        double sum = 0.0;
+        for (size_t k = 0; k < samples_per_task; k++) {
+            sum += alternative.get_noise(100.0 * task + k * 0.37, k * -0.91);
+        }
+        if (futures[task].get() != sum) {
+            LOG_ERROR(logging::main_logger, "Noise depends on the thread.");
+            return 1;
+        }
+    }
+
+    // a plant map sized grid, every four tiles
+    terrain::generation::AlternativeWorleyNoise bench_noise(32, 0.5, 32);
+    constexpr size_t bench_size = 256;
+    grid.resize(bench_size * bench_size);
+    double checksum = 0.0;
+    auto start = time_util::get_time_nanoseconds();
+    for (size_t j = 0; j < bench_size; j++) {
+        for (size_t i = 0; i < bench_size; i++) {
+            checksum += bench_noise.get_noise(i * 4.0, j * 4.0);
+        }
+    }
+    auto samples_end = time_util::get_time_nanoseconds();
+    bench_noise.sample_grid(0.0, 0.0, 4.0, 4.0, bench_size, bench_size, grid);
+    auto grid_end = time_util::get_time_nanoseconds();
+
+    double num_samples = bench_size * bench_size;
+    LOG_INFO(
+        logging::main_logger,
+        "get_noise: {:.2f} million samples/s (checksum {}).",
+        num_samples / (samples_end - start).count() * 1e3, checksum
+    );
+    LOG_INFO(
+        logging::main_logger,
+        "sample_grid: {:.2f} million samples/s, {} cached blocks.",
+        num_samples / (grid_end - samples_end).count() * 1e3,
+        bench_noise.get_num_cached_blocks()
+    );
+
+    return 0;
+}
+
+int
+biome_map_test(size_t size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    terrain::generation::Biome biome(BIOME_BASE_NAME, SEED);
+    // plant maps have one value for each tile, so use a smaller side
+    Dim plant_length = size * 16;
+
+    auto map_ids = [](const terrain::generation::TerrainMacroMap& map) {
+        std::vector<MapTile_t> ids;
+        for (const auto& map_tile : map) {
+            ids.push_back(map_tile.get_type_id());
+        }
+        return ids;
+    };
+
+    // one task calling the script for each tile is the serial result
+    biome.set_use_row_methods(false);
+    auto start = time_util::get_time_nanoseconds();
+    std::vector<MapTile_t> serial_map = map_ids(biome.get_map(size, 1));
+    auto map_end = time_util::get_time_nanoseconds();
+    auto serial_plants = biome.get_plant_map(plant_length, 1);
+    auto plants_end = time_util::get_time_nanoseconds();
+    if (serial_map.size() != size * size
+        || serial_plants.size() != biome.get_generate_plants().size()) {
+        LOG_ERROR(logging::main_logger, "Could not sample the biome map.");
+        return 1;
+    }
+    LOG_INFO(
+        logging::main_logger, "1 task, per tile: map {} ms, plant maps {} ms.",
+        static_cast<double>((map_end - start).count()) / 1e6,
+        static_cast<double>((plants_end - map_end).count()) / 1e6
+    );
+
+    // per tile times in ms for each number of tasks, to compare the row methods
+    // against
+    std::map<size_t, std::pair<double, double>> per_tile_times;
+    per_tile_times[1] = {
+        static_cast<double>((map_end - start).count()) / 1e6,
+        static_cast<double>((plants_end - map_end).count()) / 1e6
+    };
+
+    for (bool use_row_methods : {false, true}) {
+        biome.set_use_row_methods(use_row_methods);
+        const char* method_name = use_row_methods ? "per row" : "per tile";
+        for (size_t num_tasks : {1, 2, 4, 8}) {
+            if (!use_row_methods && num_tasks == 1) {
+                continue;
+            }
+            start = time_util::get_time_nanoseconds();
+            std::vector<MapTile_t> map = map_ids(biome.get_map(size, num_tasks));
+            map_end = time_util::get_time_nanoseconds();
+            auto plants = biome.get_plant_map(plant_length, num_tasks);
+            plants_end = time_util::get_time_nanoseconds();
+
+            if (map != serial_map) {
+                LOG_ERROR(
+                    logging::main_logger,
+                    "Map from {} tasks, {}, is not the serial map.", num_tasks,
+                    method_name
+                );
+                return 1;
+            }
+            for (const auto& [name, serial_plant_map] : serial_plants) {
+                const terrain::generation::PlantMap& plant_map = plants.at(name);
+                for (Dim i = 0; i < plant_length; i++) {
+                    for (Dim j = 0; j < plant_length; j++) {
+                        if (plant_map.get_tile(i, j)
+                            != serial_plant_map.get_tile(i, j)) {
+                            LOG_ERROR(
+                                logging::main_logger,
+                                "Plant map {} from {} tasks, {}, is not the serial "
+                                "map.",
+                                name, num_tasks, method_name
+                            );
+                            return 1;
+                        }
+                    }
+                }
+            }
+            double map_time = static_cast<double>((map_end - start).count()) / 1e6;
+            double plants_time =
+                static_cast<double>((plants_end - map_end).count()) / 1e6;
+            LOG_INFO(
+                logging::main_logger, "{} tasks, {}: map {} ms, plant maps {} ms.",
+                num_tasks, method_name, map_time, plants_time
+            );
+            if (!use_row_methods) {
+                per_tile_times[num_tasks] = {map_time, plants_time};
+            } else {
+                const auto& [tile_map_time, tile_plants_time] =
+                    per_tile_times.at(num_tasks);
+                LOG_INFO(
+                    logging::main_logger,
+                    "{} tasks, per row over per tile speedup: map {}x, plant maps "
+                    "{}x.",
+                    num_tasks, tile_map_time / map_time, tile_plants_time / plants_time
+                );
+            }
+        }
+    }
+
+    return 0;
+}
+
+namespace {
+
+// every tile of the terrain, in x, then y, then z order
+std::vector<MatColorId>
+get_mat_color_ids(const terrain::Terrain& terrain) {
+    std::vector<MatColorId> out;
+    out.reserve(static_cast<size_t>(terrain.X_MAX) * terrain.Y_MAX * terrain.Z_MAX);
+    for (TerrainOffset x = 0; x < terrain.X_MAX; x++) {
+        for (TerrainOffset y = 0; y < terrain.Y_MAX; y++) {
+            for (TerrainOffset z = 0; z < terrain.Z_MAX; z++) {
+                out.push_back(terrain.get_tile(x, y, z)->get_mat_color_id());
+            }
+        }
+    }
+    return out;
+}
+
+// set every tile to air, as it is before generation
+void
+clear_terrain(terrain::Terrain& terrain) {
+    terrain::Tile air(terrain.get_material(0), 0);
+    terrain.for_each_chunk_span([&air](TerrainOffset3, std::span<terrain::Tile> tiles) {
+        std::fill(tiles.begin(), tiles.end(), air);
+    });
+}
+
+// stamp part of a chunk, or do nothing when the stamp misses the chunk
+void
+stamp_chunk(terrain::Chunk& chunk, const terrain::generation::PlacedStamp& placed) {
+    TerrainOffset3 local_start = glm::clamp(
+        placed.start - chunk.get_offset(), TerrainOffset3(0),
+        TerrainOffset3(terrain::Chunk::SIZE)
+    );
+    TerrainOffset3 local_end = glm::clamp(
+        placed.end - chunk.get_offset(), TerrainOffset3(0),
+        TerrainOffset3(terrain::Chunk::SIZE)
+    );
+    if (glm::any(glm::equal(local_start, local_end))) {
+        return;
+    }
+    chunk.stamp_tile_region(
+        placed.stamp.mat, placed.stamp.color_id, placed.stamp.elements_can_stamp,
+        local_start, local_end
+    );
+}
+
+// Apply stamps the way terrain generation did before stamps were binned by
+// chunk. One task for each stamp and chunk, and each task locks its chunk.
+// Used as a baseline. Returns the number of tasks.
+size_t
+apply_stamps_per_task(
+    terrain::Terrain& terrain,
+    const std::vector<terrain::generation::PlacedStamp>& stamps
+) {
+    GlobalContext& context = GlobalContext::instance();
+    std::vector<std::future<void>> futures;
+    for (const terrain::generation::PlacedStamp& placed : stamps) {
+        ChunkPos chunk_start = terrain.get_chunk_from_tile(placed.start);
+        ChunkPos chunk_end =
+            terrain.get_chunk_from_tile(placed.end - TerrainOffset3(1, 1, 1));
+        for (ChunkDim x = chunk_start.x; x <= chunk_end.x; x++) {
+            for (ChunkDim y = chunk_start.y; y <= chunk_end.y; y++) {
+                for (ChunkDim z = chunk_start.z; z <= chunk_end.z; z++) {
+                    ChunkPos chunk_pos(x, y, z);
+                    futures.push_back(context.submit_task(
+                        [&terrain, &placed, chunk_pos]() {
+                            terrain::Chunk* chunk = terrain.get_chunk(chunk_pos);
+                            if (!chunk) {
+                                return;
+                            }
+                            std::scoped_lock lock(chunk->get_mutex());
+                            stamp_chunk(*chunk, placed);
+                        },
+                        BS::pr::highest
+                    ));
+                }
+            }
+        }
+    }
+    for (const auto& future : futures) {
+        future.wait();
+    }
+    return futures.size();
+}
+
+// apply stamps one after the other on this thread
+void
+apply_stamps_serial(
+    terrain::Terrain& terrain,
+    const std::vector<terrain::generation::PlacedStamp>& stamps
+) {
+    for (const terrain::generation::PlacedStamp& placed : stamps) {
+        ChunkPos chunk_start = terrain.get_chunk_from_tile(placed.start);
+        ChunkPos chunk_end =
+            terrain.get_chunk_from_tile(placed.end - TerrainOffset3(1, 1, 1));
+        for (ChunkDim x = chunk_start.x; x <= chunk_end.x; x++) {
+            for (ChunkDim y = chunk_start.y; y <= chunk_end.y; y++) {
+                for (ChunkDim z = chunk_start.z; z <= chunk_end.z; z++) {
+                    terrain::Chunk* chunk = terrain.get_chunk({x, y, z});
+                    if (chunk) {
+                        stamp_chunk(*chunk, placed);
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int
+stamp_benchmark(size_t max_size) {
+    manifest::ObjectHandler object_handler;
+    object_handler.load_all_manifests<false>();
+
+    terrain::generation::Biome biome(BIOME_BASE_NAME, SEED);
+    for (size_t size = 4; size <= max_size; size *= 2) {
+        // all of terrain generation, which applies stamps with apply_stamps
+        auto generation_map = biome.get_map(size);
+        auto generation_start = time_util::get_time_nanoseconds();
+        terrain::Terrain terrain(
+            size, size, World::macro_tile_size, World::height, biome,
+            std::move(generation_map)
+        );
+        auto generation_end = time_util::get_time_nanoseconds();
+
+        // making stamps uses up the random engines of the map tiles
+        auto macro_map = biome.get_map(size);
+        auto start = time_util::get_time_nanoseconds();
+        std::vector<terrain::generation::PlacedStamp> stamps =
+            terrain.get_map_tile_stamps(size, size, macro_map);
+        auto stamps_end = time_util::get_time_nanoseconds();
+
+        clear_terrain(terrain);
+        apply_stamps_serial(terrain, stamps);
+        std::vector<MatColorId> serial_tiles = get_mat_color_ids(terrain);
+
+        clear_terrain(terrain);
+        auto per_task_start = time_util::get_time_nanoseconds();
+        size_t num_tasks = apply_stamps_per_task(terrain, stamps);
+        auto per_task_end = time_util::get_time_nanoseconds();
+        // tasks may run out of order, so this can differ from the serial result
+        if (get_mat_color_ids(terrain) != serial_tiles) {
+            LOG_WARNING(
+                logging::main_logger,
+                "Stamping with a task for each stamp changed the order of "
+                "overlapping stamps."
+            );
+        }
+
+        clear_terrain(terrain);
+        auto binned_start = time_util::get_time_nanoseconds();
+        terrain.apply_stamps(stamps);
+        auto binned_end = time_util::get_time_nanoseconds();
+        if (get_mat_color_ids(terrain) != serial_tiles) {
+            LOG_ERROR(
+                logging::main_logger,
+                "Stamps binned by chunk do not match applying them in order."
+            );
+            return 1;
+        }
+
+        LOG_INFO(
+            logging::main_logger,
+            "World size {0}x{0}: {1} stamps made in {2} ms. {3} tasks, one for "
+            "each stamp and chunk: {4} ms. {5} tasks, one for each chunk: {6} ms.",
+            size, stamps.size(),
+            static_cast<double>((stamps_end - start).count()) / 1e6, num_tasks,
+            static_cast<double>((per_task_end - per_task_start).count()) / 1e6,
+            terrain.num_chunks(),
+            static_cast<double>((binned_end - binned_start).count()) / 1e6
+        );
+        LOG_INFO(
+            logging::main_logger, "World size {0}x{0}: generation took {1} ms.", size,
+            static_cast<double>((generation_end - generation_start).count()) / 1e6
+        );
+    }
+
+    return 0;
+}
+
+} // namespace world
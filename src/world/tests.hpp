@@ -0,0 +1,207 @@
+// -*- lsst-c++ -*-
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/**
+ * @file tests.hpp
+ *
+ * @author @AlemSnyder
+ *
+ * @brief Define world tests and benchmarks
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace world {
+
+/**
+ * @brief Time sequential and random tile access on a generated world.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int tile_access_benchmark(size_t size);
+
+/**
+ * @brief Time whole terrain scans done tile by tile against scans done chunk
+ * by chunk on the thread pool.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int bulk_pass_benchmark(size_t size);
+
+/**
+ * @brief Report tile memory with and without chunk compression, and check
+ * that compressing does not change any tile.
+ *
+ * @param max_size largest number of macro tiles in the x and y directions
+ */
+int chunk_memory_report(size_t max_size);
+
+/**
+ * @brief Edit tiles and check the column height cache matches a scan of the
+ * terrain, and that get_first_not matches a probe of the column.
+ */
+int column_height_test();
+
+/**
+ * @brief Time path finding between random positions on a generated world.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int path_query_benchmark(size_t size);
+
+int node_group_graph_test();
+
+/**
+ * @brief Time editing tiles and rebuilding the node groups around them, and
+ * check paths against a rebuild of every chunk after each batch of edits.
+ */
+int nodegroup_update_benchmark();
+
+/**
+ * @brief Check repeated node group path queries hit the route cache, and that
+ * routes stay valid after the terrain is edited.
+ */
+int route_cache_test();
+
+/**
+ * @brief Check batched path requests match single searches, and that requests
+ * finish while the terrain is edited.
+ */
+int path_service_test();
+
+/**
+ * @brief Check a distance field to several goals agrees with searching to the
+ * goals, and goes out of date when the terrain changes.
+ */
+int distance_field_test();
+
+/**
+ * @brief Mesh every chunk with and without greedy meshing, and report
+ * triangles, vertices, and time per chunk.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int meshing_benchmark(size_t size);
+
+/**
+ * @brief Compare meshing chunks with per slice vertex indexing to meshing with
+ * a hash map, and check both give the same mesh.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int mesh_dedupe_benchmark(size_t size);
+
+/**
+ * @brief Check meshing chunks from solid bit masks gives the same mesh as
+ * looking up every voxel, and compare the time of both.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int face_mask_test(size_t size);
+
+/**
+ * @brief Check packed chunk meshes have the same vertices as unpacked meshes,
+ * and report the bytes per chunk of both.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int packed_mesh_test(size_t size);
+
+/**
+ * @brief Check RemeshScheduler orders jobs, drops superseded jobs, and keeps
+ * to the upload budget.
+ */
+int remesh_scheduler_test();
+
+/**
+ * @brief Check util::RangeAllocator merges free ranges, resizes in place, and
+ * compacts, without overlapping ranges.
+ */
+int range_allocator_test();
+
+/**
+ * @brief Count mesh pool allocations while remeshing every chunk several
+ * times, both one chunk at a time and with update_marked_chunks_mesh.
+ *
+ * @details Allocations are read from util::PackedMeshPool::get_allocations.
+ * Fails if remeshing one chunk at a time needs new mesh memory once the pool
+ * is warm.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int mesh_allocation_benchmark(size_t size);
+
+/**
+ * @brief Check level of detail selection and meshes, and report triangles
+ * per chunk at each level.
+ *
+ * @details Checks hysteresis and seams of LodSelector, that level 0 meshes
+ * match the full mesh, and that seams close the mesh of solid chunks.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int lod_mesh_test(size_t size);
+
+/**
+ * @brief Check frustum and occlusion culling of chunks, and that the solid
+ * faces of each chunk are the same from solid masks and from voxels.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int chunk_culling_test(size_t size);
+
+/**
+ * @brief Check that the parallel coalesced data matches serial concatenation
+ * of the chunk meshes, and time both. Also time startup meshing with the copy
+ * after meshing and during it (World::mesh_all_chunks).
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int coalesced_data_test(size_t size);
+
+/**
+ * @brief Check that batched noise sampling matches sampling one point at a
+ * time exactly, and time both.
+ */
+int noise_grid_test();
+
+/**
+ * @brief Check that Worley noise grids match sampling one point at a time,
+ * that threads sharing the point cache get the same noise, and time both.
+ */
+int worley_noise_test();
+
+/**
+ * @brief Check that the biome map and plant maps do not depend on the number
+ * of tasks sampling them, or on sampling by rows, and time each of them. Logs
+ * the speedup of the row methods over per tile sampling for each number of
+ * tasks.
+ *
+ * @param size number of macro tiles in the x and y directions
+ */
+int biome_map_test(size_t size);
+
+/**
+ * @brief Time applying terrain generation stamps with a task for each stamp
+ * and chunk against a task for each chunk, and check chunk tasks apply
+ * overlapping stamps in order. Also times all of terrain generation for each
+ * size, to put the stamping times in context.
+ *
+ * @param max_size largest number of macro tiles in the x and y directions
+ */
+int stamp_benchmark(size_t max_size);
+
+} // namespace world
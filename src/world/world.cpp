@@ -29,10 +29,14 @@
 #include "terrain/material.hpp"
 #include "terrain/terrain.hpp"
 #include "util/mesh.hpp"
+#include "util/time.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 #include <string>
+#include <utility>
 
 namespace world {
 
@@ -45,7 +49,8 @@ World::World(
     manifest::ObjectHandler* object_handler, const std::string& biome_name,
     const std::string& path, size_t seed
 ) :
-    biome_(biome_name, seed), terrain_main_(path, biome_), controller_(object_handler) {
+    biome_(biome_name, seed), terrain_main_(path, biome_), path_service_(terrain_main_),
+    controller_(object_handler), lod_selector_(terrain_main_.get_chunk_grid_size()) {
 }
 
 World::World(
@@ -56,7 +61,8 @@ World::World(
     terrain_main_(
         x_tiles, y_tiles, macro_tile_size, height, biome_, biome_.get_map(x_tiles)
     ),
-    controller_(object_handler) {}
+    path_service_(terrain_main_), controller_(object_handler),
+    lod_selector_(terrain_main_.get_chunk_grid_size()) {}
 
 World::World(
     manifest::ObjectHandler* object_handler, const std::string& biome_name,
@@ -66,7 +72,8 @@ World::World(
     terrain_main_(
         3, 3, macro_tile_size, height, biome_, biome_.single_tile_type_map(tile_type)
     ),
-    controller_(object_handler) {}
+    path_service_(terrain_main_), controller_(object_handler),
+    lod_selector_(terrain_main_.get_chunk_grid_size()) {}
 
 void
 World::generate_plants() {
@@ -120,78 +127,184 @@ World::generate_plants() {
     }
 }
 
-// Should not be called om main thread
-void
-World::update_single_mesh(ChunkPos chunk_pos) {
-    const auto chunk = terrain_main_.get_chunk(chunk_pos);
-    if (!chunk) {
-        return;
-    }
-    util::Mesh chunk_mesh = util::ambient_occlusion_mesher(terrain::ChunkData(*chunk));
+util::PackedMesh
+World::mesh_chunk_(const terrain::Chunk& chunk, terrain::ChunkLod lod) const {
+    // ChunkData has solid masks, so it is faster when it can be used
+    util::PackedMesh chunk_mesh =
+        lod == terrain::ChunkLod()
+            ? util::packed_ambient_occlusion_mesher(terrain::ChunkData(chunk))
+            : util::packed_ambient_occlusion_mesher(terrain::ChunkLodData(chunk, lod));
 
     chunk_mesh.change_color_indexing(
         biome_.get_materials(), terrain::TerrainColorMapping::get_colors_inverse_map()
     );
+    return chunk_mesh;
+}
 
-    if (chunk_mesh.get_indices().size() > 0) {
-        std::scoped_lock lock(meshes_to_update_mutex_);
-        meshes_to_update_.insert({chunk_pos, chunk_mesh});
+// Should not be called om main thread
+void
+World::update_single_mesh(ChunkPos chunk_pos, terrain::ChunkLod lod) {
+    const auto chunk = terrain_main_.get_chunk(chunk_pos);
+    if (!chunk) {
+        return;
     }
+    remesh_scheduler_.store(chunk_pos, mesh_chunk_(*chunk, lod));
 }
 
-// TODO should set a limit the the number
-// update_marked_chunks_mesh runs every frame, so the number of chunks updated
-// each frame should be capped.
 void
-World::update_marked_chunks_mesh() {
-    for (auto chunk_pos : chunks_to_update_) {
-        GlobalContext& context = GlobalContext::instance();
-        context.submit_task([this, chunk_pos]() {
-            this->update_single_mesh(chunk_pos);
+World::update_marked_chunks_mesh(glm::vec3 camera_position, glm::vec3 view_direction) {
+    GlobalContext& context = GlobalContext::instance();
+    for (RemeshScheduler::Job job :
+         remesh_scheduler_.take_jobs(camera_position, view_direction)) {
+        // read on this thread, as update_level_of_detail may change it
+        terrain::ChunkLod lod = lod_selector_.get_lod(job.chunk_position);
+        context.submit_task([this, job, lod]() {
+            // the chunk changed again, and a newer job is queued
+            const auto chunk = terrain_main_.get_chunk(job.chunk_position);
+            if (!chunk || !remesh_scheduler_.is_current(job)) {
+                remesh_scheduler_.cancel(job);
+                return;
+            }
+            remesh_scheduler_.complete(job, mesh_chunk_(*chunk, lod));
         });
     }
-    chunks_to_update_.clear();
 }
 
 void
-World::update_all_chunks_mesh() {
-    LOG_DEBUG(logging::terrain_logger, "Begin load chunks mesh");
+World::update_level_of_detail(glm::vec3 camera_position) {
+    for (ChunkPos chunk_pos : lod_selector_.update(camera_position)) {
+        mark_chunk_for_update(chunk_pos);
+    }
+}
+
+gui::gpu_data::detail::coalesced_data
+World::mesh_all_chunks(std::unordered_map<ChunkPos, uint8_t>& empty_opaque_faces
+) const {
     size_t num_chunks = terrain_main_.num_chunks();
 
+    using gui::gpu_data::detail::coalesced_block;
+    using gui::gpu_data::detail::coalesced_data;
+
+    // each task writes only the mesh of its own chunk, and the last task to
+    // finish a block of chunks copies the block while other chunks are still
+    // being meshed
+    constexpr size_t block_size = coalesced_data::COPY_BLOCK_SIZE;
+    size_t num_blocks = (num_chunks + block_size - 1) / block_size;
+    std::vector<util::PackedMesh> chunk_meshes(num_chunks);
+    std::vector<ChunkPos> chunk_positions;
+    chunk_positions.reserve(num_chunks);
+    for (const auto& chunk : terrain_main_.get_chunks()) {
+        chunk_positions.push_back(chunk.get_chunk_position());
+    }
+    std::vector<coalesced_block> blocks(num_blocks);
+    std::vector<std::atomic<size_t>> blocks_remaining(num_blocks);
+    for (size_t block = 0; block < num_blocks; block++) {
+        blocks_remaining[block] = std::min(block_size, num_chunks - block * block_size);
+    }
+
     std::vector<std::future<void>> wait_for;
     wait_for.reserve(num_chunks);
     GlobalContext& context = GlobalContext::instance();
-    for (const auto& [chunk_pos, chunk] : terrain_main_.get_chunks()) {
-        auto future = context.submit_task([this, chunk_pos]() {
-            this->update_single_mesh(chunk_pos);
+    size_t index = 0;
+    for (const auto& chunk : terrain_main_.get_chunks()) {
+        terrain::ChunkLod lod = lod_selector_.get_lod(chunk_positions[index]);
+        const terrain::Chunk* chunk_ptr = &chunk;
+        auto future = context.submit_task([&, chunk_ptr, index, lod]() {
+            chunk_meshes[index] = mesh_chunk_(*chunk_ptr, lod);
+            size_t block = index / block_size;
+            // acq_rel so the last task of the block sees every mesh in it
+            if (blocks_remaining[block].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            size_t end = std::min((block + 1) * block_size, num_chunks);
+            for (size_t chunk_index = block * block_size; chunk_index < end;
+                 chunk_index++) {
+                if (!chunk_meshes[chunk_index].get_indices().empty()) {
+                    blocks[block].push_back(
+                        chunk_positions[chunk_index], chunk_meshes[chunk_index]
+                    );
+                }
+            }
         });
         wait_for.push_back(std::move(future));
+        index++;
     }
     // Should only wait for the previously queued tasks.
     for (const auto& task : wait_for) {
         task.wait();
     }
 
-    std::scoped_lock lock(meshes_to_update_mutex_);
+    // chunks with nothing to draw still hide the chunks around them
+    for (size_t chunk_index = 0; chunk_index < num_chunks; chunk_index++) {
+        const util::PackedMesh& mesh = chunk_meshes[chunk_index];
+        if (mesh.get_indices().empty() && mesh.get_opaque_faces() != 0) {
+            empty_opaque_faces.emplace(
+                chunk_positions[chunk_index], mesh.get_opaque_faces()
+            );
+        }
+    }
+    return coalesced_data(std::move(blocks));
+}
+
+void
+World::update_all_chunks_mesh() {
+    LOG_DEBUG(logging::terrain_logger, "Begin load chunks mesh");
+    auto start = time_util::get_time_nanoseconds();
+
+    std::unordered_map<ChunkPos, uint8_t> empty_opaque_faces;
+    gui::gpu_data::detail::coalesced_data data = mesh_all_chunks(empty_opaque_faces);
+    auto mesh_end = time_util::get_time_nanoseconds();
+
     terrain_mesh_ = std::make_shared<gui::gpu_data::TerrainMesh>(
-        meshes_to_update_, terrain::TerrainColorMapping::get_color_texture()
+        std::move(data), terrain::TerrainColorMapping::get_color_texture()
+    );
+    auto coalesce_end = time_util::get_time_nanoseconds();
+    LOG_INFO(
+        logging::terrain_logger,
+        "Meshed and copied {} chunks in {} ms, and made the terrain mesh in {} ms.",
+        terrain_main_.num_chunks(),
+        static_cast<double>((mesh_end - start).count()) / 1e6,
+        static_cast<double>((coalesce_end - mesh_end).count()) / 1e6
     );
+    for (const auto& [chunk_pos, opaque_faces] : empty_opaque_faces) {
+        terrain_mesh_->set_opaque_faces(chunk_pos, opaque_faces);
+    }
 }
 
 // will be called once per frame
-void
+size_t
 World::send_updated_chunks_mesh() {
-    std::scoped_lock lock(meshes_to_update_mutex_);
-    for (const auto& [chunk_pos, mesh_data] : meshes_to_update_) {
-        terrain_mesh_->replace(chunk_pos, mesh_data);
+    size_t bytes = remesh_scheduler_.take_uploads(
+        [this](ChunkPos chunk_pos, const util::PackedMesh& mesh_data) {
+            if (terrain_mesh_->has_chunk(chunk_pos)) {
+                terrain_mesh_->replace(chunk_pos, mesh_data);
+            } else if (mesh_data.get_indices().size() > 0) {
+                terrain_mesh_->push_back(chunk_pos, mesh_data);
+            } else {
+                terrain_mesh_->set_opaque_faces(
+                    chunk_pos, mesh_data.get_opaque_faces()
+                );
+            }
+        }
+    );
+    if (bytes > 0) {
+        terrain_mesh_->compact_if_fragmented();
     }
+    return bytes;
 }
 
 void
 World::set_tile(
     TerrainOffset3 tile_sop, const terrain::material_t* mat, ColorId color_id
 ) {
-    terrain_main_.get_tile(tile_sop)->set_material(mat, color_id);
+    {
+        // path searches may be reading tiles
+        std::unique_lock lock(terrain_main_.get_nodegroup_mutex());
+        terrain_main_.get_tile(tile_sop)->set_material(mat, color_id);
+    }
+    path_service_.resume_pending();
+    terrain_main_.update_column_height(tile_sop);
+    terrain_main_.mark_nodegroups_dirty(tile_sop);
 
     mark_for_update(tile_sop);
 
@@ -226,30 +339,42 @@ World::remove_entity(std::shared_ptr<object::entity::EntityInstance> entity) {
     controller_.remove_entity(entity);
 }
 
-std::optional<std::vector<TerrainOffset3>>
-World::pathfind_to_object(
-    TerrainOffset3 start_position, const std::string& object_id
-) const {
+std::shared_ptr<const terrain::path::DistanceField>
+World::get_distance_field(const std::string& object_id) const {
     auto object = get_object_handler()->get_object(object_id);
     if (!object) {
         LOG_WARNING(logging::terrain_logger, "Object {} not found.", object_id);
-        return {};
+        return nullptr;
     }
-    // object->
 
-    std::unordered_set<TerrainOffset3> object_positions;
+    size_t object_version = controller_.get_tile_object_version(object_id);
 
-    // This makes me sad
-    // TODO fix the storage mechanism
-    // for (const auto& tile_entity : controller_) {
-    //     if (tile_entity->get_object() == object) {
-    //         object_positions.insert(tile_entity->get_terrain_position());
-    //     }
-    // }
+    std::scoped_lock lock(distance_fields_mutex_);
+    auto cached = distance_fields_.find(object_id);
+    if (cached != distance_fields_.end()
+        && cached->second.object_version == object_version
+        && cached->second.field->is_current(terrain_main_)) {
+        return cached->second.field;
+    }
 
-    auto path = terrain_main_.get_path_breadth_first(start_position, object_positions);
+    auto field = std::make_shared<const terrain::path::DistanceField>(
+        terrain_main_, controller_.get_tile_object_positions(object_id)
+    );
+    distance_fields_.insert_or_assign(
+        object_id, CachedDistanceField{field, object_version}
+    );
+    return field;
+}
 
-    return path;
+std::optional<std::vector<TerrainOffset3>>
+World::pathfind_to_object(
+    TerrainOffset3 start_position, const std::string& object_id
+) const {
+    auto field = get_distance_field(object_id);
+    if (!field) {
+        return {};
+    }
+    return field->get_path(terrain_main_, start_position);
 }
 
 } // namespace world
@@ -27,7 +27,11 @@
 #include "manifest/object_handler.hpp"
 #include "object/entity/entity.hpp"
 #include "object/entity_controller.hpp"
+#include "remesh_scheduler.hpp"
+#include "terrain/level_of_detail.hpp"
 #include "terrain/material.hpp"
+#include "terrain/path/distance_field.hpp"
+#include "terrain/path/path_service.hpp"
 #include "terrain/terrain.hpp"
 #include "types.hpp"
 
@@ -38,11 +42,6 @@
 #include <unordered_set>
 #include <vector>
 
-// forward declaration of util::Mesh
-namespace util {
-class Mesh;
-}
-
 namespace world {
 
 /**
@@ -61,22 +60,31 @@ class World {
     // terrain in the world
     terrain::Terrain terrain_main_;
 
+    // batched path searches on terrain_main_
+    terrain::path::PathService path_service_;
+
     object::EntityController controller_;
 
+    // level of detail of each chunk mesh
+    terrain::LodSelector lod_selector_;
+
     // TerrainMesh for all terrain
     std::shared_ptr<gui::gpu_data::TerrainMesh> terrain_mesh_;
     // chunks_mesh like attorneys general
 
-    // Set of chunks that need to be updated on gpu.
-    // They Need to be re-meshed, and that mesh need to be sent to gpu.
-    std::unordered_set<ChunkPos> chunks_to_update_;
+    // Chunks that need to be re-meshed, and meshes that need to be sent to
+    // the gpu.
+    RemeshScheduler remesh_scheduler_;
+
+    struct CachedDistanceField {
+        std::shared_ptr<const terrain::path::DistanceField> field;
+        // tile object version the field was built from
+        size_t object_version;
+    };
 
-    // Set of meshes that need to be sent to gpu. These meshes should be sent
-    // once per frame.
-    std::unordered_map<ChunkPos, util::Mesh> meshes_to_update_;
-    // Multiple threads are writing to this map concurrently so this is its
-    // mutex
-    std::mutex meshes_to_update_mutex_;
+    // distance fields to each tile object identification
+    mutable std::unordered_map<std::string, CachedDistanceField> distance_fields_;
+    mutable std::mutex distance_fields_mutex_;
 
  public:
     /**
@@ -95,6 +103,14 @@ class World {
         return terrain_main_;
     }
 
+    /**
+     * @brief Get the service that runs path searches on the terrain
+     */
+    [[nodiscard]] inline const terrain::path::PathService&
+    get_path_service() const {
+        return path_service_;
+    }
+
     /**
      * @brief Get object handler
      */
@@ -189,7 +205,7 @@ class World {
      */
     void
     mark_chunk_for_update(ChunkPos chunk_pos) {
-        chunks_to_update_.insert(chunk_pos);
+        remesh_scheduler_.mark(chunk_pos);
     }
 
     /**
@@ -204,19 +220,69 @@ class World {
     }
 
     /**
-     * @brief Runs a loop over marked chunks and generates a mesh.
+     * @brief Start meshing the most important marked chunks.
+     *
+     * @details Chunks in front of the camera go first, then the closest. At
+     * most RemeshScheduler::set_max_in_flight jobs run at once, the others
+     * wait for a later call.
+     *
+     * @param camera_position position of the camera in tiles
+     * @param view_direction direction the camera faces, zero if unknown
      */
-    void update_marked_chunks_mesh();
+    void update_marked_chunks_mesh(
+        glm::vec3 camera_position = glm::vec3(0.0f),
+        glm::vec3 view_direction = glm::vec3(0.0f)
+    );
 
     /**
      * @brief Generates a mesh for a single chunk.
+     *
+     * @details The mesh is sent to the gpu by send_updated_chunks_mesh.
+     *
+     * @param lod level of detail and seams to mesh the chunk at
      */
-    void update_single_mesh(ChunkPos chunk_pos);
+    void update_single_mesh(ChunkPos chunk_pos, terrain::ChunkLod lod = {});
 
     /**
-     * @brief Sends chunk mesh data to gpu.
+     * @brief Choose the level of detail of each chunk from the camera position
+     *
+     * @details Chunks whose level of detail, or seams, changed are marked for
+     * update.
+     *
+     * @param camera_position position of the camera in tiles
      */
-    void send_updated_chunks_mesh();
+    void update_level_of_detail(glm::vec3 camera_position);
+
+    /**
+     * @brief Get the level of detail of each chunk
+     */
+    [[nodiscard]] inline const terrain::LodSelector&
+    get_lod_selector() const noexcept {
+        return lod_selector_;
+    }
+
+    /**
+     * @brief Sends chunk mesh data to gpu, up to the upload budget.
+     *
+     * @return size_t bytes sent
+     */
+    size_t send_updated_chunks_mesh();
+
+    /**
+     * @brief Get the remesh scheduler, to read metrics or change limits.
+     */
+    [[nodiscard]] inline RemeshScheduler&
+    get_remesh_scheduler() noexcept {
+        return remesh_scheduler_;
+    }
+
+    /**
+     * @brief Get queue depth and latency of remeshing.
+     */
+    [[nodiscard]] inline RemeshScheduler::Metrics
+    get_remesh_metrics() const {
+        return remesh_scheduler_.get_metrics();
+    }
 
     /**
      * @brief Update all chunk mesh.
@@ -226,6 +292,31 @@ class World {
      */
     void update_all_chunks_mesh();
 
+    /**
+     * @brief Mesh every chunk on the thread pool and copy the meshes into
+     * blocks for the terrain mesh
+     *
+     * @details The task that finishes the last chunk of a block copies that
+     * block, so copying overlaps meshing. Do not call from the thread pool.
+     *
+     * @param empty_opaque_faces filled with the opaque faces of chunks that
+     * have nothing to draw
+     */
+    [[nodiscard]] gui::gpu_data::detail::coalesced_data
+    mesh_all_chunks(std::unordered_map<ChunkPos, uint8_t>& empty_opaque_faces) const;
+
+    /**
+     * @brief Rebuild node groups near tiles changed since the last call.
+     *
+     * @details Should be called once per frame. Path requests that waited
+     * for the node groups are then queued again.
+     */
+    inline void
+    update_nodegroups() {
+        terrain_main_.update_dirty_nodegroups();
+        path_service_.resume_pending();
+    }
+
     // set a region to given material, and color
     /**
      * @brief Set a tile to have a material and color
@@ -251,6 +342,27 @@ class World {
         controller_.load_to_gup();
     }
 
+    /**
+     * @brief Get the distance field to the closest tile object with object_id
+     *
+     * @details The field is cached, and rebuilt when the node groups change,
+     * or a tile object with object_id is spawned or removed.
+     *
+     * @param object_id identification of tile object
+     * @return std::shared_ptr<const terrain::path::DistanceField> distance
+     * field, nullptr if object_id does not exist
+     */
+    [[nodiscard]] std::shared_ptr<const terrain::path::DistanceField>
+    get_distance_field(const std::string& object_id) const;
+
+    /**
+     * @brief Get a path to the closest tile object with object_id
+     *
+     * @param start_position start tile
+     * @param object_id identification of tile object
+     * @return std::optional<std::vector<TerrainOffset3>> path from the object
+     * back to start
+     */
     [[nodiscard]] std::optional<std::vector<TerrainOffset3>> pathfind_to_object(
         TerrainOffset3 start_position, const std::string& object_id
     ) const;
@@ -278,6 +390,10 @@ class World {
     }
 
  private:
+    // mesh a chunk, and convert colors to the gpu color ids
+    [[nodiscard]] util::PackedMesh
+    mesh_chunk_(const terrain::Chunk& chunk, terrain::ChunkLod lod) const;
+
     inline void
     initialize_terrain_mesh_() {
         terrain_mesh_ = std::make_shared<gui::gpu_data::TerrainMesh>();